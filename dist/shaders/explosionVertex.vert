@@ -1,17 +1,36 @@
 #version 140
 
-uniform mat4 PVMmatrix;        // Projection * View * Model --> model to clip coordinates
+layout(std140) uniform FrameData {  // per frame values shared by all programs, FrameUniforms
+	mat4  Vmatrix;             // View --> world to eye coordinates
+	mat4  Pmatrix;             // Projection --> eye to clip coordinates
+	mat4  PVmatrix;            // Projection * View
+	vec4  sunDirection;
+	vec4  fogColor;
+	float fogDensity;
+	int   fogActive;
+};
 
-in vec3 position;              // vertex position in world space
+uniform float time;            // elapsed time in seconds, selects the animation frame
+
+in vec3 position;              // corner of the quad, -1 .. 1
 in vec2 texCoord;              // incoming texture coordinates
+in vec4 explosion;             // center and half size of the billboard, one per instance
+in vec2 explosionTime;         // start time and frame duration, one per instance
 
 smooth out vec2 texCoord_v;    // outgoing vertex texture coordinates
+flat out int frame_v;          // animation frame of the whole billboard
 
 void main() {
-	
+
+	// rows of the view rotation are the camera axes in world coordinates, the quad faces the camera
+	vec3 right = vec3(Vmatrix[0][0], Vmatrix[1][0], Vmatrix[2][0]);
+	vec3 up = vec3(Vmatrix[0][1], Vmatrix[1][1], Vmatrix[2][1]);
+	vec3 worldPosition = explosion.xyz + explosion.w * (position.x * right + position.y * up);
+
 	// vertex position after the projection (gl_Position is predefined output variable)
-	gl_Position = PVMmatrix * vec4(position, 1);   // outgoing vertex in clip coordinates
+	gl_Position = PVmatrix * vec4(worldPosition, 1.0f);   // outgoing vertex in clip coordinates
 
 	// outputs entering the fragment shader
 	texCoord_v = texCoord;
+	frame_v = int((time - explosionTime.x) / explosionTime.y);
 }
@@ -0,0 +1,48 @@
+#version 430
+#extension GL_ARB_shader_draw_parameters : require
+
+layout(std140) uniform FrameData {  // per frame values shared by all programs, FrameUniforms
+	mat4  Vmatrix;             // View --> world to eye coordinates
+	mat4  Pmatrix;             // Projection --> eye to clip coordinates
+	mat4  PVmatrix;            // Projection * View
+	vec4  sunDirection;
+	vec4  fogColor;
+	float fogDensity;
+	int   fogActive;
+};
+
+struct DrawData {              // per draw values of the multi-draw indirect calls, RenderDrawData
+	mat4  Mmatrix;             // Model --> model to world coordinates
+	mat4  normalMatrix;        // inverse transposed VMmatrix
+	uint  material;            // index to the materials of the frame
+	uint  objectId;            // packed PickHandle
+};
+
+layout(std430, binding = 0) readonly buffer DrawBuffer {  // RENDER_DRAW_DATA_BINDING
+	DrawData draws[];
+};
+
+in vec3 position;           
+in vec3 normal;            
+in vec2 texCoord;           
+
+smooth out vec2 texCoord_v;  
+smooth out vec3 normal_v;      //normal in eye coord
+smooth out vec3 position_v;    //vertex in eye coord
+flat out uint material_v;      //index to the materials of the frame
+flat out uint objectId_v;
+
+
+void main() {
+	// base instance is the first draw of the multi-draw call
+	DrawData draw = draws[gl_BaseInstanceARB + gl_DrawIDARB];
+
+	vec4 worldPosition = draw.Mmatrix * vec4(position, 1.0f);
+
+	normal_v = normalize(draw.normalMatrix * vec4(normal, 0.0f)).xyz;   // normal in eye coordinates by NormalMatrix
+	position_v = (Vmatrix * worldPosition).xyz ;
+	texCoord_v = texCoord;
+	material_v = draw.material;
+	objectId_v = draw.objectId;
+	gl_Position = PVmatrix * worldPosition;   
+}
@@ -1,22 +1,35 @@
 #version 140
 
+layout(std140) uniform FrameData {  // per frame values shared by all programs, FrameUniforms
+	mat4  Vmatrix;             // View --> world to eye coordinates
+	mat4  Pmatrix;             // Projection --> eye to clip coordinates
+	mat4  PVmatrix;            // Projection * View
+	vec4  sunDirection;
+	vec4  fogColor;
+	float fogDensity;
+	int   fogActive;
+};
+
 in vec3 position;           
 in vec3 normal;            
 in vec2 texCoord;           
+in uint objectId;              // packed PickHandle, constant attribute set by the render queue
 
 smooth out vec2 texCoord_v;  
 smooth out vec3 normal_v;      //normal in eye coord
 smooth out vec3 position_v;    //vertex in eye coord
+flat out uint objectId_v;
 
 uniform mat4 normalMatrix;     // inverse transposed VMmatrix
-uniform mat4 PVMmatrix;   
-uniform mat4 Vmatrix;          // View --> world to eye coordinates
 uniform mat4 Mmatrix;          // Model --> model to world coordinates
 
 
 void main() {
+	vec4 worldPosition = Mmatrix * vec4(position, 1.0f);
+
 	normal_v = normalize(normalMatrix * vec4(normal, 0.0f)).xyz;   // normal in eye coordinates by NormalMatrix
-	position_v = (Vmatrix * Mmatrix * vec4(position, 1.0f)).xyz ;
+	position_v = (Vmatrix * worldPosition).xyz ;
 	texCoord_v = texCoord;
-	gl_Position = PVMmatrix * vec4(position, 1.0f);   
+	objectId_v = objectId;
+	gl_Position = PVmatrix * worldPosition;   
 }
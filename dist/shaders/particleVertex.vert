@@ -0,0 +1,36 @@
+#version 140
+
+layout(std140) uniform FrameData {  // per frame values shared by all programs, FrameUniforms
+	mat4  Vmatrix;             // View --> world to eye coordinates
+	mat4  Pmatrix;             // Projection --> eye to clip coordinates
+	mat4  PVmatrix;            // Projection * View
+	vec4  sunDirection;
+	vec4  fogColor;
+	float fogDensity;
+	int   fogActive;
+};
+
+in vec3 position;              // corner of the quad, -1 .. 1
+in vec4 particle;              // center and half size of the billboard, one per instance
+in float particleLife;         // age / lifetime of the particle, one per instance
+in vec4 particleColor;         // alpha 0 is added (sparks), one per instance
+
+smooth out vec2 corner_v;      // position in the quad, the particle is a disc
+smooth out vec4 color_v;       // color with premultiplied alpha
+
+void main() {
+
+	// rows of the view rotation are the camera axes in world coordinates, the quad faces the camera
+	vec3 right = vec3(Vmatrix[0][0], Vmatrix[1][0], Vmatrix[2][0]);
+	vec3 up = vec3(Vmatrix[0][1], Vmatrix[1][1], Vmatrix[2][1]);
+	vec3 worldPosition = particle.xyz + particle.w * (position.x * right + position.y * up);
+
+	gl_Position = PVmatrix * vec4(worldPosition, 1.0f);
+
+	// the particle fades out during its life
+	float fade = 1.0f - clamp(particleLife, 0.0f, 1.0f);
+	float weight = particleColor.a > 0.0f ? particleColor.a : 1.0f;
+
+	corner_v = position.xy;
+	color_v = vec4(particleColor.rgb * weight, particleColor.a) * fade;
+}
@@ -0,0 +1,272 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       assetRegistry.cpp
+* \author     agent
+* \date       2026
+* \brief      Shared textures and model geometries with reference counting.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#include <ctype.h>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <vector>
+#include "pgr.h"
+#include "objects.h"
+#include "assetRegistry.h"
+
+#define ASSET_TEXTURE 0
+#define ASSET_MESH    1
+
+/**
+*	struct for a resident asset
+*
+*/
+typedef struct Asset {
+	std::string   path;        // path used when the asset was registered
+	int           type;        // ASSET_TEXTURE or ASSET_MESH
+	unsigned int  references;
+	size_t        cpuBytes;    // memory kept by the application
+	size_t        gpuBytes;    // memory of OpenGL buffers and textures
+	GLuint        texture;
+	MeshGeometry* geometry;
+} Asset;
+
+// resident assets by canonical path
+static std::map<std::string, Asset> assets;
+
+/**
+*	Returns path usable as a key of the asset: forward slashes, lower case (Windows file names),
+*	without "." and "dir/.." components.
+*	\param[in] path Relative or absolute file path.
+*/
+std::string canonicalAssetPath(const std::string &path) {
+
+	std::vector<std::string> components;
+	std::string component;
+
+	for (size_t i = 0; i <= path.size(); i++) {
+		char c = i < path.size() ? path[i] : '/';
+
+		if (c != '/' && c != '\\') {
+			component += (char)tolower((unsigned char)c);
+			continue;
+		}
+
+		if (component == "..") {
+			if (!components.empty() && components.back() != "..")
+				components.pop_back();
+			else
+				components.push_back(component);
+		}
+		else if (!component.empty() && component != ".") {
+			components.push_back(component);
+		}
+		component.clear();
+	}
+
+	std::string canonical = (!path.empty() && (path[0] == '/' || path[0] == '\\')) ? "/" : "";
+	for (size_t i = 0; i < components.size(); i++) {
+		if (i > 0)
+			canonical += '/';
+		canonical += components[i];
+	}
+
+	return canonical;
+}
+
+/**
+*	Returns true if the asset is resident. Workers may call it while the main thread waits for them.
+*	\param[in] path File of the asset.
+*/
+bool isAssetResident(const std::string &path) {
+	return assets.find(canonicalAssetPath(path)) != assets.end();
+}
+
+/**
+*	Finds resident asset of given type and adds a reference.
+*/
+static Asset* acquireAsset(const std::string &path, int type) {
+
+	std::map<std::string, Asset>::iterator it = assets.find(canonicalAssetPath(path));
+	if (it == assets.end() || it->second.type != type)
+		return NULL;
+
+	it->second.references++;
+	return &it->second;
+}
+
+/**
+*	Makes the asset resident with one reference.
+*/
+static Asset* registerAsset(const std::string &path, int type, size_t cpuBytes, size_t gpuBytes) {
+
+	std::string key = canonicalAssetPath(path);
+	if (assets.find(key) != assets.end())
+		std::cerr << "registerAsset(): " << path << " is already resident, replacing it" << std::endl;
+
+	Asset *asset = &assets[key];
+	asset->path = path;
+	asset->type = type;
+	asset->references = 1;
+	asset->cpuBytes = cpuBytes;
+	asset->gpuBytes = gpuBytes;
+	asset->texture = 0;
+	asset->geometry = NULL;
+
+	return asset;
+}
+
+/**
+*	Removes one reference, the asset stays resident until evictUnusedAssets().
+*/
+static void releaseAsset(Asset *asset) {
+
+	if (asset->references == 0) {
+		std::cerr << "releaseAsset(): " << asset->path << " has no references" << std::endl;
+		return;
+	}
+	asset->references--;
+}
+
+/**
+*	Returns resident texture loaded from the file and adds a reference.
+*	\param[in] path Image file.
+*	\return Texture name or 0 if the texture is not resident.
+*/
+GLuint acquireTexture(const std::string &path) {
+	Asset *asset = acquireAsset(path, ASSET_TEXTURE);
+	return asset != NULL ? asset->texture : 0;
+}
+
+/**
+*	Makes created texture resident, the caller owns the first reference.
+*	\param[in] path     Image file.
+*	\param[in] texture  Texture name, 0 if the image could not be loaded.
+*	\param[in] gpuBytes Texture memory including mipmaps.
+*	\return The texture.
+*/
+GLuint registerTexture(const std::string &path, GLuint texture, size_t gpuBytes) {
+
+	if (texture == 0)
+		return 0;
+
+	registerAsset(path, ASSET_TEXTURE, 0, gpuBytes)->texture = texture;
+	return texture;
+}
+
+/**
+*	Removes one reference of the texture.
+*	\param[in] texture Texture returned by acquireTexture() or registerTexture(), may be 0.
+*/
+void releaseTexture(GLuint texture) {
+
+	if (texture == 0)
+		return;
+
+	for (std::map<std::string, Asset>::iterator it = assets.begin(); it != assets.end(); ++it) {
+		if (it->second.type == ASSET_TEXTURE && it->second.texture == texture) {
+			releaseAsset(&it->second);
+			return;
+		}
+	}
+
+	std::cerr << "releaseTexture(): texture " << texture << " is not registered" << std::endl;
+}
+
+/**
+*	Returns resident geometry of the model and adds a reference.
+*	\param[in] path Model file.
+*	\return Geometry or NULL if the model is not resident.
+*/
+MeshGeometry* acquireMesh(const std::string &path) {
+	Asset *asset = acquireAsset(path, ASSET_MESH);
+	return asset != NULL ? asset->geometry : NULL;
+}
+
+/**
+*	Makes created model geometry resident, the caller owns the first reference.
+*	The registry deletes the geometry and releases its material textures when it is evicted.
+*	\param[in] path     Model file.
+*	\param[in] geometry Uploaded geometry.
+*	\param[in] cpuBytes Memory of the geometry structure.
+*	\param[in] gpuBytes Memory of the vertex and element buffers.
+*/
+void registerMesh(const std::string &path, MeshGeometry *geometry, size_t cpuBytes, size_t gpuBytes) {
+	registerAsset(path, ASSET_MESH, cpuBytes, gpuBytes)->geometry = geometry;
+}
+
+/**
+*	Removes one reference of the model geometry.
+*	\param[in] geometry Geometry returned by acquireMesh() or registered by registerMesh(), may be NULL.
+*/
+void releaseMesh(MeshGeometry *geometry) {
+
+	if (geometry == NULL)
+		return;
+
+	for (std::map<std::string, Asset>::iterator it = assets.begin(); it != assets.end(); ++it) {
+		if (it->second.type == ASSET_MESH && it->second.geometry == geometry) {
+			releaseAsset(&it->second);
+			return;
+		}
+	}
+
+	std::cerr << "releaseMesh(): geometry is not registered" << std::endl;
+}
+
+/**
+*	Frees all assets without references. Meshes go first, they release the textures of their materials.
+*	\return Number of evicted assets.
+*/
+unsigned int evictUnusedAssets() {
+
+	unsigned int evicted = 0;
+
+	for (int type = ASSET_MESH; type >= ASSET_TEXTURE; type--) {
+		std::map<std::string, Asset>::iterator it = assets.begin();
+		while (it != assets.end()) {
+			Asset *asset = &it->second;
+
+			if (asset->type != type || asset->references > 0) {
+				++it;
+				continue;
+			}
+
+			if (asset->type == ASSET_MESH)
+				deleteGeometry(asset->geometry);
+			else
+				glDeleteTextures(1, &asset->texture);
+
+			assets.erase(it++);
+			evicted++;
+		}
+	}
+	CHECK_GL_ERROR();
+
+	return evicted;
+}
+
+/**
+*	Prints references and memory of all resident assets.
+*/
+void printAssetReport() {
+
+	size_t cpuBytes = 0, gpuBytes = 0;
+
+	std::cout << "Resident assets:" << std::endl;
+	for (std::map<std::string, Asset>::const_iterator it = assets.begin(); it != assets.end(); ++it) {
+		const Asset &asset = it->second;
+
+		std::cout << "  " << (asset.type == ASSET_MESH ? "mesh    " : "texture ")
+			<< std::setw(3) << asset.references << " refs "
+			<< std::setw(7) << asset.cpuBytes / 1024 << " KB CPU "
+			<< std::setw(7) << asset.gpuBytes / 1024 << " KB GL  " << it->first << std::endl;
+
+		cpuBytes += asset.cpuBytes;
+		gpuBytes += asset.gpuBytes;
+	}
+	std::cout << "  " << assets.size() << " assets, " << cpuBytes / 1024 << " KB CPU, " << gpuBytes / 1024 << " KB GL" << std::endl;
+}
@@ -0,0 +1,39 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       assetRegistry.h
+* \author     agent
+* \date       2026
+* \brief      Shared textures and model geometries with reference counting.
+*
+*	Assets are keyed by the canonical path of their file, so a texture referenced by several
+*	models is decoded and uploaded only once. acquire*() returns a resident asset and adds
+*	a reference, register*() makes a newly created asset resident with one reference.
+*	Assets without references stay resident until evictUnusedAssets() is called.
+*	All functions have to be called from the thread owning the OpenGL context.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#ifndef __ASSETREGISTRY_H
+#define __ASSETREGISTRY_H
+
+#include "pgr.h"
+#include <string>
+
+struct MeshGeometry;
+
+std::string canonicalAssetPath(const std::string &path);
+bool isAssetResident(const std::string &path);
+
+GLuint acquireTexture(const std::string &path);
+GLuint registerTexture(const std::string &path, GLuint texture, size_t gpuBytes);
+void releaseTexture(GLuint texture);
+
+MeshGeometry* acquireMesh(const std::string &path);
+void registerMesh(const std::string &path, MeshGeometry *geometry, size_t cpuBytes, size_t gpuBytes);
+void releaseMesh(MeshGeometry *geometry);
+
+unsigned int evictUnusedAssets();
+void printAssetReport();
+
+#endif
@@ -0,0 +1,377 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       benchmark.cpp
+* \author     agent
+* \date       2026
+* \brief      Performance measurements run from the command line.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <vector>
+#include <stdlib.h>
+#include <math.h>
+#include "pgr.h"
+#include "objects.h"
+#include "meshCache.h"
+#include "vertexFormat.h"
+#include "timer.h"
+#include "uniformBuffers.h"
+#include "spline.h"
+#include "transforms.h"
+#include "particles.h"
+#include "threadPool.h"
+#include "lightClusters.h"
+#include "parameters.h"
+#include "benchmark.h"
+
+#define BENCHMARK_DRAW_ITERATIONS 500
+#define BENCHMARK_REPEATS         5
+#define BENCHMARK_TRANSFORMS      100000
+#define BENCHMARK_PARTICLE_FRAMES 100
+#define BENCHMARK_LIGHT_FRAMES    50
+
+extern SCommonShaderProgram shaderProgram;
+extern const char* CAT_MODEL_NAME;
+extern const char* STOP_MODEL_NAME;
+
+/**
+*	Measures time of repeated indexed draws of one mesh.
+*	\param[in] vertexArrayObject Vao to draw.
+*	\param[in] numIndices        Number of indices to draw.
+*	\param[in] indexType         Type of indices in the element buffer.
+*	\return Time in seconds.
+*/
+static double timeMeshDraws(GLuint vertexArrayObject, GLsizei numIndices, GLenum indexType) {
+
+	glBindVertexArray(vertexArrayObject);
+
+	// warm up, the first draw may include driver side validation
+	glDrawElements(GL_TRIANGLES, numIndices, indexType, 0);
+	glFinish();
+
+	double startTime = highResolutionTime();
+	for (int i = 0; i < BENCHMARK_DRAW_ITERATIONS; i++)
+		glDrawElements(GL_TRIANGLES, numIndices, indexType, 0);
+	glFinish();
+
+	return highResolutionTime() - startTime;
+}
+
+/**
+*	Creates vao reading given vertex buffer, the attributes are set by the caller.
+*/
+static GLuint createBenchmarkVertexArray(GLuint vertexBuffer, GLuint elementBuffer) {
+	GLuint vertexArray;
+
+	glGenVertexArrays(1, &vertexArray);
+	glBindVertexArray(vertexArray);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+
+	return vertexArray;
+}
+
+/**
+*	Compares vertex throughput of the planar |VVV...|NNN...|TT...| layout, the interleaved float layout
+*	and the interleaved compact layout with 16-bit indices.
+*	\param[in] name     Name of the mesh.
+*	\param[in] fileName Model file.
+*/
+static void measureVertexThroughput(const char *name, const char *fileName) {
+
+	MeshData data;
+	bool cacheHit;
+
+	if (!loadMeshData(fileName, &data, &cacheHit)) {
+		std::cerr << "measureVertexThroughput(): " << name << " model loading failed" << std::endl;
+		return;
+	}
+
+	unsigned int numVertices = data.numVertices;
+	GLsizei numIndices = 3 * data.lodNumTriangles[0];
+
+	// rebuild the original planar layout
+	std::vector<float> planar(MESH_VERTEX_SIZE * numVertices);
+	for (unsigned int v = 0; v < numVertices; v++) {
+		const float *vertex = data.vertices + MESH_VERTEX_SIZE * v;
+		for (int i = 0; i < 3; i++) {
+			planar[3 * v + i] = vertex[i];
+			planar[3 * (numVertices + v) + i] = vertex[3 + i];
+		}
+		planar[6 * numVertices + 2 * v + 0] = vertex[6];
+		planar[6 * numVertices + 2 * v + 1] = vertex[7];
+	}
+
+	std::vector<unsigned char> compact;
+	std::vector<unsigned char> packedIndices;
+	packMeshVertices(data.vertices, numVertices, MESH_FORMAT_COMPACT, &compact);
+	GLenum packedIndexType = packMeshIndices(data.indices, numIndices, numVertices, &packedIndices);
+
+	GLuint buffers[5];
+	glGenBuffers(5, buffers);
+
+	glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+	glBufferData(GL_ARRAY_BUFFER, planar.size() * sizeof(float), &planar[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers[1]);
+	glBufferData(GL_ARRAY_BUFFER, MESH_VERTEX_SIZE * sizeof(float) * numVertices, data.vertices, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers[2]);
+	glBufferData(GL_ARRAY_BUFFER, compact.size(), &compact[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[3]);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, numIndices * sizeof(unsigned int), data.indices, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[4]);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, packedIndices.size(), &packedIndices[0], GL_STATIC_DRAW);
+
+	GLuint planarVertexArray = createBenchmarkVertexArray(buffers[0], buffers[3]);
+	glEnableVertexAttribArray(shaderProgram.posLocation);
+	glVertexAttribPointer(shaderProgram.posLocation, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	glEnableVertexAttribArray(shaderProgram.normalLocation);
+	glVertexAttribPointer(shaderProgram.normalLocation, 3, GL_FLOAT, GL_FALSE, 0, (void*)(3 * sizeof(float) * numVertices));
+	glEnableVertexAttribArray(shaderProgram.texCoordLocation);
+	glVertexAttribPointer(shaderProgram.texCoordLocation, 2, GL_FLOAT, GL_FALSE, 0, (void*)(6 * sizeof(float) * numVertices));
+
+	GLuint interleavedVertexArray = createBenchmarkVertexArray(buffers[1], buffers[3]);
+	setVertexFormatAttributes(MESH_FORMAT_FLOAT, shaderProgram.posLocation, shaderProgram.normalLocation, shaderProgram.texCoordLocation);
+
+	GLuint compactVertexArray = createBenchmarkVertexArray(buffers[2], buffers[4]);
+	setVertexFormatAttributes(MESH_FORMAT_COMPACT, shaderProgram.posLocation, shaderProgram.normalLocation, shaderProgram.texCoordLocation);
+
+	glBindVertexArray(0);
+	CHECK_GL_ERROR();
+
+	// alternate the layouts and keep the best time of each to suppress noise
+	double planarTime = 1e30, interleavedTime = 1e30, compactTime = 1e30;
+	for (int r = 0; r < BENCHMARK_REPEATS; r++) {
+		planarTime = std::min(planarTime, timeMeshDraws(planarVertexArray, numIndices, GL_UNSIGNED_INT));
+		interleavedTime = std::min(interleavedTime, timeMeshDraws(interleavedVertexArray, numIndices, GL_UNSIGNED_INT));
+		compactTime = std::min(compactTime, timeMeshDraws(compactVertexArray, numIndices, packedIndexType));
+	}
+
+	double processedVertices = (double)numIndices * BENCHMARK_DRAW_ITERATIONS;
+
+	std::cout << std::fixed << std::setprecision(1)
+		<< name << " (" << numVertices << " vertices, " << data.lodNumTriangles[0] << " triangles): "
+		<< "planar " << processedVertices / planarTime * 1e-6 << " Mvert/s, "
+		<< "interleaved " << processedVertices / interleavedTime * 1e-6 << " Mvert/s, "
+		<< "compact " << processedVertices / compactTime * 1e-6 << " Mvert/s, "
+		<< std::setprecision(2) << "speedup " << planarTime / interleavedTime << "x / " << planarTime / compactTime << "x" << std::endl;
+
+	glDeleteVertexArrays(1, &planarVertexArray);
+	glDeleteVertexArrays(1, &interleavedVertexArray);
+	glDeleteVertexArrays(1, &compactVertexArray);
+	glDeleteBuffers(5, buffers);
+
+	releaseMeshData(&data);
+}
+
+/**
+*	Measures vertex fetch and vertex shader throughput, rasterization is discarded.
+*/
+static void benchmarkVertexThroughput() {
+
+	glm::mat4 identity(1.0f);
+
+	FrameUniforms frame = FrameUniforms();
+	frame.viewMatrix = identity;
+	frame.projectionMatrix = identity;
+	frame.PVmatrix = identity;
+	uploadFrameUniforms(frame);
+
+	glUseProgram(shaderProgram.program);
+	glUniformMatrix4fv(shaderProgram.MmatrixLocation, 1, GL_FALSE, glm::value_ptr(identity));
+	glUniformMatrix4fv(shaderProgram.normalMatrixLocation, 1, GL_FALSE, glm::value_ptr(identity));
+
+	glEnable(GL_RASTERIZER_DISCARD);
+
+	std::cout << "Vertex throughput, " << BENCHMARK_DRAW_ITERATIONS << " draws per measurement:" << std::endl;
+	measureVertexThroughput("cat", CAT_MODEL_NAME);
+	measureVertexThroughput("stop", STOP_MODEL_NAME);
+
+	glDisable(GL_RASTERIZER_DISCARD);
+	glUseProgram(0);
+}
+
+/**
+*	Returns random number in <min, max>.
+*/
+static float randomFloat(float min, float max) {
+	return min + (max - min) * (float)rand() / RAND_MAX;
+}
+
+/**
+*	Returns the largest absolute difference of the elements of two matrices.
+*/
+static float matrixDifference(const glm::mat4 &a, const glm::mat4 &b) {
+	float difference = 0.0f;
+	for (int c = 0; c < 4; c++)
+		for (int r = 0; r < 4; r++)
+			difference = std::max(difference, fabsf(a[c][r] - b[c][r]));
+	return difference;
+}
+
+/**
+*	Compares model and normal matrices computed per object (alignObject, glm::scale and the general inverse)
+*	with the SIMD batches of computeTransforms().
+*/
+static void benchmarkTransforms() {
+
+	srand(51);
+
+	TransformArrays transforms;
+	clearTransforms(&transforms);
+	for (int i = 0; i < BENCHMARK_TRANSFORMS; i++) {
+		glm::vec3 position(randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f), randomFloat(0.0f, 0.5f));
+		glm::vec3 front(randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f), randomFloat(-0.2f, 0.2f));
+		addTransform(&transforms, position, front, glm::vec3(0.0f, 0.0f, 1.0f), randomFloat(0.01f, 0.2f));
+	}
+
+	glm::mat4 viewMatrix = glm::lookAt(glm::vec3(0.0f, -1.0f, 0.5f), glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+
+	std::vector<glm::mat4> models(BENCHMARK_TRANSFORMS), normals(BENCHMARK_TRANSFORMS);
+	std::vector<glm::mat4> batchModels(BENCHMARK_TRANSFORMS), batchNormals(BENCHMARK_TRANSFORMS);
+
+	// alternate the paths and keep the best time of each to suppress noise
+	double objectTime = 1e30, batchTime = 1e30;
+	for (int r = 0; r < BENCHMARK_REPEATS; r++) {
+		double startTime = highResolutionTime();
+		for (int i = 0; i < BENCHMARK_TRANSFORMS; i++) {
+			glm::vec3 position(transforms.positionX[i], transforms.positionY[i], transforms.positionZ[i]);
+			glm::vec3 front(transforms.frontX[i], transforms.frontY[i], transforms.frontZ[i]);
+			glm::vec3 up(transforms.upX[i], transforms.upY[i], transforms.upZ[i]);
+
+			glm::mat4 modelMatrix = alignObject(position, front, up);
+			models[i] = glm::scale(modelMatrix, glm::vec3(transforms.scale[i]));
+			normals[i] = glm::transpose(glm::inverse(viewMatrix * models[i]));
+		}
+		objectTime = std::min(objectTime, highResolutionTime() - startTime);
+
+		startTime = highResolutionTime();
+		computeTransforms(transforms, viewMatrix, &batchModels[0], &batchNormals[0]);
+		batchTime = std::min(batchTime, highResolutionTime() - startTime);
+	}
+
+	// the normal matrix of the shaders is only the upper 3x3 part
+	float modelDifference = 0.0f, normalDifference = 0.0f;
+	for (int i = 0; i < BENCHMARK_TRANSFORMS; i++) {
+		modelDifference = std::max(modelDifference, matrixDifference(models[i], batchModels[i]));
+		glm::mat4 normal = glm::mat4(glm::mat3(normals[i]));
+		glm::mat4 batchNormal = glm::mat4(glm::mat3(batchNormals[i]));
+		normalDifference = std::max(normalDifference, matrixDifference(normal, batchNormal) / std::max(1.0f, matrixDifference(normal, glm::mat4(0.0f))));
+	}
+
+	std::cout << "Transforms of " << BENCHMARK_TRANSFORMS << " objects:" << std::endl
+		<< std::fixed << std::setprecision(2)
+		<< "per object " << objectTime * 1e3 << " ms, "
+		<< "SIMD batches " << batchTime * 1e3 << " ms, "
+		<< "speedup " << objectTime / batchTime << "x" << std::endl
+		<< std::scientific << std::setprecision(1)
+		<< "max difference: model " << modelDifference << ", normal " << normalDifference << " (relative)" << std::endl;
+}
+
+/**
+*	Simulates a full particle system for a number of frames and compares the time of one frame
+*	(simulation and writing of the instances) with the refresh interval.
+*/
+static void benchmarkParticles() {
+
+	srand(51);
+
+	ParticleSystem particles;
+	initParticleSystem(&particles);
+	while (particles.count < PARTICLE_CAPACITY) {
+		glm::vec3 position(randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f), randomFloat(0.0f, 0.2f));
+		if (spawnExplosionParticles(&particles, position, 0.1f) == 0)
+			break;
+	}
+	// particles must not die during the measurement
+	for (unsigned int i = 0; i < particles.count; i++)
+		particles.lifetime[i] = 1e6f;
+
+	std::vector<ParticleInstance> instances(PARTICLE_CAPACITY);
+	const float deltaTime = SIMULATION_STEP;
+
+	double updateTime = 0.0, writeTime = 0.0;
+	for (int f = 0; f < BENCHMARK_PARTICLE_FRAMES; f++) {
+		double startTime = highResolutionTime();
+		updateParticles(&particles, deltaTime, 0.0f);
+		double updatedTime = highResolutionTime();
+		writeParticleInstances(particles, &instances[0]);
+		writeTime += highResolutionTime() - updatedTime;
+		updateTime += updatedTime - startTime;
+	}
+	updateTime /= BENCHMARK_PARTICLE_FRAMES;
+	writeTime /= BENCHMARK_PARTICLE_FRAMES;
+
+	std::cout << "Particles, " << particles.count << " live on " << threadPoolSize() << " workers:" << std::endl
+		<< std::fixed << std::setprecision(2)
+		<< "update " << updateTime * 1e3 << " ms, "
+		<< "instances " << writeTime * 1e3 << " ms, "
+		<< "step and frame " << (updateTime + writeTime) * 1e3 << " ms, a step simulates " << SIMULATION_STEP * 1e3 << " ms" << std::endl;
+}
+
+/**
+*	Draws the scene with growing number of lights and plots the frame time.
+*	\param[in] drawFrame Function drawing one frame, it waits until the frame is finished.
+*/
+static void benchmarkLights(BenchmarkDrawFunction drawFrame) {
+
+	const unsigned int lightCounts[] = { 3, 8, 16, 32, 64, 128, 256, 512, MAX_LIGHTS };
+	const int numCounts = sizeof(lightCounts) / sizeof(lightCounts[0]);
+	double frameTimes[numCounts];
+
+	for (int c = 0; c < numCounts; c++) {
+		// first frame uploads the buffers of the new size
+		drawFrame(lightCounts[c]);
+
+		double startTime = highResolutionTime();
+		for (int f = 0; f < BENCHMARK_LIGHT_FRAMES; f++)
+			drawFrame(lightCounts[c]);
+		frameTimes[c] = (highResolutionTime() - startTime) / BENCHMARK_LIGHT_FRAMES;
+	}
+
+	const double maxTime = *std::max_element(frameTimes, frameTimes + numCounts);
+	const int plotWidth = 60;
+
+	std::cout << "Clustered lights, " << CLUSTER_GRID_X << "x" << CLUSTER_GRID_Y << "x" << CLUSTER_GRID_Z
+		<< " clusters, frame time:" << std::endl << std::fixed << std::setprecision(2);
+	for (int c = 0; c < numCounts; c++) {
+		int bar = maxTime > 0.0 ? (int)(plotWidth * frameTimes[c] / maxTime + 0.5) : 0;
+		std::cout << std::setw(5) << lightCounts[c] << " lights " << std::setw(8) << frameTimes[c] * 1e3 << " ms |"
+			<< std::string(std::max(bar, 1), '#') << std::endl;
+	}
+}
+
+/**
+*	Runs benchmark with given name.
+*	\param[in] name      Name of the benchmark.
+*	\param[in] drawFrame Function drawing one frame of the scene, used by the benchmarks of the whole scene.
+*	\return False if there is no such benchmark.
+*/
+bool runBenchmark(const std::string &name, BenchmarkDrawFunction drawFrame) {
+
+	if (name == "vertex") {
+		benchmarkVertexThroughput();
+		return true;
+	}
+
+	if (name == "transforms") {
+		benchmarkTransforms();
+		return true;
+	}
+
+	if (name == "particles") {
+		benchmarkParticles();
+		return true;
+	}
+
+	if (name == "lights") {
+		benchmarkLights(drawFrame);
+		return true;
+	}
+
+	std::cerr << "Unknown benchmark: " << name << " (available: vertex, transforms, particles, lights)" << std::endl;
+	return false;
+}
@@ -0,0 +1,24 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       benchmark.h
+* \author     agent
+* \date       2026
+* \brief      Performance measurements run from the command line.
+*
+*	Start the application with "-benchmark <name>", the benchmark runs after the scene
+*	is initialized, prints its results and the application quits.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#ifndef __BENCHMARK_H
+#define __BENCHMARK_H
+
+#include <string>
+
+// draws one frame of the scene with the given number of random lights, 0 keeps the lights of the scene
+typedef void (*BenchmarkDrawFunction)(unsigned int numLights);
+
+bool runBenchmark(const std::string &name, BenchmarkDrawFunction drawFrame);
+
+#endif
@@ -0,0 +1,266 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       culling.cpp
+* \author     agent
+* \date       2026
+* \brief      Bounding volumes of meshes and view frustum culling.
+*
+*	Objects are tested conservatively: an object is culled only if its bounding volume
+*	lies completely behind one of the planes.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#include <math.h>
+#include <algorithm>
+#include "pgr.h"
+#include "culling.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE__)
+#include <xmmintrin.h>
+#define CULLING_SSE 1
+#endif
+
+/**
+*	Computes bounding box and bounding sphere of the vertices.
+*	\param[in]  vertices    Interleaved vertices, position is the first three floats of each vertex.
+*	\param[in]  numVertices Number of vertices.
+*	\param[in]  stride      Floats per vertex.
+*	\param[out] bounds      Bounds in model space.
+*/
+void computeMeshBounds(const float *vertices, unsigned int numVertices, unsigned int stride, MeshBounds *bounds) {
+
+	if (numVertices == 0) {
+		bounds->boxMin = bounds->boxMax = bounds->sphereCenter = glm::vec3(0.0f);
+		bounds->sphereRadius = 0.0f;
+		return;
+	}
+
+	glm::vec3 boxMin(vertices[0], vertices[1], vertices[2]);
+	glm::vec3 boxMax = boxMin;
+
+	for (unsigned int v = 1; v < numVertices; v++) {
+		const float *position = vertices + stride * v;
+		boxMin = glm::vec3(std::min(boxMin.x, position[0]), std::min(boxMin.y, position[1]), std::min(boxMin.z, position[2]));
+		boxMax = glm::vec3(std::max(boxMax.x, position[0]), std::max(boxMax.y, position[1]), std::max(boxMax.z, position[2]));
+	}
+
+	// sphere around the center of the box, tighter than the half of its diagonal
+	glm::vec3 center = (boxMin + boxMax) * 0.5f;
+	float radius2 = 0.0f;
+
+	for (unsigned int v = 0; v < numVertices; v++) {
+		const float *position = vertices + stride * v;
+		glm::vec3 offset = glm::vec3(position[0], position[1], position[2]) - center;
+		radius2 = std::max(radius2, glm::dot(offset, offset));
+	}
+
+	bounds->boxMin = boxMin;
+	bounds->boxMax = boxMax;
+	bounds->sphereCenter = center;
+	bounds->sphereRadius = sqrtf(radius2);
+}
+
+/**
+*	Returns radius of a sphere around the model origin containing the mesh in any orientation.
+*/
+float boundingRadius(const MeshBounds &bounds) {
+	return glm::length(bounds.sphereCenter) + bounds.sphereRadius;
+}
+
+/**
+*	Extracts normalized planes of the view frustum.
+*	\param[in]  projectionViewMatrix Projection * view matrix of the frame.
+*	\param[out] frustum              Left, right, bottom, top, near and far plane in world space.
+*/
+void extractFrustum(const glm::mat4 &projectionViewMatrix, Frustum *frustum) {
+	const glm::mat4 &m = projectionViewMatrix;
+
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+		rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+
+	// -w <= x, y, z <= w in clip space
+	glm::vec4 planes[6] = {
+		rows[3] + rows[0], rows[3] - rows[0],
+		rows[3] + rows[1], rows[3] - rows[1],
+		rows[3] + rows[2], rows[3] - rows[2],
+	};
+
+	for (int p = 0; p < 6; p++) {
+		float length = glm::length(glm::vec3(planes[p]));
+		float scale = length > 0.0f ? 1.0f / length : 0.0f;
+		frustum->a[p] = planes[p].x * scale;
+		frustum->b[p] = planes[p].y * scale;
+		frustum->c[p] = planes[p].z * scale;
+		frustum->d[p] = planes[p].w * scale;
+	}
+
+	// padding planes have everything inside
+	for (int p = 6; p < FRUSTUM_PLANES; p++) {
+		frustum->a[p] = frustum->b[p] = frustum->c[p] = 0.0f;
+		frustum->d[p] = 1.0f;
+	}
+}
+
+/**
+*	Returns false if the sphere is completely outside the frustum.
+*	\param[in] frustum Planes of the frustum.
+*	\param[in] center  World space center of the sphere.
+*	\param[in] radius  Radius of the sphere.
+*/
+bool sphereInFrustum(const Frustum &frustum, const glm::vec3 &center, float radius) {
+
+#ifdef CULLING_SSE
+	__m128 x = _mm_set1_ps(center.x);
+	__m128 y = _mm_set1_ps(center.y);
+	__m128 z = _mm_set1_ps(center.z);
+	__m128 negativeRadius = _mm_set1_ps(-radius);
+
+	for (int p = 0; p < FRUSTUM_PLANES; p += 4) {
+		__m128 distance = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(frustum.a + p), x), _mm_mul_ps(_mm_loadu_ps(frustum.b + p), y)),
+			_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(frustum.c + p), z), _mm_loadu_ps(frustum.d + p)));
+		if (_mm_movemask_ps(_mm_cmplt_ps(distance, negativeRadius)) != 0)
+			return false;
+	}
+#else
+	for (int p = 0; p < 6; p++) {
+		if (frustum.a[p] * center.x + frustum.b[p] * center.y + frustum.c[p] * center.z + frustum.d[p] < -radius)
+			return false;
+	}
+#endif
+
+	return true;
+}
+
+/**
+*	Returns false if the axis aligned box is completely outside the frustum.
+*	\param[in] frustum Planes of the frustum.
+*	\param[in] center  World space center of the box.
+*	\param[in] extents Half sizes of the box.
+*/
+bool boxInFrustum(const Frustum &frustum, const glm::vec3 &center, const glm::vec3 &extents) {
+
+#ifdef CULLING_SSE
+	__m128 x = _mm_set1_ps(center.x);
+	__m128 y = _mm_set1_ps(center.y);
+	__m128 z = _mm_set1_ps(center.z);
+	__m128 ex = _mm_set1_ps(extents.x);
+	__m128 ey = _mm_set1_ps(extents.y);
+	__m128 ez = _mm_set1_ps(extents.z);
+	__m128 signMask = _mm_set1_ps(-0.0f);
+
+	for (int p = 0; p < FRUSTUM_PLANES; p += 4) {
+		__m128 a = _mm_loadu_ps(frustum.a + p);
+		__m128 b = _mm_loadu_ps(frustum.b + p);
+		__m128 c = _mm_loadu_ps(frustum.c + p);
+
+		__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, x), _mm_mul_ps(b, y)), _mm_add_ps(_mm_mul_ps(c, z), _mm_loadu_ps(frustum.d + p)));
+
+		// projection of the box extents on the plane normal
+		__m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, a), ex), _mm_mul_ps(_mm_andnot_ps(signMask, b), ey)),
+			_mm_mul_ps(_mm_andnot_ps(signMask, c), ez));
+
+		if (_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, reach), _mm_setzero_ps())) != 0)
+			return false;
+	}
+#else
+	for (int p = 0; p < 6; p++) {
+		float distance = frustum.a[p] * center.x + frustum.b[p] * center.y + frustum.c[p] * center.z + frustum.d[p];
+		float reach = fabsf(frustum.a[p]) * extents.x + fabsf(frustum.b[p]) * extents.y + fabsf(frustum.c[p]) * extents.z;
+		if (distance + reach < 0.0f)
+			return false;
+	}
+#endif
+
+	return true;
+}
+
+/**
+*	Returns false if the mesh with the pose is outside the frustum. The cheap sphere test
+*	does not depend on the orientation, the box of the mesh is tested only if the sphere passes.
+*	\param[in] frustum  Planes of the frustum.
+*	\param[in] bounds   Bounds of the mesh.
+*	\param[in] position Position of the object.
+*	\param[in] front    Direction the object faces.
+*	\param[in] up       Up direction of the object.
+*	\param[in] scale    Uniform scale of the object.
+*/
+bool poseInFrustum(const Frustum &frustum, const MeshBounds &bounds, const glm::vec3 &position, const glm::vec3 &front, const glm::vec3 &up, float scale) {
+
+	if (!sphereInFrustum(frustum, position, scale * boundingRadius(bounds)))
+		return false;
+
+	glm::vec3 center, extents;
+	poseBox(bounds, position, front, up, scale, &center, &extents);
+
+	return boxInFrustum(frustum, center, extents);
+}
+
+/**
+*	Computes world space axis aligned box around the rotated bounding box of the mesh with the pose.
+*	\param[in]  bounds   Bounds of the mesh.
+*	\param[in]  position Position of the object.
+*	\param[in]  front    Direction the object faces.
+*	\param[in]  up       Up direction of the object.
+*	\param[in]  scale    Uniform scale of the object.
+*	\param[out] center   Center of the box.
+*	\param[out] extents  Half sizes of the box.
+*/
+void poseBox(const MeshBounds &bounds, const glm::vec3 &position, const glm::vec3 &front, const glm::vec3 &up, float scale, glm::vec3 *center, glm::vec3 *extents) {
+
+	glm::mat3 rotation = poseRotation(front, up);
+	glm::vec3 halfSize = (bounds.boxMax - bounds.boxMin) * (0.5f * scale);
+
+	*center = position + rotation * ((bounds.boxMin + bounds.boxMax) * (0.5f * scale));
+	for (int i = 0; i < 3; i++)
+		(*extents)[i] = fabsf(rotation[0][i]) * halfSize.x + fabsf(rotation[1][i]) * halfSize.y + fabsf(rotation[2][i]) * halfSize.z;
+}
+
+/**
+*	Tests spheres around the positions of the poses, four poses at once.
+*	\param[in]  frustum    Planes of the frustum.
+*	\param[in]  transforms Poses of the objects.
+*	\param[in]  radius     Bounding radius of the mesh around its origin, multiplied by the scale of each pose.
+*	\param[out] visible    1 for poses inside the frustum, 0 for the culled ones.
+*	\return Number of visible poses.
+*/
+unsigned int cullTransforms(const Frustum &frustum, const TransformArrays &transforms, float radius, unsigned char *visible) {
+	unsigned int numVisible = 0;
+	unsigned int i = 0;
+
+#ifdef CULLING_SSE
+	__m128 negativeRadius = _mm_set1_ps(-radius);
+
+	for (; i + TRANSFORM_BATCH_WIDTH <= transforms.count; i += TRANSFORM_BATCH_WIDTH) {
+		__m128 x = _mm_loadu_ps(&transforms.positionX[i]);
+		__m128 y = _mm_loadu_ps(&transforms.positionY[i]);
+		__m128 z = _mm_loadu_ps(&transforms.positionZ[i]);
+		__m128 limit = _mm_mul_ps(_mm_loadu_ps(&transforms.scale[i]), negativeRadius);
+
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < 6; p++) {
+			__m128 distance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(frustum.a[p]), x), _mm_mul_ps(_mm_set1_ps(frustum.b[p]), y)),
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(frustum.c[p]), z), _mm_set1_ps(frustum.d[p])));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, limit));
+		}
+
+		int mask = _mm_movemask_ps(outside);
+		for (unsigned int k = 0; k < TRANSFORM_BATCH_WIDTH; k++) {
+			visible[i + k] = (mask >> k) & 1 ? 0 : 1;
+			numVisible += visible[i + k];
+		}
+	}
+#endif
+
+	// remaining poses
+	for (; i < transforms.count; i++) {
+		glm::vec3 position(transforms.positionX[i], transforms.positionY[i], transforms.positionZ[i]);
+		visible[i] = sphereInFrustum(frustum, position, radius * transforms.scale[i]) ? 1 : 0;
+		numVisible += visible[i];
+	}
+
+	return numVisible;
+}
@@ -0,0 +1,56 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       culling.h
+* \author     agent
+* \date       2026
+* \brief      Bounding volumes of meshes and view frustum culling.
+*
+*	Bounds are computed once when a mesh is imported. Objects are tested against the planes
+*	of the current view frustum before they are queued, culled objects are never drawn.
+*	The planes are kept in structure of arrays, so one SSE instruction tests four of them.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#ifndef __CULLING_H
+#define __CULLING_H
+
+#include "pgr.h"
+#include "transforms.h"
+
+// 6 planes of the frustum padded to two SIMD batches
+#define FRUSTUM_PLANES 8
+
+/**
+*	struct for bounding volumes of a mesh in model space
+*
+*/
+typedef struct MeshBounds {
+	glm::vec3 boxMin;
+	glm::vec3 boxMax;
+	glm::vec3 sphereCenter;
+	float     sphereRadius;
+} MeshBounds;
+
+/**
+*	struct for planes of a view frustum, a * x + b * y + c * z + d >= 0 inside
+*
+*/
+typedef struct Frustum {
+	float a[FRUSTUM_PLANES];
+	float b[FRUSTUM_PLANES];
+	float c[FRUSTUM_PLANES];
+	float d[FRUSTUM_PLANES];
+} Frustum;
+
+void computeMeshBounds(const float *vertices, unsigned int numVertices, unsigned int stride, MeshBounds *bounds);
+float boundingRadius(const MeshBounds &bounds);
+
+void extractFrustum(const glm::mat4 &projectionViewMatrix, Frustum *frustum);
+bool sphereInFrustum(const Frustum &frustum, const glm::vec3 &center, float radius);
+bool boxInFrustum(const Frustum &frustum, const glm::vec3 &center, const glm::vec3 &extents);
+void poseBox(const MeshBounds &bounds, const glm::vec3 &position, const glm::vec3 &front, const glm::vec3 &up, float scale, glm::vec3 *center, glm::vec3 *extents);
+bool poseInFrustum(const Frustum &frustum, const MeshBounds &bounds, const glm::vec3 &position, const glm::vec3 &front, const glm::vec3 &up, float scale);
+unsigned int cullTransforms(const Frustum &frustum, const TransformArrays &transforms, float radius, unsigned char *visible);
+
+#endif
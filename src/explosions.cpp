@@ -0,0 +1,91 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       explosions.cpp
+* \author     agent
+* \date       2026
+* \brief      Pool of explosion billboards.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#include "pgr.h"
+#include "explosions.h"
+
+/**
+*	Allocates arrays of the pool for EXPLOSION_POOL_CAPACITY explosions, the pool is empty.
+*/
+void initExplosionPool(ExplosionPool *pool) {
+	pool->positionX.resize(EXPLOSION_POOL_CAPACITY);
+	pool->positionY.resize(EXPLOSION_POOL_CAPACITY);
+	pool->positionZ.resize(EXPLOSION_POOL_CAPACITY);
+	pool->size.resize(EXPLOSION_POOL_CAPACITY);
+	pool->startTime.resize(EXPLOSION_POOL_CAPACITY);
+	pool->frameDuration.resize(EXPLOSION_POOL_CAPACITY);
+	pool->endTime.resize(EXPLOSION_POOL_CAPACITY);
+	pool->count = 0;
+}
+
+/**
+*	Removes all explosions, the arrays stay allocated.
+*/
+void clearExplosions(ExplosionPool *pool) {
+	pool->count = 0;
+}
+
+/**
+*	Adds explosion to the pool.
+*	\param[in,out] pool          Pool of live explosions.
+*	\param[in]     position      Center of the billboard.
+*	\param[in]     size          Half size of the billboard.
+*	\param[in]     startTime     Time of the first animation frame.
+*	\param[in]     frameDuration Seconds per animation frame.
+*	\param[in]     frames        Number of animation frames.
+*	\return False if the pool is full and the explosion has not been added.
+*/
+bool spawnExplosion(ExplosionPool *pool, const glm::vec3 &position, float size, float startTime, float frameDuration, int frames) {
+
+	if (pool->count >= pool->positionX.size())
+		return false;
+
+	unsigned int i = pool->count++;
+	pool->positionX[i] = position.x;
+	pool->positionY[i] = position.y;
+	pool->positionZ[i] = position.z;
+	pool->size[i] = size;
+	pool->startTime[i] = startTime;
+	pool->frameDuration[i] = frameDuration;
+	pool->endTime[i] = startTime + frames * frameDuration;
+
+	return true;
+}
+
+/**
+*	Removes explosions whose animation has ended, each one is replaced by the last live explosion.
+*	\param[in,out] pool Pool of live explosions.
+*	\param[in]     time Current time.
+*	\return Number of removed explosions.
+*/
+unsigned int expireExplosions(ExplosionPool *pool, float time) {
+
+	unsigned int removed = 0;
+	unsigned int i = 0;
+
+	while (i < pool->count) {
+		if (time <= pool->endTime[i]) {
+			i++;
+			continue;
+		}
+
+		unsigned int last = --pool->count;
+		pool->positionX[i] = pool->positionX[last];
+		pool->positionY[i] = pool->positionY[last];
+		pool->positionZ[i] = pool->positionZ[last];
+		pool->size[i] = pool->size[last];
+		pool->startTime[i] = pool->startTime[last];
+		pool->frameDuration[i] = pool->frameDuration[last];
+		pool->endTime[i] = pool->endTime[last];
+		removed++;
+	}
+
+	return removed;
+}
@@ -0,0 +1,43 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       explosions.h
+* \author     agent
+* \date       2026
+* \brief      Pool of explosion billboards.
+*
+*	Live explosions are kept in structure of arrays with a fixed capacity, nothing is
+*	allocated when an explosion is spawned. An expired explosion is replaced by the last
+*	live one, so the live explosions always are 0 .. count - 1. The billboards are drawn
+*	by drawExplosions() with one instanced call, the animation frame is chosen on the GPU.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#ifndef __EXPLOSIONS_H
+#define __EXPLOSIONS_H
+
+#include "pgr.h"
+#include <vector>
+
+// maximal number of live explosions, more are not spawned
+#define EXPLOSION_POOL_CAPACITY 65536
+
+/**
+*	struct for live explosions in structure of arrays
+*
+*/
+typedef struct ExplosionPool {
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> size;
+	std::vector<float> startTime;
+	std::vector<float> frameDuration;   // seconds per animation frame
+	std::vector<float> endTime;         // startTime + frames * frameDuration
+	unsigned int       count;
+} ExplosionPool;
+
+void initExplosionPool(ExplosionPool *pool);
+void clearExplosions(ExplosionPool *pool);
+bool spawnExplosion(ExplosionPool *pool, const glm::vec3 &position, float size, float startTime, float frameDuration, int frames);
+unsigned int expireExplosions(ExplosionPool *pool, float time);
+
+#endif
@@ -0,0 +1,376 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       idBuffer.cpp
+* \author     agent
+* \date       2026
+* \brief      Optional 32-bit object ID buffer read asynchronously by pixel buffer objects.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#include <string.h>
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include "pgr.h"
+#include "idBuffer.h"
+
+/**
+*	struct for a query waiting for the end of the frame
+*
+*/
+typedef struct IdBufferQuery {
+	int kind;
+	int x, y;
+} IdBufferQuery;
+
+/**
+*	struct for a region copied into a pixel buffer object
+*
+*/
+typedef struct IdBufferReadback {
+	GLuint        pixelBuffer;
+	GLsync        fence;          // NULL without fences
+	bool          pending;        // copy issued, result not returned yet
+	unsigned int  frame;          // frame of the copy
+	IdBufferQuery query;
+	int           left, bottom;   // copied region
+	int           width, height;
+} IdBufferReadback;
+
+/**
+*	struct for the framebuffer and its readbacks
+*
+*/
+typedef struct IdBuffer {
+	bool   enabled;
+	GLuint framebuffer;
+	GLuint renderbuffers[3];      // color, object IDs, depth and stencil
+	int    width, height;
+	unsigned int frame;
+
+	std::vector<IdBufferQuery> queries;   // issued by endIdBufferFrame()
+	IdBufferReadback readbacks[ID_BUFFER_READBACKS];
+} IdBuffer;
+
+static IdBuffer idBuffer;
+
+/**
+*	Returns true if the driver has fence sync objects (OpenGL 3.2 or ARB_sync).
+*	Has to be called from the thread owning the OpenGL context.
+*/
+static bool fenceSyncSupported() {
+	static int supported = -1;
+
+	if (supported < 0) {
+		GLint major = 0, minor = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &major);
+		glGetIntegerv(GL_MINOR_VERSION, &minor);
+
+		supported = 0;
+		if (major > 3 || (major == 3 && minor >= 2)) {
+			supported = 1;
+		}
+		else {
+			GLint numExtensions = 0;
+			glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+
+			for (GLint i = 0; i < numExtensions; i++) {
+				const char *extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+				if (extension != NULL && strcmp(extension, "GL_ARB_sync") == 0)
+					supported = 1;
+			}
+		}
+	}
+
+	return supported == 1;
+}
+
+/**
+*	Allocates storage of the renderbuffers for the window size.
+*	\return True if the framebuffer is complete.
+*/
+static bool allocateIdBuffer(int width, int height) {
+	const GLenum formats[3] = { GL_RGBA8, GL_R32UI, GL_DEPTH24_STENCIL8 };
+
+	idBuffer.width = std::max(width, 1);
+	idBuffer.height = std::max(height, 1);
+
+	for (int i = 0; i < 3; i++) {
+		glBindRenderbuffer(GL_RENDERBUFFER, idBuffer.renderbuffers[i]);
+		glRenderbufferStorage(GL_RENDERBUFFER, formats[i], idBuffer.width, idBuffer.height);
+	}
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, idBuffer.framebuffer);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	CHECK_GL_ERROR();
+
+	return status == GL_FRAMEBUFFER_COMPLETE;
+}
+
+/**
+*	Switches drawing into the ID buffer on or off, the buffers are created when it is enabled the first time.
+*	\param[in] enabled True to draw the following frames into the ID buffer.
+*	\param[in] width   Width of the window.
+*	\param[in] height  Height of the window.
+*	\return True if the ID buffer is enabled now, false if it has been disabled or its framebuffer is not complete.
+*/
+bool setIdBufferEnabled(bool enabled, int width, int height) {
+
+	if (!enabled) {
+		idBuffer.enabled = false;
+		return false;
+	}
+
+	if (idBuffer.framebuffer == 0) {
+		glGenFramebuffers(1, &idBuffer.framebuffer);
+		glGenRenderbuffers(3, idBuffer.renderbuffers);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, idBuffer.framebuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, idBuffer.renderbuffers[0]);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_RENDERBUFFER, idBuffer.renderbuffers[1]);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, idBuffer.renderbuffers[2]);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		for (int i = 0; i < ID_BUFFER_READBACKS; i++) {
+			IdBufferReadback *readback = &idBuffer.readbacks[i];
+			glGenBuffers(1, &readback->pixelBuffer);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, readback->pixelBuffer);
+			glBufferData(GL_PIXEL_PACK_BUFFER, ID_BUFFER_QUERY_SIZE * ID_BUFFER_QUERY_SIZE * sizeof(GLuint), NULL, GL_STREAM_READ);
+			readback->fence = NULL;
+			readback->pending = false;
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+
+	if (!allocateIdBuffer(width, height)) {
+		std::cerr << "setIdBufferEnabled(): ID framebuffer is not complete" << std::endl;
+		idBuffer.enabled = false;
+		return false;
+	}
+
+	idBuffer.enabled = true;
+	return true;
+}
+
+/**
+*	Returns true if the frames are drawn into the ID buffer.
+*/
+bool idBufferEnabled() {
+	return idBuffer.enabled;
+}
+
+/**
+*	Reallocates the buffers for the new size of the window, does nothing while the ID buffer is disabled.
+*/
+void resizeIdBuffer(int width, int height) {
+	if (!idBuffer.enabled || (width == idBuffer.width && height == idBuffer.height))
+		return;
+
+	if (!allocateIdBuffer(width, height)) {
+		std::cerr << "resizeIdBuffer(): ID framebuffer is not complete" << std::endl;
+		idBuffer.enabled = false;
+	}
+}
+
+/**
+*	Deletes the framebuffer and the pixel buffers, queries in flight are dropped.
+*/
+void deleteIdBuffer() {
+	if (idBuffer.framebuffer == 0)
+		return;
+
+	for (int i = 0; i < ID_BUFFER_READBACKS; i++) {
+		IdBufferReadback *readback = &idBuffer.readbacks[i];
+		if (readback->fence != NULL)
+			glDeleteSync(readback->fence);
+		glDeleteBuffers(1, &readback->pixelBuffer);
+		readback->pixelBuffer = 0;
+		readback->fence = NULL;
+		readback->pending = false;
+	}
+
+	glDeleteFramebuffers(1, &idBuffer.framebuffer);
+	glDeleteRenderbuffers(3, idBuffer.renderbuffers);
+	idBuffer.framebuffer = 0;
+	idBuffer.enabled = false;
+	idBuffer.queries.clear();
+}
+
+/**
+*	Binds the ID buffer and clears it, the frame is then drawn into it.
+*	\param[in] clearMask Buffers cleared, the object IDs are cleared to 0 whenever the color is.
+*	\return False if the ID buffer is disabled, nothing is bound or cleared then.
+*/
+bool beginIdBufferFrame(GLbitfield clearMask) {
+	if (!idBuffer.enabled)
+		return false;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, idBuffer.framebuffer);
+
+	// glClear() of an integer buffer is undefined, it gets its own clear
+	const GLenum colorOnly[2] = { GL_COLOR_ATTACHMENT0, GL_NONE };
+	const GLenum withIds[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, colorOnly);
+	glClear(clearMask);
+	glDrawBuffers(2, withIds);
+
+	if (clearMask & GL_COLOR_BUFFER_BIT) {
+		const GLuint background = 0;
+		glClearBufferuiv(GL_COLOR, 1, &background);
+	}
+
+	return true;
+}
+
+/**
+*	Asks for the object around the pixel in the frame drawn next, see pollIdBuffer().
+*	\param[in] kind ID_QUERY_HOVER replaces the hover query of the frame, ID_QUERY_CLICK is added.
+*	\param[in] x    Horizontal window coordinate of the pixel.
+*	\param[in] y    Vertical window coordinate of the pixel, from the bottom.
+*/
+void queryIdBuffer(int kind, int x, int y) {
+	if (!idBuffer.enabled)
+		return;
+
+	IdBufferQuery query = { kind, x, y };
+	if (kind == ID_QUERY_HOVER) {
+		for (size_t i = 0; i < idBuffer.queries.size(); i++) {
+			if (idBuffer.queries[i].kind == ID_QUERY_HOVER) {
+				idBuffer.queries[i] = query;
+				return;
+			}
+		}
+	}
+	idBuffer.queries.push_back(query);
+}
+
+/**
+*	Starts copies of the queried regions into free pixel buffers and blits the color to the window,
+*	the window framebuffer is bound afterwards. Has to be called after the frame is drawn.
+*/
+void endIdBufferFrame() {
+	if (!idBuffer.enabled)
+		return;
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, idBuffer.framebuffer);
+	glReadBuffer(GL_COLOR_ATTACHMENT1);
+
+	std::vector<IdBufferQuery> waiting;
+	for (size_t q = 0; q < idBuffer.queries.size(); q++) {
+		const IdBufferQuery &query = idBuffer.queries[q];
+
+		IdBufferReadback *readback = NULL;
+		for (int i = 0; i < ID_BUFFER_READBACKS && readback == NULL; i++) {
+			if (!idBuffer.readbacks[i].pending)
+				readback = &idBuffer.readbacks[i];
+		}
+		if (readback == NULL) {
+			// hovering is asked again next frame, clicks must not be lost
+			if (query.kind != ID_QUERY_HOVER)
+				waiting.push_back(query);
+			continue;
+		}
+
+		// region around the pixel clamped to the window
+		readback->width = std::min(ID_BUFFER_QUERY_SIZE, idBuffer.width);
+		readback->height = std::min(ID_BUFFER_QUERY_SIZE, idBuffer.height);
+		readback->left = std::min(std::max(query.x - ID_BUFFER_QUERY_SIZE / 2, 0), idBuffer.width - readback->width);
+		readback->bottom = std::min(std::max(query.y - ID_BUFFER_QUERY_SIZE / 2, 0), idBuffer.height - readback->height);
+		readback->query = query;
+		readback->frame = idBuffer.frame;
+		readback->pending = true;
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, readback->pixelBuffer);
+		glReadPixels(readback->left, readback->bottom, readback->width, readback->height, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+		if (fenceSyncSupported())
+			readback->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	idBuffer.queries.swap(waiting);
+
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(0, 0, idBuffer.width, idBuffer.height, 0, 0, idBuffer.width, idBuffer.height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	CHECK_GL_ERROR();
+
+	idBuffer.frame++;
+}
+
+/**
+*	Returns true if the copy into the pixel buffer has finished, mapping it will not wait.
+*/
+static bool readbackFinished(IdBufferReadback *readback) {
+	if (readback->fence == NULL)
+		return idBuffer.frame - readback->frame >= ID_BUFFER_LATENCY;
+
+	GLenum status = glClientWaitSync(readback->fence, 0, 0);
+	if (status == GL_TIMEOUT_EXPIRED)
+		return false;
+
+	glDeleteSync(readback->fence);
+	readback->fence = NULL;
+	return true;
+}
+
+/**
+*	Returns the object ID nearest to the queried pixel in the region of the readback, 0 if there is none.
+*/
+static GLuint nearestObjectId(const IdBufferReadback &readback, const GLuint *ids) {
+	GLuint nearest = 0;
+	int nearestDistance = 1 << 30;
+
+	for (int row = 0; row < readback.height; row++) {
+		for (int column = 0; column < readback.width; column++) {
+			GLuint id = ids[row * readback.width + column];
+			int dx = readback.left + column - readback.query.x;
+			int dy = readback.bottom + row - readback.query.y;
+			if (id != 0 && dx * dx + dy * dy < nearestDistance) {
+				nearest = id;
+				nearestDistance = dx * dx + dy * dy;
+			}
+		}
+	}
+
+	return nearest;
+}
+
+/**
+*	Returns the oldest query whose pixels have arrived, call it until it returns false.
+*	\param[out] result Query and the object around its pixel.
+*	\return False if no copy has finished yet.
+*/
+bool pollIdBuffer(IdQueryResult *result) {
+
+	IdBufferReadback *oldest = NULL;
+	for (int i = 0; i < ID_BUFFER_READBACKS; i++) {
+		IdBufferReadback *readback = &idBuffer.readbacks[i];
+		if (readback->pending && (oldest == NULL || readback->frame < oldest->frame))
+			oldest = readback;
+	}
+
+	// queries are answered in the order they have been issued
+	if (oldest == NULL || !readbackFinished(oldest))
+		return false;
+
+	GLuint id = 0;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, oldest->pixelBuffer);
+	const GLuint *ids = (const GLuint*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, oldest->width * oldest->height * sizeof(GLuint), GL_MAP_READ_BIT);
+	if (ids != NULL) {
+		id = nearestObjectId(*oldest, ids);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	CHECK_GL_ERROR();
+
+	oldest->pending = false;
+	result->kind = oldest->query.kind;
+	result->x = oldest->query.x;
+	result->y = oldest->query.y;
+	result->handle = unpackPickHandle(id);
+
+	return true;
+}
@@ -0,0 +1,57 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       idBuffer.h
+* \author     agent
+* \date       2026
+* \brief      Optional 32-bit object ID buffer read asynchronously by pixel buffer objects.
+*
+*	When the ID buffer is enabled, the frame is drawn into a framebuffer with a color, an
+*	R32UI and a depth stencil attachment and blitted to the window afterwards. Every opaque
+*	item writes the object ID of the render queue (packPickHandle() of picking.h) into the
+*	integer attachment, items which cannot be picked write 0 and still hide the others.
+*
+*	Queries do not read the pixel at once. After the frame is drawn, a small region around
+*	each queried pixel is copied into a pixel buffer object and the buffer is mapped one or
+*	two frames later, when the copy has finished (a fence tells it if the driver has them),
+*	so neither the hover queries of every frame nor clicks wait for the GPU.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#ifndef __IDBUFFER_H
+#define __IDBUFFER_H
+
+#include "pgr.h"
+#include "picking.h"
+
+// side of the region read around the queried pixel, the nearest object in it is returned
+#define ID_BUFFER_QUERY_SIZE   5
+// pixel buffers in flight, queries without a free one wait for the next frame
+#define ID_BUFFER_READBACKS    8
+// frames after which a pixel buffer is mapped when the driver has no fences
+#define ID_BUFFER_LATENCY      2
+
+#define ID_QUERY_HOVER         0
+#define ID_QUERY_CLICK         1
+
+/**
+*	struct for an answered query
+*
+*/
+typedef struct IdQueryResult {
+	int        kind;     // ID_QUERY_*
+	int        x, y;     // queried pixel, y from the bottom
+	PickHandle handle;   // type PICK_NONE if there is no object around the pixel
+} IdQueryResult;
+
+bool setIdBufferEnabled(bool enabled, int width, int height);
+bool idBufferEnabled();
+void resizeIdBuffer(int width, int height);
+void deleteIdBuffer();
+
+bool beginIdBufferFrame(GLbitfield clearMask);
+void queryIdBuffer(int kind, int x, int y);
+void endIdBufferFrame();
+bool pollIdBuffer(IdQueryResult *result);
+
+#endif
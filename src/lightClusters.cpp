@@ -0,0 +1,242 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       lightClusters.cpp
+* \author     agent
+* \date       2026
+* \brief      Point and spot lights binned into clusters of the view frustum.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#include <stddef.h>
+#include <math.h>
+#include <algorithm>
+#include "pgr.h"
+#include "threadPool.h"
+#include "uniformBuffers.h"
+#include "lightClusters.h"
+
+static_assert(offsetof(ClusterLight, spotCosCutoff) == 80 && sizeof(ClusterLight) == LIGHT_TEXELS * 16, "ClusterLight does not match texels of fetchLight()");
+
+#define NUM_CLUSTERS (CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z)
+
+/**
+*	struct for the texture buffers and the lists of the clusters
+*
+*/
+typedef struct LightClusters {
+	GLuint buffers[3];    // lights, first index and count of each cluster, light indices
+	GLuint textures[3];
+
+	std::vector<ClusterLight>                 lights;         // point lights followed by spot lights
+	std::vector<std::vector<unsigned short> > clusterLights;  // filled by the workers, one slice per worker at a time
+	std::vector<GLuint>                       clusterRanges;  // first index and point and spot light counts of each cluster
+	std::vector<unsigned short>               lightIndices;
+} LightClusters;
+
+static LightClusters clusters;
+
+/**
+*	Creates the texture buffers and binds them to their texture units.
+*/
+void initializeLightClusters() {
+	const GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R16UI };
+	const GLenum units[3] = { LIGHT_TEXTURE_UNIT, CLUSTER_TEXTURE_UNIT, LIGHT_INDEX_TEXTURE_UNIT };
+
+	glGenBuffers(3, clusters.buffers);
+	glGenTextures(3, clusters.textures);
+
+	for (int i = 0; i < 3; i++) {
+		// empty buffers would be incomplete textures, one element is enough
+		glBindBuffer(GL_TEXTURE_BUFFER, clusters.buffers[i]);
+		glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+
+		glActiveTexture(GL_TEXTURE0 + units[i]);
+		glBindTexture(GL_TEXTURE_BUFFER, clusters.textures[i]);
+		glTexBuffer(GL_TEXTURE_BUFFER, formats[i], clusters.buffers[i]);
+	}
+
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	glActiveTexture(GL_TEXTURE0);
+	CHECK_GL_ERROR();
+
+	clusters.clusterLights.resize(NUM_CLUSTERS);
+	clusters.clusterRanges.resize(2 * NUM_CLUSTERS);
+}
+
+/**
+*	Deletes the texture buffers.
+*/
+void deleteLightClusters() {
+	glDeleteTextures(3, clusters.textures);
+	glDeleteBuffers(3, clusters.buffers);
+	for (int i = 0; i < 3; i++) {
+		clusters.textures[i] = 0;
+		clusters.buffers[i] = 0;
+	}
+}
+
+/**
+*	Connects samplers of the light clusters to their texture units.
+*	\param[in] program Program with the LightData block, samplers it does not use are skipped.
+*/
+void setLightClusterSamplers(GLuint program) {
+	GLint lightTexels = glGetUniformLocation(program, "lightTexels");
+	GLint clusterTexels = glGetUniformLocation(program, "clusterTexels");
+	GLint lightIndexTexels = glGetUniformLocation(program, "lightIndexTexels");
+
+	glUseProgram(program);
+	if (lightTexels >= 0)
+		glUniform1i(lightTexels, LIGHT_TEXTURE_UNIT);
+	if (clusterTexels >= 0)
+		glUniform1i(clusterTexels, CLUSTER_TEXTURE_UNIT);
+	if (lightIndexTexels >= 0)
+		glUniform1i(lightIndexTexels, LIGHT_INDEX_TEXTURE_UNIT);
+	glUseProgram(0);
+}
+
+/**
+*	Returns cluster coordinate of a normalized device coordinate, clamped to the grid.
+*/
+static int clusterTile(float ndc, int gridSize) {
+	int tile = (int)floorf((ndc + 1.0f) * 0.5f * gridSize);
+	return std::min(std::max(tile, 0), gridSize - 1);
+}
+
+/**
+*	Adds the lights into the clusters of slices firstSlice .. endSlice - 1.
+*	Each light is bounded by the box around its sphere, clipped to the depth range of the slice.
+*/
+static void binLightSlices(const std::vector<ClusterLight> &lights, unsigned int numLights, const glm::mat4 &projectionMatrix,
+	float nearPlane, float farPlane, int firstSlice, int endSlice) {
+
+	const float depthRatio = farPlane / nearPlane;
+
+	for (int slice = firstSlice; slice < endSlice; slice++) {
+		for (int c = 0; c < CLUSTER_GRID_X * CLUSTER_GRID_Y; c++)
+			clusters.clusterLights[slice * CLUSTER_GRID_X * CLUSTER_GRID_Y + c].clear();
+	}
+
+	float sliceNear = nearPlane * powf(depthRatio, (float)firstSlice / CLUSTER_GRID_Z);
+
+	for (int slice = firstSlice; slice < endSlice; slice++) {
+		float sliceFar = nearPlane * powf(depthRatio, (float)(slice + 1) / CLUSTER_GRID_Z);
+
+		for (unsigned int l = 0; l < numLights; l++) {
+			const ClusterLight &light = lights[l];
+			float depth = -light.position.z;
+
+			float nearDepth = std::max(depth - light.range, sliceNear);
+			float farDepth = std::min(depth + light.range, sliceFar);
+			if (nearDepth > farDepth)
+				continue;
+
+			// x / depth over the box is extreme in its corners
+			float minX = 1e30f, maxX = -1e30f, minY = 1e30f, maxY = -1e30f;
+			const float xs[2] = { light.position.x - light.range, light.position.x + light.range };
+			const float ys[2] = { light.position.y - light.range, light.position.y + light.range };
+			const float depths[2] = { nearDepth, farDepth };
+			for (int d = 0; d < 2; d++) {
+				for (int i = 0; i < 2; i++) {
+					float x = projectionMatrix[0][0] * xs[i] / depths[d];
+					float y = projectionMatrix[1][1] * ys[i] / depths[d];
+					minX = std::min(minX, x);
+					maxX = std::max(maxX, x);
+					minY = std::min(minY, y);
+					maxY = std::max(maxY, y);
+				}
+			}
+			if (minX > 1.0f || maxX < -1.0f || minY > 1.0f || maxY < -1.0f)
+				continue;
+
+			int endX = clusterTile(maxX, CLUSTER_GRID_X);
+			int endY = clusterTile(maxY, CLUSTER_GRID_Y);
+			for (int y = clusterTile(minY, CLUSTER_GRID_Y); y <= endY; y++) {
+				for (int x = clusterTile(minX, CLUSTER_GRID_X); x <= endX; x++)
+					clusters.clusterLights[(slice * CLUSTER_GRID_Y + y) * CLUSTER_GRID_X + x].push_back((unsigned short)l);
+			}
+		}
+
+		sliceNear = sliceFar;
+	}
+}
+
+/**
+*	Bins the lights into the clusters and uploads the lights, the light lists and the LightData block.
+*	\param[in] lights           Point and spot lights in view space, only the first MAX_LIGHTS are used.
+*	\param[in] projectionMatrix Symmetric perspective projection of the frame.
+*	\param[in] nearPlane        Near plane distance of the projection.
+*	\param[in] farPlane         Far plane distance of the projection.
+*	\param[in] viewportWidth    Width of the viewport in pixels.
+*	\param[in] viewportHeight   Height of the viewport in pixels.
+*	\return Number of light indices in all clusters.
+*/
+unsigned int buildLightClusters(const std::vector<ClusterLight> &lights, const glm::mat4 &projectionMatrix,
+	float nearPlane, float farPlane, int viewportWidth, int viewportHeight) {
+
+	const unsigned int numLights = (unsigned int)std::min(lights.size(), (size_t)MAX_LIGHTS);
+
+	// lists are sorted by the index, so the point lights of each cluster come before its spot lights
+	clusters.lights.clear();
+	for (unsigned int l = 0; l < numLights; l++) {
+		if (lights[l].spotCosCutoff <= -1.0f)
+			clusters.lights.push_back(lights[l]);
+	}
+	const unsigned int numPointLights = (unsigned int)clusters.lights.size();
+	for (unsigned int l = 0; l < numLights; l++) {
+		if (lights[l].spotCosCutoff > -1.0f)
+			clusters.lights.push_back(lights[l]);
+	}
+
+	// the slices are split among the workers, each one writes only the lists of its slices
+	int numTasks = (int)std::min(std::max(threadPoolSize(), 1u), (unsigned int)CLUSTER_GRID_Z);
+	if (numLights < 64)
+		numTasks = 1;
+
+	for (int t = 0; t < numTasks; t++) {
+		int firstSlice = t * CLUSTER_GRID_Z / numTasks;
+		int endSlice = (t + 1) * CLUSTER_GRID_Z / numTasks;
+		const std::vector<ClusterLight> *lightList = &clusters.lights;
+		const glm::mat4 projection = projectionMatrix;
+
+		if (numTasks == 1)
+			binLightSlices(clusters.lights, numLights, projectionMatrix, nearPlane, farPlane, firstSlice, endSlice);
+		else
+			runTask([lightList, numLights, projection, nearPlane, farPlane, firstSlice, endSlice]() {
+				binLightSlices(*lightList, numLights, projection, nearPlane, farPlane, firstSlice, endSlice);
+			});
+	}
+	if (numTasks > 1)
+		waitForTasks();
+
+	clusters.lightIndices.clear();
+	for (int c = 0; c < NUM_CLUSTERS; c++) {
+		const std::vector<unsigned short> &clusterLights = clusters.clusterLights[c];
+		clusters.clusterRanges[2 * c] = (GLuint)clusters.lightIndices.size();
+		GLuint numPoints = (GLuint)(std::lower_bound(clusterLights.begin(), clusterLights.end(), numPointLights) - clusterLights.begin());
+		clusters.clusterRanges[2 * c + 1] = numPoints | ((GLuint)(clusterLights.size() - numPoints) << 16);
+		clusters.lightIndices.insert(clusters.lightIndices.end(), clusterLights.begin(), clusterLights.end());
+	}
+	const unsigned int numIndices = (unsigned int)clusters.lightIndices.size();
+
+	// the buffers are orphaned, empty lists keep one element
+	glBindBuffer(GL_TEXTURE_BUFFER, clusters.buffers[0]);
+	glBufferData(GL_TEXTURE_BUFFER, std::max(numLights, 1u) * sizeof(ClusterLight), numLights > 0 ? &clusters.lights[0] : NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, clusters.buffers[1]);
+	glBufferData(GL_TEXTURE_BUFFER, clusters.clusterRanges.size() * sizeof(GLuint), &clusters.clusterRanges[0], GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, clusters.buffers[2]);
+	glBufferData(GL_TEXTURE_BUFFER, std::max(numIndices, 1u) * sizeof(unsigned short), numIndices > 0 ? &clusters.lightIndices[0] : NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	// slice = log(depth / near) / log(far / near) * grid z
+	LightUniforms uniforms;
+	float slicesPerLog = CLUSTER_GRID_Z / logf(farPlane / nearPlane);
+	uniforms.clusterScale = glm::vec4((float)CLUSTER_GRID_X / viewportWidth, (float)CLUSTER_GRID_Y / viewportHeight, slicesPerLog, -logf(nearPlane) * slicesPerLog);
+	uniforms.clusterGrid[0] = CLUSTER_GRID_X;
+	uniforms.clusterGrid[1] = CLUSTER_GRID_Y;
+	uniforms.clusterGrid[2] = CLUSTER_GRID_Z;
+	uniforms.numLights = (int)numLights;
+	uploadLightUniforms(uniforms);
+
+	return numIndices;
+}
@@ -0,0 +1,69 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       lightClusters.h
+* \author     agent
+* \date       2026
+* \brief      Point and spot lights binned into clusters of the view frustum.
+*
+*	The view frustum is split into CLUSTER_GRID_X x CLUSTER_GRID_Y tiles of the screen and
+*	CLUSTER_GRID_Z slices of exponentially growing depth. Every frame the lights are binned
+*	into the clusters they may reach, the slices are split among the worker threads. The
+*	lights, the range of the light list of each cluster and the lists themselves are stored
+*	in texture buffers, the fragment shaders light a fragment only by the lights of its cluster.
+*	The point lights of a cluster come first, its range holds the point and spot light counts
+*	in the low and high 16 bits, so the shaders loop over each type without a branch.
+*
+*	Only lights with a position and a range are clustered, the sun stays in the shaders.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#ifndef __LIGHTCLUSTERS_H
+#define __LIGHTCLUSTERS_H
+
+#include "pgr.h"
+#include <vector>
+
+// lights of one frame, the others are dropped
+#define MAX_LIGHTS          1024
+
+#define CLUSTER_GRID_X      16
+#define CLUSTER_GRID_Y      9
+#define CLUSTER_GRID_Z      24
+
+// texture units of the texture buffers, the units below are used by the render queue and the texture arrays
+#define LIGHT_TEXTURE_UNIT        9
+#define CLUSTER_TEXTURE_UNIT      10
+#define LIGHT_INDEX_TEXTURE_UNIT  11
+
+// RGBA32F texels of one ClusterLight in the light texture buffer
+#define LIGHT_TEXELS        7
+
+/**
+*	struct for one light, texels of the Light fetched by fetchLight() of the fragment shaders
+*
+*/
+typedef struct ClusterLight {
+	glm::vec4 position;          // view space, w = 1
+	glm::vec4 ambient;
+	glm::vec4 diffuse;
+	glm::vec4 specular;
+	glm::vec4 spotDirection;     // view space, normalized
+	float     spotCosCutoff;     // -1 for point lights
+	float     spotExponent;
+	float     constantAttenuation;
+	float     linearAttenuation;
+	float     quadraticAttenuation;
+	float     intensity;
+	float     range;             // the light fades out to zero at this distance
+	float     padding;
+} ClusterLight;
+
+void initializeLightClusters();
+void deleteLightClusters();
+void setLightClusterSamplers(GLuint program);
+
+unsigned int buildLightClusters(const std::vector<ClusterLight> &lights, const glm::mat4 &projectionMatrix,
+	float nearPlane, float farPlane, int viewportWidth, int viewportHeight);
+
+#endif
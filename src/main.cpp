@@ -8,20 +8,50 @@
 //----------------------------------------------------------------------------------------
 
 #include <time.h>
+#include <stdlib.h>
+#include <algorithm>
 #include <iostream>
+#include <iomanip>
+#include <sstream>
 #include <list>
 #include "pgr.h"
+#ifdef _WIN32
+#include <GL/wglew.h>
+#endif
 #include "parameters.h"
 #include "objects.h"
 #include "spline.h"
-
-//shader programs
-extern SCommonShaderProgram shaderProgram;
-extern SSkyboxShaderProgram skyboxShaderProgram;
+#include "threadPool.h"
+#include "benchmark.h"
+#include "assetRegistry.h"
+#include "renderQueue.h"
+#include "uniformBuffers.h"
+#include "lightClusters.h"
+#include "idBuffer.h"
+#include "timer.h"
+
+//levels of detail and statistics of the current frame
+extern bool meshLodEnabled;
+extern bool occlusionCullingEnabled;
+extern RenderStats renderStats;
 
 //list for objects in the scene
 typedef std::vector<void *> ObjectsList;
 
+/**
+*	struct for the simulated values a frame interpolates between the last two steps
+*
+*/
+struct SimulationState {
+	float     time;               // elapsedTime
+	glm::vec3 cameraPosition;
+	glm::vec3 cameraDirection;    // used only by the alien view, the other cameras are turned by the input
+	glm::vec3 scannerPosition;
+	glm::vec3 scannerDirection;
+	glm::vec3 alienDirection;
+	float     ufoTime;
+};
+
 struct GameState {
 
 	int windowWidth;
@@ -43,8 +73,29 @@ struct GameState {
 	int fogAutomatic;
 	int lampEnable;
 	bool scannerAnimated;
+	bool statsEnabled;
+
+	int mouseX;                 // last cursor position outside the free camera, from the bottom
+	int mouseY;
+	PickHandle hoveredObject;   // object under the cursor by the object ID buffer
 	
-	float elapsedTime;
+	float elapsedTime;      // simulated time of the last step, multiple of SIMULATION_STEP
+	float particlesTime;    // time the particles are simulated to
+
+	double simulationClock; // high resolution time the simulation has been advanced to, 0 before the first frame
+	float interpolation;    // position of the frame between the last two steps, 0 .. 1
+	SimulationState previousState;
+	SimulationState currentState;
+	bool verticalSync;      // swap waits for the vertical blank, otherwise frames are drawn as fast as possible
+
+	double statsTime;               // high resolution time of the last printed statistics
+	unsigned int statsFrames;       // since the last printed statistics
+	unsigned int statsSteps;
+	double statsDrawSeconds;        // drawing of the frames without waiting for the swap
+	double statsSimulationSeconds;
+
+	int boxesNumber;        // boxes created by reloadScene()
+	int benchmarkLights;    // random lights replacing the lights of the scene, 0 for the scene lights
 
 } gameState;
 
@@ -66,7 +117,13 @@ struct Objects {
 
 	//objects list
 	ObjectsList boxes;
-	ObjectsList explosions;
+	ObjectsList lamps;      // lamps around the compound, switched together with the lamp
+
+	//explosion billboards, see explosions.h
+	ExplosionPool explosions;
+
+	//debris, sparks and smoke of the explosions, see particles.h
+	ParticleSystem particles;
 
 } objects;
 
@@ -93,19 +150,9 @@ bool pointInSphere(const glm::vec3 &point, const glm::vec3 &center, float radius
 
 void insertExplosion(const glm::vec3 & position) {
 
-	ExplosionObject* newExplosion = new ExplosionObject;
-
-	newExplosion->speed = 0.0f;
-	newExplosion->notDestroyed = true;
-	newExplosion->startTime = gameState.elapsedTime;
-	newExplosion->currentTime = newExplosion->startTime;
-	newExplosion->size = 0.1f;
-	newExplosion->direction = glm::vec3(0.0f, 0.0f, 1.0f);
-	newExplosion->frameDuration = 0.1f;
-	newExplosion->textureFrames = 16;
-	newExplosion->position = position;
-
-	objects.explosions.push_back(newExplosion);
+	// 16 frames of 0.1 s, nothing is added when the pool is full
+	spawnExplosion(&objects.explosions, position, 0.1f, gameState.elapsedTime, 0.1f, 16);
+	spawnExplosionParticles(&objects.particles, position, 0.1f);
 }
 
 /**
@@ -139,6 +186,16 @@ void cleanUpObjects(void) {
 		delete objects.boxes.back();
 		objects.boxes.pop_back();
 	}
+
+	// delete lamps around the compound
+	while (!objects.lamps.empty()) {
+		delete (LampObject*)objects.lamps.back();
+		objects.lamps.pop_back();
+	}
+
+	// explosions and their particles do not survive into the new scene
+	clearExplosions(&objects.explosions);
+	clearParticles(&objects.particles);
 }
 
 /**
@@ -181,6 +238,7 @@ AlienObject* createAlien(void){
 	//newAlien->position = glm::vec3(-0.4f, -0.4f, 0.065f);
 	newAlien->position = glm::vec3(0.0f, 0.0f, 0.065f);
 	newAlien->size = ALIEN_SIZE;
+	newAlien->lod = 0;
 	newAlien->collision = glm::length(glm::vec2((objects.camera->position.x - newAlien->position.x), (objects.camera->position.y - newAlien->position.y)));
 	newAlien->direction = glm::vec3((float)(2.0 * (rand() / (double)RAND_MAX) - 1.0), (float)(2.0 * (rand() / (double)RAND_MAX) - 1.0), 0.0f);
 	
@@ -197,6 +255,7 @@ ScannerObject* createScanner(void){
 	newScanner->initPosition = glm::vec3(0.0f, 0.0f, 0.5f);
 	newScanner->position = newScanner->initPosition;
 	newScanner->size = SCANNER_SIZE;
+	newScanner->lod = 0;
 	newScanner->radius = 0.2f;
 
 	newScanner->direction = glm::vec3((float)(2.0 * (rand() / (double)RAND_MAX) - 1.0), (float)(2.0 * (rand() / (double)RAND_MAX) - 1.0), 0.0f);
@@ -215,6 +274,7 @@ CargoObject* createCargo(void){
 
 	newCargo->position = glm::vec3(0.0f, 1.0f, 0.10f);
 	newCargo->size = CARGO_SIZE;
+	newCargo->lod = 0;
 	newCargo->direction = glm::vec3(-0.8f, -0.7f, 0.0f);
 
 	return newCargo;
@@ -229,6 +289,7 @@ StopObject* createStop(void){
 
 	newStop->position = glm::vec3(0.8f, 0.0f, 0.10f);
 	newStop->size = STOP_SIZE;
+	newStop->lod = 0;
 	newStop->direction = glm::vec3(-0.2f, 1.0f, 0.0f);
 
 	return newStop;
@@ -243,6 +304,7 @@ SwarmObject* createSwarm(void){
 
 	newSwarm->position = glm::vec3(0.8f, 0.2f, 0.03f);
 	newSwarm->size = SWARM_SIZE;
+	newSwarm->lod = 0;
 	newSwarm->direction = glm::vec3(-1.0f, 0.1f, 0.0f);
 	newSwarm->collision = glm::length(glm::vec2((objects.camera->position.x - newSwarm->position.x), (objects.camera->position.y - newSwarm->position.y)));
 
@@ -257,6 +319,7 @@ CatObject* createCat(void){
 	CatObject* newCat = new CatObject;
 
 	newCat->size = CAT_SIZE;
+	newCat->lod = 0;
 	newCat->position = generateRandomPosition();
 	newCat->position.z = 0.02f;
 	newCat->direction = glm::vec3((float)(2.0 * (rand() / (double)RAND_MAX) - 1.0), (float)(2.0 * (rand() / (double)RAND_MAX) - 1.0), 0.0f);
@@ -274,22 +337,51 @@ LampObject* createLamp(void){
 
 	newLamp->position = glm::vec3(0.0f, 0.4f, 0.1f);
 	newLamp->size = LAMP_SIZE;
+	newLamp->lod = 0;
 	newLamp->radius = 0.2f;
 	
 	return newLamp;
 }
 
+/**
+*	Creates a lamp on the border of the compound.
+*	\param[in] index Index of the lamp, the lamps are spread evenly along the border.
+*   \return New LampObject
+*/
+LampObject* createCompoundLamp(int index){
+	LampObject* newLamp = new LampObject;
+
+	// walk along the square border, each side has a quarter of the lamps
+	float t = 4.0f * index / COMPOUND_LAMPS;
+	int side = (int)t;
+	float u = 2.0f * (t - side) - 1.0f;
+	float halfX = 0.5f * AREA_SIZE_X, halfY = 0.5f * AREA_SIZE_Y;
+	const glm::vec2 corners[4] = { glm::vec2(u, -1.0f), glm::vec2(1.0f, u), glm::vec2(-u, 1.0f), glm::vec2(-1.0f, -u) };
+
+	newLamp->position = glm::vec3(corners[side].x * halfX, corners[side].y * halfY, 0.1f);
+	newLamp->size = LAMP_SIZE;
+	newLamp->lod = 0;
+	newLamp->radius = 0.2f;
+
+	return newLamp;
+}
+
 /**
 *	Creates a new box.
 *   \return New BoxObject
 */
 BoxObject* createBox(void) {
+	static unsigned int nextId = 1;
+
 	BoxObject* newBox = new BoxObject;
 
+	newBox->id = nextId++;
+
 	newBox->notDestroyed = true;
 	newBox->startTime = gameState.elapsedTime;
 	newBox->currentTime = newBox->startTime;
 	newBox->size = BOX_SIZE;
+	newBox->lod = 0;
 
 	newBox->direction = glm::vec3((float)(2.0 * (rand() / (double)RAND_MAX) - 1.0), (float)(2.0 * (rand() / (double)RAND_MAX) - 1.0), 0.0f);
 	newBox->direction = glm::normalize(newBox->direction);
@@ -316,6 +408,53 @@ UfoObject* createUfo() {
 	return newUfo;
 }
 
+/**
+*	Returns the simulated values of the objects.
+*/
+SimulationState captureSimulationState(void) {
+	SimulationState state;
+	state.time = gameState.elapsedTime;
+	state.cameraPosition = objects.camera->position;
+	state.cameraDirection = objects.camera->direction;
+	state.scannerPosition = objects.scanner->position;
+	state.scannerDirection = objects.scanner->direction;
+	state.alienDirection = objects.alien->direction;
+	state.ufoTime = objects.ufo->time;
+	return state;
+}
+
+/**
+*	Writes the simulated values back to the objects.
+*/
+void applySimulationState(const SimulationState &state) {
+	gameState.elapsedTime = state.time;
+	objects.camera->position = state.cameraPosition;
+	if (gameState.activeCamera == 2)
+		objects.camera->direction = state.cameraDirection;
+	objects.scanner->position = state.scannerPosition;
+	objects.scanner->direction = state.scannerDirection;
+	objects.alien->direction = state.alienDirection;
+	objects.ufo->time = state.ufoTime;
+}
+
+/**
+*	Returns state between the two states.
+*	\param[in] previous State of the previous step.
+*	\param[in] current  State of the last step.
+*	\param[in] t        0 for the previous state, 1 for the current one.
+*/
+SimulationState interpolateSimulationState(const SimulationState &previous, const SimulationState &current, float t) {
+	SimulationState state;
+	state.time = previous.time + t * (current.time - previous.time);
+	state.cameraPosition = glm::mix(previous.cameraPosition, current.cameraPosition, t);
+	state.cameraDirection = glm::normalize(glm::mix(previous.cameraDirection, current.cameraDirection, t));
+	state.scannerPosition = glm::mix(previous.scannerPosition, current.scannerPosition, t);
+	state.scannerDirection = glm::normalize(glm::mix(previous.scannerDirection, current.scannerDirection, t));
+	state.alienDirection = glm::normalize(glm::mix(previous.alienDirection, current.alienDirection, t));
+	state.ufoTime = previous.ufoTime + t * (current.ufoTime - previous.ufoTime);
+	return state;
+}
+
 /**
 *	Sets up camera according to number of active camera
 *
@@ -340,6 +479,12 @@ void setupCamera(void){
 		gameState.cameraElevationAngle = 10.0f;
 	}
 	gameState.cameraNeedsSetup = false;
+
+	// the camera jumps, it is not interpolated from its previous pose
+	gameState.previousState.cameraPosition = objects.camera->position;
+	gameState.currentState.cameraPosition = objects.camera->position;
+	gameState.previousState.cameraDirection = objects.camera->direction;
+	gameState.currentState.cameraDirection = objects.camera->direction;
 }
 
 /**
@@ -350,6 +495,12 @@ void reloadScene(void) {
 
 	cleanUpObjects();
 
+	// models are acquired again, assets the scene does not use any more are freed
+	deleteModels();
+	initializeModels();
+	evictUnusedAssets();
+	printAssetReport();
+
 	//set camera, create newOne and setup it
 	gameState.activeCamera = 0;
 	if (objects.camera == NULL)
@@ -371,16 +522,157 @@ void reloadScene(void) {
 	objects.lamp = createLamp();
 	objects.ufo = createUfo();
 
+	for (int i = 0; i < COMPOUND_LAMPS; i++)
+		objects.lamps.push_back(createCompoundLamp(i));
+
 	// initialize asteroids
-	int maxBoxes = BOXES_NUMBER;
+	int maxBoxes = gameState.boxesNumber;
 	for (int i = 0; i < maxBoxes; i++) {
 		BoxObject* newBox = createBox();
 
 		objects.boxes.push_back(newBox);
 	}
 
+	// frames start from the new scene
+	gameState.currentState = captureSimulationState();
+	gameState.previousState = gameState.currentState;
+}
+
+
+/**
+*	Returns light of a lamp at the position.
+*/
+static ClusterLight lampLight(const glm::vec3 &position) {
+	ClusterLight lamp = ClusterLight();
+	lamp.ambient = glm::vec4(0.2f, 0.2f, 0.2f, 1.0f);
+	lamp.diffuse = glm::vec4(1.0f, 1.0f, 0.35f, 1.0f);
+	lamp.specular = glm::vec4(1.0f);
+	lamp.intensity = 1.5f;
+	lamp.position = glm::vec4(position, 1.0f);
+	lamp.spotCosCutoff = -1.0f;
+	lamp.spotExponent = 0.0f;
+	lamp.constantAttenuation = 0.5f;
+	lamp.linearAttenuation = 1.0f;
+	lamp.quadraticAttenuation = 0.0f;
+	lamp.range = 3.0f;
+	return lamp;
+}
+
+/**
+*	Adds point lights of random colors scattered over the compound, the same ones in each frame.
+*	\param[in,out] lights    Lights of the frame.
+*	\param[in]     numLights Number of lights to add.
+*/
+static void addBenchmarkLights(std::vector<ClusterLight> *lights, int numLights) {
+	unsigned int seed = 51;
+	for (int i = 0; i < numLights; i++) {
+		float random[6];
+		for (int r = 0; r < 6; r++) {
+			seed = seed * 1664525u + 1013904223u;
+			random[r] = (seed >> 8) / (float)(1 << 24);
+		}
+
+		ClusterLight light = ClusterLight();
+		light.diffuse = glm::vec4(random[3], random[4], random[5], 1.0f);
+		light.specular = light.diffuse;
+		light.intensity = 1.0f;
+		light.position = glm::vec4((random[0] - 0.5f) * AREA_SIZE_X, (random[1] - 0.5f) * AREA_SIZE_Y, 0.02f + 0.3f * random[2], 1.0f);
+		light.spotCosCutoff = -1.0f;
+		light.constantAttenuation = 0.5f;
+		light.linearAttenuation = 2.0f;
+		light.range = 0.4f;
+		lights->push_back(light);
+	}
 }
 
+/**
+*	Uploads camera, sun, fog and lights of the frame into the uniform buffers shared by all programs
+*	and selects variants of the programs for them. Has to be called before the draw functions.
+*	\param[in] cameraViewDirection Direction of the flashlight.
+*/
+void updateFrameUniforms(const glm::vec3 &cameraViewDirection) {
+	const glm::mat4 &viewMatrix = gameState.viewMatrix;
+
+	FrameUniforms frame;
+	frame.viewMatrix = viewMatrix;
+	frame.projectionMatrix = gameState.projectionMatrix;
+	frame.PVmatrix = gameState.projectionMatrix * viewMatrix;
+	frame.sunDirection = viewMatrix * glm::vec4(0.0f, 1.0f, 1.0f, 0.0f); // sun stands still above the plane
+	frame.fogColor = glm::vec4(0.6f, 0.6f, 0.6f, 1.0f);
+	frame.fogDensity = 1.0f;
+	frame.fogActive = gameState.fogEnable == 1 ? 1 : 0;
+	uploadFrameUniforms(frame);
+
+	std::vector<ClusterLight> lights;
+	lights.reserve(MAX_LIGHTS);
+
+	if (gameState.benchmarkLights > 0) {
+		addBenchmarkLights(&lights, gameState.benchmarkLights);
+	}
+	else {
+		// lamp and the lamps around the compound
+		if (gameState.lampEnable != 0) {
+			lights.push_back(lampLight(objects.lamp->position));
+			for (ObjectsList::iterator it = objects.lamps.begin(); it != objects.lamps.end(); ++it)
+				lights.push_back(lampLight(((LampObject*)(*it))->position));
+		}
+
+		// flashlight
+		ClusterLight flashlight = ClusterLight();
+		flashlight.ambient = glm::vec4(0.25f, 0.25f, 0.25f, 1.0f);
+		flashlight.diffuse = glm::vec4(1.0f, 1.0f, 0.8f, 1.0f);
+		flashlight.specular = glm::vec4(1.0f);
+		flashlight.intensity = gameState.flashlightIntensity;
+		flashlight.position = glm::vec4(objects.camera->position, 1.0f);
+		flashlight.spotDirection = glm::vec4(cameraViewDirection, 0.0f);
+		flashlight.constantAttenuation = 0.0f;
+		flashlight.linearAttenuation = 1.5f;
+		flashlight.quadraticAttenuation = 0.0f;
+		flashlight.spotExponent = 10.0f;
+		flashlight.spotCosCutoff = 0.97f;
+		flashlight.range = 4.0f;
+		if (flashlight.intensity > 0.0f)
+			lights.push_back(flashlight);
+
+		// explosions flash and fade out during their animation
+		const ExplosionPool &explosions = objects.explosions;
+		for (unsigned int i = 0; i < explosions.count && lights.size() < MAX_LIGHTS; i++) {
+			float age = (gameState.elapsedTime - explosions.startTime[i]) / (explosions.endTime[i] - explosions.startTime[i]);
+			if (age < 0.0f || age > 1.0f)
+				continue;
+
+			ClusterLight explosion = ClusterLight();
+			explosion.diffuse = glm::vec4(1.0f, 0.55f, 0.2f, 1.0f);
+			explosion.specular = glm::vec4(1.0f, 0.8f, 0.5f, 1.0f);
+			explosion.intensity = 2.0f * (1.0f - age);
+			explosion.position = glm::vec4(explosions.positionX[i], explosions.positionY[i], explosions.positionZ[i], 1.0f);
+			explosion.spotCosCutoff = -1.0f;
+			explosion.constantAttenuation = 0.2f;
+			explosion.linearAttenuation = 4.0f;
+			explosion.range = 0.5f;
+			lights.push_back(explosion);
+		}
+	}
+
+	// the shaders light in view space
+	for (size_t i = 0; i < lights.size(); i++) {
+		lights[i].position = viewMatrix * lights[i].position;
+		if (lights[i].spotCosCutoff > -1.0f)
+			lights[i].spotDirection = glm::vec4(glm::normalize(glm::vec3(viewMatrix * lights[i].spotDirection)), 0.0f);
+	}
+
+	buildLightClusters(lights, gameState.projectionMatrix, 0.01f, 10.0f, gameState.windowWidth, gameState.windowHeight);
+
+	// the common programs are compiled without the fog and the light types the frame does not have
+	bool pointLights = false, spotLights = false;
+	for (size_t i = 0; i < lights.size() && i < MAX_LIGHTS; i++) {
+		if (lights[i].spotCosCutoff > -1.0f)
+			spotLights = true;
+		else
+			pointLights = true;
+	}
+	setShaderVariantFrame(frame.fogActive != 0, pointLights, spotLights);
+}
 
 /**
 *	Draws the scene.
@@ -415,41 +707,34 @@ void drawSceneContent(void) {
 		cameraUpVector
 		);
 	gameState.projectionMatrix = glm::perspective(60.0f, gameState.windowWidth / (float)gameState.windowHeight, 0.01f, 10.0f);
+
+	// the items pick their program variants by the fog and the lights
+	updateFrameUniforms(cameraViewDirection);
+
+	// draw functions only queue their draw calls, they are sorted and submitted at the end
+	beginRenderQueue(gameState.viewMatrix, gameState.projectionMatrix);
+
+	// occluders first, the draw functions skip objects hidden behind them
+	drawOccluders(objects.cargo, objects.stop, objects.lamp, gameState.viewMatrix, gameState.projectionMatrix);
 	
 	// floor
-	drawFloor(objects.floor, gameState.viewMatrix, gameState.projectionMatrix);
+	drawFloor(objects.floor);
 	
 	// scanner
 	drawScanner(objects.scanner, gameState.viewMatrix, gameState.projectionMatrix);
 
-	glEnable(GL_STENCIL_TEST);
-	glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
-
-	int id = 0;
 	// draw objects boom
-	for (ObjectsList::iterator it = objects.boxes.begin(); it != objects.boxes.end(); ++it) {
-		glStencilFunc(GL_ALWAYS, id + 1, 0xFF);
-		BoxObject* box = (BoxObject*)(*it);
-		drawBox(box, gameState.viewMatrix, gameState.projectionMatrix);
-		id++;
-	}
-	
-	glDisable(GL_STENCIL_TEST);
+	drawBoxes(objects.boxes, gameState.viewMatrix, gameState.projectionMatrix);
 
 	// skybox
-	drawSkybox(gameState.viewMatrix, gameState.projectionMatrix);
+	drawSkybox();
 
 	// ufo
-	drawUfo(objects.ufo, gameState.viewMatrix, gameState.projectionMatrix);
-
-	// draw explosions with depth test disabled
-	glDisable(GL_DEPTH_TEST);
+	drawUfo(objects.ufo, gameState.viewMatrix);
 
-	for (ObjectsList::iterator it = objects.explosions.begin(); it != objects.explosions.end(); ++it) {
-		ExplosionObject* explosion = (ExplosionObject *)(*it);
-		drawExplosion(explosion, gameState.viewMatrix, gameState.projectionMatrix);
-	}
-	glEnable(GL_DEPTH_TEST);
+	// explosions are drawn with depth test disabled
+	drawExplosions(objects.explosions, gameState.elapsedTime);
+	drawParticles(objects.particles);
 	
 	// alien
 	drawAlien(objects.alien, gameState.viewMatrix, gameState.projectionMatrix);
@@ -469,77 +754,104 @@ void drawSceneContent(void) {
 	objects.swarm2->direction = glm::vec3(-0.42f, -0.9f, 0.0f);
 	objects.swarm2->collision = glm::length(glm::vec2((objects.camera->position.x - objects.swarm2->position.x), (objects.camera->position.y - objects.swarm2->position.y)));
 
-	glEnable(GL_STENCIL_TEST);
-	glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
-
-	// cat
-	glStencilFunc(GL_ALWAYS, 88, 0xFF);
+	// cat, the lamps and the boxes have object IDs of their pick handles
+	PickHandle handle = { PICK_CAT, 0 };
+	setRenderObjectId(packPickHandle(handle));
 	drawCat(objects.cat, gameState.viewMatrix, gameState.projectionMatrix);
 	
 	// lamp
-	glStencilFunc(GL_ALWAYS, 99, 0xFF);
+	handle.type = PICK_LAMP;
+	setRenderObjectId(packPickHandle(handle));
 	drawLamp(objects.lamp, gameState.viewMatrix, gameState.projectionMatrix);
-	
-	glDisable(GL_STENCIL_TEST);
 
-	glUseProgram(shaderProgram.program);
-	glUniform3fv(shaderProgram.lampPositionLoc, 1, glm::value_ptr(objects.lamp->position));
-	glUniform1f(shaderProgram.lampIntensityLoc, 1.5f);
+	// lamps around the compound
+	for (unsigned int i = 0; i < objects.lamps.size(); i++) {
+		handle.id = i + 1;
+		setRenderObjectId(packPickHandle(handle));
+		drawLamp((LampObject*)objects.lamps[i], gameState.viewMatrix, gameState.projectionMatrix);
+	}
+
+	setRenderObjectId(0);
 
-	glUniform3fv(shaderProgram.flashlightPositionLoc, 1, glm::value_ptr(objects.camera->position));
-	glUniform3fv(shaderProgram.flashlightDirectionLoc, 1, glm::value_ptr(cameraViewDirection));
-	glUseProgram(0);
+	flushRenderQueue();
 }
 
 
 /**
-*	Callback for update the display.
-*
+*	Handles click on the object: explodes a box, catches the cat or switches the lamps.
+*	\param[in] picked Clicked object, type PICK_NONE for the background.
 */
-void displayCallback() {
-	GLbitfield mask = GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT;
-
-	glUseProgram(shaderProgram.program);
-	// fog
-	if (gameState.fogEnable == 1) {
-		glUniform1i(shaderProgram.fogActiveLocation, 1);
-	} else {
-		glUniform1i(shaderProgram.fogActiveLocation, 0);
-	}
-
-	
-	// flashlight
-	if (gameState.flashlightEnable == 0) {
-		glUniform1f(shaderProgram.flashlightIntensityLoc, gameState.flashlightIntensity);
+void clickObject(const PickHandle &picked) {
+
+	if (picked.type == PICK_NONE) { 		// background was clicked
+		std::cout << "Clicked on background" << std::endl;
+	} 
+	else if (picked.type == PICK_CAT) {
+		std::cout << "MEOW!!!" << std::endl;
+		objects.cat->size = 0.0f;
 	}
-	else {
-		glUniform1f(shaderProgram.flashlightIntensityLoc, gameState.flashlightIntensity);
+	else if (picked.type == PICK_LAMP) {
+		std::cout << "Clicked on lamp" << std::endl;
+		gameState.lampEnable = !gameState.lampEnable;
 	}
+	else if (picked.type == PICK_BOX) {
+		std::cout << "Clicked on object with ID: " << picked.id << std::endl;
 
-	// lamp
-	if (gameState.lampEnable == 0) {
-		glUniform1i(shaderProgram.lampActiveLoc, 0);
-	}
-	else {
-		glUniform1i(shaderProgram.lampActiveLoc, 1);
+		// the id stays with its box, other boxes may have been removed since it was created
+		for (ObjectsList::iterator it = objects.boxes.begin(); it != objects.boxes.end(); ++it) {
+			BoxObject* asteroid = (BoxObject*)(*it);
+			if (asteroid->id != picked.id)
+				continue;
+
+			if (asteroid->notDestroyed == true) {
+				asteroid->notDestroyed = false;		   // remove asteroid
+				insertExplosion(asteroid->position);   // insert explosion billboard
+			}
+			break;
+		}
 	}
+}
 
-	glUseProgram(0);
+/**
+*	Shows the object under the cursor in the title of the window when it changes.
+*	\param[in] hovered Object under the cursor, type PICK_NONE for the background.
+*/
+void hoverObject(const PickHandle &hovered) {
+
+	if (hovered.type == gameState.hoveredObject.type && hovered.id == gameState.hoveredObject.id)
+		return;
+	gameState.hoveredObject = hovered;
+
+	std::ostringstream title;
+	title << WINDOW_TITLE;
+	if (hovered.type == PICK_BOX)
+		title << " - box " << hovered.id;
+	else if (hovered.type == PICK_CAT)
+		title << " - cat";
+	else if (hovered.type == PICK_LAMP)
+		title << " - lamp";
+	glutSetWindowTitle(title.str().c_str());
+}
 
-	glUseProgram(skyboxShaderProgram.program);
-	
-	// fog
-	if (gameState.fogEnable == 1) {
-		glUniform1i(skyboxShaderProgram.fogActiveLocation, 1);
-	}
-	else {
-		glUniform1i(skyboxShaderProgram.fogActiveLocation, 0);
+/**
+*	Draws one frame of the scene for the benchmarks and waits until it is finished.
+*	\param[in] numLights Number of random lights replacing the lights of the scene, 0 keeps the scene lights.
+*/
+void drawBenchmarkFrame(unsigned int numLights) {
+
+	// the window may not have been shown yet
+	if (gameState.windowWidth == 0 || gameState.windowHeight == 0) {
+		gameState.windowWidth = WINDOW_WIDTH;
+		gameState.windowHeight = WINDOW_HEIGHT;
 	}
-	glUseProgram(0);
+	glViewport(0, 0, gameState.windowWidth, gameState.windowHeight);
 
-	glClear(mask);
+	gameState.benchmarkLights = (int)numLights;
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+	resetRenderStats();
 	drawSceneContent();
-	glutSwapBuffers();
+	glFinish();
+	gameState.benchmarkLights = 0;
 }
 
 /**
@@ -552,6 +864,7 @@ void reshapeCallback(int newWidth, int newHeight) {
 	gameState.windowHeight = newHeight;
 
 	glViewport(0, 0, (GLsizei)newWidth, (GLsizei)newHeight);
+	resizeIdBuffer(newWidth, newHeight);
 }
 
 void updateObjects(float elapsedTime) {
@@ -569,24 +882,13 @@ void updateObjects(float elapsedTime) {
 		}
 	}
 
-	// update explosion billboards
-	it = objects.explosions.begin();
-	while (it != objects.explosions.end()) {
-		ExplosionObject* explosion = (ExplosionObject*)(*it);
-
-		// update explosion
-		explosion->currentTime = elapsedTime;
+	// remove explosion billboards whose animation has ended
+	expireExplosions(&objects.explosions, elapsedTime);
 
-		if (explosion->currentTime > explosion->startTime + explosion->textureFrames*explosion->frameDuration)
-			explosion->notDestroyed = false;
-
-		if (explosion->notDestroyed == false) {
-			it = objects.explosions.erase(it);
-		}
-		else {
-			++it;
-		}
-	}
+	// particles bounce off the floor, the step is limited after long frames (scene reload)
+	float particleStep = std::min(std::max(elapsedTime - gameState.particlesTime, 0.0f), 0.1f);
+	gameState.particlesTime = elapsedTime;
+	updateParticles(&objects.particles, particleStep, objects.floor->position.z);
 
 	float curveParamT = 0.5f * (elapsedTime - objects.scanner->startTime);
 	float curveAlienParamT = (elapsedTime - objects.scanner->startTime);
@@ -613,18 +915,19 @@ void updateObjects(float elapsedTime) {
 
 /**
 *	Moving with free camera.
-*
+*	\param[in] type      0 forward, 1 backward, 2 right, 3 left.
+*	\param[in] deltaTime Duration of the simulation step in seconds.
 */
-void move(int type) {
+void move(int type, float deltaTime) {
 	glm::vec3 newPosition;
 	float speed;
 	float direction;
 
 	if (objects.camera->sprint == 1) {
-		speed = 0.05f;
+		speed = CAMERA_SPRINT_SPEED * deltaTime;
 	}
 	else {
-		speed = 0.01f;
+		speed = CAMERA_MOVEMENT_SPEED * deltaTime;
 	}
 
 	if (type == 0) {
@@ -674,22 +977,20 @@ void move(int type) {
 }
 
 /**
-*	Callback for timer.
-*
+*	Advances the simulation by one fixed step.
+*	\param[in] deltaTime Duration of the step in seconds, SIMULATION_STEP.
 */
-void timerCallback(int) {
+void simulationStep(float deltaTime) {
 	// update scene time
-	gameState.elapsedTime = 0.001f * (float)glutGet(GLUT_ELAPSED_TIME); // milliseconds => seconds
+	gameState.elapsedTime += deltaTime;
 
 	// free camera
-	glm::vec3 newPosition;
-	float timeDelta = gameState.elapsedTime - objects.camera->currentTime;
 	objects.camera->currentTime = gameState.elapsedTime;
 	if (gameState.freeCamera == true) {
-		if (gameState.keyMap[KEY_UP_ARROW] == true) move(0);
-		if (gameState.keyMap[KEY_DOWN_ARROW] == true) move(1);
-		if (gameState.keyMap[KEY_RIGHT_ARROW] == true) move(2);
-		if (gameState.keyMap[KEY_LEFT_ARROW] == true) move(3);
+		if (gameState.keyMap[KEY_UP_ARROW] == true) move(0, deltaTime);
+		if (gameState.keyMap[KEY_DOWN_ARROW] == true) move(1, deltaTime);
+		if (gameState.keyMap[KEY_RIGHT_ARROW] == true) move(2, deltaTime);
+		if (gameState.keyMap[KEY_LEFT_ARROW] == true) move(3, deltaTime);
 	}
 
 	if (gameState.activeCamera == 2) {
@@ -706,7 +1007,7 @@ void timerCallback(int) {
 
 	if (objects.ufo->direction == 0) {
 		if (objects.ufo->time < 4.5f) {
-			objects.ufo->time += 0.01f;
+			objects.ufo->time += UFO_SCROLL_SPEED * deltaTime;
 		}
 		else {
 			objects.ufo->direction = 1;
@@ -714,19 +1015,156 @@ void timerCallback(int) {
 	}
 	else {
 		if (objects.ufo->time > 0.5f) {
-			objects.ufo->time -= 0.01f;
+			objects.ufo->time -= UFO_SCROLL_SPEED * deltaTime;
 		}
 		else {
 			objects.ufo->direction = 0;
 		}
 	}
 	//std::cout << objects.ufo->time << std::endl;
+}
+
+/**
+*	Runs the fixed steps up to the time and sets where the frame lies between the last two of them.
+*	At most SIMULATION_MAX_STEPS are run, the time the simulation could not catch up with is dropped.
+*	\param[in] now High resolution time of the frame.
+*/
+void advanceSimulation(double now) {
 
+	if (gameState.simulationClock == 0.0)
+		gameState.simulationClock = now;
 
-	glutTimerFunc(REFRESH_INTERVAL, timerCallback, 0);
+	double startTime = highResolutionTime();
+	unsigned int steps = 0;
+	while (now - gameState.simulationClock >= SIMULATION_STEP) {
+		if (steps == SIMULATION_MAX_STEPS) {
+			gameState.simulationClock = now;
+			break;
+		}
+		gameState.previousState = gameState.currentState;
+		simulationStep(SIMULATION_STEP);
+		gameState.currentState = captureSimulationState();
+		gameState.simulationClock += SIMULATION_STEP;
+		steps++;
+	}
+
+	gameState.interpolation = std::min(std::max((float)((now - gameState.simulationClock) / SIMULATION_STEP), 0.0f), 1.0f);
+	gameState.statsSteps += steps;
+	gameState.statsSimulationSeconds += highResolutionTime() - startTime;
+}
+
+/**
+*	Callback called when there are no events, the next frame is drawn at once.
+*	With the vertical sync on, glutSwapBuffers() paces the frames.
+*/
+void idleCallback(void) {
 	glutPostRedisplay();
 }
 
+/**
+*	Switches waiting for the vertical blank in glutSwapBuffers().
+*	\param[in] enabled True to wait, false to draw the frames as fast as possible.
+*	\return False if the driver does not let the application set the swap interval.
+*/
+bool setVerticalSync(bool enabled) {
+#ifdef _WIN32
+	if (WGLEW_EXT_swap_control) {
+		wglSwapIntervalEXT(enabled ? 1 : 0);
+		return true;
+	}
+#else
+	(void)enabled;
+#endif
+	return false;
+}
+
+/**
+*	Starts a new period of the frame and simulation statistics.
+*	\param[in] now High resolution time the period starts at.
+*/
+void resetFrameStats(double now) {
+	gameState.statsTime = now;
+	gameState.statsFrames = 0;
+	gameState.statsSteps = 0;
+	gameState.statsDrawSeconds = 0.0;
+	gameState.statsSimulationSeconds = 0.0;
+}
+
+/**
+*	Callback for update the display.
+*
+*/
+void displayCallback() {
+	GLbitfield mask = GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT;
+
+	// fixed steps up to now, the frame shows the scene between the last two of them
+	advanceSimulation(highResolutionTime());
+	if (gameState.cameraNeedsSetup == true) setupCamera();
+
+	double drawStartTime = highResolutionTime();
+	applySimulationState(interpolateSimulationState(gameState.previousState, gameState.currentState, gameState.interpolation));
+
+	if (!beginIdBufferFrame(mask))
+		glClear(mask);
+	resetRenderStats();
+	drawSceneContent();
+
+	// object under the cursor, the free camera keeps the cursor in the center
+	if (idBufferEnabled()) {
+		if (gameState.freeCamera)
+			queryIdBuffer(ID_QUERY_HOVER, gameState.windowWidth / 2, gameState.windowHeight / 2);
+		else
+			queryIdBuffer(ID_QUERY_HOVER, gameState.mouseX, gameState.mouseY);
+	}
+	endIdBufferFrame();
+
+	// the next steps go on from the last one
+	applySimulationState(gameState.currentState);
+	gameState.statsDrawSeconds += highResolutionTime() - drawStartTime;
+	gameState.statsFrames++;
+
+	glutSwapBuffers();
+
+	// queries of the previous frames whose pixels have arrived
+	IdQueryResult result;
+	while (pollIdBuffer(&result)) {
+		if (result.kind == ID_QUERY_CLICK)
+			clickObject(result.handle);
+		else if (idBufferEnabled())
+			hoverObject(result.handle);
+	}
+
+	// statistics of the current frame once per second
+	double now = highResolutionTime();
+	if (gameState.statsEnabled && now - gameState.statsTime >= 1.0) {
+		double period = now - gameState.statsTime;
+		std::streamsize precision = std::cout.precision(3);
+		std::cout << "frames per second: " << gameState.statsFrames / period << " (drawing " << 1e3 * gameState.statsDrawSeconds / std::max(gameState.statsFrames, 1u)
+			<< " ms per frame, vertical sync " << (gameState.verticalSync ? "on" : "off") << "), simulation steps per second: " << gameState.statsSteps / period
+			<< " (" << 1e3 * gameState.statsSimulationSeconds / std::max(gameState.statsSteps, 1u) << " ms per step)" << std::endl;
+		std::cout.precision(precision);
+		resetFrameStats(now);
+
+		std::cout << "triangles per frame: " << renderStats.triangles << " (LOD " << (meshLodEnabled ? "on" : "off")
+			<< ", full detail " << renderStats.fullDetailTriangles << "), draw calls: " << renderStats.drawCalls
+			<< " (" << renderStats.indirectDraws << " draws in multi-draw indirect calls)" << std::endl;
+		std::cout << "visible objects per frame: " << renderStats.visibleObjects << " / " << renderStats.totalObjects
+			<< " (occluded " << renderStats.occludedObjects << ", occlusion culling " << (occlusionCullingEnabled ? "on" : "off") << ")" << std::endl;
+		std::cout << "state changes per frame: " << renderStats.stateChanges << " (unsorted " << renderStats.unsortedStateChanges
+			<< "), program " << renderStats.programChanges << ", vao " << renderStats.vertexArrayChanges
+			<< ", texture " << renderStats.textureChanges << ", blend/depth/id " << renderStats.fixedStateChanges << std::endl;
+	}
+}
+
+/**
+*	Remembers position of the cursor for the hover queries of the object ID buffer.
+*	\param[in] mouseX   New mouse X position.
+*	\param[in] mouseY   New mouse Y position.
+*/
+void hoverMotionCallback(int mouseX, int mouseY) {
+	gameState.mouseX = mouseX;
+	gameState.mouseY = gameState.windowHeight - 1 - mouseY;
+}
 
 /**
 *	Listens to mouse motion.
@@ -804,7 +1242,7 @@ void keyboardCallback(unsigned char keyPressed, int mouseX, int mouseY) {
 				}
 				else {
 					gameState.cameraNeedsSetup = true;
-					glutPassiveMotionFunc(NULL);
+					glutPassiveMotionFunc(hoverMotionCallback);
 				}
 			}
 			break;
@@ -831,7 +1269,7 @@ void keyboardCallback(unsigned char keyPressed, int mouseX, int mouseY) {
 			gameState.activeCamera %= NUMBER_OF_CAMERA;
 			gameState.cameraNeedsSetup = true;
 			gameState.freeCamera = false;
-			glutPassiveMotionFunc(NULL);
+			glutPassiveMotionFunc(hoverMotionCallback);
 			break;
 		case 'w':
 			gameState.keyMap[KEY_UP_ARROW] = true;
@@ -848,6 +1286,33 @@ void keyboardCallback(unsigned char keyPressed, int mouseX, int mouseY) {
 		case 'r':
 			reloadScene();
 			break;
+		case 'v':
+			meshLodEnabled = !meshLodEnabled;
+			std::cout << "mesh LOD " << (meshLodEnabled ? "on" : "off") << std::endl;
+			break;
+		case 'h':
+			occlusionCullingEnabled = !occlusionCullingEnabled;
+			std::cout << "occlusion culling " << (occlusionCullingEnabled ? "on" : "off") << std::endl;
+			break;
+		case 'i':
+			gameState.statsEnabled = !gameState.statsEnabled;
+			resetFrameStats(highResolutionTime());
+			break;
+		case 'u':
+			gameState.verticalSync = !gameState.verticalSync;
+			if (setVerticalSync(gameState.verticalSync))
+				std::cout << "vertical sync " << (gameState.verticalSync ? "on" : "off") << std::endl;
+			else
+				std::cout << "vertical sync cannot be switched by this driver" << std::endl;
+			break;
+		case 'p':
+			setIdBufferEnabled(!idBufferEnabled(), gameState.windowWidth, gameState.windowHeight);
+			std::cout << "object ID buffer " << (idBufferEnabled() ? "on" : "off") << std::endl;
+			if (!idBufferEnabled()) {
+				PickHandle none = { PICK_NONE, 0 };
+				hoverObject(none);
+			}
+			break;
 		default:
 			;
 		}
@@ -989,51 +1454,31 @@ void mouseWheel(int button, int dir, int x, int y) {
 			if (gameState.flashlightIntensity > 0.1f) gameState.flashlightIntensity -= 0.1f;
 		}
 		std::cout << "flashlight " << gameState.flashlightIntensity << std::endl;
-		glUseProgram(shaderProgram.program);
-		glUniform1f(shaderProgram.flashlightIntensityLoc, gameState.flashlightIntensity);
-		glUseProgram(0);
 	}
 
 	return;
 }
 
 /**
-*	If mouse is clicked, reads from stencil buffer.
+*	If mouse is clicked, finds the clicked object by the object ID buffer when it is enabled,
+*	otherwise by a ray cast through the clicked pixel.
 *
 */
 void mouseCallback(int buttonPressed, int buttonState, int mouseX, int mouseY)
 {
 	if ((buttonPressed == GLUT_LEFT_BUTTON) && (buttonState == GLUT_DOWN)) {
-		unsigned char objectID = 0;
 
 		//std::cout << "klik leve mysi - " << "x: " << mouseX << " y: " << mouseY << std::endl;
 
-		glReadPixels(mouseX, gameState.windowHeight - 1 - mouseY, 1, 1, GL_STENCIL_INDEX, GL_UNSIGNED_BYTE, &objectID);
-		
-		if (objectID == 0) { 		// background was clicked
-			std::cout << "Clicked on background" << std::endl;
-		} 
-		else if (objectID == 88) {
-			std::cout << "MEOW!!!" << std::endl;
-			objects.cat->size = 0.0f;
-		}
-		else if (objectID == 99) {
-			std::cout << "Clicked on lamp" << std::endl;
-			gameState.lampEnable = !gameState.lampEnable;
-		}
-		else {				// object was clicked
-			std::cout << "Clicked on object with ID: " << (int)objectID << std::endl;
-
-			ObjectsList::iterator it = objects.boxes.begin();
-			std::advance(it, objectID - 1); // now it points to the nth asteroids of the list (counting from zero)
-			BoxObject* asteroid = (BoxObject*)(*it);
-
-			if (asteroid->notDestroyed == true) {
-				asteroid->notDestroyed = false;		   // remove asteroid
-				insertExplosion(asteroid->position);   // insert explosion billboard
-			}
+		// the ID buffer answers after the next frame, clickObject() is called by displayCallback()
+		if (idBufferEnabled()) {
+			queryIdBuffer(ID_QUERY_CLICK, mouseX, gameState.windowHeight - 1 - mouseY);
+			return;
 		}
 
+		clickObject(pickObject(objects.boxes, objects.cat, objects.lamp, objects.lamps,
+			mouseX, gameState.windowHeight - 1 - mouseY, gameState.windowWidth, gameState.windowHeight,
+			gameState.viewMatrix, gameState.projectionMatrix));
 	}
 }
 
@@ -1065,7 +1510,7 @@ void myMenu(int item)
 			}
 			else {
 				gameState.cameraNeedsSetup = true;
-				glutPassiveMotionFunc(NULL);
+				glutPassiveMotionFunc(hoverMotionCallback);
 			}
 		}
 		break;
@@ -1165,14 +1610,25 @@ void initializeApplication(void) {
 	gameState.fogAutomatic = 0;
 	gameState.flashlightEnable = 0;
 	gameState.lampEnable = 0;
+	gameState.benchmarkLights = 0;
 
-	// initialize shaders
+	// workers for loading of assets
+	initializeThreadPool();
+
+	// initialize shaders and the uniform buffers they share
+	initializeUniformBuffers();
+	initializeLightClusters();
 	initializeShaderPrograms();
-	// create geometry for all models used
-	initializeModels();
 
 	objects.camera = NULL;
-
+	initExplosionPool(&objects.explosions);
+	initParticleSystem(&objects.particles);
+	gameState.particlesTime = 0.0f;
+	gameState.elapsedTime = 0.0f;
+	gameState.simulationClock = 0.0;
+	resetFrameStats(highResolutionTime());
+
+	// create geometry for all models used and the scene
 	reloadScene();
 }
 
@@ -1186,7 +1642,14 @@ void finalizeApplication(void) {
 	objects.camera = NULL;
 
 	deleteModels();
+	evictUnusedAssets();
 	deleteShaderPrograms();
+	deleteUniformBuffers();
+	deleteLightClusters();
+	deleteRenderQueue();
+	deleteIdBuffer();
+
+	finalizeThreadPool();
 }
 
 int main(int argc, char** argv) {
@@ -1194,6 +1657,16 @@ int main(int argc, char** argv) {
 	// initialize windowing system
 	glutInit(&argc, argv);
 
+	// -benchmark <name> runs the benchmark instead of the game, -boxes <count> changes the number of boxes
+	const char* benchmarkName = NULL;
+	gameState.boxesNumber = BOXES_NUMBER;
+	for (int i = 1; i < argc - 1; i++) {
+		if (std::string(argv[i]) == "-benchmark")
+			benchmarkName = argv[i + 1];
+		else if (std::string(argv[i]) == "-boxes")
+			gameState.boxesNumber = std::max(atoi(argv[i + 1]), 0);
+	}
+
 	glutInitContextVersion(pgr::OGL_VER_MAJOR, pgr::OGL_VER_MINOR);
 	glutInitContextFlags(GLUT_FORWARD_COMPATIBLE);
 	glutInitDisplayMode(GLUT_RGB | GLUT_DOUBLE | GLUT_DEPTH | GLUT_STENCIL);
@@ -1214,10 +1687,11 @@ int main(int argc, char** argv) {
 	
 	// mouse
 	glutMouseFunc(mouseCallback);
+	glutPassiveMotionFunc(hoverMotionCallback);
 	glutMouseWheelFunc(mouseWheel);
 	
-	// timer
-	glutTimerFunc(REFRESH_INTERVAL, timerCallback, 0);
+	// frames are drawn whenever there are no events, the simulation runs by fixed steps inside them
+	glutIdleFunc(idleCallback);
 
 	// openGL initialize
 	if (!pgr::initialize(pgr::OGL_VER_MAJOR, pgr::OGL_VER_MINOR))
@@ -1228,6 +1702,15 @@ int main(int argc, char** argv) {
 
 	// application
 	initializeApplication();
+	gameState.verticalSync = true;
+	setVerticalSync(gameState.verticalSync);
+
+	if (benchmarkName != NULL) {
+		bool success = runBenchmark(benchmarkName, drawBenchmarkFrame);
+		finalizeApplication();
+		return success ? 0 : 1;
+	}
+
 	glutCloseFunc(finalizeApplication);
 	glutMainLoop();
 
@@ -0,0 +1,347 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       meshBuffer.cpp
+* \author     agent
+* \date       2026
+* \brief      One vertex and two index buffers shared by all loaded models.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "pgr.h"
+#include "parameters.h"
+#include "vertexFormat.h"
+#include "meshBuffer.h"
+
+/**
+*	struct for a vertex array reading the shared buffers with attribute locations of one program
+*
+*/
+typedef struct MeshBufferVertexArray {
+	GLint  posLocation;
+	GLint  normalLocation;
+	GLint  texCoordLocation;
+	GLenum indexType;
+	GLuint vertexArrayObject;
+} MeshBufferVertexArray;
+
+/**
+*	struct for the shared buffers
+*
+*/
+typedef struct MeshBuffer {
+	GLuint       vertexBufferObject;
+	GLuint       elementBufferObject;        // 32-bit indices rebased to the vertex buffer
+	GLuint       shortElementBufferObject;   // 16-bit indices relative to the first vertex of their model
+	unsigned int vertexCapacity;
+	unsigned int indexCapacity;
+	unsigned int shortIndexCapacity;
+	unsigned int numVertices;     // used by the models, released ranges included
+	unsigned int numIndices;
+	unsigned int numShortIndices;
+	unsigned int numRanges;       // models not released yet
+
+	std::vector<MeshBufferVertexArray> vertexArrays;
+} MeshBuffer;
+
+static MeshBuffer meshBuffer;
+
+/**
+*	Returns true if the driver can draw the render queue by multi-draw indirect calls reading
+*	per draw data by gl_DrawID (OpenGL 4.3 and ARB_shader_draw_parameters or OpenGL 4.6).
+*	Has to be called from the thread owning the OpenGL context.
+*/
+bool multiDrawIndirectSupported() {
+	static int supported = -1;
+
+	if (supported < 0) {
+		GLint major = 0, minor = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &major);
+		glGetIntegerv(GL_MINOR_VERSION, &minor);
+
+		supported = 0;
+		if (major > 4 || (major == 4 && minor >= 6)) {
+			supported = 1;
+		}
+		else if (major == 4 && minor >= 3) {
+			GLint numExtensions = 0;
+			glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+
+			for (GLint i = 0; i < numExtensions; i++) {
+				const char *extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+				if (extension != NULL && strcmp(extension, "GL_ARB_shader_draw_parameters") == 0)
+					supported = 1;
+			}
+		}
+	}
+
+	return supported == 1;
+}
+
+/**
+*	Returns true if the driver has draw calls with a base vertex (OpenGL 3.2 or ARB_draw_elements_base_vertex).
+*	Has to be called from the thread owning the OpenGL context.
+*/
+bool baseVertexSupported() {
+	static int supported = -1;
+
+	if (supported < 0) {
+		GLint major = 0, minor = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &major);
+		glGetIntegerv(GL_MINOR_VERSION, &minor);
+
+		supported = 0;
+		if (major > 3 || (major == 3 && minor >= 2)) {
+			supported = 1;
+		}
+		else {
+			GLint numExtensions = 0;
+			glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+
+			for (GLint i = 0; i < numExtensions; i++) {
+				const char *extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+				if (extension != NULL && strcmp(extension, "GL_ARB_draw_elements_base_vertex") == 0)
+					supported = 1;
+			}
+		}
+	}
+
+	return supported == 1;
+}
+
+/**
+*	Returns vertex format of the shared vertex buffer, MESH_FORMAT_FLOAT or MESH_FORMAT_COMPACT.
+*/
+unsigned int meshBufferFormat() {
+	return MESH_COMPACT_VERTICES ? MESH_FORMAT_COMPACT : MESH_FORMAT_FLOAT;
+}
+
+/**
+*	Returns type of the indices a model gets in the shared buffers.
+*	\param[in] numVertices Vertices of the model.
+*	\return GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+*/
+GLenum meshBufferIndexType(unsigned int numVertices) {
+	return numVertices <= 65536 && baseVertexSupported() ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+/**
+*	Enlarges the buffer, its name stays the same, so vertex arrays using it need no update.
+*	\param[in] buffer    Buffer to enlarge.
+*	\param[in] usedBytes Content kept in the enlarged buffer.
+*	\param[in] newBytes  New size of the buffer.
+*/
+static void growBuffer(GLuint buffer, size_t usedBytes, size_t newBytes) {
+
+	GLuint copy = 0;
+
+	if (usedBytes > 0) {
+		glGenBuffers(1, &copy);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, copy);
+		glBufferData(GL_COPY_WRITE_BUFFER, usedBytes, NULL, GL_STATIC_COPY);
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedBytes);
+	}
+
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+	glBufferData(GL_COPY_READ_BUFFER, newBytes, NULL, GL_STATIC_DRAW);
+
+	if (usedBytes > 0) {
+		glCopyBufferSubData(GL_COPY_WRITE_BUFFER, GL_COPY_READ_BUFFER, 0, 0, usedBytes);
+		glDeleteBuffers(1, &copy);
+	}
+
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	CHECK_GL_ERROR();
+}
+
+/**
+*	Makes room for more models, so they are appended without copying the buffers for each of them.
+*	\param[in] numVertices     Vertices of the models to add.
+*	\param[in] numIndices      32-bit indices of the models to add.
+*	\param[in] numShortIndices 16-bit indices of the models to add, see meshBufferIndexType().
+*/
+void reserveMeshBuffer(unsigned int numVertices, unsigned int numIndices, unsigned int numShortIndices) {
+
+	if (meshBuffer.vertexBufferObject == 0) {
+		glGenBuffers(1, &meshBuffer.vertexBufferObject);
+		glGenBuffers(1, &meshBuffer.elementBufferObject);
+		glGenBuffers(1, &meshBuffer.shortElementBufferObject);
+	}
+
+	const size_t vertexSize = meshVertexSize(meshBufferFormat());
+
+	if (meshBuffer.numVertices + numVertices > meshBuffer.vertexCapacity) {
+		unsigned int capacity = std::max(meshBuffer.numVertices + numVertices, 2 * meshBuffer.vertexCapacity);
+		growBuffer(meshBuffer.vertexBufferObject, meshBuffer.numVertices * vertexSize, capacity * vertexSize);
+		meshBuffer.vertexCapacity = capacity;
+	}
+
+	if (meshBuffer.numIndices + numIndices > meshBuffer.indexCapacity) {
+		unsigned int capacity = std::max(meshBuffer.numIndices + numIndices, 2 * meshBuffer.indexCapacity);
+		growBuffer(meshBuffer.elementBufferObject, meshBuffer.numIndices * sizeof(unsigned int), capacity * sizeof(unsigned int));
+		meshBuffer.indexCapacity = capacity;
+	}
+
+	if (meshBuffer.numShortIndices + numShortIndices > meshBuffer.shortIndexCapacity) {
+		unsigned int capacity = std::max(meshBuffer.numShortIndices + numShortIndices, 2 * meshBuffer.shortIndexCapacity);
+		growBuffer(meshBuffer.shortElementBufferObject, meshBuffer.numShortIndices * sizeof(unsigned short), capacity * sizeof(unsigned short));
+		meshBuffer.shortIndexCapacity = capacity;
+	}
+}
+
+/**
+*	Packs the model and appends it to the shared buffers.
+*	\param[in]  vertices    Interleaved vertex data |VVVNNNTT|VVVNNNTT|...
+*	\param[in]  numVertices Number of vertices.
+*	\param[in]  indices     Indices of the triangles, relative to the model.
+*	\param[in]  numIndices  Number of indices.
+*	\param[out] range       Vertices and indices of the model in the shared buffers.
+*/
+void addMeshToBuffer(const float *vertices, unsigned int numVertices, const unsigned int *indices, unsigned int numIndices, MeshBufferRange *range) {
+
+	const GLenum indexType = meshBufferIndexType(numVertices);
+	if (indexType == GL_UNSIGNED_SHORT)
+		reserveMeshBuffer(numVertices, 0, numIndices);
+	else
+		reserveMeshBuffer(numVertices, numIndices, 0);
+
+	range->firstVertex = meshBuffer.numVertices;
+	range->numVertices = numVertices;
+	range->firstIndex = indexType == GL_UNSIGNED_SHORT ? meshBuffer.numShortIndices : meshBuffer.numIndices;
+	range->numIndices = numIndices;
+	range->indexType = indexType;
+
+	std::vector<unsigned char> packed;
+	packMeshVertices(vertices, numVertices, meshBufferFormat(), &packed);
+
+	// 16-bit indices stay relative to the model and the draw calls add its first vertex,
+	// 32-bit indices point to the shared vertex buffer and the draw calls need no base vertex
+	std::vector<unsigned char> packedIndices;
+	if (indexType == GL_UNSIGNED_SHORT) {
+		packMeshIndices(indices, numIndices, numVertices, &packedIndices);
+		range->baseVertex = (int)range->firstVertex;
+	}
+	else {
+		packedIndices.resize(numIndices * sizeof(unsigned int));
+		for (unsigned int i = 0; i < numIndices; i++) {
+			unsigned int index = indices[i] + range->firstVertex;
+			memcpy(&packedIndices[i * sizeof(unsigned int)], &index, sizeof(index));
+		}
+		range->baseVertex = 0;
+	}
+
+	const size_t vertexSize = meshVertexSize(meshBufferFormat());
+
+	if (!packed.empty()) {
+		glBindBuffer(GL_ARRAY_BUFFER, meshBuffer.vertexBufferObject);
+		glBufferSubData(GL_ARRAY_BUFFER, range->firstVertex * vertexSize, packed.size(), &packed[0]);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	// the element array binding belongs to the vao, the copy target leaves it alone
+	if (!packedIndices.empty()) {
+		glBindBuffer(GL_COPY_WRITE_BUFFER, meshIndexBuffer(indexType));
+		glBufferSubData(GL_COPY_WRITE_BUFFER, range->firstIndex * indexTypeSize(indexType), packedIndices.size(), &packedIndices[0]);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+	CHECK_GL_ERROR();
+
+	meshBuffer.numVertices += numVertices;
+	if (indexType == GL_UNSIGNED_SHORT)
+		meshBuffer.numShortIndices += numIndices;
+	else
+		meshBuffer.numIndices += numIndices;
+	meshBuffer.numRanges++;
+}
+
+/**
+*	Releases range of a deleted model, the buffers and their vertex arrays are deleted with the last range.
+*	\param[in] range Range returned by addMeshToBuffer().
+*/
+void releaseMeshBufferRange(const MeshBufferRange &range) {
+
+	if (range.numIndices == 0 || meshBuffer.numRanges == 0)
+		return;
+
+	if (--meshBuffer.numRanges > 0)
+		return;
+
+	for (size_t i = 0; i < meshBuffer.vertexArrays.size(); i++)
+		glDeleteVertexArrays(1, &meshBuffer.vertexArrays[i].vertexArrayObject);
+	meshBuffer.vertexArrays.clear();
+
+	glDeleteBuffers(1, &meshBuffer.vertexBufferObject);
+	glDeleteBuffers(1, &meshBuffer.elementBufferObject);
+	glDeleteBuffers(1, &meshBuffer.shortElementBufferObject);
+
+	meshBuffer.vertexBufferObject = 0;
+	meshBuffer.elementBufferObject = 0;
+	meshBuffer.shortElementBufferObject = 0;
+	meshBuffer.vertexCapacity = 0;
+	meshBuffer.indexCapacity = 0;
+	meshBuffer.shortIndexCapacity = 0;
+	meshBuffer.numVertices = 0;
+	meshBuffer.numIndices = 0;
+	meshBuffer.numShortIndices = 0;
+}
+
+/**
+*	Returns the shared vertex buffer object, 0 if no model has been added.
+*/
+GLuint meshVertexBuffer() {
+	return meshBuffer.vertexBufferObject;
+}
+
+/**
+*	Returns the shared element buffer object with indices of the type, 0 if no model has been added.
+*	\param[in] indexType GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+*/
+GLuint meshIndexBuffer(GLenum indexType) {
+	return indexType == GL_UNSIGNED_SHORT ? meshBuffer.shortElementBufferObject : meshBuffer.elementBufferObject;
+}
+
+/**
+*	Returns vertex array connecting the shared buffers to the attributes, it is created by the first call
+*	with the locations and deleted with the buffers.
+*	\param[in] posLocation      Location of the position attribute.
+*	\param[in] normalLocation   Location of the normal attribute or -1.
+*	\param[in] texCoordLocation Location of the texture coordinates attribute or -1.
+*	\param[in] indexType        Element buffer of the vertex array, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+*/
+GLuint meshBufferVertexArray(GLint posLocation, GLint normalLocation, GLint texCoordLocation, GLenum indexType) {
+
+	if (meshBuffer.vertexBufferObject == 0)
+		return 0;
+
+	for (size_t i = 0; i < meshBuffer.vertexArrays.size(); i++) {
+		const MeshBufferVertexArray &vertexArray = meshBuffer.vertexArrays[i];
+		if (vertexArray.posLocation == posLocation && vertexArray.normalLocation == normalLocation && vertexArray.texCoordLocation == texCoordLocation
+			&& vertexArray.indexType == indexType)
+			return vertexArray.vertexArrayObject;
+	}
+
+	MeshBufferVertexArray vertexArray;
+	vertexArray.posLocation = posLocation;
+	vertexArray.normalLocation = normalLocation;
+	vertexArray.texCoordLocation = texCoordLocation;
+	vertexArray.indexType = indexType;
+
+	glGenVertexArrays(1, &vertexArray.vertexArrayObject);
+	glBindVertexArray(vertexArray.vertexArrayObject);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, meshIndexBuffer(indexType));
+	glBindBuffer(GL_ARRAY_BUFFER, meshBuffer.vertexBufferObject);
+
+	setVertexFormatAttributes(meshBufferFormat(), posLocation, normalLocation, texCoordLocation);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	CHECK_GL_ERROR();
+
+	meshBuffer.vertexArrays.push_back(vertexArray);
+	return vertexArray.vertexArrayObject;
+}
@@ -0,0 +1,56 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       meshBuffer.h
+* \author     agent
+* \date       2026
+* \brief      One vertex and two index buffers shared by all loaded models.
+*
+*	Models are appended to the shared buffers when they are uploaded, each one keeps the
+*	range of its vertices and indices. All models are drawn from the same vertex array, so
+*	switching between them needs no state change and the render queue can draw several of
+*	them by one multi-draw indirect call.
+*
+*	Models up to 65536 vertices keep 16-bit indices relative to their first vertex in their
+*	own element buffer, the draw calls add the first vertex as the base vertex. Larger models,
+*	and all models on drivers without base vertex draw calls, have 32-bit indices rebased
+*	to the shared vertex buffer. Each element buffer has its vertex arrays, so the models
+*	of one index type are drawn from the same one.
+*
+*	Space of a released model is reused only after all models are released, resident models
+*	survive reloads of the scene, so the buffers do not fragment in practice.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#ifndef __MESHBUFFER_H
+#define __MESHBUFFER_H
+
+#include "pgr.h"
+
+/**
+*	struct for the range of one model in the shared buffers
+*
+*/
+typedef struct MeshBufferRange {
+	unsigned int firstVertex;   // first vertex in the shared vertex buffer
+	unsigned int numVertices;
+	unsigned int firstIndex;    // first index in the shared index buffer of its type, a multiple of 3
+	unsigned int numIndices;    // 0 for geometries with their own buffers
+	GLenum       indexType;     // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	int          baseVertex;    // added to the indices by the draw calls, firstVertex for 16-bit indices, 0 for rebased ones
+} MeshBufferRange;
+
+bool multiDrawIndirectSupported();
+bool baseVertexSupported();
+
+unsigned int meshBufferFormat();
+GLenum meshBufferIndexType(unsigned int numVertices);
+void reserveMeshBuffer(unsigned int numVertices, unsigned int numIndices, unsigned int numShortIndices);
+void addMeshToBuffer(const float *vertices, unsigned int numVertices, const unsigned int *indices, unsigned int numIndices, MeshBufferRange *range);
+void releaseMeshBufferRange(const MeshBufferRange &range);
+
+GLuint meshVertexBuffer();
+GLuint meshIndexBuffer(GLenum indexType);
+GLuint meshBufferVertexArray(GLint posLocation, GLint normalLocation, GLint texCoordLocation, GLenum indexType);
+
+#endif
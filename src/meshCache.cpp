@@ -0,0 +1,442 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       meshCache.cpp
+* \author     agent
+* \date       2026
+* \brief      Binary cache of processed meshes.
+*
+*	Cache file layout: header | materials | draw ranges | source path | texture names | padding to 4 bytes |
+*	interleaved vertex data (MESH_VERTEX_SIZE floats per vertex) | indices (3 unsigned ints per triangle).
+*	Vertices and indices are stored already optimized by meshOptimizer, indices of all levels of detail follow each other.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <direct.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <fstream>
+#include "meshCache.h"
+
+/**
+*	header of the cache file
+*
+*/
+typedef struct MeshCacheHeader {
+	char         magic[4];          // "A51M"
+	unsigned int version;           // MESH_CACHE_VERSION
+	unsigned int importFlags;       // assimp post processing flags used for the import
+	unsigned int sourcePathLength;
+	long long    sourceTime;        // modification time of the source file
+	unsigned int numVertices;
+	unsigned int numTriangles;
+	unsigned int numMaterials;
+	unsigned int numLods;
+	unsigned int lodFirstTriangle[MESH_MAX_LODS];
+	unsigned int lodNumTriangles[MESH_MAX_LODS];
+	float        lodError[MESH_MAX_LODS];
+	float        bounds[10];        // box min, box max, sphere center and radius
+	float        vertexCacheStats[4]; // ACMR and ATVR before and after the optimization
+} MeshCacheHeader;
+
+/**
+*	material record of the cache file
+*
+*/
+typedef struct MeshCacheMaterial {
+	float        ambient[3];
+	float        diffuse[3];
+	float        specular[3];
+	float        shininess;
+	unsigned int textureNameLength;
+} MeshCacheMaterial;
+
+static const char MESH_CACHE_MAGIC[4] = { 'A', '5', '1', 'M' };
+
+/**
+*	Returns modification time of the file.
+*	\param[in] fileName File to check.
+*	\return Modification time or -1 if the file does not exist.
+*/
+long long fileModificationTime(const std::string &fileName) {
+	struct stat fileInfo;
+
+	if (stat(fileName.c_str(), &fileInfo) != 0)
+		return -1;
+
+	return (long long)fileInfo.st_mtime;
+}
+
+/**
+*	Rounds size up to the multiple of four bytes.
+*/
+static size_t alignSize(size_t size) {
+	return (size + 3) & ~(size_t)3;
+}
+
+/**
+*	Maps whole file into memory for reading.
+*	\param[in]  fileName File to map.
+*	\param[out] file     Mapped file.
+*	\return True if the file has been mapped.
+*/
+bool mapFile(const std::string &fileName, MappedFile *file) {
+
+	file->data = NULL;
+	file->size = 0;
+	file->fileHandle = NULL;
+	file->mappingHandle = NULL;
+
+#ifdef _WIN32
+	HANDLE fileHandle = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+		CloseHandle(fileHandle);
+		return false;
+	}
+
+	HANDLE mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mappingHandle == NULL) {
+		CloseHandle(fileHandle);
+		return false;
+	}
+
+	void* data = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (data == NULL) {
+		CloseHandle(mappingHandle);
+		CloseHandle(fileHandle);
+		return false;
+	}
+
+	file->fileHandle = fileHandle;
+	file->mappingHandle = mappingHandle;
+	file->size = (size_t)fileSize.QuadPart;
+	file->data = (const unsigned char*)data;
+#else
+	int fd = open(fileName.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat fileInfo;
+	if (fstat(fd, &fileInfo) != 0 || fileInfo.st_size == 0) {
+		close(fd);
+		return false;
+	}
+
+	void* data = mmap(NULL, (size_t)fileInfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return false;
+
+	file->size = (size_t)fileInfo.st_size;
+	file->data = (const unsigned char*)data;
+#endif
+
+	return true;
+}
+
+/**
+*	Unmaps file mapped by mapFile().
+*	\param[in] file Mapped file.
+*/
+void unmapFile(MappedFile *file) {
+
+	if (file->data == NULL)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(file->data);
+	CloseHandle((HANDLE)file->mappingHandle);
+	CloseHandle((HANDLE)file->fileHandle);
+#else
+	munmap((void*)file->data, file->size);
+#endif
+
+	file->data = NULL;
+	file->size = 0;
+	file->fileHandle = NULL;
+	file->mappingHandle = NULL;
+}
+
+/**
+*	Returns name of the cache file for given source file.
+*	\param[in] sourceFileName Path to the source model.
+*/
+std::string meshCacheFileName(const std::string &sourceFileName) {
+	std::string name = sourceFileName;
+
+	for (size_t i = 0; i < name.size(); i++) {
+		if (name[i] == '/' || name[i] == '\\' || name[i] == ':')
+			name[i] = '_';
+	}
+
+	return std::string(MESH_CACHE_DIRECTORY) + name + ".mesh";
+}
+
+/**
+*	Checks that the levels of detail, the draw ranges and the indices of a cached mesh stay inside
+*	its triangles and vertices, a damaged cache file must not be uploaded.
+*	\param[in] header  Header of the cache file.
+*	\param[in] ranges  Draw ranges of all levels of detail.
+*	\param[in] indices Indices of all triangles.
+*	\return True if the mesh is consistent.
+*/
+static bool validMeshCacheData(const MeshCacheHeader &header, const MeshDrawRange *ranges, const unsigned int *indices) {
+
+	for (unsigned int i = 0; i < header.numLods; i++) {
+		if ((unsigned long long)header.lodFirstTriangle[i] + header.lodNumTriangles[i] > header.numTriangles)
+			return false;
+	}
+
+	for (size_t i = 0; i < (size_t)header.numMaterials * header.numLods; i++) {
+		if ((unsigned long long)ranges[i].firstTriangle + ranges[i].numTriangles > header.numTriangles)
+			return false;
+	}
+
+	for (size_t i = 0; i < 3 * (size_t)header.numTriangles; i++) {
+		if (indices[i] >= header.numVertices)
+			return false;
+	}
+
+	return true;
+}
+
+/**
+*	Loads processed mesh from the cache.
+*	Cache file is valid only if it has the same version, source path, source modification time and import flags
+*	and if its ranges and indices stay inside the mesh, otherwise the model is imported again.
+*	\param[in]  sourceFileName Path to the source model.
+*	\param[in]  importFlags    Assimp post processing flags.
+*	\param[out] data           Mesh data pointing into the mapped cache file.
+*	\return True on cache hit.
+*/
+bool loadMeshCache(const std::string &sourceFileName, unsigned int importFlags, MeshData *data) {
+
+	long long sourceTime = fileModificationTime(sourceFileName);
+	if (sourceTime < 0)
+		return false;
+
+	MappedFile file;
+	if (!mapFile(meshCacheFileName(sourceFileName), &file))
+		return false;
+
+	MeshCacheHeader header;
+	if (file.size < sizeof(MeshCacheHeader)) {
+		unmapFile(&file);
+		return false;
+	}
+	memcpy(&header, file.data, sizeof(MeshCacheHeader));
+
+	if (memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic)) != 0
+		|| header.version != MESH_CACHE_VERSION
+		|| header.importFlags != importFlags
+		|| header.sourceTime != sourceTime
+		|| header.numLods == 0 || header.numLods > MESH_MAX_LODS
+		|| header.numMaterials == 0) {
+		unmapFile(&file);
+		return false;
+	}
+
+	size_t materialsSize = sizeof(MeshCacheMaterial) * (size_t)header.numMaterials;
+	size_t rangesSize = sizeof(MeshDrawRange) * (size_t)header.numMaterials * header.numLods;
+	size_t offset = sizeof(MeshCacheHeader) + materialsSize + rangesSize;
+
+	if (file.size < offset) {
+		unmapFile(&file);
+		return false;
+	}
+
+	const MeshCacheMaterial *materials = (const MeshCacheMaterial*)(file.data + sizeof(MeshCacheHeader));
+	size_t stringsSize = header.sourcePathLength;
+	for (unsigned int i = 0; i < header.numMaterials; i++)
+		stringsSize += materials[i].textureNameLength;
+
+	size_t verticesSize = MESH_VERTEX_SIZE * sizeof(float) * (size_t)header.numVertices;
+	size_t indicesSize = 3 * sizeof(unsigned int) * (size_t)header.numTriangles;
+
+	if (file.size != offset + alignSize(stringsSize) + verticesSize + indicesSize
+		|| sourceFileName.compare(0, std::string::npos, (const char*)file.data + offset, header.sourcePathLength) != 0) {
+		unmapFile(&file);
+		return false;
+	}
+
+	const MeshDrawRange *ranges = (const MeshDrawRange*)(file.data + sizeof(MeshCacheHeader) + materialsSize);
+	const unsigned int *indices = (const unsigned int*)(file.data + offset + alignSize(stringsSize) + verticesSize);
+
+	if (!validMeshCacheData(header, ranges, indices)) {
+		std::cerr << "loadMeshCache(): damaged cache file for " << sourceFileName << std::endl;
+		unmapFile(&file);
+		return false;
+	}
+
+	const char *names = (const char*)file.data + offset + header.sourcePathLength;
+	data->materials.resize(header.numMaterials);
+	for (unsigned int i = 0; i < header.numMaterials; i++) {
+		MeshMaterial *material = &data->materials[i];
+		material->ambient = glm::vec3(materials[i].ambient[0], materials[i].ambient[1], materials[i].ambient[2]);
+		material->diffuse = glm::vec3(materials[i].diffuse[0], materials[i].diffuse[1], materials[i].diffuse[2]);
+		material->specular = glm::vec3(materials[i].specular[0], materials[i].specular[1], materials[i].specular[2]);
+		material->shininess = materials[i].shininess;
+		material->textureName.assign(names, materials[i].textureNameLength);
+		names += materials[i].textureNameLength;
+	}
+
+	data->drawRanges.assign(ranges, ranges + header.numMaterials * header.numLods);
+
+	offset += alignSize(stringsSize);
+
+	data->numVertices = header.numVertices;
+	data->numTriangles = header.numTriangles;
+	data->numLods = header.numLods;
+	for (unsigned int i = 0; i < MESH_MAX_LODS; i++) {
+		data->lodFirstTriangle[i] = header.lodFirstTriangle[i];
+		data->lodNumTriangles[i] = header.lodNumTriangles[i];
+		data->lodError[i] = header.lodError[i];
+	}
+	data->bounds.boxMin = glm::vec3(header.bounds[0], header.bounds[1], header.bounds[2]);
+	data->bounds.boxMax = glm::vec3(header.bounds[3], header.bounds[4], header.bounds[5]);
+	data->bounds.sphereCenter = glm::vec3(header.bounds[6], header.bounds[7], header.bounds[8]);
+	data->bounds.sphereRadius = header.bounds[9];
+	data->vertices = (const float*)(file.data + offset);
+	data->indices = indices;
+
+	data->importAcmr = header.vertexCacheStats[0];
+	data->importAtvr = header.vertexCacheStats[1];
+	data->acmr = header.vertexCacheStats[2];
+	data->atvr = header.vertexCacheStats[3];
+
+	data->mapping = file;
+
+	return true;
+}
+
+/**
+*	Stores processed mesh into the cache.
+*	\param[in] sourceFileName Path to the source model.
+*	\param[in] importFlags    Assimp post processing flags.
+*	\param[in] data           Mesh data to store.
+*	\return True if the cache file has been written.
+*/
+bool saveMeshCache(const std::string &sourceFileName, unsigned int importFlags, const MeshData &data) {
+
+	long long sourceTime = fileModificationTime(sourceFileName);
+	if (sourceTime < 0)
+		return false;
+
+#ifdef _WIN32
+	_mkdir(MESH_CACHE_DIRECTORY);
+#else
+	mkdir(MESH_CACHE_DIRECTORY, 0755);
+#endif
+
+	MeshCacheHeader header;
+	memset(&header, 0, sizeof(MeshCacheHeader));
+	memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+	header.version = MESH_CACHE_VERSION;
+	header.importFlags = importFlags;
+	header.sourcePathLength = (unsigned int)sourceFileName.size();
+	header.sourceTime = sourceTime;
+	header.numVertices = data.numVertices;
+	header.numTriangles = data.numTriangles;
+	header.numMaterials = (unsigned int)data.materials.size();
+	header.numLods = data.numLods;
+	for (unsigned int i = 0; i < MESH_MAX_LODS; i++) {
+		header.lodFirstTriangle[i] = data.lodFirstTriangle[i];
+		header.lodNumTriangles[i] = data.lodNumTriangles[i];
+		header.lodError[i] = data.lodError[i];
+	}
+	for (int i = 0; i < 3; i++) {
+		header.bounds[i] = data.bounds.boxMin[i];
+		header.bounds[3 + i] = data.bounds.boxMax[i];
+		header.bounds[6 + i] = data.bounds.sphereCenter[i];
+	}
+	header.bounds[9] = data.bounds.sphereRadius;
+	header.vertexCacheStats[0] = data.importAcmr;
+	header.vertexCacheStats[1] = data.importAtvr;
+	header.vertexCacheStats[2] = data.acmr;
+	header.vertexCacheStats[3] = data.atvr;
+
+	std::vector<MeshCacheMaterial> materials(data.materials.size());
+	size_t stringsSize = sourceFileName.size();
+	for (size_t i = 0; i < data.materials.size(); i++) {
+		const MeshMaterial &material = data.materials[i];
+		for (int j = 0; j < 3; j++) {
+			materials[i].ambient[j] = material.ambient[j];
+			materials[i].diffuse[j] = material.diffuse[j];
+			materials[i].specular[j] = material.specular[j];
+		}
+		materials[i].shininess = material.shininess;
+		materials[i].textureNameLength = (unsigned int)material.textureName.size();
+		stringsSize += material.textureName.size();
+	}
+
+	const char padding[4] = { 0, 0, 0, 0 };
+
+	// write into the temporary file first, half written cache must never be mapped
+	std::string cacheFileName = meshCacheFileName(sourceFileName);
+	std::string tempFileName = cacheFileName + ".tmp";
+	std::ofstream out(tempFileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!out) {
+		std::cerr << "saveMeshCache(): cannot create " << tempFileName << std::endl;
+		return false;
+	}
+
+	out.write((const char*)&header, sizeof(MeshCacheHeader));
+	out.write((const char*)&materials[0], materials.size() * sizeof(MeshCacheMaterial));
+	out.write((const char*)&data.drawRanges[0], data.drawRanges.size() * sizeof(MeshDrawRange));
+	out.write(sourceFileName.data(), sourceFileName.size());
+	for (size_t i = 0; i < data.materials.size(); i++)
+		out.write(data.materials[i].textureName.data(), data.materials[i].textureName.size());
+	out.write(padding, alignSize(stringsSize) - stringsSize);
+	out.write((const char*)data.vertices, MESH_VERTEX_SIZE * sizeof(float) * data.numVertices);
+	out.write((const char*)data.indices, 3 * sizeof(unsigned int) * data.numTriangles);
+	out.close();
+
+	if (!out) {
+		std::cerr << "saveMeshCache(): cannot write " << tempFileName << std::endl;
+		remove(tempFileName.c_str());
+		return false;
+	}
+
+	remove(cacheFileName.c_str());
+	if (rename(tempFileName.c_str(), cacheFileName.c_str()) != 0) {
+		std::cerr << "saveMeshCache(): cannot rename " << tempFileName << std::endl;
+		remove(tempFileName.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+/**
+*	Frees memory held by mesh data and unmaps the cache file.
+*	\param[in] data Mesh data to release.
+*/
+void releaseMeshData(MeshData *data) {
+	unmapFile(&data->mapping);
+	std::vector<float>().swap(data->vertexStorage);
+	std::vector<unsigned int>().swap(data->indexStorage);
+	data->vertices = NULL;
+	data->indices = NULL;
+	data->numVertices = 0;
+	data->numTriangles = 0;
+	data->numLods = 0;
+	data->materials.clear();
+	data->drawRanges.clear();
+}
@@ -0,0 +1,109 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       meshCache.h
+* \author     agent
+* \date       2026
+* \brief      Binary cache of processed meshes.
+*
+*	Meshes imported by assimp are stored into a compact binary file. Next launches
+*	map this file into memory and upload its content directly to OpenGL buffers.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#ifndef __MESHCACHE_H
+#define __MESHCACHE_H
+
+#include "pgr.h"
+#include "culling.h"
+#include <string>
+#include <vector>
+
+#define MESH_CACHE_DIRECTORY "cache/"
+#define MESH_CACHE_VERSION   6
+
+// floats per interleaved vertex: position (3), normal (3), texture coordinates (2)
+#define MESH_VERTEX_SIZE     8
+
+// maximal number of levels of detail of one mesh
+#define MESH_MAX_LODS        4
+
+/**
+*	struct for a read-only file mapped into memory
+*
+*/
+typedef struct MappedFile {
+	const unsigned char* data;   // mapped content of the file, NULL if nothing is mapped
+	size_t               size;   // size of the mapped content in bytes
+	void*                fileHandle;
+	void*                mappingHandle;
+} MappedFile;
+
+/**
+*	struct for a material of a part of the mesh
+*
+*/
+typedef struct MeshMaterial {
+	glm::vec3           ambient;
+	glm::vec3           diffuse;
+	glm::vec3           specular;
+	float               shininess;
+	std::string         textureName; // path to the diffuse texture, empty if there is no texture
+} MeshMaterial;
+
+/**
+*	struct for a range of triangles drawn with one material
+*
+*/
+typedef struct MeshDrawRange {
+	unsigned int        firstTriangle;
+	unsigned int        numTriangles;
+} MeshDrawRange;
+
+/**
+*	struct for a processed mesh ready for the upload to OpenGL
+*
+*	Vertex data are interleaved as |VVVNNNTT|VVVNNNTT|... (MESH_VERTEX_SIZE floats per vertex). Pointers point either
+*	to the storage vectors (freshly imported mesh) or into the mapped cache file.
+*	All parts (assimp meshes) of the model share the buffers. Triangles of each level of detail are grouped by material,
+*	materials are ordered by texture so that consecutive draws change as little state as possible.
+*
+*/
+typedef struct MeshData {
+	unsigned int        numVertices;
+	unsigned int        numTriangles;  // triangles of all levels of detail
+	const float*        vertices;    // interleaved position, normal and texture coordinates
+	const unsigned int* indices;     // 3 indices per triangle
+
+	// levels of detail are consecutive ranges of the indices sharing all vertices, level 0 is the full mesh
+	unsigned int        numLods;
+	unsigned int        lodFirstTriangle[MESH_MAX_LODS];
+	unsigned int        lodNumTriangles[MESH_MAX_LODS];
+	float               lodError[MESH_MAX_LODS];       // distance from the full mesh in model units
+
+	MeshBounds          bounds;
+
+	std::vector<MeshMaterial>  materials;
+	std::vector<MeshDrawRange> drawRanges;  // range of material m in level of detail l is at l * materials.size() + m
+
+	// post-transform vertex cache efficiency of the full mesh indices in the file order and after the optimization
+	float               importAcmr;
+	float               importAtvr;
+	float               acmr;
+	float               atvr;
+
+	std::vector<float>        vertexStorage;
+	std::vector<unsigned int> indexStorage;
+	MappedFile                mapping;
+} MeshData;
+
+long long fileModificationTime(const std::string &fileName);
+bool mapFile(const std::string &fileName, MappedFile *file);
+void unmapFile(MappedFile *file);
+
+std::string meshCacheFileName(const std::string &sourceFileName);
+bool loadMeshCache(const std::string &sourceFileName, unsigned int importFlags, MeshData *data);
+bool saveMeshCache(const std::string &sourceFileName, unsigned int importFlags, const MeshData &data);
+void releaseMeshData(MeshData *data);
+
+#endif
@@ -0,0 +1,641 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       meshOptimizer.cpp
+* \author     agent
+* \date       2026
+* \brief      Reordering of mesh triangles and vertices for faster rendering.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include "pgr.h"
+#include "meshOptimizer.h"
+
+// size of the LRU cache modelled by the triangle scoring, see T. Forsyth, Linear-Speed Vertex Cache Optimisation
+#define FORSYTH_CACHE_SIZE          32
+#define FORSYTH_CACHE_DECAY_POWER   1.5f
+#define FORSYTH_LAST_TRIANGLE_SCORE 0.75f
+#define FORSYTH_VALENCE_BOOST_SCALE 2.0f
+#define FORSYTH_VALENCE_BOOST_POWER 0.5f
+
+/**
+*	Returns score of a vertex, vertices recently used and vertices with few remaining triangles score higher.
+*	\param[in] cachePosition     Position in the LRU cache, -1 if the vertex is not in the cache.
+*	\param[in] remainingValence  Number of triangles using the vertex not emitted yet.
+*/
+static float vertexScore(int cachePosition, unsigned int remainingValence) {
+
+	if (remainingValence == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+
+	if (cachePosition >= 0) {
+		// the last triangle is in the cache whole, its vertices get fixed score so the next triangle does not prefer any of them
+		if (cachePosition < 3)
+			score = FORSYTH_LAST_TRIANGLE_SCORE;
+		else
+			score = powf(1.0f - (float)(cachePosition - 3) / (FORSYTH_CACHE_SIZE - 3), FORSYTH_CACHE_DECAY_POWER);
+	}
+
+	// finish lonely vertices first, they would otherwise be transformed again later
+	score += FORSYTH_VALENCE_BOOST_SCALE * powf((float)remainingValence, -FORSYTH_VALENCE_BOOST_POWER);
+
+	return score;
+}
+
+/**
+*	Reorders triangles to improve reuse of the post-transform vertex cache.
+*	Greedy algorithm by T. Forsyth, the vertices are not moved.
+*	\param[in,out] indices     Triangle indices, 3 per triangle.
+*	\param[in]     numIndices  Number of indices.
+*	\param[in]     numVertices Number of vertices referenced by the indices.
+*/
+void optimizeVertexCache(unsigned int *indices, unsigned int numIndices, unsigned int numVertices) {
+
+	unsigned int numTriangles = numIndices / 3;
+	if (numTriangles == 0)
+		return;
+
+	// triangles using each vertex, the first valence[v] entries of the vertex are the triangles not emitted yet
+	std::vector<unsigned int> valence(numVertices, 0);
+	for (unsigned int i = 0; i < numIndices; i++)
+		valence[indices[i]]++;
+
+	std::vector<unsigned int> adjacencyOffsets(numVertices + 1, 0);
+	for (unsigned int v = 0; v < numVertices; v++)
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + valence[v];
+
+	std::vector<unsigned int> adjacency(numIndices);
+	std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (unsigned int i = 0; i < numIndices; i++)
+		adjacency[fill[indices[i]]++] = i / 3;
+
+	std::vector<int> cachePosition(numVertices, -1);
+	std::vector<float> vertexScores(numVertices);
+	for (unsigned int v = 0; v < numVertices; v++)
+		vertexScores[v] = vertexScore(-1, valence[v]);
+
+	std::vector<float> triangleScores(numTriangles);
+	std::vector<bool> emitted(numTriangles, false);
+	int bestTriangle = 0;
+
+	for (unsigned int t = 0; t < numTriangles; t++) {
+		const unsigned int *triangle = indices + 3 * t;
+		triangleScores[t] = vertexScores[triangle[0]] + vertexScores[triangle[1]] + vertexScores[triangle[2]];
+		if (triangleScores[t] > triangleScores[bestTriangle])
+			bestTriangle = t;
+	}
+
+	std::vector<unsigned int> output;
+	output.reserve(numTriangles * 3);
+
+	unsigned int cache[FORSYTH_CACHE_SIZE + 3];
+	unsigned int newCache[FORSYTH_CACHE_SIZE + 3];
+	unsigned int cacheCount = 0;
+	unsigned int nextUnemitted = 0;
+
+	while (bestTriangle >= 0) {
+		const unsigned int *triangle = indices + 3 * bestTriangle;
+		unsigned int newCacheCount = 0;
+
+		emitted[bestTriangle] = true;
+		output.push_back(triangle[0]);
+		output.push_back(triangle[1]);
+		output.push_back(triangle[2]);
+
+		for (int k = 0; k < 3; k++) {
+			unsigned int v = triangle[k];
+
+			// remove the triangle from the remaining triangles of the vertex
+			unsigned int *first = &adjacency[adjacencyOffsets[v]];
+			for (unsigned int i = 0; i < valence[v]; i++) {
+				if (first[i] == (unsigned int)bestTriangle) {
+					first[i] = first[valence[v] - 1];
+					valence[v]--;
+					break;
+				}
+			}
+
+			// degenerate triangles have the same vertex more than once
+			if ((k > 0 && v == triangle[0]) || (k > 1 && v == triangle[1]))
+				continue;
+
+			newCache[newCacheCount++] = v;
+		}
+
+		// vertices of the emitted triangle go to the front of the LRU cache
+		for (unsigned int i = 0; i < cacheCount; i++) {
+			unsigned int v = cache[i];
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+				newCache[newCacheCount++] = v;
+		}
+
+		for (unsigned int i = 0; i < newCacheCount; i++) {
+			unsigned int v = newCache[i];
+			cachePosition[v] = i < FORSYTH_CACHE_SIZE ? (int)i : -1;
+			vertexScores[v] = vertexScore(cachePosition[v], valence[v]);
+		}
+
+		// only triangles of the cached vertices changed their scores, the best of them is emitted next
+		bestTriangle = -1;
+		float bestScore = -1.0f;
+
+		for (unsigned int i = 0; i < newCacheCount; i++) {
+			unsigned int v = newCache[i];
+			const unsigned int *remaining = &adjacency[adjacencyOffsets[v]];
+
+			for (unsigned int j = 0; j < valence[v]; j++) {
+				unsigned int t = remaining[j];
+				const unsigned int *candidate = indices + 3 * t;
+				triangleScores[t] = vertexScores[candidate[0]] + vertexScores[candidate[1]] + vertexScores[candidate[2]];
+
+				if (i < FORSYTH_CACHE_SIZE && triangleScores[t] > bestScore) {
+					bestScore = triangleScores[t];
+					bestTriangle = t;
+				}
+			}
+		}
+
+		cacheCount = std::min(newCacheCount, (unsigned int)FORSYTH_CACHE_SIZE);
+		memcpy(cache, newCache, cacheCount * sizeof(unsigned int));
+
+		// nothing connected to the cache, continue with the next unused part of the mesh
+		if (bestTriangle < 0) {
+			while (nextUnemitted < numTriangles && emitted[nextUnemitted])
+				nextUnemitted++;
+			if (nextUnemitted < numTriangles)
+				bestTriangle = nextUnemitted;
+		}
+	}
+
+	memcpy(indices, &output[0], output.size() * sizeof(unsigned int));
+}
+
+/**
+*	Simulates one triangle in the FIFO vertex cache.
+*	\param[in]     triangle   Three vertex indices.
+*	\param[in,out] timestamps Time each vertex entered the cache.
+*	\param[in,out] time       Current time, increased by every cache miss.
+*	\return Number of vertices that had to be transformed.
+*/
+static unsigned int simulateTriangle(const unsigned int *triangle, std::vector<unsigned int> &timestamps, unsigned int *time) {
+	unsigned int misses = 0;
+
+	for (int k = 0; k < 3; k++) {
+		unsigned int v = triangle[k];
+		if (*time - timestamps[v] > VERTEX_CACHE_SIZE) {
+			timestamps[v] = (*time)++;
+			misses++;
+		}
+	}
+
+	return misses;
+}
+
+/**
+*	Reorders clusters of cache optimized triangles so that triangles facing outwards of the mesh are drawn first.
+*	Triangles are split at the points where the cache is cold anyway and then further while the average
+*	cache miss ratio stays within the threshold.
+*	\param[in,out] indices     Triangle indices after optimizeVertexCache().
+*	\param[in]     numIndices  Number of indices.
+*	\param[in]     vertices    Vertices starting with the position.
+*	\param[in]     numVertices Number of vertices.
+*	\param[in]     vertexSize  Number of floats per vertex.
+*	\param[in]     threshold   Accepted ACMR degradation, 1.05 allows 5 % more transformed vertices.
+*/
+void optimizeOverdraw(unsigned int *indices, unsigned int numIndices, const float *vertices, unsigned int numVertices, unsigned int vertexSize, float threshold) {
+
+	unsigned int numTriangles = numIndices / 3;
+	if (numTriangles == 0 || numVertices == 0)
+		return;
+
+	std::vector<unsigned int> timestamps(numVertices, 0);
+	unsigned int time = VERTEX_CACHE_SIZE + 1;
+
+	// hard boundaries: no vertex of the triangle is in the cache
+	std::vector<unsigned int> hardClusters;
+	for (unsigned int t = 0; t < numTriangles; t++) {
+		if (simulateTriangle(indices + 3 * t, timestamps, &time) == 3 || t == 0)
+			hardClusters.push_back(t);
+	}
+	hardClusters.push_back(numTriangles);
+
+	// soft boundaries: each cluster starts with a cold cache, split only while it keeps the cache efficiency
+	std::vector<unsigned int> clusters;
+	for (size_t c = 0; c + 1 < hardClusters.size(); c++) {
+		unsigned int start = hardClusters[c];
+		unsigned int end = hardClusters[c + 1];
+		unsigned int misses = 0;
+
+		time += VERTEX_CACHE_SIZE + 1;
+		for (unsigned int t = start; t < end; t++)
+			misses += simulateTriangle(indices + 3 * t, timestamps, &time);
+
+		float clusterThreshold = threshold * (float)misses / (end - start);
+		unsigned int clusterStart = start;
+
+		clusters.push_back(start);
+		misses = 0;
+		time += VERTEX_CACHE_SIZE + 1;
+
+		for (unsigned int t = start; t < end; t++) {
+			misses += simulateTriangle(indices + 3 * t, timestamps, &time);
+
+			if (t + 1 < end && (float)misses / (t + 1 - clusterStart) <= clusterThreshold) {
+				clusterStart = t + 1;
+				clusters.push_back(clusterStart);
+				misses = 0;
+				time += VERTEX_CACHE_SIZE + 1;
+			}
+		}
+	}
+	clusters.push_back(numTriangles);
+
+	glm::vec3 meshCentroid(0.0f);
+	for (unsigned int v = 0; v < numVertices; v++)
+		meshCentroid += glm::vec3(vertices[vertexSize * v], vertices[vertexSize * v + 1], vertices[vertexSize * v + 2]);
+	meshCentroid /= (float)numVertices;
+
+	// clusters far from the centre in the direction of their normal are likely to occlude the others
+	unsigned int numClusters = (unsigned int)clusters.size() - 1;
+	std::vector<float> sortKeys(numClusters);
+	std::vector<unsigned int> order(numClusters);
+
+	for (unsigned int c = 0; c < numClusters; c++) {
+		glm::vec3 centroid(0.0f);
+		glm::vec3 normal(0.0f);
+		float area = 0.0f;
+
+		for (unsigned int t = clusters[c]; t < clusters[c + 1]; t++) {
+			const float *p0 = vertices + vertexSize * indices[3 * t + 0];
+			const float *p1 = vertices + vertexSize * indices[3 * t + 1];
+			const float *p2 = vertices + vertexSize * indices[3 * t + 2];
+			glm::vec3 a(p0[0], p0[1], p0[2]);
+			glm::vec3 b(p1[0], p1[1], p1[2]);
+			glm::vec3 d(p2[0], p2[1], p2[2]);
+
+			glm::vec3 faceNormal = glm::cross(b - a, d - a);
+			float faceArea = glm::length(faceNormal);
+
+			centroid += (a + b + d) * (faceArea / 3.0f);
+			normal += faceNormal;
+			area += faceArea;
+		}
+
+		if (area > 0.0f)
+			centroid /= area;
+		if (glm::length(normal) > 0.0f)
+			normal = glm::normalize(normal);
+
+		sortKeys[c] = glm::dot(centroid - meshCentroid, normal);
+		order[c] = c;
+	}
+
+	std::stable_sort(order.begin(), order.end(), [&sortKeys](unsigned int a, unsigned int b) {
+		return sortKeys[a] > sortKeys[b];
+	});
+
+	std::vector<unsigned int> output;
+	output.reserve(numTriangles * 3);
+	for (unsigned int i = 0; i < numClusters; i++) {
+		unsigned int c = order[i];
+		output.insert(output.end(), indices + 3 * clusters[c], indices + 3 * clusters[c + 1]);
+	}
+
+	memcpy(indices, &output[0], output.size() * sizeof(unsigned int));
+}
+
+/**
+*	Reorders vertices in the order of their first use by the indices, unused vertices are dropped.
+*	\param[in,out] vertices    Vertex data.
+*	\param[in,out] indices     Triangle indices, remapped to the new vertex order.
+*	\param[in]     numIndices  Number of indices.
+*	\param[in]     numVertices Number of vertices.
+*	\param[in]     vertexSize  Number of floats per vertex.
+*	\return Number of vertices after the reordering.
+*/
+unsigned int optimizeVertexFetch(float *vertices, unsigned int *indices, unsigned int numIndices, unsigned int numVertices, unsigned int vertexSize) {
+
+	const unsigned int UNUSED = 0xFFFFFFFF;
+	std::vector<unsigned int> remap(numVertices, UNUSED);
+	unsigned int usedVertices = 0;
+
+	for (unsigned int i = 0; i < numIndices; i++) {
+		unsigned int v = indices[i];
+		if (remap[v] == UNUSED)
+			remap[v] = usedVertices++;
+		indices[i] = remap[v];
+	}
+
+	std::vector<float> original(vertices, vertices + (size_t)vertexSize * numVertices);
+	for (unsigned int v = 0; v < numVertices; v++) {
+		if (remap[v] != UNUSED)
+			memcpy(vertices + (size_t)vertexSize * remap[v], &original[(size_t)vertexSize * v], vertexSize * sizeof(float));
+	}
+
+	return usedVertices;
+}
+
+/**
+*	Measures efficiency of the FIFO post-transform cache of VERTEX_CACHE_SIZE entries.
+*	\param[in]  indices     Triangle indices.
+*	\param[in]  numIndices  Number of indices.
+*	\param[in]  numVertices Number of vertices.
+*	\param[out] acmr        Average cache miss ratio, transformed vertices per triangle (0.5 is the optimum for regular grids).
+*	\param[out] atvr        Average transformed vertex ratio, transformed vertices per vertex (1.0 is the optimum).
+*/
+void analyzeVertexCache(const unsigned int *indices, unsigned int numIndices, unsigned int numVertices, float *acmr, float *atvr) {
+
+	std::vector<unsigned int> timestamps(numVertices, 0);
+	unsigned int time = VERTEX_CACHE_SIZE + 1;
+	unsigned int misses = 0;
+
+	for (unsigned int t = 0; t + 2 < numIndices; t += 3)
+		misses += simulateTriangle(indices + t, timestamps, &time);
+
+	*acmr = numIndices >= 3 ? (float)misses / (numIndices / 3) : 0.0f;
+	*atvr = numVertices > 0 ? (float)misses / numVertices : 0.0f;
+}
+
+/**
+*	Symmetric 4x4 matrix of the quadric error metric, sum of squared distances to the planes of triangles.
+*
+*/
+typedef struct Quadric {
+	double a2, ab, ac, ad;
+	double b2, bc, bd;
+	double c2, cd;
+	double d2;
+	double weight;
+} Quadric;
+
+/**
+*	Adds plane ax + by + cz + d = 0 with given weight to the quadric.
+*/
+static void addPlaneToQuadric(Quadric *q, double a, double b, double c, double d, double weight) {
+	q->a2 += weight * a * a; q->ab += weight * a * b; q->ac += weight * a * c; q->ad += weight * a * d;
+	q->b2 += weight * b * b; q->bc += weight * b * c; q->bd += weight * b * d;
+	q->c2 += weight * c * c; q->cd += weight * c * d;
+	q->d2 += weight * d * d;
+	q->weight += weight;
+}
+
+/**
+*	Adds quadric r to the quadric q.
+*/
+static void addQuadric(Quadric *q, const Quadric &r) {
+	q->a2 += r.a2; q->ab += r.ab; q->ac += r.ac; q->ad += r.ad;
+	q->b2 += r.b2; q->bc += r.bc; q->bd += r.bd;
+	q->c2 += r.c2; q->cd += r.cd;
+	q->d2 += r.d2;
+	q->weight += r.weight;
+}
+
+/**
+*	Returns average squared distance of the point to the planes of the quadric.
+*/
+static double quadricError(const Quadric &q, const float *p) {
+	double x = p[0], y = p[1], z = p[2];
+	double error = q.a2 * x * x + q.b2 * y * y + q.c2 * z * z
+		+ 2.0 * (q.ab * x * y + q.ac * x * z + q.bc * y * z)
+		+ 2.0 * (q.ad * x + q.bd * y + q.cd * z)
+		+ q.d2;
+
+	return q.weight > 0.0 ? fabs(error) / q.weight : 0.0;
+}
+
+/**
+*	Returns not normalized normal of the triangle.
+*/
+static glm::vec3 triangleNormal(const float *p0, const float *p1, const float *p2) {
+	glm::vec3 a(p0[0], p0[1], p0[2]);
+	return glm::cross(glm::vec3(p1[0], p1[1], p1[2]) - a, glm::vec3(p2[0], p2[1], p2[2]) - a);
+}
+
+/**
+*	Candidate for the collapse of vertex 'from' into vertex 'to'.
+*
+*/
+typedef struct EdgeCollapse {
+	unsigned int from;
+	unsigned int to;
+	double       error;
+} EdgeCollapse;
+
+/**
+*	Reduces number of triangles by collapsing vertices into their neighbours (quadric error metric).
+*	Vertices are not moved nor created, the simplified indices use the original vertex buffer. Vertices on
+*	open borders and on attribute seams (several vertices with the same position) are never removed.
+*	\param[out] destination      Simplified indices, must have space for numIndices.
+*	\param[in]  indices          Triangle indices.
+*	\param[in]  numIndices       Number of indices.
+*	\param[in]  vertices         Vertices starting with the position.
+*	\param[in]  numVertices      Number of vertices.
+*	\param[in]  vertexSize       Number of floats per vertex.
+*	\param[in]  targetIndexCount Wanted number of indices.
+*	\param[out] resultError      Largest distance of the simplified surface from the original one in model units.
+*	\return Number of simplified indices, can be higher than the target when only locked vertices remain.
+*/
+unsigned int simplifyMesh(unsigned int *destination, const unsigned int *indices, unsigned int numIndices, const float *vertices,
+	unsigned int numVertices, unsigned int vertexSize, unsigned int targetIndexCount, float *resultError) {
+
+	unsigned int indexCount = numIndices - numIndices % 3;
+	memcpy(destination, indices, indexCount * sizeof(unsigned int));
+	*resultError = 0.0f;
+
+	if (indexCount <= targetIndexCount || numVertices == 0)
+		return indexCount;
+
+	// vertices sharing a position with another vertex lie on a seam of normals or texture coordinates
+	std::vector<bool> locked(numVertices, false);
+	std::vector<unsigned int> sorted(numVertices);
+	for (unsigned int v = 0; v < numVertices; v++)
+		sorted[v] = v;
+
+	std::sort(sorted.begin(), sorted.end(), [vertices, vertexSize](unsigned int a, unsigned int b) {
+		return memcmp(vertices + (size_t)vertexSize * a, vertices + (size_t)vertexSize * b, 3 * sizeof(float)) < 0;
+	});
+	for (unsigned int i = 1; i < numVertices; i++) {
+		if (memcmp(vertices + (size_t)vertexSize * sorted[i - 1], vertices + (size_t)vertexSize * sorted[i], 3 * sizeof(float)) == 0) {
+			locked[sorted[i - 1]] = true;
+			locked[sorted[i]] = true;
+		}
+	}
+
+	// edges used by other number of triangles than two are open borders or non-manifold
+	std::vector<std::pair<unsigned int, unsigned int> > edges;
+	edges.reserve(indexCount);
+	for (unsigned int i = 0; i < indexCount; i += 3) {
+		for (int k = 0; k < 3; k++) {
+			unsigned int a = destination[i + k];
+			unsigned int b = destination[i + (k + 1) % 3];
+			edges.push_back(std::make_pair(std::min(a, b), std::max(a, b)));
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+	for (size_t i = 0; i < edges.size(); ) {
+		size_t j = i + 1;
+		while (j < edges.size() && edges[j] == edges[i])
+			j++;
+		if (j - i != 2) {
+			locked[edges[i].first] = true;
+			locked[edges[i].second] = true;
+		}
+		i = j;
+	}
+
+	// quadrics of the planes of the triangles around each vertex, weighted by area
+	Quadric zero;
+	memset(&zero, 0, sizeof(Quadric));
+	std::vector<Quadric> quadrics(numVertices, zero);
+
+	for (unsigned int i = 0; i < indexCount; i += 3) {
+		const float *p0 = vertices + (size_t)vertexSize * destination[i + 0];
+		const float *p1 = vertices + (size_t)vertexSize * destination[i + 1];
+		const float *p2 = vertices + (size_t)vertexSize * destination[i + 2];
+
+		glm::vec3 normal = triangleNormal(p0, p1, p2);
+		float area = glm::length(normal);
+		if (area <= 0.0f)
+			continue;
+
+		normal /= area;
+		double d = -(normal.x * p0[0] + normal.y * p0[1] + normal.z * p0[2]);
+		for (int k = 0; k < 3; k++)
+			addPlaneToQuadric(&quadrics[destination[i + k]], normal.x, normal.y, normal.z, d, area);
+	}
+
+	std::vector<unsigned int> adjacencyOffsets(numVertices + 1);
+	std::vector<unsigned int> adjacency;
+	std::vector<unsigned int> remap(numVertices);
+	std::vector<bool> touched(numVertices);
+	std::vector<EdgeCollapse> collapses;
+	double maxError = 0.0;
+
+	while (indexCount > targetIndexCount) {
+
+		// triangles around each vertex
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+		for (unsigned int i = 0; i < indexCount; i++)
+			adjacencyOffsets[destination[i] + 1]++;
+		for (unsigned int v = 0; v < numVertices; v++)
+			adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+
+		adjacency.resize(indexCount);
+		std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (unsigned int i = 0; i < indexCount; i++)
+			adjacency[fill[destination[i]]++] = i / 3;
+
+		// every edge gives up to two collapses, one in each direction
+		collapses.clear();
+		for (unsigned int i = 0; i < indexCount; i += 3) {
+			for (int k = 0; k < 3; k++) {
+				unsigned int a = destination[i + k];
+				unsigned int b = destination[i + (k + 1) % 3];
+
+				for (int direction = 0; direction < 2; direction++) {
+					unsigned int from = direction == 0 ? a : b;
+					unsigned int to = direction == 0 ? b : a;
+					if (locked[from])
+						continue;
+
+					Quadric q = quadrics[from];
+					addQuadric(&q, quadrics[to]);
+
+					EdgeCollapse collapse = { from, to, quadricError(q, vertices + (size_t)vertexSize * to) };
+					collapses.push_back(collapse);
+				}
+			}
+		}
+
+		std::sort(collapses.begin(), collapses.end(), [](const EdgeCollapse &a, const EdgeCollapse &b) {
+			return a.error < b.error;
+		});
+
+		for (unsigned int v = 0; v < numVertices; v++) {
+			remap[v] = v;
+			touched[v] = false;
+		}
+
+		// each collapse removes two triangles on average, every vertex may change once per pass
+		unsigned int trianglesToRemove = (indexCount - targetIndexCount) / 3;
+		unsigned int removedTriangles = 0;
+
+		for (size_t c = 0; c < collapses.size() && removedTriangles < trianglesToRemove; c++) {
+			const EdgeCollapse &collapse = collapses[c];
+			if (touched[collapse.from] || touched[collapse.to])
+				continue;
+
+			const float *target = vertices + (size_t)vertexSize * collapse.to;
+			bool flipped = false;
+			unsigned int removed = 0;
+
+			// triangles around the removed vertex must not turn over
+			for (unsigned int j = adjacencyOffsets[collapse.from]; j < adjacencyOffsets[collapse.from + 1]; j++) {
+				const unsigned int *triangle = destination + 3 * adjacency[j];
+
+				if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+					removed++;
+					continue;
+				}
+
+				const float *p[3];
+				const float *q[3];
+				for (int k = 0; k < 3; k++) {
+					p[k] = vertices + (size_t)vertexSize * triangle[k];
+					q[k] = triangle[k] == collapse.from ? target : p[k];
+				}
+
+				glm::vec3 before = triangleNormal(p[0], p[1], p[2]);
+				glm::vec3 after = triangleNormal(q[0], q[1], q[2]);
+				if (glm::dot(before, after) <= 0.0f) {
+					flipped = true;
+					break;
+				}
+			}
+
+			if (flipped)
+				continue;
+
+			remap[collapse.from] = collapse.to;
+			addQuadric(&quadrics[collapse.to], quadrics[collapse.from]);
+			maxError = std::max(maxError, collapse.error);
+			removedTriangles += removed;
+
+			// the neighbourhood is fixed for the rest of the pass so the flip test stays valid
+			for (unsigned int j = adjacencyOffsets[collapse.from]; j < adjacencyOffsets[collapse.from + 1]; j++) {
+				const unsigned int *triangle = destination + 3 * adjacency[j];
+				touched[triangle[0]] = true;
+				touched[triangle[1]] = true;
+				touched[triangle[2]] = true;
+			}
+		}
+
+		if (removedTriangles == 0)
+			break;
+
+		// apply the collapses and drop the degenerate triangles
+		unsigned int writeIndex = 0;
+		for (unsigned int i = 0; i < indexCount; i += 3) {
+			unsigned int a = remap[destination[i + 0]];
+			unsigned int b = remap[destination[i + 1]];
+			unsigned int c = remap[destination[i + 2]];
+
+			if (a != b && b != c && a != c) {
+				destination[writeIndex++] = a;
+				destination[writeIndex++] = b;
+				destination[writeIndex++] = c;
+			}
+		}
+		indexCount = writeIndex;
+	}
+
+	*resultError = (float)sqrt(maxError);
+
+	return indexCount;
+}
@@ -0,0 +1,32 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       meshOptimizer.h
+* \author     agent
+* \date       2026
+* \brief      Reordering of mesh triangles and vertices for faster rendering.
+*
+*	Import pipeline: optimizeVertexCache() (Forsyth) -> optimizeOverdraw() (Tipsify style
+*	cluster sorting) -> optimizeVertexFetch(). analyzeVertexCache() measures the result.
+*	simplifyMesh() builds coarser levels of detail sharing the vertices of the full mesh.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#ifndef __MESHOPTIMIZER_H
+#define __MESHOPTIMIZER_H
+
+// size of the simulated FIFO post-transform cache used to measure and cluster the triangles
+#define VERTEX_CACHE_SIZE  16
+
+// maximal ACMR degradation accepted by the overdraw optimization
+#define OVERDRAW_THRESHOLD 1.05f
+
+void optimizeVertexCache(unsigned int *indices, unsigned int numIndices, unsigned int numVertices);
+void optimizeOverdraw(unsigned int *indices, unsigned int numIndices, const float *vertices, unsigned int numVertices, unsigned int vertexSize, float threshold);
+unsigned int simplifyMesh(unsigned int *destination, const unsigned int *indices, unsigned int numIndices, const float *vertices,
+	unsigned int numVertices, unsigned int vertexSize, unsigned int targetIndexCount, float *resultError);
+unsigned int optimizeVertexFetch(float *vertices, unsigned int *indices, unsigned int numIndices, unsigned int numVertices, unsigned int vertexSize);
+
+void analyzeVertexCache(const unsigned int *indices, unsigned int numIndices, unsigned int numVertices, float *acmr, float *atvr);
+
+#endif
@@ -11,17 +11,45 @@
 
 #include <iostream>
 #include <stdlib.h>
+#include <stddef.h>
+#include <algorithm>
+#include <map>
+#include <mutex>
 #include "pgr.h"
 #include "parameters.h"
 #include "spline.h"
 #include "objects.h"
-
-///used shader programs
+#include "meshCache.h"
+#include "textures.h"
+#include "threadPool.h"
+#include "vertexFormat.h"
+#include "meshOptimizer.h"
+#include "assetRegistry.h"
+#include "textureCache.h"
+#include "programCache.h"
+#include "renderQueue.h"
+#include "uniformBuffers.h"
+#include "transforms.h"
+#include "culling.h"
+#include "meshBuffer.h"
+#include "textureArrays.h"
+#include "picking.h"
+
+///used shader programs, the common ones are their textured variants used for the vertex arrays
 SCommonShaderProgram shaderProgram;
+SCommonShaderProgram instancedShaderProgram;
+SCommonShaderProgram indirectShaderProgram;   // program 0 if multi-draw indirect is not supported
 SSkyboxShaderProgram skyboxShaderProgram;
 SExplosionShaderProgram explosionShaderProgram;
+SParticleShaderProgram particleShaderProgram;
 SUfoProgram ufoShaderProgram;
 
+// all variants of the common programs and the variant bits of the current frame
+static SCommonShaderVariants mainShaderVariants;
+static SCommonShaderVariants instancedShaderVariants;
+static SCommonShaderVariants indirectShaderVariants;
+static unsigned int shaderVariantFrameBits = 0;
+
 //objects
 MeshGeometry* floorGeometry     = NULL; // 1
 MeshGeometry* alienGeometry     = NULL; // 2
@@ -34,9 +62,42 @@ MeshGeometry* boxGeometry       = NULL; // 8
 MeshGeometry* explosionGeometry = NULL; // 9
 MeshGeometry* ufoGeometry       = NULL; // 10
 MeshGeometry* lampGeometry      = NULL; // 11
+MeshGeometry* particleGeometry  = NULL; // 12
 
 //skybox
 MeshGeometry* skyboxGeometry = NULL;
+
+//barrels drawn by instanced draw calls
+InstancedMesh boxInstances;
+static TransformArrays boxTransforms;         // all boxes, for the culling
+static TransformArrays visibleBoxTransforms;  // boxes left after the culling
+static std::vector<unsigned char> boxVisible;
+static std::vector<unsigned int> visibleBoxes;
+static std::vector<glm::mat4> boxModelMatrices;
+
+/**
+*	struct for one explosion billboard in the instance buffer
+*
+*/
+typedef struct ExplosionInstance {
+	glm::vec4 positionSize;    // center and half size
+	float     startTime;
+	float     frameDuration;
+} ExplosionInstance;
+
+//explosions drawn by one instanced draw call
+static GLuint                         explosionInstanceBuffer = 0;
+static unsigned int                   explosionInstanceCapacity = 0;
+static std::vector<ExplosionInstance> explosionInstances;
+
+//particles drawn by one instanced draw call, the instance buffer is filled by the workers
+static GLuint       particleInstanceBuffer = 0;
+static unsigned int particleInstanceCapacity = 0;
+
+//levels of detail and statistics of the current frame
+bool meshLodEnabled = true;
+bool occlusionCullingEnabled = true;
+RenderStats renderStats;
 const char* SKYBOX_CUBE_TEXTURE_FILE_PREFIX = "data/skybox/";
 
 // paths to objects
@@ -56,347 +117,819 @@ const char* EXPLOSION_TEXTURE_NAME = "data/explode/explode.png";
 const char* UFO_TEXTURE_NAME = "data/ufo/ufo.png";
 
 /**
-*	Sets all shaders used in this program.
+*	Creates program with a lighting fragment shader and gets locations of its inputs.
+*	\param[in]  vertexFile   Path to the vertex shader.
+*	\param[in]  fragmentFile Path to the fragment shader.
+*	\param[in]  defines      Lines with #defines of the variant.
+*	\param[out] shader       Program and locations, inputs the shaders do not have are -1.
 */
-void initializeShaderPrograms(void) {
-
-	std::vector<GLuint> shaderList;
-
-	// push vertex shader and fragment shader
-	shaderList.push_back(pgr::createShaderFromFile(GL_VERTEX_SHADER, "shaders/mainVertex.vert"));
-	shaderList.push_back(pgr::createShaderFromFile(GL_FRAGMENT_SHADER, "shaders/mainFragment.frag"));
+static void initCommonShaderProgram(const std::string &vertexFile, const std::string &fragmentFile, const std::string &defines, SCommonShaderProgram *shader) {
 
 	// create the program with two shaders (fragment and vertex)
-	shaderProgram.program = pgr::createProgram(shaderList);
+	shader->program = createCachedProgram(vertexFile, fragmentFile, defines);
 
 	// get position and color attributes locations
-	shaderProgram.posLocation = glGetAttribLocation(shaderProgram.program, "position");
-	shaderProgram.colorLocation = glGetAttribLocation(shaderProgram.program, "color");
-	shaderProgram.normalLocation = glGetAttribLocation(shaderProgram.program, "normal");
-	shaderProgram.texCoordLocation = glGetAttribLocation(shaderProgram.program, "texCoord");
-	shaderProgram.timeLocation = glGetUniformLocation(shaderProgram.program, "time");
+	shader->posLocation = glGetAttribLocation(shader->program, "position");
+	shader->colorLocation = glGetAttribLocation(shader->program, "color");
+	shader->normalLocation = glGetAttribLocation(shader->program, "normal");
+	shader->texCoordLocation = glGetAttribLocation(shader->program, "texCoord");
+	shader->instanceMatrixLocation = glGetAttribLocation(shader->program, "instanceMatrix");
+	shader->timeLocation = glGetUniformLocation(shader->program, "time");
 	// material
-	shaderProgram.ambientLocation = glGetUniformLocation(shaderProgram.program, "material.ambient");
-	shaderProgram.diffuseLocation = glGetUniformLocation(shaderProgram.program, "material.diffuse");
-	shaderProgram.specularLocation = glGetUniformLocation(shaderProgram.program, "material.specular");
-	shaderProgram.shininessLocation = glGetUniformLocation(shaderProgram.program, "material.shininess");
+	shader->ambientLocation = glGetUniformLocation(shader->program, "material.ambient");
+	shader->diffuseLocation = glGetUniformLocation(shader->program, "material.diffuse");
+	shader->specularLocation = glGetUniformLocation(shader->program, "material.specular");
+	shader->shininessLocation = glGetUniformLocation(shader->program, "material.shininess");
 	// texture
-	shaderProgram.texSamplerLocation = glGetUniformLocation(shaderProgram.program, "texSampler");
-	shaderProgram.useTextureLocation = glGetUniformLocation(shaderProgram.program, "material.useTexture");
+	shader->texSamplerLocation = glGetUniformLocation(shader->program, "texSampler");
 	// matrix    
-	shaderProgram.VmatrixLocation = glGetUniformLocation(shaderProgram.program, "Vmatrix");
-	shaderProgram.PVMmatrixLocation = glGetUniformLocation(shaderProgram.program, "PVMmatrix");
-	shaderProgram.MmatrixLocation = glGetUniformLocation(shaderProgram.program, "Mmatrix");
-	shaderProgram.normalMatrixLocation = glGetUniformLocation(shaderProgram.program, "normalMatrix");
+	shader->MmatrixLocation = glGetUniformLocation(shader->program, "Mmatrix");
+	shader->normalMatrixLocation = glGetUniformLocation(shader->program, "normalMatrix");
+
+	// view, projection, fog and lights
+	bindUniformBlocks(shader->program);
+
+	// textures of the multi-draw indirect calls, each texture array has its own unit
+	GLint materialTexturesLocation = glGetUniformLocation(shader->program, "materialTextures");
+	if (materialTexturesLocation >= 0) {
+		GLint units[MAX_TEXTURE_ARRAYS];
+		for (int i = 0; i < MAX_TEXTURE_ARRAYS; i++)
+			units[i] = TEXTURE_ARRAY_UNIT + i;
+		glUseProgram(shader->program);
+		glUniform1iv(materialTexturesLocation, MAX_TEXTURE_ARRAYS, units);
+		glUseProgram(0);
+	}
+}
+
+/**
+*	Returns #defines of the shaders of the variant.
+*/
+static std::string shaderVariantDefines(unsigned int variant) {
+	std::string defines;
+
+	if (variant & SHADER_VARIANT_TEXTURE)
+		defines += "#define USE_TEXTURE\n";
+	if (variant & SHADER_VARIANT_FOG)
+		defines += "#define USE_FOG\n";
+	if (variant & SHADER_VARIANT_POINT_LIGHTS)
+		defines += "#define POINT_LIGHTS\n";
+	if (variant & SHADER_VARIANT_SPOT_LIGHTS)
+		defines += "#define SPOT_LIGHTS\n";
+
+	return defines;
+}
 
-	//fog
-	shaderProgram.fogActiveLocation = glGetUniformLocation(shaderProgram.program, "fogActive");
+/**
+*	Returns variant of the common program for an item of the current frame. Variants not
+*	prepared by prepareMaterialShaderVariants() are created here on first use.
+*	\param[in,out] shaders  Variants of the program.
+*	\param[in]     textured True if the material of the item has a texture.
+*/
+static const SCommonShaderProgram* commonShaderVariant(SCommonShaderVariants *shaders, bool textured) {
+	unsigned int variant = shaderVariantFrameBits | (textured ? SHADER_VARIANT_TEXTURE : 0);
+	SCommonShaderProgram *shader = &shaders->variants[variant];
+
+	if (shader->program == 0)
+		initCommonShaderProgram(shaders->vertexFile, shaders->fragmentFile, shaderVariantDefines(variant), shader);
+
+	return shader;
+}
 
-	//lights
-	shaderProgram.lampActiveLoc = glGetUniformLocation(shaderProgram.program, "lampActive");
-	shaderProgram.lampPositionLoc = glGetUniformLocation(shaderProgram.program, "lampPosition");
-	shaderProgram.lampIntensityLoc = glGetUniformLocation(shaderProgram.program, "lampIntensity");
+/**
+*	Creates the textured variant of the common program without fog and lights, the other
+*	variants are created when the materials using them are known.
+*	\return The created variant, its attribute locations are shared by all variants.
+*/
+static const SCommonShaderProgram& initCommonShaderVariants(const std::string &vertexFile, const std::string &fragmentFile, SCommonShaderVariants *shaders) {
+	shaders->vertexFile = vertexFile;
+	shaders->fragmentFile = fragmentFile;
+	for (unsigned int i = 0; i < SHADER_VARIANT_COUNT; i++)
+		shaders->variants[i] = SCommonShaderProgram();
+	initCommonShaderProgram(vertexFile, fragmentFile, shaderVariantDefines(SHADER_VARIANT_TEXTURE), &shaders->variants[SHADER_VARIANT_TEXTURE]);
+
+	return shaders->variants[SHADER_VARIANT_TEXTURE];
+}
 
-	shaderProgram.flashlightPositionLoc = glGetUniformLocation(shaderProgram.program, "flashlightPosition");
-	shaderProgram.flashlightDirectionLoc = glGetUniformLocation(shaderProgram.program, "flashlightDirection");
-	shaderProgram.flashlightIntensityLoc = glGetUniformLocation(shaderProgram.program, "flashlightIntensity");
+/**
+*	Creates the fog and light variants of the common program for materials with or without
+*	a texture, so toggling the fog or the first explosion does not compile a program in the
+*	middle of a frame. Variants already created are kept.
+*	\param[in,out] shaders  Variants of the program.
+*	\param[in]     textured True for the variants of textured materials.
+*/
+static void prepareShaderVariants(SCommonShaderVariants *shaders, bool textured) {
+	for (unsigned int frameBits = 0; frameBits < SHADER_VARIANT_COUNT; frameBits += SHADER_VARIANT_FOG) {
+		unsigned int variant = frameBits | (textured ? SHADER_VARIANT_TEXTURE : 0);
+		if (shaders->variants[variant].program == 0)
+			initCommonShaderProgram(shaders->vertexFile, shaders->fragmentFile, shaderVariantDefines(variant), &shaders->variants[variant]);
+	}
+}
 
+/**
+*	Prepares the variants the materials of a geometry can reach, the program of each material
+*	is selected the same way as when the geometry is drawn.
+*	\param[in] geometry  Geometry whose materials are drawn, may be NULL.
+*	\param[in] instanced True if the geometry is drawn by the instanced program.
+*/
+static void prepareMaterialShaderVariants(const MeshGeometry *geometry, bool instanced) {
+	if (geometry == NULL)
+		return;
+
+	const bool indirect = indirectShaderProgram.program != 0 && geometry->bufferRange.numIndices > 0;
+	for (size_t m = 0; m < geometry->materials.size(); m++) {
+		const MeshGeometryMaterial &material = geometry->materials[m];
+		const bool textured = material.texture != 0;
+
+		if (instanced)
+			prepareShaderVariants(&instancedShaderVariants, textured);
+		else if (indirect && (!textured || material.textureArray >= 0))
+			prepareShaderVariants(&indirectShaderVariants, textured);
+		else
+			prepareShaderVariants(&mainShaderVariants, textured);
+	}
+}
 
-	// load and compile shader for explosions (dynamic texture)
-	shaderList.clear();
+/**
+*	Deletes compiled variants of the common program.
+*/
+static void deleteCommonShaderVariants(SCommonShaderVariants *shaders) {
+	for (int i = 0; i < SHADER_VARIANT_COUNT; i++) {
+		if (shaders->variants[i].program != 0)
+			pgr::deleteProgramAndShaders(shaders->variants[i].program);
+		shaders->variants[i] = SCommonShaderProgram();
+	}
+}
 
-	// push vertex shader and fragment shader
-	shaderList.push_back(pgr::createShaderFromFile(GL_VERTEX_SHADER, "shaders/explosionVertex.vert"));
-	shaderList.push_back(pgr::createShaderFromFile(GL_FRAGMENT_SHADER, "shaders/explosionFragment.frag"));
+/**
+*	Selects variants of the common programs for the items of the frame, the lights and the fog
+*	are the same for all items of the frame. Has to be called before the draw functions.
+*	\param[in] fog         True if the fog is on.
+*	\param[in] pointLights True if any point light is clustered in this frame.
+*	\param[in] spotLights  True if any spot light is clustered in this frame.
+*/
+void setShaderVariantFrame(bool fog, bool pointLights, bool spotLights) {
+	shaderVariantFrameBits = (fog ? SHADER_VARIANT_FOG : 0)
+		| (pointLights ? SHADER_VARIANT_POINT_LIGHTS : 0)
+		| (spotLights ? SHADER_VARIANT_SPOT_LIGHTS : 0);
+}
 
-	// create the program with two shaders
-	explosionShaderProgram.program = pgr::createProgram(shaderList);
+/**
+*	Sets all shaders used in this program.
+*	Programs are created from the binary cache, GLSL sources are compiled only when they or the driver change.
+*	Only the base variants of the common programs are created here, the variants reachable by
+*	the materials are prepared by initializeModels().
+*/
+void initializeShaderPrograms(void) {
+
+	int startTime = glutGet(GLUT_ELAPSED_TIME);
+
+	shaderProgram = initCommonShaderVariants("shaders/mainVertex.vert", "shaders/mainFragment.frag", &mainShaderVariants);
+
+	// barrels, model matrices come from the per instance attribute
+	instancedShaderProgram = initCommonShaderVariants("shaders/instancedVertex.vert", "shaders/mainFragment.frag", &instancedShaderVariants);
+
+	// loaded models drawn by multi-draw indirect calls, matrices and materials come from the per draw data
+	indirectShaderProgram = SCommonShaderProgram();
+	if (multiDrawIndirectSupported())
+		indirectShaderProgram = initCommonShaderVariants("shaders/indirectVertex.vert", "shaders/indirectFragment.frag", &indirectShaderVariants);
+
+	// explosion billboards, one instanced draw call for all of them, the animation frame is chosen in the vertex shader
+	explosionShaderProgram.program = createCachedProgram("shaders/explosionVertex.vert", "shaders/explosionFragment.frag");
 
 	// get position and texture coordinates attributes locations
 	explosionShaderProgram.posLocation = glGetAttribLocation(explosionShaderProgram.program, "position");
 	explosionShaderProgram.texCoordLocation = glGetAttribLocation(explosionShaderProgram.program, "texCoord");
+	explosionShaderProgram.instanceLocation = glGetAttribLocation(explosionShaderProgram.program, "explosion");
+	explosionShaderProgram.instanceTimeLocation = glGetAttribLocation(explosionShaderProgram.program, "explosionTime");
 	// get uniforms locations
-	explosionShaderProgram.PVMmatrixLocation = glGetUniformLocation(explosionShaderProgram.program, "PVMmatrix");
-	explosionShaderProgram.VmatrixLocation = glGetUniformLocation(explosionShaderProgram.program, "Vmatrix");
 	explosionShaderProgram.timeLocation = glGetUniformLocation(explosionShaderProgram.program, "time");
 	explosionShaderProgram.texSamplerLocation = glGetUniformLocation(explosionShaderProgram.program, "texSampler");
-	explosionShaderProgram.frameDurationLocation = glGetUniformLocation(explosionShaderProgram.program, "frameDuration");
+	bindUniformBlocks(explosionShaderProgram.program);
+
+	//particles ----------------------------------------------------------
+	particleShaderProgram.program = createCachedProgram("shaders/particleVertex.vert", "shaders/particleFragment.frag");
+
+	particleShaderProgram.posLocation = glGetAttribLocation(particleShaderProgram.program, "position");
+	particleShaderProgram.instanceLocation = glGetAttribLocation(particleShaderProgram.program, "particle");
+	particleShaderProgram.instanceLifeLocation = glGetAttribLocation(particleShaderProgram.program, "particleLife");
+	particleShaderProgram.instanceColorLocation = glGetAttribLocation(particleShaderProgram.program, "particleColor");
+	bindUniformBlocks(particleShaderProgram.program);
 
 	//skybox -------------------------------------------------------------
-	shaderList.clear();
-	shaderList.push_back(pgr::createShaderFromFile(GL_VERTEX_SHADER, "shaders/skyboxVertex.vert"));
-	shaderList.push_back(pgr::createShaderFromFile(GL_FRAGMENT_SHADER, "shaders/skyboxFragment.frag"));
-	skyboxShaderProgram.program = pgr::createProgram(shaderList);
+	skyboxShaderProgram.program = createCachedProgram("shaders/skyboxVertex.vert", "shaders/skyboxFragment.frag");
 
 	skyboxShaderProgram.posLocation = glGetAttribLocation(skyboxShaderProgram.program, "position");
 	skyboxShaderProgram.skyboxSamplerLocation = glGetUniformLocation(skyboxShaderProgram.program, "skyboxSampler");
 	skyboxShaderProgram.PVMmatrixLocation = glGetUniformLocation(skyboxShaderProgram.program, "PVM");
-	skyboxShaderProgram.fogDensityLocation = glGetUniformLocation(skyboxShaderProgram.program, "fogDensity");
-	skyboxShaderProgram.fogActiveLocation = glGetUniformLocation(skyboxShaderProgram.program, "fogActive");
+	bindUniformBlocks(skyboxShaderProgram.program);
 
 	//ufo --------------------------------------------------------------
-	shaderList.clear();
-
-	shaderList.push_back(pgr::createShaderFromFile(GL_VERTEX_SHADER, "shaders/animatedVertex.vert"));
-	shaderList.push_back(pgr::createShaderFromFile(GL_FRAGMENT_SHADER, "shaders/animatedFragment.frag"));
-	ufoShaderProgram.program = pgr::createProgram(shaderList);
+	ufoShaderProgram.program = createCachedProgram("shaders/animatedVertex.vert", "shaders/animatedFragment.frag");
 
 	ufoShaderProgram.posLocation = glGetAttribLocation(ufoShaderProgram.program, "position");
 	ufoShaderProgram.texCoordLocation = glGetAttribLocation(ufoShaderProgram.program, "texCoord");
 	ufoShaderProgram.PVMmatrixLocation = glGetUniformLocation(ufoShaderProgram.program, "PVMmatrix");
 	ufoShaderProgram.timeLocation = glGetUniformLocation(ufoShaderProgram.program, "time");
 	ufoShaderProgram.texSamplerLocation = glGetUniformLocation(ufoShaderProgram.program, "texSampler");
+
+	std::cout << "Shader programs ready in " << glutGet(GLUT_ELAPSED_TIME) - startTime << " ms" << std::endl;
 }
 
 /**
-*	Sets (matrices, lights) uniforms for shaderProgram.
+*	Sets model and normal matrix uniforms for a variant of shaderProgram.
+*	\param[in] shader       Program in use.
 *	\param[in] modelMatrix
-*	\param[in] viewMatrix
-*	\param[in] projectionMatrix
+*	\param[in] normalMatrix Inverse transposed view * model, computed by the render queue.
 */
-void setTransformUniforms(const glm::mat4 &modelMatrix, const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix) {
+void setTransformUniforms(const SCommonShaderProgram &shader, const glm::mat4 &modelMatrix, const glm::mat4 &normalMatrix) {
 
-	glm::mat4 PVMmatrix = projectionMatrix * viewMatrix * modelMatrix;
-	glUniformMatrix4fv(shaderProgram.PVMmatrixLocation, 1, GL_FALSE, glm::value_ptr(PVMmatrix));	//value_ptr vraci pointer
-	glUniformMatrix4fv(shaderProgram.VmatrixLocation, 1, GL_FALSE, glm::value_ptr(viewMatrix));
-	glUniformMatrix4fv(shaderProgram.MmatrixLocation, 1, GL_FALSE, glm::value_ptr(modelMatrix));
-	glm::mat4 normalMatrix = glm::transpose(glm::inverse(viewMatrix * modelMatrix));
-	glUniformMatrix4fv(shaderProgram.normalMatrixLocation, 1, GL_FALSE, glm::value_ptr(normalMatrix));  // correct matrix for non-rigid transform
+	// view and projection come from the FrameData uniform block
+	glUniformMatrix4fv(shader.MmatrixLocation, 1, GL_FALSE, glm::value_ptr(modelMatrix));	//value_ptr vraci pointer
+	glUniformMatrix4fv(shader.normalMatrixLocation, 1, GL_FALSE, glm::value_ptr(normalMatrix));
 
 }
 
 /**
-*	Sets (material and texture) uniforms for shaderProgram.
+*	Sets material uniforms without the texture.
+*	\param[in] shader Program in use, a variant of shaderProgram or instancedShaderProgram.
 *	\param[in] ambient
+*	\param[in] diffuse
 *	\param[in] specular
 *	\param[in] shininess
-*	\param[in] texture
 */
-void setMaterialUniforms(const glm::vec3 &ambient, const glm::vec3 &diffuse, const glm::vec3 &specular, float shininess, GLuint texture) {
-	glUniform3fv(shaderProgram.diffuseLocation, 1, glm::value_ptr(diffuse));  // 2nd parameter must be 1 - it declares number of vectors in the vector array
-	glUniform3fv(shaderProgram.ambientLocation, 1, glm::value_ptr(ambient));
-	glUniform3fv(shaderProgram.specularLocation, 1, glm::value_ptr(specular));
-	glUniform1f(shaderProgram.shininessLocation, shininess);
+void setMaterialColorUniforms(const SCommonShaderProgram &shader, const glm::vec3 &ambient, const glm::vec3 &diffuse, const glm::vec3 &specular, float shininess) {
+	glUniform3fv(shader.diffuseLocation, 1, glm::value_ptr(diffuse));  // 2nd parameter must be 1 - it declares number of vectors in the vector array
+	glUniform3fv(shader.ambientLocation, 1, glm::value_ptr(ambient));
+	glUniform3fv(shader.specularLocation, 1, glm::value_ptr(specular));
+	glUniform1f(shader.shininessLocation, shininess);
 	CHECK_GL_ERROR();
-	if (texture != 0){
-		glUniform1i(shaderProgram.useTextureLocation, 1);  // do texture sampling
-		CHECK_GL_ERROR();
-		glUniform1i(shaderProgram.texSamplerLocation, 0);  // texturing unit 0 -> samplerID   [for the GPU linker]
-		CHECK_GL_ERROR();
-		glActiveTexture(GL_TEXTURE0 + 0);                  // texturing unit 0 -> to be bound [for OpenGL BindTexture]
-		CHECK_GL_ERROR();
-		glBindTexture(GL_TEXTURE_2D, texture);
-		CHECK_GL_ERROR();
-	}
-	else{
-		glUniform1i(shaderProgram.useTextureLocation, 0);  // do not sample the texture
+}
+
+// assimp post processing applied to all loaded models, part of the mesh cache key
+const unsigned int MESH_IMPORT_FLAGS = 0
+	| aiProcess_Triangulate             // Triangulate polygons (if any).
+	| aiProcess_PreTransformVertices    // Transforms scene hierarchy into one root with geometry-leafs only. For more see Doc.
+	| aiProcess_GenSmoothNormals        // Calculate normals per vertex.
+	| aiProcess_JoinIdenticalVertices;
+
+/** Read material of the loaded model
+* \param mat [in] assimp material
+* \param fileName [in] loaded file, texture paths are relative to its directory
+* \param material [out] colors and path to the diffuse texture
+*/
+static void importMaterial(const aiMaterial *mat, const std::string &fileName, MeshMaterial *material) {
+	aiColor3D color;
+	aiString name;
+
+	// Get returns: aiReturn_SUCCESS 0 | aiReturn_FAILURE -1 | aiReturn_OUTOFMEMORY -3
+	mat->Get(AI_MATKEY_NAME, name); // may be "" after the input mesh processing. Must be aiString type!
+	mat->Get<aiColor3D>(AI_MATKEY_COLOR_DIFFUSE, color);
+	material->diffuse = glm::vec3(color.r, color.g, color.b);
+	mat->Get<aiColor3D>(AI_MATKEY_COLOR_AMBIENT, color);
+	material->ambient = glm::vec3(color.r, color.g, color.b);
+	mat->Get<aiColor3D>(AI_MATKEY_COLOR_SPECULAR, color);
+	material->specular = glm::vec3(color.r, color.g, color.b);
+	float shininess;
+
+	mat->Get<float>(AI_MATKEY_SHININESS, shininess);
+	material->shininess = shininess / 4.0f;  // shininess divisor-not descibed anywhere
+
+	material->textureName.clear();
+
+	// texture image path
+	if (mat->GetTextureCount(aiTextureType_DIFFUSE) > 0) {
+		// get texture name 
+		mat->Get<aiString>(AI_MATKEY_TEXTURE(aiTextureType_DIFFUSE, 0), name);
+		std::string textureName = name.data;
+
+		size_t found = fileName.find_last_of("/\\");
+		// insert correct texture file path 
+		if (found != std::string::npos) { // not found
+			textureName.insert(0, fileName.substr(0, found + 1));
+		}
+
+		material->textureName = textureName;
 	}
 }
 
-/** Load mesh using assimp library
-* \param filename [in] file to open/load
-* \param shader [in] vao will connect loaded data to shader
-* \param vbo [out] vertex and normal data |VVVVV...|NNNNN...| (no interleaving)
-* \param eao [out] triangle indices
-* \param vao [out] vao connects data to shader input
-* \param numTriangles [out] how many triangles have been loaded and stored into index array eao
+/** Import model using assimp library, all its meshes are merged into one vertex and index buffer
+* \param fileName [in] file to open/load
+* \param data [out] interleaved vertex data |VVVNNNTT|VVVNNNTT|..., indices, materials and their draw ranges
+* \return true if the mesh has been imported
 */
-bool loadSingleMesh(const std::string &fileName, SCommonShaderProgram& shader, MeshGeometry** geometry) {
+bool importMesh(const std::string &fileName, MeshData *data) {
 	Assimp::Importer importer;
 
 	importer.SetPropertyInteger(AI_CONFIG_PP_PTV_NORMALIZE, 1); // Unitize object in size (scale the model to fit into (-1..1)^3)
 	// Load asset from the file - you can play with various processing steps
-	const aiScene * scn = importer.ReadFile(fileName.c_str(), 0
-		| aiProcess_Triangulate             // Triangulate polygons (if any).
-		| aiProcess_PreTransformVertices    // Transforms scene hierarchy into one root with geometry-leafs only. For more see Doc.
-		| aiProcess_GenSmoothNormals        // Calculate normals per vertex.
-		| aiProcess_JoinIdenticalVertices);
+	const aiScene * scn = importer.ReadFile(fileName.c_str(), MESH_IMPORT_FLAGS);
 
 	// abort if the loader fails
 	if (scn == NULL) {
 		std::cerr << "assimp error: " << importer.GetErrorString() << std::endl;
-		*geometry = NULL;
 		return false;
 	}
-	// some formats store whole scene (multiple meshes and materials, lights, cameras, ...) in one file, we cannot handle that in our simplified example
 
-	if (scn->mNumMeshes != 1) {
-		std::cerr << "this simplified loader can only process files with only one mesh" << std::endl;
-		*geometry = NULL;
+	if (scn->mNumMeshes == 0) {
+		std::cerr << "importMesh(): " << fileName << " contains no mesh" << std::endl;
 		return false;
 	}
-	// in this phase we know we have one mesh in our loaded scene, we can directly copy its data to opengl ...
-	const aiMesh * mesh = scn->mMeshes[0];
 
-	*geometry = new MeshGeometry;
+	// materials used by the meshes, ordered by texture so that draws with the same texture follow each other
+	std::vector<MeshMaterial> sceneMaterials(scn->mNumMaterials);
+	std::vector<bool> materialUsed(scn->mNumMaterials, false);
+	std::vector<unsigned int> materialOrder;
 
-	// vertex buffer object, store all vertex positions and normals
-	glGenBuffers(1, &((*geometry)->vertexBufferObject));
-	glBindBuffer(GL_ARRAY_BUFFER, (*geometry)->vertexBufferObject);
-	glBufferData(GL_ARRAY_BUFFER, 8 * sizeof(float)*mesh->mNumVertices, 0, GL_STATIC_DRAW); // allocate memory for vertices, normals, and texture coordinates
-	// first store all vertices
-	glBufferSubData(GL_ARRAY_BUFFER, 0, 3 * sizeof(float)*mesh->mNumVertices, mesh->mVertices);
-	// then store all normals
-	glBufferSubData(GL_ARRAY_BUFFER, 3 * sizeof(float)*mesh->mNumVertices, 3 * sizeof(float)*mesh->mNumVertices, mesh->mNormals);
-
-	// just texture 0 for now
-	float *textureCoords = new float[2 * mesh->mNumVertices];  // 2 floats per vertex
-	float *currentTextureCoord = textureCoords;
-
-	// copy texture coordinates
-	aiVector3D vect;
-
-	if (mesh->HasTextureCoords(0)) {
-		// we use 2D textures with 2 coordinates and ignore the third coordinate
-		for (unsigned int idx = 0; idx<mesh->mNumVertices; idx++) {
-			vect = (mesh->mTextureCoords[0])[idx];
-			*currentTextureCoord++ = vect.x;
-			*currentTextureCoord++ = vect.y;
+	for (unsigned int i = 0; i < scn->mNumMeshes; i++)
+		materialUsed[scn->mMeshes[i]->mMaterialIndex] = true;
+
+	for (unsigned int i = 0; i < scn->mNumMaterials; i++) {
+		if (!materialUsed[i])
+			continue;
+		importMaterial(scn->mMaterials[i], fileName, &sceneMaterials[i]);
+		materialOrder.push_back(i);
+	}
+
+	std::stable_sort(materialOrder.begin(), materialOrder.end(), [&sceneMaterials](unsigned int a, unsigned int b) {
+		return sceneMaterials[a].textureName < sceneMaterials[b].textureName;
+	});
+
+	data->mapping.data = NULL;
+	data->mapping.size = 0;
+	data->vertexStorage.clear();
+	data->indexStorage.clear();
+	data->materials.clear();
+	data->drawRanges.clear();
+
+	// meshes with the same material form one draw range
+	for (size_t m = 0; m < materialOrder.size(); m++) {
+		MeshDrawRange range;
+		range.firstTriangle = (unsigned int)data->indexStorage.size() / 3;
+
+		for (unsigned int i = 0; i < scn->mNumMeshes; i++) {
+			const aiMesh * mesh = scn->mMeshes[i];
+			if (mesh->mMaterialIndex != materialOrder[m])
+				continue;
+
+			// append interleaved vertices, normals, and texture coordinates
+			unsigned int baseVertex = (unsigned int)(data->vertexStorage.size() / MESH_VERTEX_SIZE);
+			data->vertexStorage.resize(data->vertexStorage.size() + MESH_VERTEX_SIZE * mesh->mNumVertices, 0.0f);
+			float *vertices = &data->vertexStorage[MESH_VERTEX_SIZE * baseVertex];
+
+			for (unsigned int idx = 0; idx < mesh->mNumVertices; idx++) {
+				float *vertex = vertices + MESH_VERTEX_SIZE * idx;
+
+				vertex[0] = mesh->mVertices[idx].x;
+				vertex[1] = mesh->mVertices[idx].y;
+				vertex[2] = mesh->mVertices[idx].z;
+
+				vertex[3] = mesh->mNormals[idx].x;
+				vertex[4] = mesh->mNormals[idx].y;
+				vertex[5] = mesh->mNormals[idx].z;
+
+				// just texture 0 for now, we use 2D textures with 2 coordinates and ignore the third coordinate
+				if (mesh->HasTextureCoords(0)) {
+					vertex[6] = mesh->mTextureCoords[0][idx].x;
+					vertex[7] = mesh->mTextureCoords[0][idx].y;
+				}
+			}
+
+			// copy mesh faces (assimp supports faces with ordinary number of vertices, we use only 3 -> triangles, lines and points are skipped)
+			for (unsigned int f = 0; f < mesh->mNumFaces; ++f) {
+				if (mesh->mFaces[f].mNumIndices != 3)
+					continue;
+				data->indexStorage.push_back(baseVertex + mesh->mFaces[f].mIndices[0]);
+				data->indexStorage.push_back(baseVertex + mesh->mFaces[f].mIndices[1]);
+				data->indexStorage.push_back(baseVertex + mesh->mFaces[f].mIndices[2]);
+			}
 		}
+
+		range.numTriangles = (unsigned int)data->indexStorage.size() / 3 - range.firstTriangle;
+		data->materials.push_back(sceneMaterials[materialOrder[m]]);
+		data->drawRanges.push_back(range);
 	}
 
-	// finally store all texture coordinates
-	glBufferSubData(GL_ARRAY_BUFFER, 6 * sizeof(float)*mesh->mNumVertices, 2 * sizeof(float)*mesh->mNumVertices, textureCoords);
+	data->numVertices = (unsigned int)(data->vertexStorage.size() / MESH_VERTEX_SIZE);
+	data->numTriangles = (unsigned int)(data->indexStorage.size() / 3);
 
-	// copy all mesh faces into one big array (assimp supports faces with ordinary number of vertices, we use only 3 -> triangles)
-	unsigned int *indices = new unsigned int[mesh->mNumFaces * 3];
-	for (unsigned int f = 0; f < mesh->mNumFaces; ++f) {
-		indices[f * 3 + 0] = mesh->mFaces[f].mIndices[0];
-		indices[f * 3 + 1] = mesh->mFaces[f].mIndices[1];
-		indices[f * 3 + 2] = mesh->mFaces[f].mIndices[2];
+	if (data->numTriangles == 0) {
+		std::cerr << "importMesh(): " << fileName << " contains no triangles" << std::endl;
+		return false;
 	}
-	// copy our temporary index array to OpenGL and free the array
-	glGenBuffers(1, &((*geometry)->elementBufferObject));
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, (*geometry)->elementBufferObject);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, 3 * sizeof(unsigned) * mesh->mNumFaces, indices, GL_STATIC_DRAW);
 
-	delete[] indices;
+	unsigned int numMaterials = (unsigned int)data->materials.size();
+	unsigned int numIndices = 3 * data->numTriangles;
+	float *vertices = &data->vertexStorage[0];
+	unsigned int *indices = &data->indexStorage[0];
 
-	// copy the material info to MeshGeometry structure
-	const aiMaterial *mat = scn->mMaterials[mesh->mMaterialIndex];
-	aiColor3D color;
-	aiString name;
+	// reorder triangles of each draw range for the post-transform vertex cache and overdraw
+	analyzeVertexCache(indices, numIndices, data->numVertices, &data->importAcmr, &data->importAtvr);
+	for (unsigned int m = 0; m < numMaterials; m++) {
+		unsigned int *rangeIndices = indices + 3 * data->drawRanges[m].firstTriangle;
+		unsigned int rangeNumIndices = 3 * data->drawRanges[m].numTriangles;
 
-	// Get returns: aiReturn_SUCCESS 0 | aiReturn_FAILURE -1 | aiReturn_OUTOFMEMORY -3
-	mat->Get(AI_MATKEY_NAME, name); // may be "" after the input mesh processing. Must be aiString type!
-	mat->Get<aiColor3D>(AI_MATKEY_COLOR_DIFFUSE, color);
-	(*geometry)->diffuse = glm::vec3(color.r, color.g, color.b);
-	mat->Get<aiColor3D>(AI_MATKEY_COLOR_AMBIENT, color);
-	(*geometry)->ambient = glm::vec3(color.r, color.g, color.b);
-	mat->Get<aiColor3D>(AI_MATKEY_COLOR_SPECULAR, color);
-	(*geometry)->specular = glm::vec3(color.r, color.g, color.b);
-	float shininess;
+		optimizeVertexCache(rangeIndices, rangeNumIndices, data->numVertices);
+		optimizeOverdraw(rangeIndices, rangeNumIndices, vertices, data->numVertices, MESH_VERTEX_SIZE, OVERDRAW_THRESHOLD);
+	}
 
-	mat->Get<float>(AI_MATKEY_SHININESS, shininess);
-	(*geometry)->shininess = shininess / 4.0f;  // shininess divisor-not descibed anywhere
+	data->numLods = 1;
+	data->lodFirstTriangle[0] = 0;
+	data->lodNumTriangles[0] = data->numTriangles;
+	data->lodError[0] = 0.0f;
 
-	(*geometry)->texture = 0;
+	// each coarser level of detail has half of the triangles of the previous one, draw ranges are simplified separately from the full mesh
+	std::vector<unsigned int> lodIndices;
+	std::vector<unsigned int> simplified(numIndices);
 
-	// load texture image
-	if (mat->GetTextureCount(aiTextureType_DIFFUSE) > 0) {
-		// get texture name 
-		mat->Get<aiString>(AI_MATKEY_TEXTURE(aiTextureType_DIFFUSE, 0), name);
-		std::string textureName = name.data;
+	for (unsigned int lod = 1; lod < MESH_MAX_LODS; lod++) {
+		size_t levelStart = lodIndices.size();
+		std::vector<MeshDrawRange> levelRanges(numMaterials);
+		float levelError = data->lodError[lod - 1];
 
-		size_t found = fileName.find_last_of("/\\");
-		// insert correct texture file path 
-		if (found != std::string::npos) { // not found
-			//subMesh_p->textureName.insert(0, "/");
-			textureName.insert(0, fileName.substr(0, found + 1));
+		for (unsigned int m = 0; m < numMaterials; m++) {
+			const MeshDrawRange &full = data->drawRanges[m];
+			const MeshDrawRange &previous = data->drawRanges[(lod - 1) * numMaterials + m];
+			float error;
+
+			unsigned int rangeNumIndices = simplifyMesh(&simplified[0], indices + 3 * full.firstTriangle, 3 * full.numTriangles,
+				vertices, data->numVertices, MESH_VERTEX_SIZE, previous.numTriangles / 2 * 3, &error);
+			optimizeVertexCache(&simplified[0], rangeNumIndices, data->numVertices);
+
+			levelRanges[m].firstTriangle = data->numTriangles + (unsigned int)lodIndices.size() / 3;
+			levelRanges[m].numTriangles = rangeNumIndices / 3;
+			levelError = std::max(levelError, error);
+
+			lodIndices.insert(lodIndices.end(), simplified.begin(), simplified.begin() + rangeNumIndices);
 		}
 
-		std::cout << "Loading texture file: " << textureName << std::endl;
-		CHECK_GL_ERROR();
-		(*geometry)->texture = pgr::createTexture(textureName);
+		unsigned int levelTriangles = (unsigned int)(lodIndices.size() - levelStart) / 3;
+
+		// locked borders and seams do not allow further simplification
+		if (levelTriangles == 0 || levelTriangles > data->lodNumTriangles[lod - 1] * MESH_LOD_MIN_REDUCTION) {
+			lodIndices.resize(levelStart);
+			break;
+		}
+
+		data->lodFirstTriangle[lod] = data->numTriangles + (unsigned int)levelStart / 3;
+		data->lodNumTriangles[lod] = levelTriangles;
+		data->lodError[lod] = levelError;
+		data->numLods++;
+		data->drawRanges.insert(data->drawRanges.end(), levelRanges.begin(), levelRanges.end());
 	}
-	CHECK_GL_ERROR();
 
-	glGenVertexArrays(1, &((*geometry)->vertexArrayObject));
-	glBindVertexArray((*geometry)->vertexArrayObject);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, (*geometry)->elementBufferObject); // bind our element array buffer (indices) to vao
-	glBindBuffer(GL_ARRAY_BUFFER, (*geometry)->vertexBufferObject);
+	data->indexStorage.insert(data->indexStorage.end(), lodIndices.begin(), lodIndices.end());
+	data->numTriangles = (unsigned int)data->indexStorage.size() / 3;
+	indices = &data->indexStorage[0];
 
-	glEnableVertexAttribArray(shader.posLocation);
-	glVertexAttribPointer(shader.posLocation, 3, GL_FLOAT, GL_FALSE, 0, 0);
-	CHECK_GL_ERROR();
+	// vertices in the order of their first use, the full mesh uses all of them
+	data->numVertices = optimizeVertexFetch(vertices, indices, 3 * data->numTriangles, data->numVertices, MESH_VERTEX_SIZE);
+	data->vertexStorage.resize(MESH_VERTEX_SIZE * data->numVertices);
+	computeMeshBounds(&data->vertexStorage[0], data->numVertices, MESH_VERTEX_SIZE, &data->bounds);
+	analyzeVertexCache(indices, numIndices, data->numVertices, &data->acmr, &data->atvr);
 
-	glEnableVertexAttribArray(shader.texCoordLocation);
-	CHECK_GL_ERROR();
-	glVertexAttribPointer(shader.texCoordLocation, 2, GL_FLOAT, GL_FALSE, 0, (void*)(6 * sizeof(float) * mesh->mNumVertices));
-	CHECK_GL_ERROR();
-	glEnableVertexAttribArray(shader.normalLocation);
-	glVertexAttribPointer(shader.normalLocation, 3, GL_FLOAT, GL_FALSE, 0, (void*)(3 * sizeof(float) * mesh->mNumVertices));
-	CHECK_GL_ERROR();
+	data->vertices = &data->vertexStorage[0];
+	data->indices = indices;
 
+	return true;
+}
+
+/** Load mesh from the mesh cache or using assimp library, does not touch OpenGL (safe on worker threads)
+* \param fileName [in] file to open/load
+* \param data [out] loaded vertex data, indices and material
+* \param cacheHit [out] true if the mesh has been read from the mesh cache
+* \return true if the mesh has been loaded
+*/
+bool loadMeshData(const std::string &fileName, MeshData *data, bool *cacheHit) {
+
+	*cacheHit = loadMeshCache(fileName, MESH_IMPORT_FLAGS, data);
+	if (*cacheHit)
+		return true;
+
+	if (!importMesh(fileName, data))
+		return false;
+
+	if (!saveMeshCache(fileName, MESH_IMPORT_FLAGS, *data))
+		std::cerr << "loadMeshData(): cannot store mesh cache for " << fileName << std::endl;
+
+	return true;
+}
+
+/** Upload loaded mesh to the shared mesh buffer
+* \param data [in] interleaved vertex data |VVVNNNTT|VVVNNNTT|..., indices and material
+* \param textures [in] diffuse texture of each material or 0, the geometry takes over one reference of each
+* \param shader [in] vao will connect loaded data to shader
+* \param geometry [out] range in the shared buffers, its vbo, ebo and vao, textures and materials
+*/
+void createMeshGeometry(const MeshData &data, const std::vector<GLuint> &textures, SCommonShaderProgram& shader, MeshGeometry** geometry) {
+
+	*geometry = new MeshGeometry;
+
+	// vertices are converted to the vertex format used on the GPU, indices to 16 bits if the model is small enough
+	(*geometry)->vertexFormat = meshBufferFormat();
+	addMeshToBuffer(data.vertices, data.numVertices, data.indices, 3 * data.numTriangles, &(*geometry)->bufferRange);
+	(*geometry)->indexType = (*geometry)->bufferRange.indexType;
+
+	(*geometry)->vertexBufferObject = meshVertexBuffer();
+	(*geometry)->elementBufferObject = meshIndexBuffer((*geometry)->indexType);
+	(*geometry)->vertexArrayObject = meshBufferVertexArray(shader.posLocation, shader.normalLocation, shader.texCoordLocation, (*geometry)->indexType);
+
+	// copy the material info to MeshGeometry structure, textures are shared through the asset registry
+	(*geometry)->materials.resize(data.materials.size());
+	for (size_t m = 0; m < data.materials.size(); m++) {
+		MeshGeometryMaterial *material = &(*geometry)->materials[m];
+		material->diffuse = data.materials[m].diffuse;
+		material->ambient = data.materials[m].ambient;
+		material->specular = data.materials[m].specular;
+		material->shininess = data.materials[m].shininess;
+		material->texture = textures[m];
+		material->textureArray = -1;
+		material->textureLayer = 0;
+	}
+	(*geometry)->texture = 0;
+
+	// triangle ranges point to the shared element buffer
+	const unsigned int firstTriangle = (*geometry)->bufferRange.firstIndex / 3;
+
+	(*geometry)->drawRanges = data.drawRanges;
+	for (size_t r = 0; r < (*geometry)->drawRanges.size(); r++)
+		(*geometry)->drawRanges[r].firstTriangle += firstTriangle;
+
+	(*geometry)->numVertices = data.numVertices;
+	(*geometry)->numTriangles = data.lodNumTriangles[0];
+	(*geometry)->numLods = data.numLods;
+	for (unsigned int i = 0; i < data.numLods; i++) {
+		(*geometry)->lodFirstTriangle[i] = firstTriangle + data.lodFirstTriangle[i];
+		(*geometry)->lodNumTriangles[i] = data.lodNumTriangles[i];
+		(*geometry)->lodError[i] = data.lodError[i];
+	}
+	(*geometry)->bounds = data.bounds;
+	createOccluderMesh(data, &(*geometry)->occluder);
+	createPickMesh(data, &(*geometry)->pickMesh);
 	CHECK_GL_ERROR();
-	glBindVertexArray(0);
-	CHECK_GL_ERROR();
-	(*geometry)->numTriangles = mesh->mNumFaces;
-	CHECK_GL_ERROR();
+}
+
+/**
+*	Clears statistics, called at the beginning of a frame.
+*/
+void resetRenderStats() {
+	renderStats.drawCalls = 0;
+	renderStats.indirectDraws = 0;
+	renderStats.triangles = 0;
+	renderStats.fullDetailTriangles = 0;
+	renderStats.visibleObjects = 0;
+	renderStats.occludedObjects = 0;
+	renderStats.totalObjects = 0;
+	renderStats.stateChanges = 0;
+	renderStats.unsortedStateChanges = 0;
+	renderStats.programChanges = 0;
+	renderStats.vertexArrayChanges = 0;
+	renderStats.textureChanges = 0;
+	renderStats.fixedStateChanges = 0;
+}
+
+/**
+*	Returns pixels per unit of view space at unit distance, the projection is perspective.
+*/
+static float lodPixelScale(const glm::mat4 & projectionMatrix) {
+	return projectionMatrix[1][1] * 0.5f * glutGet(GLUT_WINDOW_HEIGHT);
+}
+
+/**
+*	Chooses level of detail so that the simplification error projected on the screen stays under LOD_PIXEL_ERROR.
+*	The previous level is kept until the error leaves the hysteresis band around the threshold, so levels do not pop.
+*	\param[in]     geometry         Mesh with levels of detail.
+*	\param[in,out] lod              Level of detail of the object used in the previous frame.
+*	\param[in]     position         Position of the object.
+*	\param[in]     size             Scale of the object (mesh fits into (-1..1)^3).
+*	\param[in]     viewMatrix
+*	\param[in]     pixelScale       Result of lodPixelScale() for the projection matrix.
+*	\return Level of detail to draw.
+*/
+static int selectMeshLod(const MeshGeometry *geometry, int *lod, const glm::vec3 &position, float size, const glm::mat4 & viewMatrix, float pixelScale) {
+
+	if (!meshLodEnabled || geometry->numLods <= 1) {
+		*lod = 0;
+		return 0;
+	}
+
+	// pixels per model unit at the distance of the object
+	float distance = std::max(-(viewMatrix * glm::vec4(position, 1.0f)).z, 0.01f);
+	float pixelsPerUnit = size * pixelScale / distance;
+
+	int level = std::min(std::max(*lod, 0), (int)geometry->numLods - 1);
+
+	while (level + 1 < (int)geometry->numLods && geometry->lodError[level + 1] * pixelsPerUnit < LOD_PIXEL_ERROR * (1.0f - LOD_HYSTERESIS))
+		level++;
+	while (level > 0 && geometry->lodError[level] * pixelsPerUnit > LOD_PIXEL_ERROR * (1.0f + LOD_HYSTERESIS))
+		level--;
+
+	*lod = level;
+	return level;
+}
+
+/**
+*	Chooses level of detail of one object, see above.
+*/
+static int selectMeshLod(const MeshGeometry *geometry, int *lod, const glm::vec3 &position, float size, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix) {
+	return selectMeshLod(geometry, lod, position, size, viewMatrix, lodPixelScale(projectionMatrix));
+}
+
+/**
+*	Counts the object and returns true if the mesh with the pose is inside the view frustum of the frame
+*	and not hidden behind the occluders.
+*	\param[in] geometry Mesh of the object.
+*	\param[in] position Position of the object.
+*	\param[in] front    Direction the object faces.
+*	\param[in] up       Up direction of the object.
+*	\param[in] size     Uniform scale of the object.
+*/
+static bool meshVisible(const MeshGeometry *geometry, const glm::vec3 &position, const glm::vec3 &front, const glm::vec3 &up, float size) {
+	renderStats.totalObjects++;
+
+	// collapsed objects (the clicked cat) cover no pixel
+	if (size <= 0.0f)
+		return false;
+
+	if (!poseInFrustum(renderFrustum(), geometry->bounds, position, front, up, size))
+		return false;
+
+	glm::vec3 center, extents;
+	poseBox(geometry->bounds, position, front, up, size, &center, &extents);
+	if (boxOccluded(center, extents)) {
+		renderStats.occludedObjects++;
+		return false;
+	}
+
+	renderStats.visibleObjects++;
 	return true;
 }
 
 /**
-*	Draws floor
-*	\param[in] floor Object to draw
+*	Counts the object and returns true if the billboard is inside the view frustum of the frame.
+*	\param[in] geometry Quad of the billboard.
+*	\param[in] position Position of the billboard.
+*	\param[in] size     Uniform scale of the billboard.
+*/
+static bool billboardVisible(const MeshGeometry *geometry, const glm::vec3 &position, float size) {
+	renderStats.totalObjects++;
+	if (!sphereInFrustum(renderFrustum(), position, size * boundingRadius(geometry->bounds)))
+		return false;
+	renderStats.visibleObjects++;
+	return true;
+}
+
+/**
+*	Sets transformation and material uniforms of the render item for its variant of shaderProgram.
+*	\param[in] item Item with a pose, the material and the variant.
 *	\param[in] viewMatrix
 *	\param[in] projectionMatrix
 */
-void drawFloor(FloorObject* floor, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix){
+static void setCommonItemUniforms(const RenderItem &item, const glm::mat4 & /*viewMatrix*/, const glm::mat4 & /*projectionMatrix*/) {
+	const MeshGeometryMaterial *material = item.material;
+	const SCommonShaderProgram &shader = *item.shader;
 
-	glUseProgram(shaderProgram.program);
-	
-	glm::mat4 modelMatrix = alignObject(floor->position, glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-	modelMatrix = glm::scale(modelMatrix, glm::vec3(floor->size));
-
-	setTransformUniforms(modelMatrix, viewMatrix, projectionMatrix);
-	setMaterialUniforms(
-		floorGeometry->ambient,
-		floorGeometry->diffuse,
-		floorGeometry->specular,
-		floorGeometry->shininess,
-		floorGeometry->texture
+	setTransformUniforms(shader, item.modelMatrix, item.normalMatrix);
+	setMaterialColorUniforms(shader, material->ambient, material->diffuse, material->specular, material->shininess);
+	glUniform1i(shader.texSamplerLocation, 0);
+}
+
+/**
+*	Queues one level of detail of the mesh, one render item per material. With multi-draw indirect
+*	the items of the loaded models share the program and the vao, their uniforms come from
+*	the per draw data and their textures from the texture arrays, so the queue draws them
+*	by one call. Materials with a texture outside the arrays are drawn one by one.
+*	\param[in] geometry    Mesh to draw.
+*	\param[in] lod         Level of detail.
+*	\param[in] transform   Pose of the object from addRenderTransform().
+*	\param[in] position    Position of the object.
+*/
+static void queueMeshLod(const MeshGeometry *geometry, int lod, int transform, const glm::vec3 &position) {
+	size_t numMaterials = geometry->materials.size();
+
+	const bool indirect = indirectShaderProgram.program != 0 && geometry->bufferRange.numIndices > 0;
+	const GLuint indirectVertexArray = indirect ? meshBufferVertexArray(indirectShaderProgram.posLocation,
+		indirectShaderProgram.normalLocation, indirectShaderProgram.texCoordLocation, geometry->indexType) : 0;
+
+	for (size_t m = 0; m < numMaterials; m++) {
+		const MeshDrawRange &range = geometry->drawRanges[lod * numMaterials + m];
+		const MeshGeometryMaterial &material = geometry->materials[m];
+
+		if (range.numTriangles == 0)
+			continue;
+
+		RenderItem *item = pushRenderItem(position);
+		item->shader = commonShaderVariant(&mainShaderVariants, material.texture != 0);
+		item->program = item->shader->program;
+		item->vertexArrayObject = geometry->vertexArrayObject;
+		item->texture = material.texture;
+		item->indexType = geometry->indexType;
+		item->first = 3 * range.firstTriangle;
+		item->baseVertex = geometry->bufferRange.baseVertex;
+		item->count = 3 * range.numTriangles;
+		item->fullDetailTriangles = geometry->drawRanges[m].numTriangles;
+		item->setUniforms = setCommonItemUniforms;
+		item->transform = transform;
+		item->material = &material;
+
+		if (indirect && (material.texture == 0 || material.textureArray >= 0)) {
+			item->shader = commonShaderVariant(&indirectShaderVariants, material.texture != 0);
+			item->program = item->shader->program;
+			item->vertexArrayObject = indirectVertexArray;
+			item->texture = 0;
+			item->setUniforms = NULL;
+			item->indirect = true;
+		}
+	}
+}
+
+/**
+*	Returns model matrix of the pose, translate * scale * rotation of poseRotation().
+*/
+static glm::mat4 poseMatrix(const glm::vec3 &position, const glm::vec3 &front, const glm::vec3 &up, float size) {
+
+	glm::mat3 rotation = poseRotation(front, up);
+	return glm::mat4(
+		glm::vec4(rotation[0] * size, 0.0f),
+		glm::vec4(rotation[1] * size, 0.0f),
+		glm::vec4(rotation[2] * size, 0.0f),
+		glm::vec4(position, 1.0f)
 	);
-	
-	glBindVertexArray(floorGeometry->vertexArrayObject);
-	glDrawArrays(GL_TRIANGLES, 0, 3 * floorGeometry->numTriangles);
+}
 
-	glBindVertexArray(0);
-	glUseProgram(0);
+/**
+*	Adds the occluder of the mesh with the pose to the occlusion buffer if the mesh is inside the view frustum.
+*/
+static void addMeshOccluder(const MeshGeometry *geometry, const glm::vec3 &position, const glm::vec3 &front, const glm::vec3 &up, float size) {
+
+	if (geometry == NULL || !poseInFrustum(renderFrustum(), geometry->bounds, position, front, up, size))
+		return;
+
+	addOccluder(geometry->occluder, poseMatrix(position, front, up, size));
 }
 
 /**
-*	Draws alien
-*	\param[in] alien Object to draw
+*	Rasterizes the large objects into the occlusion buffer, objects hidden behind them are not drawn.
+*	Has to be called after beginRenderQueue() and before the other draw functions.
+*	\param[in] cargo Container
+*	\param[in] stop  Stop sign
+*	\param[in] lamp  Lamp
 *	\param[in] viewMatrix
 *	\param[in] projectionMatrix
 */
-void drawAlien(AlienObject* alien, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix) {
-	glUseProgram(shaderProgram.program);
+void drawOccluders(CargoObject* cargo, StopObject* stop, LampObject* lamp, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix) {
 
-	glm::mat4 modelMatrix = alignObject(alien->position, alien->direction, glm::vec3(0.0f, 0.0f, 0.2f));
-	modelMatrix = glm::scale(modelMatrix, glm::vec3(alien->size));
-	modelMatrix = glm::rotate(modelMatrix, 0.0f, glm::vec3(1, 0, 0));
-	CHECK_GL_ERROR();
+	beginOcclusionFrame(projectionMatrix * viewMatrix);
+	if (!occlusionCullingEnabled)
+		return;
 
-	setTransformUniforms(modelMatrix, viewMatrix, projectionMatrix);
+	const glm::vec3 up(0.0f, 0.0f, 1.0f);
+	addMeshOccluder(cargoGeometry, cargo->position, cargo->direction, up, cargo->size);
+	addMeshOccluder(stopGeometry, stop->position, stop->direction, up, stop->size);
+	addMeshOccluder(lampGeometry, lamp->position, glm::vec3(0.0f, 1.0f, 0.0f), up, lamp->size);
 
-	setMaterialUniforms(
-		alienGeometry->ambient,
-		alienGeometry->diffuse,
-		alienGeometry->specular,
-		alienGeometry->shininess,
-		alienGeometry->texture
-		);
+	rasterizeOccluders();
+}
 
+/**
+*	Draws floor
+*	\param[in] floor Object to draw
+*/
+void drawFloor(FloorObject* floor){
+
+	const glm::vec3 front(1.0f, 0.0f, 0.0f), up(0.0f, 0.0f, 1.0f);
+	if (!meshVisible(floorGeometry, floor->position, front, up, floor->size))
+		return;
+
+	int transform = addRenderTransform(floor->position, front, up, floor->size);
+
+	RenderItem *item = pushRenderItem(floor->position);
+	item->shader = commonShaderVariant(&mainShaderVariants, floorGeometry->materials[0].texture != 0);
+	item->program = item->shader->program;
+	item->vertexArrayObject = floorGeometry->vertexArrayObject;
+	item->texture = floorGeometry->materials[0].texture;
+	item->count = 3 * floorGeometry->numTriangles;
+	item->fullDetailTriangles = floorGeometry->numTriangles;
+	item->setUniforms = setCommonItemUniforms;
+	item->transform = transform;
+	item->material = &floorGeometry->materials[0];
+}
 
-	CHECK_GL_ERROR();
-	glBindVertexArray(alienGeometry->vertexArrayObject);
-	glDrawElements(GL_TRIANGLES, alienGeometry->numTriangles * 3, GL_UNSIGNED_INT, 0);
+/**
+*	Draws alien
+*	\param[in] alien Object to draw
+*	\param[in] viewMatrix
+*	\param[in] projectionMatrix
+*/
+void drawAlien(AlienObject* alien, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix) {
 
-	glBindVertexArray(0);
-	glUseProgram(0);
-	CHECK_GL_ERROR();
+	const glm::vec3 up(0.0f, 0.0f, 0.2f);
+	if (!meshVisible(alienGeometry, alien->position, alien->direction, up, alien->size))
+		return;
+
+	int transform = addRenderTransform(alien->position, alien->direction, up, alien->size);
+
+	int lod = selectMeshLod(alienGeometry, &alien->lod, alien->position, alien->size, viewMatrix, projectionMatrix);
+	queueMeshLod(alienGeometry, lod, transform, alien->position);
 }
 
 /**
@@ -406,30 +939,15 @@ void drawAlien(AlienObject* alien, const glm::mat4 & viewMatrix, const glm::mat4
 *	\param[in] projectionMatrix
 */
 void drawScanner(ScannerObject* scanner, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix) {
-	glUseProgram(shaderProgram.program);
-
-	glm::mat4 modelMatrix = alignObject(scanner->position, scanner->direction, glm::vec3(0.0f, 0.0f, 1.0f));
-	modelMatrix = glm::scale(modelMatrix, glm::vec3(scanner->size));
-	CHECK_GL_ERROR();
 
-	setTransformUniforms(modelMatrix, viewMatrix, projectionMatrix);
-
-	setMaterialUniforms(
-		scannerGeometry->ambient,
-		scannerGeometry->diffuse,
-		scannerGeometry->specular,
-		scannerGeometry->shininess,
-		scannerGeometry->texture
-		);
+	const glm::vec3 up(0.0f, 0.0f, 1.0f);
+	if (!meshVisible(scannerGeometry, scanner->position, scanner->direction, up, scanner->size))
+		return;
 
+	int transform = addRenderTransform(scanner->position, scanner->direction, up, scanner->size);
 
-	CHECK_GL_ERROR();
-	glBindVertexArray(scannerGeometry->vertexArrayObject);
-	glDrawElements(GL_TRIANGLES, scannerGeometry->numTriangles * 3, GL_UNSIGNED_INT, 0);
-
-	glBindVertexArray(0);
-	glUseProgram(0);
-	CHECK_GL_ERROR();
+	int lod = selectMeshLod(scannerGeometry, &scanner->lod, scanner->position, scanner->size, viewMatrix, projectionMatrix);
+	queueMeshLod(scannerGeometry, lod, transform, scanner->position);
 }
 
 /**
@@ -439,30 +957,15 @@ void drawScanner(ScannerObject* scanner, const glm::mat4 & viewMatrix, const glm
 *	\param[in] projectionMatrix
 */
 void drawCargo(CargoObject* cargo, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix) {
-	glUseProgram(shaderProgram.program);
-
-	glm::mat4 modelMatrix = alignObject(cargo->position, cargo->direction, glm::vec3(0.0f, 0.0f, 1.0f));
-	modelMatrix = glm::scale(modelMatrix, glm::vec3(cargo->size));
-	CHECK_GL_ERROR();
-
-	setTransformUniforms(modelMatrix, viewMatrix, projectionMatrix);
-
-	setMaterialUniforms(
-		cargoGeometry->ambient,
-		cargoGeometry->diffuse,
-		cargoGeometry->specular,
-		cargoGeometry->shininess,
-		cargoGeometry->texture
-		);
 
+	const glm::vec3 up(0.0f, 0.0f, 1.0f);
+	if (!meshVisible(cargoGeometry, cargo->position, cargo->direction, up, cargo->size))
+		return;
 
-	CHECK_GL_ERROR();
-	glBindVertexArray(cargoGeometry->vertexArrayObject);
-	glDrawElements(GL_TRIANGLES, cargoGeometry->numTriangles * 3, GL_UNSIGNED_INT, 0);
+	int transform = addRenderTransform(cargo->position, cargo->direction, up, cargo->size);
 
-	glBindVertexArray(0);
-	glUseProgram(0);
-	CHECK_GL_ERROR();
+	int lod = selectMeshLod(cargoGeometry, &cargo->lod, cargo->position, cargo->size, viewMatrix, projectionMatrix);
+	queueMeshLod(cargoGeometry, lod, transform, cargo->position);
 }
 
 /**
@@ -472,127 +975,366 @@ void drawCargo(CargoObject* cargo, const glm::mat4 & viewMatrix, const glm::mat4
 *	\param[in] projectionMatrix
 */
 void drawStop(StopObject* stop, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix) {
-	glUseProgram(shaderProgram.program);
 
-	glm::mat4 modelMatrix = alignObject(stop->position, stop->direction, glm::vec3(0.0f, 0.0f, 1.0f));
-	modelMatrix = glm::scale(modelMatrix, glm::vec3(stop->size));
-	CHECK_GL_ERROR();
+	const glm::vec3 up(0.0f, 0.0f, 1.0f);
+	if (!meshVisible(stopGeometry, stop->position, stop->direction, up, stop->size))
+		return;
 
-	setTransformUniforms(modelMatrix, viewMatrix, projectionMatrix);
+	int transform = addRenderTransform(stop->position, stop->direction, up, stop->size);
 
-	setMaterialUniforms(
-		stopGeometry->ambient,
-		stopGeometry->diffuse,
-		stopGeometry->specular,
-		stopGeometry->shininess,
-		stopGeometry->texture
-		);
+	int lod = selectMeshLod(stopGeometry, &stop->lod, stop->position, stop->size, viewMatrix, projectionMatrix);
+	queueMeshLod(stopGeometry, lod, transform, stop->position);
+}
+
+/**
+*	Draws Swarm
+*	\param[in] Swarm Object to draw
+*	\param[in] viewMatrix
+*	\param[in] projectionMatrix
+*/
+void drawSwarm(SwarmObject* swarm, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix) {
 
+	const glm::vec3 up(0.0f, 0.0f, 1.0f);
+	if (!meshVisible(swarmGeometry, swarm->position, swarm->direction, up, swarm->size))
+		return;
 
-	CHECK_GL_ERROR();
-	glBindVertexArray(stopGeometry->vertexArrayObject);
-	glDrawElements(GL_TRIANGLES, stopGeometry->numTriangles * 3, GL_UNSIGNED_INT, 0);
+	int transform = addRenderTransform(swarm->position, swarm->direction, up, swarm->size);
+
+	int lod = selectMeshLod(swarmGeometry, &swarm->lod, swarm->position, swarm->size, viewMatrix, projectionMatrix);
+	queueMeshLod(swarmGeometry, lod, transform, swarm->position);
+}
+
+/**
+*	Draws Cat
+*	\param[in] Cat Object to draw
+*	\param[in] viewMatrix
+*	\param[in] projectionMatrix
+*/
+void drawCat(CatObject* cat, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix) {
+
+	const glm::vec3 up(0.0f, 0.0f, 1.0f);
+	if (!meshVisible(catGeometry, cat->position, cat->direction, up, cat->size))
+		return;
+
+	int transform = addRenderTransform(cat->position, cat->direction, up, cat->size);
+
+	int lod = selectMeshLod(catGeometry, &cat->lod, cat->position, cat->size, viewMatrix, projectionMatrix);
+	queueMeshLod(catGeometry, lod, transform, cat->position);
+}
+
+/**
+*	Returns true if the driver can read vertex attributes per instance (OpenGL 3.3).
+*	Otherwise instances are drawn one by one with the per instance attributes set as constant vertex attributes.
+*/
+static bool instancedArraysSupported() {
+	static int supported = -1;
+
+	if (supported < 0) {
+		GLint major = 0, minor = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &major);
+		glGetIntegerv(GL_MINOR_VERSION, &minor);
+		supported = (major > 3 || (major == 3 && minor >= 3)) ? 1 : 0;
+	}
+
+	return supported == 1;
+}
+
+/**
+*	Connects instances in the instance buffer object to the per instance attributes of the bound vao.
+*	\param[in] instances              Instance buffer object.
+*	\param[in] firstInstance          Instance read by the first instance of a draw call.
+*	\param[in] instanceMatrixLocation Location of the model matrix attribute, its columns use 4 locations.
+*	The object IDs go to RENDER_OBJECT_ID_LOCATION, they replace the constant object ID of the render queue.
+*/
+static void setInstanceAttributes(GLuint instances, unsigned int firstInstance, GLint instanceMatrixLocation) {
+	const GLsizei stride = sizeof(MeshInstance);
+	const size_t offset = firstInstance * sizeof(MeshInstance);
+
+	glBindBuffer(GL_ARRAY_BUFFER, instances);
+
+	for (int column = 0; column < 4; column++) {
+		glEnableVertexAttribArray(instanceMatrixLocation + column);
+		glVertexAttribPointer(instanceMatrixLocation + column, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset + column * sizeof(glm::vec4)));
+		glVertexAttribDivisor(instanceMatrixLocation + column, 1);
+	}
+
+	glEnableVertexAttribArray(RENDER_OBJECT_ID_LOCATION);
+	glVertexAttribIPointer(RENDER_OBJECT_ID_LOCATION, 1, GL_UNSIGNED_INT, stride, (void*)(offset + offsetof(MeshInstance, objectId)));
+	glVertexAttribDivisor(RENDER_OBJECT_ID_LOCATION, 1);
+}
+
+/**
+*	Sets per instance attributes as constant vertex attributes, used when instanced arrays are not supported.
+*	The object ID is set by the render queue from the item.
+*/
+static void setConstantInstanceAttributes(const MeshInstance &instance, GLint instanceMatrixLocation) {
+	for (int column = 0; column < 4; column++)
+		glVertexAttrib4fv(instanceMatrixLocation + column, glm::value_ptr(instance.modelMatrix[column]));
+}
+
+/**
+*	Creates vertex arrays drawing the mesh with the per instance attributes.
+*	\param[in]  geometry  Mesh to draw, may be NULL if its loading failed.
+*	\param[out] instanced Instanced mesh, the instance buffer grows when it is filled.
+*/
+static void createInstancedMesh(const MeshGeometry *geometry, InstancedMesh *instanced) {
+
+	instanced->geometry = geometry;
+	instanced->instanceBufferObject = 0;
+	instanced->capacity = 0;
+	instanced->instances.clear();
+	for (unsigned int lod = 0; lod < MESH_MAX_LODS; lod++) {
+		instanced->lodVertexArrays[lod] = 0;
+		instanced->lodFirstInstance[lod] = 0;
+		instanced->lodNumInstances[lod] = 0;
+	}
+
+	if (geometry == NULL)
+		return;
+
+	glGenBuffers(1, &instanced->instanceBufferObject);
+
+	// one vao per level of detail, its instance attributes point to the instances of the level
+	glGenVertexArrays(geometry->numLods, instanced->lodVertexArrays);
+
+	for (unsigned int lod = 0; lod < geometry->numLods; lod++) {
+		glBindVertexArray(instanced->lodVertexArrays[lod]);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry->elementBufferObject);
+		glBindBuffer(GL_ARRAY_BUFFER, geometry->vertexBufferObject);
+		setVertexFormatAttributes(geometry->vertexFormat, instancedShaderProgram.posLocation, instancedShaderProgram.normalLocation, instancedShaderProgram.texCoordLocation);
+	}
 
 	glBindVertexArray(0);
-	glUseProgram(0);
 	CHECK_GL_ERROR();
 }
 
 /**
-*	Draws Swarm
-*	\param[in] Swarm Object to draw
+*	Deletes buffers of the instanced mesh, its geometry is not deleted.
+*/
+static void deleteInstancedMesh(InstancedMesh *instanced) {
+
+	if (instanced->geometry != NULL) {
+		glDeleteVertexArrays(instanced->geometry->numLods, instanced->lodVertexArrays);
+		glDeleteBuffers(1, &instanced->instanceBufferObject);
+	}
+
+	instanced->geometry = NULL;
+	instanced->instances.clear();
+}
+
+/**
+*	Sets material uniforms of the instanced render item for its variant of instancedShaderProgram, matrices are per instance.
+*	\param[in] item Item with the material and the variant, the model matrix is used only without instanced arrays.
 *	\param[in] viewMatrix
 *	\param[in] projectionMatrix
 */
-void drawSwarm(SwarmObject* swarm, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix) {
-	glUseProgram(shaderProgram.program);
+static void setInstancedItemUniforms(const RenderItem &item, const glm::mat4 & /*viewMatrix*/, const glm::mat4 & /*projectionMatrix*/) {
+	const MeshGeometryMaterial *material = item.material;
+	const SCommonShaderProgram &shader = *item.shader;
 
-	glm::mat4 modelMatrix = alignObject(swarm->position, swarm->direction, glm::vec3(0.0f, 0.0f, 1.0f));
-	modelMatrix = glm::scale(modelMatrix, glm::vec3(swarm->size));
-	CHECK_GL_ERROR();
+	setMaterialColorUniforms(shader, material->ambient, material->diffuse, material->specular, material->shininess);
+	glUniform1i(shader.texSamplerLocation, 0);
 
-	setTransformUniforms(modelMatrix, viewMatrix, projectionMatrix);
+	if (!instancedArraysSupported()) {
+		MeshInstance instance;
+		instance.modelMatrix = item.modelMatrix;
+		setConstantInstanceAttributes(instance, instancedShaderProgram.instanceMatrixLocation);
+	}
+}
 
-	setMaterialUniforms(
-		swarmGeometry->ambient,
-		swarmGeometry->diffuse,
-		swarmGeometry->specular,
-		swarmGeometry->shininess,
-		swarmGeometry->texture
-		);
+/**
+*	Draws boxes inside the view frustum and not hidden behind the occluders, one instanced draw call
+*	per level of detail and material.
+*	\param[in] boxes List of BoxObject
+*	\param[in] viewMatrix
+*	\param[in] projectionMatrix
+*/
+void drawBoxes(const std::vector<void*> &boxes, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix) {
+
+	InstancedMesh *instanced = &boxInstances;
+	const MeshGeometry *geometry = instanced->geometry;
+	const unsigned int numBoxes = (unsigned int)boxes.size();
+
+	instanced->instances.clear();
+	for (unsigned int lod = 0; lod < MESH_MAX_LODS; lod++)
+		instanced->lodNumInstances[lod] = 0;
+
+	if (geometry == NULL || numBoxes == 0)
+		return;
+
+	// translate * scale * rotate(90, x)
+	const glm::vec3 front(0.0f, 1.0f, 0.0f), up(0.0f, 0.0f, 1.0f);
+
+	// cull spheres around the boxes in SIMD batches
+	clearTransforms(&boxTransforms);
+	for (unsigned int i = 0; i < numBoxes; i++) {
+		const BoxObject *box = (const BoxObject*)boxes[i];
+		addTransform(&boxTransforms, box->position, front, up, box->size);
+	}
+	const float radius = boundingRadius(geometry->bounds);
+	boxVisible.resize(numBoxes);
+	const unsigned int numInFrustum = cullTransforms(renderFrustum(), boxTransforms, radius, &boxVisible[0]);
+	renderStats.totalObjects += numBoxes;
+
+	if (numInFrustum == 0)
+		return;
+
+	// sort the visible instances by their level of detail, the model matrices are computed in SIMD batches
+	float pixelScale = lodPixelScale(projectionMatrix);
+	clearTransforms(&visibleBoxTransforms);
+	visibleBoxes.clear();
+	for (unsigned int i = 0; i < numBoxes; i++) {
+		if (!boxVisible[i])
+			continue;
+		BoxObject *box = (BoxObject*)boxes[i];
+		if (boxOccluded(box->position, glm::vec3(radius * box->size))) {
+			renderStats.occludedObjects++;
+			continue;
+		}
+		int lod = selectMeshLod(geometry, &box->lod, box->position, box->size, viewMatrix, pixelScale);
+		instanced->lodNumInstances[lod]++;
+		addTransform(&visibleBoxTransforms, box->position, front, up, box->size);
+		visibleBoxes.push_back(i);
+	}
+	const unsigned int numVisible = (unsigned int)visibleBoxes.size();
+	renderStats.visibleObjects += numVisible;
+
+	if (numVisible == 0)
+		return;
+
+	boxModelMatrices.resize(numVisible);
+	computeTransforms(visibleBoxTransforms, viewMatrix, &boxModelMatrices[0], NULL);
+
+	unsigned int next[MESH_MAX_LODS];
+	unsigned int firstInstance = 0;
+	for (unsigned int lod = 0; lod < geometry->numLods; lod++) {
+		instanced->lodFirstInstance[lod] = firstInstance;
+		next[lod] = firstInstance;
+		firstInstance += instanced->lodNumInstances[lod];
+	}
 
+	instanced->instances.resize(numVisible);
+	for (unsigned int v = 0; v < numVisible; v++) {
+		const BoxObject *box = (const BoxObject*)boxes[visibleBoxes[v]];
+		MeshInstance *instance = &instanced->instances[next[box->lod]++];
+		instance->modelMatrix = boxModelMatrices[v];
+		PickHandle handle = { PICK_BOX, box->id };
+		instance->objectId = packPickHandle(handle);
+	}
 
-	CHECK_GL_ERROR();
-	glBindVertexArray(swarmGeometry->vertexArrayObject);
-	glDrawElements(GL_TRIANGLES, swarmGeometry->numTriangles * 3, GL_UNSIGNED_INT, 0);
+	const bool instancedArrays = instancedArraysSupported();
+	if (instancedArrays) {
+		// orphan the buffer, the driver does not wait for the draw calls of the previous frame
+		glBindBuffer(GL_ARRAY_BUFFER, instanced->instanceBufferObject);
+		if (numVisible > instanced->capacity)
+			instanced->capacity = std::max(numVisible, 2 * instanced->capacity);
+		glBufferData(GL_ARRAY_BUFFER, instanced->capacity * sizeof(MeshInstance), NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, numVisible * sizeof(MeshInstance), &instanced->instances[0]);
+
+		for (unsigned int lod = 0; lod < geometry->numLods; lod++) {
+			if (instanced->lodNumInstances[lod] == 0)
+				continue;
+			glBindVertexArray(instanced->lodVertexArrays[lod]);
+			setInstanceAttributes(instanced->instanceBufferObject, instanced->lodFirstInstance[lod],
+				instancedShaderProgram.instanceMatrixLocation);
+		}
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		CHECK_GL_ERROR();
+	}
 
-	glBindVertexArray(0);
-	glUseProgram(0);
-	CHECK_GL_ERROR();
+	// instanced items are spread over the whole scene, they are sorted as if they were at the origin
+	size_t numMaterials = geometry->materials.size();
+	for (unsigned int lod = 0; lod < geometry->numLods; lod++) {
+		unsigned int numInstances = instanced->lodNumInstances[lod];
+		if (numInstances == 0)
+			continue;
+
+		for (size_t m = 0; m < numMaterials; m++) {
+			const MeshDrawRange &range = geometry->drawRanges[lod * numMaterials + m];
+			const MeshGeometryMaterial &material = geometry->materials[m];
+
+			if (range.numTriangles == 0)
+				continue;
+
+			// without instanced arrays every instance is an item with its matrix
+			unsigned int numItems = instancedArrays ? 1 : numInstances;
+			for (unsigned int i = 0; i < numItems; i++) {
+				const MeshInstance &instance = instanced->instances[instanced->lodFirstInstance[lod] + i];
+
+				RenderItem *item = pushRenderItem(instancedArrays ? glm::vec3(0.0f) : glm::vec3(instance.modelMatrix[3]));
+				item->shader = commonShaderVariant(&instancedShaderVariants, material.texture != 0);
+				item->program = item->shader->program;
+				item->vertexArrayObject = instanced->lodVertexArrays[lod];
+				item->texture = material.texture;
+				item->indexType = geometry->indexType;
+				item->first = 3 * range.firstTriangle;
+				item->baseVertex = geometry->bufferRange.baseVertex;
+				item->count = 3 * range.numTriangles;
+				item->instanceCount = instancedArrays ? numInstances : 1;
+				item->fullDetailTriangles = geometry->drawRanges[m].numTriangles * item->instanceCount;
+				item->setUniforms = setInstancedItemUniforms;
+				item->modelMatrix = instance.modelMatrix;
+				item->material = &material;
+				item->objectId = instancedArrays ? 0 : instance.objectId;
+			}
+		}
+	}
 }
 
 /**
-*	Draws Cat
-*	\param[in] Cat Object to draw
-*	\param[in] viewMatrix
-*	\param[in] projectionMatrix
+*	Adds the object with the pose to the scene of the pick, objects without a loaded mesh are skipped.
 */
-void drawCat(CatObject* cat, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix) {
-	glUseProgram(shaderProgram.program);
+static void addPosePickObject(PickScene *scene, int type, unsigned int id, const MeshGeometry *geometry,
+	const glm::vec3 &position, const glm::vec3 &front, const glm::vec3 &up, float size) {
 
-	glm::mat4 modelMatrix = alignObject(cat->position, cat->direction, glm::vec3(0.0f, 0.0f, 1.0f));
-	modelMatrix = glm::scale(modelMatrix, glm::vec3(cat->size));
-	CHECK_GL_ERROR();
-
-	setTransformUniforms(modelMatrix, viewMatrix, projectionMatrix);
-
-	setMaterialUniforms(
-		catGeometry->ambient,
-		catGeometry->diffuse,
-		catGeometry->specular,
-		catGeometry->shininess,
-		catGeometry->texture
-		);
+	if (geometry == NULL || size <= 0.0f)
+		return;
 
-
-	CHECK_GL_ERROR();
-	glBindVertexArray(catGeometry->vertexArrayObject);
-	glDrawElements(GL_TRIANGLES, catGeometry->numTriangles * 3, GL_UNSIGNED_INT, 0);
-
-	glBindVertexArray(0);
-	glUseProgram(0);
-	CHECK_GL_ERROR();
+	PickHandle handle = { type, id };
+	addPickObject(scene, handle, &geometry->pickMesh, geometry->bounds, poseMatrix(position, front, up, size));
 }
 
 /**
-*	Draws Box
-*	\param[in] Box Object to draw
+*	Returns the object at the pixel, the nearest triangle hit by the ray through the pixel wins.
+*	The pickable objects are collected into a new hierarchy every call, so objects moved or
+*	removed since the last frame are picked where they are now.
+*	\param[in] boxes            List of BoxObject, they are identified by their id.
+*	\param[in] cat              Cat, skipped when it already has been clicked away.
+*	\param[in] lamp             Lamp
+*	\param[in] lamps            List of LampObject around the compound.
+*	\param[in] x                Horizontal window coordinate of the pixel.
+*	\param[in] y                Vertical window coordinate of the pixel, from the bottom.
+*	\param[in] windowWidth      Width of the window.
+*	\param[in] windowHeight     Height of the window.
 *	\param[in] viewMatrix
 *	\param[in] projectionMatrix
+*	\return Handle of the picked object, type PICK_NONE if the ray hits nothing.
 */
-void drawBox(BoxObject* box, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix) {
-	
-	glUseProgram(shaderProgram.program);
-
-	glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), box->position);
-	modelMatrix = glm::scale(modelMatrix, glm::vec3(box->size));
-	modelMatrix = glm::rotate(modelMatrix, 90.0f, glm::vec3(1, 0, 0));
-
-	// setting matrices to the vertex & fragment shader
-	setTransformUniforms(modelMatrix, viewMatrix, projectionMatrix);
-	setMaterialUniforms(
-		boxGeometry->ambient,
-		boxGeometry->diffuse,
-		boxGeometry->specular,
-		boxGeometry->shininess,
-		boxGeometry->texture
-		);
+PickHandle pickObject(const std::vector<void*> &boxes, CatObject* cat, LampObject* lamp, const std::vector<void*> &lamps,
+	int x, int y, int windowWidth, int windowHeight, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix) {
 
-	glBindVertexArray(boxGeometry->vertexArrayObject);
-	glDrawElements(GL_TRIANGLES, boxGeometry->numTriangles * 3, GL_UNSIGNED_INT, 0);
+	static PickScene scene;
 
-	glBindVertexArray(0);
-	glUseProgram(0);
+	const glm::vec3 front(0.0f, 1.0f, 0.0f), up(0.0f, 0.0f, 1.0f);
+
+	clearPickScene(&scene);
+	for (std::vector<void*>::const_iterator it = boxes.begin(); it != boxes.end(); ++it) {
+		const BoxObject *box = (const BoxObject*)(*it);
+		addPosePickObject(&scene, PICK_BOX, box->id, boxGeometry, box->position, front, up, box->size);
+	}
+	addPosePickObject(&scene, PICK_CAT, 0, catGeometry, cat->position, cat->direction, up, cat->size);
+	addPosePickObject(&scene, PICK_LAMP, 0, lampGeometry, lamp->position, front, up, lamp->size);
+	for (unsigned int i = 0; i < lamps.size(); i++) {
+		const LampObject *compoundLamp = (const LampObject*)lamps[i];
+		addPosePickObject(&scene, PICK_LAMP, i + 1, lampGeometry, compoundLamp->position, front, up, compoundLamp->size);
+	}
+	buildPickHierarchy(&scene);
+
+	glm::vec3 origin, direction;
+	pickRay(x, y, windowWidth, windowHeight, viewMatrix, projectionMatrix, &origin, &direction);
+
+	return pickScene(scene, origin, direction);
 }
 
 /**
@@ -602,43 +1344,22 @@ void drawBox(BoxObject* box, const glm::mat4 & viewMatrix, const glm::mat4 & pro
 *	\param[in] projectionMatrix
 */
 void drawLamp(LampObject* lamp, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix) {
-	
-	glUseProgram(shaderProgram.program);
-
-	glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), lamp->position);
-	modelMatrix = glm::scale(modelMatrix, glm::vec3(lamp->size));
-	modelMatrix = glm::rotate(modelMatrix, 90.0f, glm::vec3(1, 0, 0));
-
-	setTransformUniforms(modelMatrix, viewMatrix, projectionMatrix);
-	setMaterialUniforms(
-		lampGeometry->ambient,
-		lampGeometry->diffuse,
-		lampGeometry->specular,
-		lampGeometry->shininess,
-		lampGeometry->texture
-		);
 
-	glUniform1i(shaderProgram.texSamplerLocation, 0);
-	
-	glBindVertexArray(lampGeometry->vertexArrayObject);
-	glDrawElements(GL_TRIANGLES, lampGeometry->numTriangles * 3, GL_UNSIGNED_INT, 0);
+	// translate * scale * rotate(90, x)
+	const glm::vec3 front(0.0f, 1.0f, 0.0f), up(0.0f, 0.0f, 1.0f);
+	if (!meshVisible(lampGeometry, lamp->position, front, up, lamp->size))
+		return;
 
-	glBindVertexArray(0);
-	glUseProgram(0);
+	int transform = addRenderTransform(lamp->position, front, up, lamp->size);
+
+	int lod = selectMeshLod(lampGeometry, &lamp->lod, lamp->position, lamp->size, viewMatrix, projectionMatrix);
+	queueMeshLod(lampGeometry, lod, transform, lamp->position);
 }
 
 /**
-*	Draws Explosion
-*	\param[in] Explosion Object to draw
-*	\param[in] viewMatrix
-*	\param[in] projectionMatrix
+*	Returns matrix rotating a billboard at the position to face the camera.
 */
-void drawExplosion(ExplosionObject* explosion, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix) {
-
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_ONE, GL_ONE);
-
-	glUseProgram(explosionShaderProgram.program);
+static glm::mat4 billboardMatrix(const glm::vec3 &position, float size, const glm::mat4 & viewMatrix) {
 
 	// just take rotation part of the view transform
 	glm::mat4 billboardRotationMatrix = glm::mat4(
@@ -650,113 +1371,218 @@ void drawExplosion(ExplosionObject* explosion, const glm::mat4 & viewMatrix, con
 	// inverse view rotation
 	billboardRotationMatrix = glm::transpose(billboardRotationMatrix);
 
-	glm::mat4 matrix = glm::translate(glm::mat4(1.0f), explosion->position);
-	matrix = glm::scale(matrix, glm::vec3(explosion->size));
-	matrix = matrix*billboardRotationMatrix; // make billboard to face the camera
+	glm::mat4 matrix = glm::translate(glm::mat4(1.0f), position);
+	matrix = glm::scale(matrix, glm::vec3(size));
+	return matrix*billboardRotationMatrix; // make billboard to face the camera
+}
 
-	glm::mat4 PVMmatrix = projectionMatrix * viewMatrix * matrix;
-	glUniformMatrix4fv(explosionShaderProgram.PVMmatrixLocation, 1, GL_FALSE, glm::value_ptr(PVMmatrix));  // model-view-projection
-	glUniformMatrix4fv(explosionShaderProgram.VmatrixLocation, 1, GL_FALSE, glm::value_ptr(viewMatrix));   // view
-	glUniform1f(explosionShaderProgram.timeLocation, explosion->currentTime - explosion->startTime);
+/**
+*	Sets uniforms of the explosion render item, params[0] is the elapsed time.
+*	Without instanced arrays the item draws one billboard, modelMatrix[0] is its center and half size
+*	and modelMatrix[1] its start time and frame duration.
+*/
+static void setExplosionItemUniforms(const RenderItem &item, const glm::mat4 & /*viewMatrix*/, const glm::mat4 & /*projectionMatrix*/) {
+	glUniform1f(explosionShaderProgram.timeLocation, item.params[0]);
 	glUniform1i(explosionShaderProgram.texSamplerLocation, 0);
-	glUniform1f(explosionShaderProgram.frameDurationLocation, explosion->frameDuration);
 
-	glBindVertexArray(explosionGeometry->vertexArrayObject);
-	glBindTexture(GL_TEXTURE_2D, explosionGeometry->texture);
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, explosionGeometry->numTriangles);
+	if (!instancedArraysSupported()) {
+		glVertexAttrib4fv(explosionShaderProgram.instanceLocation, glm::value_ptr(item.modelMatrix[0]));
+		glVertexAttrib2f(explosionShaderProgram.instanceTimeLocation, item.modelMatrix[1].x, item.modelMatrix[1].y);
+	}
+}
 
-	glBindVertexArray(0);
-	glUseProgram(0);
+/**
+*	Draws explosions inside the view frustum by one instanced draw call, additive blending without
+*	the depth test, so the billboards need no sorting.
+*	\param[in] pool Live explosions.
+*	\param[in] time Elapsed time, selects the animation frame of each explosion.
+*/
+void drawExplosions(const ExplosionPool &pool, float time) {
+
+	explosionInstances.clear();
+	renderStats.totalObjects += pool.count;
 
-	glDisable(GL_BLEND);
+	if (explosionGeometry == NULL || pool.count == 0)
+		return;
+
+	const Frustum &frustum = renderFrustum();
+	const float radius = boundingRadius(explosionGeometry->bounds);
+
+	for (unsigned int i = 0; i < pool.count; i++) {
+		glm::vec3 position(pool.positionX[i], pool.positionY[i], pool.positionZ[i]);
+		if (!sphereInFrustum(frustum, position, pool.size[i] * radius))
+			continue;
+
+		ExplosionInstance instance;
+		instance.positionSize = glm::vec4(position, pool.size[i]);
+		instance.startTime = pool.startTime[i];
+		instance.frameDuration = pool.frameDuration[i];
+		explosionInstances.push_back(instance);
+	}
+	const unsigned int numVisible = (unsigned int)explosionInstances.size();
+	renderStats.visibleObjects += numVisible;
+
+	if (numVisible == 0)
+		return;
+
+	const bool instancedArrays = instancedArraysSupported();
+	if (instancedArrays) {
+		// orphan the buffer, the driver does not wait for the draw call of the previous frame
+		glBindBuffer(GL_ARRAY_BUFFER, explosionInstanceBuffer);
+		if (numVisible > explosionInstanceCapacity)
+			explosionInstanceCapacity = std::max(numVisible, 2 * explosionInstanceCapacity);
+		glBufferData(GL_ARRAY_BUFFER, explosionInstanceCapacity * sizeof(ExplosionInstance), NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, numVisible * sizeof(ExplosionInstance), &explosionInstances[0]);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		CHECK_GL_ERROR();
+	}
+
+	// without instanced arrays every billboard is an item with its own attributes
+	unsigned int numItems = instancedArrays ? 1 : numVisible;
+	for (unsigned int i = 0; i < numItems; i++) {
+		const ExplosionInstance &instance = explosionInstances[i];
+
+		RenderItem *item = pushRenderItem(instancedArrays ? glm::vec3(0.0f) : glm::vec3(instance.positionSize));
+		item->program = explosionShaderProgram.program;
+		item->vertexArrayObject = explosionGeometry->vertexArrayObject;
+		item->texture = explosionGeometry->texture;
+		item->layer = RENDER_LAYER_BLENDED;
+		item->blendMode = RENDER_BLEND_ADDITIVE;
+		item->depthTest = false;
+		item->primitive = GL_TRIANGLE_STRIP;
+		item->count = explosionGeometry->numTriangles;
+		item->instanceCount = instancedArrays ? numVisible : 1;
+		item->fullDetailTriangles = (explosionGeometry->numTriangles - 2) * item->instanceCount;
+		item->setUniforms = setExplosionItemUniforms;
+		item->modelMatrix[0] = instance.positionSize;
+		item->modelMatrix[1] = glm::vec4(instance.startTime, instance.frameDuration, 0.0f, 0.0f);
+		item->params[0] = time;
+	}
 }
 
 /**
-*	Draws Ufo
-*	\param[in] Explosion Object to draw
-*	\param[in] viewMatrix
-*	\param[in] projectionMatrix
+*	Draws all particles by one instanced draw call. Sparks are added, debris and smoke are blended,
+*	both by the premultiplied alpha of one blend mode. Needs instanced arrays (OpenGL 3.3).
+*	\param[in] particles Live particles.
 */
-void drawUfo(UfoObject* ufo, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix) {
+void drawParticles(const ParticleSystem &particles) {
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	const unsigned int numParticles = particles.count;
 
-	glUseProgram(ufoShaderProgram.program);
+	if (particleGeometry == NULL || particleInstanceBuffer == 0 || numParticles == 0)
+		return;
 
-	// just take rotation part of the view transform
-	glm::mat4 billboardRotationMatrix = glm::mat4(
-		viewMatrix[0],
-		viewMatrix[1],
-		viewMatrix[2],
-		glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)
-		);
-	// inverse view rotation
-	billboardRotationMatrix = glm::transpose(billboardRotationMatrix);
+	// orphan the buffer and let the workers write the billboards directly into it
+	glBindBuffer(GL_ARRAY_BUFFER, particleInstanceBuffer);
+	if (numParticles > particleInstanceCapacity)
+		particleInstanceCapacity = std::max(numParticles, 2 * particleInstanceCapacity);
+	glBufferData(GL_ARRAY_BUFFER, particleInstanceCapacity * sizeof(ParticleInstance), NULL, GL_STREAM_DRAW);
 
-	glm::mat4 matrix = glm::translate(glm::mat4(1.0f), ufo->position);
-	matrix = glm::scale(matrix, glm::vec3(ufo->size));
-	matrix = matrix*billboardRotationMatrix;
+	void *instances = glMapBufferRange(GL_ARRAY_BUFFER, 0, numParticles * sizeof(ParticleInstance), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (instances == NULL) {
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		std::cerr << "drawParticles(): instance buffer mapping failed" << std::endl;
+		return;
+	}
+	writeParticleInstances(particles, (ParticleInstance*)instances);
+	bool written = glUnmapBuffer(GL_ARRAY_BUFFER) == GL_TRUE;
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	CHECK_GL_ERROR();
+
+	// the buffer contents are undefined when the driver lost them
+	if (!written)
+		return;
+
+	RenderItem *item = pushRenderItem(glm::vec3(0.0f));
+	item->program = particleShaderProgram.program;
+	item->vertexArrayObject = particleGeometry->vertexArrayObject;
+	item->layer = RENDER_LAYER_BLENDED;
+	item->blendMode = RENDER_BLEND_PREMULTIPLIED;
+	item->primitive = GL_TRIANGLE_STRIP;
+	item->count = particleGeometry->numTriangles;
+	item->instanceCount = numParticles;
+	item->fullDetailTriangles = (particleGeometry->numTriangles - 2) * numParticles;
+}
 
-	glm::mat4 PVMmatrix = projectionMatrix * viewMatrix * matrix;
+/**
+*	Sets uniforms of the ufo render item, params[0] is the animation time.
+*/
+static void setUfoItemUniforms(const RenderItem &item, const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix) {
+	glm::mat4 PVMmatrix = projectionMatrix * viewMatrix * item.modelMatrix;
 	glUniformMatrix4fv(ufoShaderProgram.PVMmatrixLocation, 1, GL_FALSE, glm::value_ptr(PVMmatrix));  // model-view-projection
-	glUniform1f(ufoShaderProgram.timeLocation, (*ufo).time);
+	glUniform1f(ufoShaderProgram.timeLocation, item.params[0]);
 	glUniform1i(ufoShaderProgram.texSamplerLocation, 0);
-
-	glBindVertexArray(ufoGeometry->vertexArrayObject);
-	glBindTexture(GL_TEXTURE_2D, ufoGeometry->texture);
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, ufoGeometry->numTriangles);
-
-	glBindVertexArray(0);
-	glUseProgram(0);
-
-	glDisable(GL_BLEND);
 }
 
 /**
-*	Draws skybox
+*	Draws Ufo, alpha blended
+*	\param[in] Explosion Object to draw
 *	\param[in] viewMatrix
-*	\param[in] projectionMatrix
 */
-void drawSkybox(const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix) {
-
-	glUseProgram(skyboxShaderProgram.program);
-
-	glm::mat4 modelMatrix = alignObject(glm::vec3(0.0f, 0.0f, 0.05f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-	modelMatrix = glm::rotate(modelMatrix, -90.f, glm::vec3(1, 0, 0));
-	modelMatrix = glm::scale(modelMatrix, glm::vec3(2.2f));
+void drawUfo(UfoObject* ufo, const glm::mat4 & viewMatrix) {
+
+	if (!billboardVisible(ufoGeometry, ufo->position, ufo->size))
+		return;
+
+	RenderItem *item = pushRenderItem(ufo->position);
+	item->program = ufoShaderProgram.program;
+	item->vertexArrayObject = ufoGeometry->vertexArrayObject;
+	item->texture = ufoGeometry->texture;
+	item->layer = RENDER_LAYER_BLENDED;
+	item->blendMode = RENDER_BLEND_ALPHA;
+	item->primitive = GL_TRIANGLE_STRIP;
+	item->count = ufoGeometry->numTriangles;
+	item->fullDetailTriangles = ufoGeometry->numTriangles - 2;
+	item->setUniforms = setUfoItemUniforms;
+	item->modelMatrix = billboardMatrix(ufo->position, ufo->size, viewMatrix);
+	item->params[0] = (*ufo).time;
+}
 
+/**
+*	Sets uniforms of the skybox render item, the skybox follows the camera.
+*/
+static void setSkyboxItemUniforms(const RenderItem &item, const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix) {
 	glm::mat4 viewWithoutTranslation = viewMatrix;
 	viewWithoutTranslation[3] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
 
-	glm::mat4 PVM = projectionMatrix * viewWithoutTranslation *modelMatrix;
-	//glUniformMatrix4fv(skyboxShaderProgram.MmatrixLocation, 1, GL_FALSE, glm::value_ptr(modelMatrix));
-	//glUniformMatrix4fv(skyboxShaderProgram.VmatrixLocation, 1, GL_FALSE, glm::value_ptr(viewMatrix));
+	glm::mat4 PVM = projectionMatrix * viewWithoutTranslation * item.modelMatrix;
 	glUniformMatrix4fv(skyboxShaderProgram.PVMmatrixLocation, 1, GL_FALSE, glm::value_ptr(PVM));
 	glUniform1i(skyboxShaderProgram.skyboxSamplerLocation, 0);
-	CHECK_GL_ERROR();
+}
 
-	
-	CHECK_GL_ERROR();
+/**
+*	Draws skybox after all opaque objects, so it is shaded only where nothing covers it.
+*	The skybox surrounds the camera, it is never culled.
+*/
+void drawSkybox() {
 
-	glBindVertexArray(skyboxGeometry->vertexArrayObject);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxGeometry->texture);
-	glDrawElements(GL_TRIANGLES, skyboxGeometry->numTriangles * 3, GL_UNSIGNED_INT, 0);
-	CHECK_GL_ERROR();
+	glm::mat4 modelMatrix = alignObject(glm::vec3(0.0f, 0.0f, 0.05f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	modelMatrix = glm::rotate(modelMatrix, -90.f, glm::vec3(1, 0, 0));
+	modelMatrix = glm::scale(modelMatrix, glm::vec3(2.2f));
 
-	glBindVertexArray(0);
-	glUseProgram(0);
+	RenderItem *item = pushRenderItem(glm::vec3(0.0f));
+	item->program = skyboxShaderProgram.program;
+	item->vertexArrayObject = skyboxGeometry->vertexArrayObject;
+	item->texture = skyboxGeometry->texture;
+	item->textureTarget = GL_TEXTURE_CUBE_MAP;
+	item->layer = RENDER_LAYER_SKY;
+	item->indexType = skyboxGeometry->indexType;
+	item->count = 3 * skyboxGeometry->numTriangles;
+	item->fullDetailTriangles = skyboxGeometry->numTriangles;
+	item->setUniforms = setSkyboxItemUniforms;
+	item->modelMatrix = modelMatrix;
 }
 
 /**
 *	Initializes floor geometry.
 *	\param[in] shader	Used shader program.
+*	\param[in] texture	Floor texture, the geometry takes over the reference.
 *	\param[in] geometry Geometry object for a floor.
 */
-void initFloorGeometry(SCommonShaderProgram &shader, MeshGeometry **geometry) {
+void initFloorGeometry(SCommonShaderProgram &shader, GLuint texture, MeshGeometry **geometry) {
 
-	*geometry = new MeshGeometry;
-	(*geometry)->texture = pgr::createTexture(FLOOR_TEXTURE_NAME);
+	*geometry = new MeshGeometry();
+	(*geometry)->texture = 0;
 
 	glGenVertexArrays(1, &((*geometry)->vertexArrayObject));		//VAO
 	glBindVertexArray((*geometry)->vertexArrayObject);
@@ -772,7 +1598,7 @@ void initFloorGeometry(SCommonShaderProgram &shader, MeshGeometry **geometry) {
 	glVertexAttribPointer(shader.normalLocation, 3, GL_FLOAT, GL_FALSE, 11 * sizeof(float), (void*)(6 * sizeof(float)));
 	CHECK_GL_ERROR();
 	
-	glBindTexture(GL_TEXTURE_2D, (*geometry)->texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
@@ -785,24 +1611,33 @@ void initFloorGeometry(SCommonShaderProgram &shader, MeshGeometry **geometry) {
 	glVertexAttribPointer(shader.texCoordLocation, 2, GL_FLOAT, GL_FALSE, 11 * sizeof(float), (void*)(9 * sizeof(float)));
 
 
-	(*geometry)->ambient = glm::vec3(0.6f, 0.6f, 0.6f);
-	(*geometry)->diffuse = glm::vec3(0.7f, 0.7f, 0.7f);
-	(*geometry)->specular = glm::vec3(0.02f, 0.02f, 0.02f);
-	(*geometry)->shininess = 0.9f;
+	(*geometry)->materials.resize(1);
+	(*geometry)->materials[0].ambient = glm::vec3(0.6f, 0.6f, 0.6f);
+	(*geometry)->materials[0].diffuse = glm::vec3(0.7f, 0.7f, 0.7f);
+	(*geometry)->materials[0].specular = glm::vec3(0.02f, 0.02f, 0.02f);
+	(*geometry)->materials[0].shininess = 0.9f;
+	(*geometry)->materials[0].texture = texture;
+	(*geometry)->materials[0].textureArray = -1;
+	(*geometry)->materials[0].textureLayer = 0;
 
 	glBindVertexArray(0);
+	(*geometry)->numVertices = 3 * FLOOR_TRIANGLES;
+	(*geometry)->vertexFormat = MESH_FORMAT_FLOAT;
+	(*geometry)->indexType = GL_UNSIGNED_INT;
 	(*geometry)->numTriangles = FLOOR_TRIANGLES;
+	computeMeshBounds(Floor, 3 * FLOOR_TRIANGLES, 11, &(*geometry)->bounds);
 }
 
 /**
 *	Initializes explosion geometry.
 *	\param[in] shader	Used shader program.
+*	\param[in] texture	Explosion texture, the geometry takes over the reference.
 *	\param[in] geometry Geometry object for a floor.
 */
-void initExplosionGeometry(GLuint shader, MeshGeometry **geometry) {
+void initExplosionGeometry(GLuint shader, GLuint texture, MeshGeometry **geometry) {
 
-	*geometry = new MeshGeometry;
-	(*geometry)->texture = pgr::createTexture(EXPLOSION_TEXTURE_NAME);
+	*geometry = new MeshGeometry();
+	(*geometry)->texture = texture;
 
 	glGenVertexArrays(1, &((*geometry)->vertexArrayObject));
 	glBindVertexArray((*geometry)->vertexArrayObject);
@@ -811,7 +1646,7 @@ void initExplosionGeometry(GLuint shader, MeshGeometry **geometry) {
 	glBindBuffer(GL_ARRAY_BUFFER, (*geometry)->vertexBufferObject);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(explosionVertexData), explosionVertexData, GL_STATIC_DRAW);
 
-	glEnableVertexAttribArray(ufoShaderProgram.posLocation);
+	glEnableVertexAttribArray(explosionShaderProgram.posLocation);
 	// vertices of triangles - start at the beginning of the array (interlaced array)
 	glVertexAttribPointer(explosionShaderProgram.posLocation, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), 0);
 
@@ -819,20 +1654,97 @@ void initExplosionGeometry(GLuint shader, MeshGeometry **geometry) {
 	// texture coordinates are placed just after the position of each vertex (interlaced array)
 	glVertexAttribPointer(explosionShaderProgram.texCoordLocation, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
 
+	// billboards of all explosions, filled by drawExplosions() every frame
+	if (instancedArraysSupported()) {
+		const GLsizei stride = sizeof(ExplosionInstance);
+
+		glGenBuffers(1, &explosionInstanceBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, explosionInstanceBuffer);
+		explosionInstanceCapacity = 0;
+
+		glEnableVertexAttribArray(explosionShaderProgram.instanceLocation);
+		glVertexAttribPointer(explosionShaderProgram.instanceLocation, 4, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(ExplosionInstance, positionSize));
+		glVertexAttribDivisor(explosionShaderProgram.instanceLocation, 1);
+
+		glEnableVertexAttribArray(explosionShaderProgram.instanceTimeLocation);
+		glVertexAttribPointer(explosionShaderProgram.instanceTimeLocation, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(ExplosionInstance, startTime));
+		glVertexAttribDivisor(explosionShaderProgram.instanceTimeLocation, 1);
+	}
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	(*geometry)->numVertices = explosionNumQuadVertices;
+	(*geometry)->vertexFormat = MESH_FORMAT_FLOAT;
+	(*geometry)->indexType = GL_UNSIGNED_INT;
+	(*geometry)->numTriangles = explosionNumQuadVertices;
+	computeMeshBounds(explosionVertexData, explosionNumQuadVertices, 5, &(*geometry)->bounds);
+}
+
+/**
+*	Initializes geometry of the particles, the quad of the explosions with the per instance attributes.
+*	Particles are not drawn without instanced arrays, the geometry stays NULL.
+*	\param[in] geometry Geometry object for the particles.
+*/
+static void initParticleGeometry(MeshGeometry **geometry) {
+
+	if (!instancedArraysSupported()) {
+		std::cout << "Particles are not drawn, instanced arrays are not supported" << std::endl;
+		*geometry = NULL;
+		return;
+	}
+
+	*geometry = new MeshGeometry();
+
+	glGenVertexArrays(1, &((*geometry)->vertexArrayObject));
+	glBindVertexArray((*geometry)->vertexArrayObject);
+
+	glGenBuffers(1, &((*geometry)->vertexBufferObject));
+	glBindBuffer(GL_ARRAY_BUFFER, (*geometry)->vertexBufferObject);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(explosionVertexData), explosionVertexData, GL_STATIC_DRAW);
+
+	// corners of the quad, the texture coordinates are not needed
+	glEnableVertexAttribArray(particleShaderProgram.posLocation);
+	glVertexAttribPointer(particleShaderProgram.posLocation, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), 0);
+
+	// billboards of all particles, filled by drawParticles() every frame
+	const GLsizei stride = sizeof(ParticleInstance);
+
+	glGenBuffers(1, &particleInstanceBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, particleInstanceBuffer);
+	particleInstanceCapacity = 0;
+
+	glEnableVertexAttribArray(particleShaderProgram.instanceLocation);
+	glVertexAttribPointer(particleShaderProgram.instanceLocation, 4, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(ParticleInstance, position));
+	glVertexAttribDivisor(particleShaderProgram.instanceLocation, 1);
+
+	glEnableVertexAttribArray(particleShaderProgram.instanceLifeLocation);
+	glVertexAttribPointer(particleShaderProgram.instanceLifeLocation, 1, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(ParticleInstance, life));
+	glVertexAttribDivisor(particleShaderProgram.instanceLifeLocation, 1);
+
+	glEnableVertexAttribArray(particleShaderProgram.instanceColorLocation);
+	glVertexAttribPointer(particleShaderProgram.instanceColorLocation, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)offsetof(ParticleInstance, color));
+	glVertexAttribDivisor(particleShaderProgram.instanceColorLocation, 1);
+
 	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
+	(*geometry)->numVertices = explosionNumQuadVertices;
+	(*geometry)->vertexFormat = MESH_FORMAT_FLOAT;
 	(*geometry)->numTriangles = explosionNumQuadVertices;
+	computeMeshBounds(explosionVertexData, explosionNumQuadVertices, 5, &(*geometry)->bounds);
 }
 
 /**
 *	Initializes ufo geometry.
 *	\param[in] shader	Used shader program.
+*	\param[in] texture	Ufo texture, the geometry takes over the reference.
 *	\param[in] geometry Geometry object for a floor.
 */
-void initUfoGeometry(GLuint shader, MeshGeometry **geometry) {
+void initUfoGeometry(GLuint shader, GLuint texture, MeshGeometry **geometry) {
 
-	*geometry = new MeshGeometry;
-	(*geometry)->texture = pgr::createTexture(UFO_TEXTURE_NAME);
+	*geometry = new MeshGeometry();
+	(*geometry)->texture = texture;
 
 	glGenVertexArrays(1, &((*geometry)->vertexArrayObject));
 	glBindVertexArray((*geometry)->vertexArrayObject);
@@ -853,16 +1765,22 @@ void initUfoGeometry(GLuint shader, MeshGeometry **geometry) {
 
 	glBindVertexArray(0);
 
+	(*geometry)->numVertices = ufoNumQuadVertices;
+	(*geometry)->vertexFormat = MESH_FORMAT_FLOAT;
+	(*geometry)->indexType = GL_UNSIGNED_INT;
 	(*geometry)->numTriangles = ufoNumQuadVertices;
+	computeMeshBounds(ufoVertexData, ufoNumQuadVertices, 5, &(*geometry)->bounds);
 }
 
 /**
 *	Initializes skybox geometry.
 *	\param[in] shader	Used shader program.
+*	\param[in] texture	Skybox cube map, the geometry takes over the reference.
 *	\param[in] geometry Geometry object for a skybox.
 */
-void initSkyboxGeometry(GLuint shader, MeshGeometry **geometry) {
-	*geometry = new MeshGeometry;
+void initSkyboxGeometry(GLuint shader, GLuint texture, MeshGeometry **geometry) {
+	*geometry = new MeshGeometry();
+	(*geometry)->texture = texture;
 
 	const float skycubeVertices[] = {
 		-1.0, 1.0, 1.0,	//0
@@ -891,29 +1809,6 @@ void initSkyboxGeometry(GLuint shader, MeshGeometry **geometry) {
 		6, 5, 1
 	};
 
-	glActiveTexture(GL_TEXTURE0);
-
-	glGenTextures(1, &((*geometry)->texture));
-	glBindTexture(GL_TEXTURE_CUBE_MAP, (*geometry)->texture);
-
-	const char * suffixes[] = { "bk", "ft", "lf", "rt", "up", "dn" };
-	GLuint targets[] = {
-		GL_TEXTURE_CUBE_MAP_POSITIVE_X, GL_TEXTURE_CUBE_MAP_NEGATIVE_X,
-		GL_TEXTURE_CUBE_MAP_POSITIVE_Y, GL_TEXTURE_CUBE_MAP_NEGATIVE_Y,
-		GL_TEXTURE_CUBE_MAP_POSITIVE_Z, GL_TEXTURE_CUBE_MAP_NEGATIVE_Z
-	};
-
-	for (int i = 0; i < 6; i++) {
-		std::string texName = std::string(SKYBOX_CUBE_TEXTURE_FILE_PREFIX) + "desertsky_" + suffixes[i] + ".jpg";
-		std::cout << "Loading cube map texture: " << texName << std::endl;
-		if (!pgr::loadTexImage2D(texName, targets[i])) {
-			pgr::dieWithError("Skybox cube map loading failed!");
-		}
-	}
-
-	glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
-	CHECK_GL_ERROR();
-
 	glGenVertexArrays(1, &((*geometry)->vertexArrayObject));		//VAO
 	glBindVertexArray((*geometry)->vertexArrayObject);
 
@@ -928,7 +1823,11 @@ void initSkyboxGeometry(GLuint shader, MeshGeometry **geometry) {
 	glVertexAttribPointer(skyboxShaderProgram.posLocation, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0);
 
 	CHECK_GL_ERROR();
+	skyboxGeometry->numVertices = 8;
+	skyboxGeometry->vertexFormat = MESH_FORMAT_FLOAT;
+	skyboxGeometry->indexType = GL_UNSIGNED_INT;
 	skyboxGeometry->numTriangles = 12;
+	computeMeshBounds(skycubeVertices, 8, 3, &skyboxGeometry->bounds);
 
 	glBindVertexArray(0);
 	glUseProgram(0);
@@ -936,97 +1835,412 @@ void initSkyboxGeometry(GLuint shader, MeshGeometry **geometry) {
 }
 
 /**
-*	Initialize vertex buffers and vertex arrays for all objects.
+*	struct for a model loaded by the loading pipeline
+*
 */
-void initializeModels() {
+typedef struct ModelLoadJob {
+	const char*    fileName;
+	const char*    name;
+	MeshGeometry** geometry;
+
+	MeshData       mesh;
+	bool           resident;  // geometry is shared from the asset registry, nothing to load
+	bool           loaded;
+	bool           cacheHit;
+} ModelLoadJob;
+
+/**
+*	struct for a texture loaded by the loading pipeline
+*
+*/
+typedef struct TextureLoad {
+	std::vector<std::string> files;     // source image of each face
+	std::vector<ImageData>   faces;     // decoded source images on a cache miss
+	CookedTexture            cooked;    // mapped cooked texture on a cache hit
+	bool                     cacheHit;
+} TextureLoad;
+
+/**
+*	struct for textures loaded by the loading pipeline
+*
+*/
+typedef struct TextureDecodeSet {
+	std::mutex                         mutex;
+	std::map<std::string, TextureLoad> textures;  // by canonical path, each file is loaded only once
+} TextureDecodeSet;
+
+/**
+*	Decodes source images of the texture.
+*/
+static void decodeTextureFaces(TextureLoad *load) {
+	load->faces.resize(load->files.size());
+	for (size_t i = 0; i < load->files.size(); i++)
+		decodeImage(load->files[i], &load->faces[i]);
+}
+
+/**
+*	Maps cooked texture or decodes its source images on a cache miss, runs on a worker thread.
+*	\param[in] name Path to the source image or name of the cube map.
+*	\param[in] load Texture to load, the source files have to be set.
+*/
+static void loadTextureJob(const std::string &name, TextureLoad *load) {
+
+	load->cacheHit = loadCookedTexture(name, load->files, &load->cooked);
+	if (!load->cacheHit)
+		decodeTextureFaces(load);
+}
+
+/**
+*	Loads image unless its texture is resident or another task has taken it, runs on a worker thread.
+*	\param[in] set      Loaded textures.
+*	\param[in] fileName Image file.
+*/
+static void decodeSharedImage(TextureDecodeSet *set, const std::string &fileName) {
+
+	if (fileName.empty() || isAssetResident(fileName))
+		return;
+
+	TextureLoad *load;
+	{
+		std::unique_lock<std::mutex> lock(set->mutex);
+		std::string key = canonicalAssetPath(fileName);
+		if (set->textures.find(key) != set->textures.end())
+			return;
+		load = &set->textures[key];
+		load->files.assign(1, fileName);
+	}
+
+	loadTextureJob(fileName, load);
+}
+
+/**
+*	Uploads loaded texture, textures missing in the cache are cooked first.
+*	\param[in] name Path to the source image or name of the cube map.
+*	\param[in] load Texture loaded by loadTextureJob().
+*	\return Texture with a reference owned by the caller or 0.
+*/
+static GLuint createLoadedTexture(const std::string &name, TextureLoad *load) {
+
+	GLuint texture = 0;
+	size_t gpuBytes = 0;
+
+	if (load->cacheHit)
+		texture = createCookedTexture(load->cooked, &gpuBytes);
+
+	// not cooked yet or cooked with the compressed format the driver does not support
+	if (texture == 0) {
+		if (load->cacheHit)
+			decodeTextureFaces(load);
+		std::cout << "Cooking texture file: " << name << std::endl;
+		texture = cookTexture(name, load->files, load->faces, &gpuBytes);
+	}
+
+	return registerTexture(name, texture, gpuBytes);
+}
 
-	// load alien model from external file
-	if (loadSingleMesh(ALIEN_MODEL_NAME, shaderProgram, &alienGeometry) != true) {
-		std::cerr << "initModels(): Alien model loading failed." << std::endl;
+/**
+*	Returns resident texture of the image or creates it from the loaded texture.
+*	\param[in] set      Loaded textures.
+*	\param[in] fileName Image file.
+*	\return Texture with a reference owned by the caller or 0.
+*/
+static GLuint acquireDecodedTexture(TextureDecodeSet *set, const std::string &fileName) {
+
+	if (fileName.empty())
+		return 0;
+
+	GLuint texture = acquireTexture(fileName);
+	if (texture != 0)
+		return texture;
+
+	std::map<std::string, TextureLoad>::iterator it = set->textures.find(canonicalAssetPath(fileName));
+	if (it == set->textures.end())
+		return 0;
+
+	return createLoadedTexture(fileName, &it->second);
+}
+
+/**
+*	Frees source images and unmaps the cooked texture.
+*/
+static void releaseTextureLoad(TextureLoad *load) {
+	for (size_t i = 0; i < load->faces.size(); i++)
+		releaseImage(&load->faces[i]);
+	releaseCookedTexture(&load->cooked);
+}
+
+/**
+*	Loads mesh and decodes its textures, runs on a worker thread.
+*	\param[in] job Model to load.
+*	\param[in] set Textures shared by all jobs.
+*/
+void loadModelJob(ModelLoadJob *job, TextureDecodeSet *set) {
+
+	job->loaded = loadMeshData(job->fileName, &job->mesh, &job->cacheHit);
+	if (!job->loaded)
+		return;
+
+	for (size_t m = 0; m < job->mesh.materials.size(); m++)
+		decodeSharedImage(set, job->mesh.materials[m].textureName);
+}
+
+/**
+*	Copies textures of the loaded models into the texture arrays, resident models included.
+*	\param[in] models Geometries of the loaded models, may be NULL.
+*	\param[in] numModels Number of the models.
+*/
+static void buildMaterialTextureArrays(MeshGeometry* const *models, int numModels) {
+
+	std::vector<MeshGeometryMaterial*> materials;
+	std::vector<GLuint> textures;
+
+	for (int i = 0; i < numModels; i++) {
+		if (models[i] == NULL)
+			continue;
+		for (size_t m = 0; m < models[i]->materials.size(); m++) {
+			materials.push_back(&models[i]->materials[m]);
+			textures.push_back(models[i]->materials[m].texture);
+		}
 	}
 
-	// load scanner model from external file
-	if (loadSingleMesh(SCANNER_MODEL_NAME, shaderProgram, &scannerGeometry) != true) {
-		std::cerr << "initModels(): Scanner model loading failed." << std::endl;
+	std::vector<TextureArrayLayer> layers;
+	buildTextureArrays(textures, &layers);
+
+	for (size_t m = 0; m < materials.size(); m++) {
+		materials[m]->textureArray = layers[m].array;
+		materials[m]->textureLayer = layers[m].layer;
 	}
+}
+
+/**
+*	Initialize vertex buffers and vertex arrays for all objects.
+*	File reading, mesh import and image decoding run on the worker threads,
+*	only the upload to OpenGL is done here on the thread owning the context.
+*	Models and textures still resident in the asset registry are only referenced again.
+*/
+void initializeModels() {
+
+	int startTime = glutGet(GLUT_ELAPSED_TIME);
+
+	ModelLoadJob jobs[] = {
+		{ ALIEN_MODEL_NAME,   "Alien",   &alienGeometry,   MeshData(), false, false, false },
+		{ SCANNER_MODEL_NAME, "Scanner", &scannerGeometry, MeshData(), false, false, false },
+		{ CARGO_MODEL_NAME,   "Cargo",   &cargoGeometry,   MeshData(), false, false, false },
+		{ STOP_MODEL_NAME,    "Stop",    &stopGeometry,    MeshData(), false, false, false },
+		{ SWARM_MODEL_NAME,   "Swarm",   &swarmGeometry,   MeshData(), false, false, false },
+		{ CAT_MODEL_NAME,     "Cat",     &catGeometry,     MeshData(), false, false, false },
+		{ BOX_MODEL_NAME,     "Box",     &boxGeometry,     MeshData(), false, false, false },
+		{ LAMP_MODEL_NAME,    "Lamp",    &lampGeometry,    MeshData(), false, false, false },
+	};
+	const int numJobs = sizeof(jobs) / sizeof(jobs[0]);
 
-	// load cargo model from external file
-	if (loadSingleMesh(CARGO_MODEL_NAME, shaderProgram, &cargoGeometry) != true) {
-		std::cerr << "initModels(): Cargo model loading failed." << std::endl;
+	TextureDecodeSet decodedTextures;
+	TextureLoad skyboxLoad = TextureLoad();
+	const char * suffixes[] = { "bk", "ft", "lf", "rt", "up", "dn" };
+	const std::string skyboxName = std::string(SKYBOX_CUBE_TEXTURE_FILE_PREFIX) + "desertsky_*.jpg";
+	for (int i = 0; i < 6; i++)
+		skyboxLoad.files.push_back(std::string(SKYBOX_CUBE_TEXTURE_FILE_PREFIX) + "desertsky_" + suffixes[i] + ".jpg");
+
+	// the registry is not touched by the workers, resident assets are acquired before they start
+	for (int i = 0; i < numJobs; i++) {
+		*(jobs[i].geometry) = acquireMesh(jobs[i].fileName);
+		jobs[i].resident = *(jobs[i].geometry) != NULL;
 	}
+	GLuint skyboxTexture = acquireTexture(skyboxName);
 
-	// load stop model from external file
-	if (loadSingleMesh(STOP_MODEL_NAME, shaderProgram, &stopGeometry) != true) {
-		std::cerr << "initModels(): Stop model loading failed." << std::endl;
+	// load models from external files
+	for (int i = 0; i < numJobs; i++) {
+		ModelLoadJob *job = &jobs[i];
+		if (!job->resident)
+			runTask([job, &decodedTextures]() { loadModelJob(job, &decodedTextures); });
 	}
 
-	// load swarm model from external file
-	if (loadSingleMesh(SWARM_MODEL_NAME, shaderProgram, &swarmGeometry) != true) {
-		std::cerr << "initModels(): Swarm model loading failed." << std::endl;
+	// load textures of the remaining objects
+	TextureDecodeSet *set = &decodedTextures;
+	runTask([set]() { decodeSharedImage(set, FLOOR_TEXTURE_NAME); });
+	runTask([set]() { decodeSharedImage(set, EXPLOSION_TEXTURE_NAME); });
+	runTask([set]() { decodeSharedImage(set, UFO_TEXTURE_NAME); });
+	if (skyboxTexture == 0) {
+		TextureLoad *load = &skyboxLoad;
+		runTask([load, skyboxName]() { loadTextureJob(skyboxName, load); });
 	}
 
-	// load cat model from external file
-	if (loadSingleMesh(CAT_MODEL_NAME, shaderProgram, &catGeometry) != true) {
-		std::cerr << "initModels(): Cat model loading failed." << std::endl;
+	waitForTasks();
+
+	int decodedTime = glutGet(GLUT_ELAPSED_TIME);
+
+	// loaded models are appended to the shared mesh buffer, it grows at most once
+	unsigned int loadedVertices = 0, loadedIndices = 0, loadedShortIndices = 0;
+	for (int i = 0; i < numJobs; i++) {
+		if (!jobs[i].resident && jobs[i].loaded) {
+			loadedVertices += jobs[i].mesh.numVertices;
+			if (meshBufferIndexType(jobs[i].mesh.numVertices) == GL_UNSIGNED_SHORT)
+				loadedShortIndices += 3 * jobs[i].mesh.numTriangles;
+			else
+				loadedIndices += 3 * jobs[i].mesh.numTriangles;
+		}
 	}
+	if (loadedIndices + loadedShortIndices > 0)
+		reserveMeshBuffer(loadedVertices, loadedIndices, loadedShortIndices);
+
+	// upload to OpenGL
+	for (int i = 0; i < numJobs; i++) {
+		ModelLoadJob *job = &jobs[i];
+
+		if (job->resident) {
+			std::cout << "Mesh resident: " << job->fileName << std::endl;
+			continue;
+		}
+
+		if (!job->loaded) {
+			std::cerr << "initializeModels(): " << job->name << " model loading failed." << std::endl;
+			*(job->geometry) = NULL;
+			continue;
+		}
+
+		std::cout << (job->cacheHit ? "Mesh cache hit: " : "Mesh cache miss: ") << job->fileName << std::endl;
+
+		std::vector<GLuint> textures(job->mesh.materials.size());
+		for (size_t m = 0; m < job->mesh.materials.size(); m++)
+			textures[m] = acquireDecodedTexture(&decodedTextures, job->mesh.materials[m].textureName);
+
+		createMeshGeometry(job->mesh, textures, shaderProgram, job->geometry);
 
-	// load box model from external file
-	if (loadSingleMesh(BOX_MODEL_NAME, shaderProgram, &boxGeometry) != true) {
-		std::cerr << "initializeModels(): Box model loading failed." << std::endl;
+		MeshGeometry *geometry = *(job->geometry);
+		size_t gpuBytes = geometry->numVertices * meshVertexSize(geometry->vertexFormat) + 3 * job->mesh.numTriangles * indexTypeSize(geometry->indexType);
+		registerMesh(job->fileName, geometry,
+			sizeof(MeshGeometry) + geometry->materials.size() * sizeof(MeshGeometryMaterial) + geometry->drawRanges.size() * sizeof(MeshDrawRange)
+			+ geometry->occluder.vertices.size() * sizeof(float) + geometry->occluder.indices.size() * sizeof(unsigned int)
+			+ geometry->pickMesh.vertices.size() * sizeof(float) + geometry->pickMesh.indices.size() * sizeof(unsigned int), gpuBytes);
+
+		std::cout << "  " << geometry->materials.size() << " materials, " << geometry->numVertices << " vertices, " << meshVertexSize(geometry->vertexFormat) << " B per vertex, "
+			<< 8 * indexTypeSize(geometry->indexType) << "-bit indices, " << gpuBytes / 1024
+			<< " KB (float format " << (geometry->numVertices * meshVertexSize(MESH_FORMAT_FLOAT) + 3 * job->mesh.numTriangles * sizeof(unsigned int)) / 1024
+			<< " KB)" << std::endl;
+
+		std::streamsize precision = std::cout.precision(3);
+		std::cout << "  vertex cache ACMR " << job->mesh.importAcmr << " -> " << job->mesh.acmr
+			<< ", ATVR " << job->mesh.importAtvr << " -> " << job->mesh.atvr << std::endl;
+		std::cout << "  LOD triangles:";
+		for (unsigned int lod = 0; lod < geometry->numLods; lod++)
+			std::cout << " " << geometry->lodNumTriangles[lod] << " (error " << geometry->lodError[lod] << ")";
+		std::cout << std::endl;
+		std::cout.precision(precision);
+
+		releaseMeshData(&job->mesh);
 	}
 
-	// load box model from external file
-	if (loadSingleMesh(LAMP_MODEL_NAME, shaderProgram, &lampGeometry) != true) {
-		std::cerr << "initializeModels(): Lamp model loading failed." << std::endl;
+	// the indirect draws of the models do not bind textures
+	if (indirectShaderProgram.program != 0) {
+		MeshGeometry* models[numJobs];
+		for (int i = 0; i < numJobs; i++)
+			models[i] = *(jobs[i].geometry);
+		buildMaterialTextureArrays(models, numJobs);
 	}
 
+	if (skyboxTexture == 0)
+		skyboxTexture = createLoadedTexture(skyboxName, &skyboxLoad);
+	if (skyboxTexture == 0)
+		pgr::dieWithError("Skybox cube map loading failed!");
+
 	// load shaders
-	initFloorGeometry(shaderProgram, &floorGeometry);
-	initSkyboxGeometry(skyboxShaderProgram.program, &skyboxGeometry);
-	initExplosionGeometry(explosionShaderProgram.program, &explosionGeometry);
-	initUfoGeometry(ufoShaderProgram.program, &ufoGeometry);
-	
+	initFloorGeometry(shaderProgram, acquireDecodedTexture(&decodedTextures, FLOOR_TEXTURE_NAME), &floorGeometry);
+	initSkyboxGeometry(skyboxShaderProgram.program, skyboxTexture, &skyboxGeometry);
+	initExplosionGeometry(explosionShaderProgram.program, acquireDecodedTexture(&decodedTextures, EXPLOSION_TEXTURE_NAME), &explosionGeometry);
+	initUfoGeometry(ufoShaderProgram.program, acquireDecodedTexture(&decodedTextures, UFO_TEXTURE_NAME), &ufoGeometry);
+	initParticleGeometry(&particleGeometry);
+	createInstancedMesh(boxGeometry, &boxInstances);
+
+	// only the variants the scene can reach are created, none is compiled while drawing
+	for (int i = 0; i < numJobs; i++)
+		prepareMaterialShaderVariants(*(jobs[i].geometry), jobs[i].geometry == &boxGeometry);
+	prepareMaterialShaderVariants(floorGeometry, false);
+
+	for (std::map<std::string, TextureLoad>::iterator it = decodedTextures.textures.begin(); it != decodedTextures.textures.end(); ++it)
+		releaseTextureLoad(&it->second);
+	releaseTextureLoad(&skyboxLoad);
 
 	CHECK_GL_ERROR();
+
+	int endTime = glutGet(GLUT_ELAPSED_TIME);
+	std::cout << "Models loaded in " << endTime - startTime << " ms (decoding " << decodedTime - startTime
+		<< " ms on " << threadPoolSize() << " workers, upload " << endTime - decodedTime << " ms)" << std::endl;
 }
 
 /**
 *	Deletes shader programs.
 */
 void deleteShaderPrograms(void) {
-	pgr::deleteProgramAndShaders(shaderProgram.program);
+	// the common programs are variants
+	deleteCommonShaderVariants(&mainShaderVariants);
+	deleteCommonShaderVariants(&instancedShaderVariants);
+	deleteCommonShaderVariants(&indirectShaderVariants);
+	shaderProgram = SCommonShaderProgram();
+	instancedShaderProgram = SCommonShaderProgram();
+	indirectShaderProgram = SCommonShaderProgram();
 	pgr::deleteProgramAndShaders(skyboxShaderProgram.program);
 	pgr::deleteProgramAndShaders(explosionShaderProgram.program);
+	pgr::deleteProgramAndShaders(particleShaderProgram.program);
 	pgr::deleteProgramAndShaders(ufoShaderProgram.program);
 }
 
 /**
-*	Deletes buffers.
-*	\param[in] geometry Geometry to be delete
+*	Deletes buffers or releases the range in the shared mesh buffer, releases textures and frees the geometry.
+*	\param[in] geometry Geometry to be delete, may be NULL
 */
 void deleteGeometry(MeshGeometry *geometry) {
+
+	if (geometry == NULL)
+		return;
 	
-	glDeleteVertexArrays(1, &(geometry->vertexArrayObject));
-	glDeleteBuffers(1, &(geometry->elementBufferObject));
-	glDeleteBuffers(1, &(geometry->vertexBufferObject));
+	if (geometry->bufferRange.numIndices > 0) {
+		releaseMeshBufferRange(geometry->bufferRange);
+	}
+	else {
+		glDeleteVertexArrays(1, &(geometry->vertexArrayObject));
+		glDeleteBuffers(1, &(geometry->elementBufferObject));
+		glDeleteBuffers(1, &(geometry->vertexBufferObject));
+	}
+
+	releaseTexture(geometry->texture);
 
-	if (geometry->texture != 0) glDeleteTextures(1, &(geometry->texture));
+	for (size_t m = 0; m < geometry->materials.size(); m++)
+		releaseTexture(geometry->materials[m].texture);
+
+	delete geometry;
 }
 
 /**
-Delete all geometries.
+Delete all geometries. Loaded models are only released, the asset registry deletes them when they are evicted.
 */
 void deleteModels() {
-	deleteGeometry(floorGeometry);
-	deleteGeometry(alienGeometry);
-	deleteGeometry(scannerGeometry);
-	deleteGeometry(cargoGeometry);
-	deleteGeometry(stopGeometry);
-	deleteGeometry(swarmGeometry);
-	deleteGeometry(catGeometry);
-	deleteGeometry(boxGeometry);
-	deleteGeometry(explosionGeometry);
-	deleteGeometry(ufoGeometry);
-	deleteGeometry(lampGeometry);
-	deleteGeometry(skyboxGeometry);
+	MeshGeometry** models[] = {
+		&alienGeometry, &scannerGeometry, &cargoGeometry, &stopGeometry,
+		&swarmGeometry, &catGeometry, &boxGeometry, &lampGeometry,
+	};
+	MeshGeometry** geometries[] = {
+		&floorGeometry, &explosionGeometry, &ufoGeometry, &skyboxGeometry, &particleGeometry,
+	};
+
+	const int numModels = sizeof(models) / sizeof(models[0]);
+	const int numGeometries = sizeof(geometries) / sizeof(geometries[0]);
+
+	deleteInstancedMesh(&boxInstances);
+	deleteTextureArrays();
+
+	glDeleteBuffers(1, &explosionInstanceBuffer);
+	explosionInstanceBuffer = 0;
+	explosionInstances.clear();
+	glDeleteBuffers(1, &particleInstanceBuffer);
+	particleInstanceBuffer = 0;
+
+	for (int i = 0; i < numModels; i++) {
+		releaseMesh(*models[i]);
+		*models[i] = NULL;
+	}
+
+	for (int i = 0; i < numGeometries; i++) {
+		deleteGeometry(*geometries[i]);
+		*geometries[i] = NULL;
+	}
 }
@@ -14,7 +14,28 @@
 #define __OBJECTS_H
 
 #include "pgr.h"
+#include "meshCache.h"
+#include "occlusion.h"
+#include "meshBuffer.h"
+#include "explosions.h"
+#include "particles.h"
+#include "picking.h"
 #include <string>
+#include <vector>
+
+/**
+*	struct for a material of a loaded model
+*
+*/
+typedef struct MeshGeometryMaterial {
+	glm::vec3     ambient;
+	glm::vec3     diffuse;
+	glm::vec3     specular;
+	float         shininess;
+	GLuint        texture;
+	int           textureArray;   // texture array of the texture, -1 if it is not in any, see textureArrays.h
+	int           textureLayer;
+} MeshGeometryMaterial;
 
 /**
 *	struct for a mesh geometry
@@ -24,16 +45,89 @@ typedef struct MeshGeometry {
 	GLuint        vertexBufferObject;   // identifier for the vertex buffer object
 	GLuint        elementBufferObject;  // identifier for the element buffer object
 	GLuint        vertexArrayObject;    // identifier for the vertex array object
+	unsigned int  numVertices;          // number of vertices in the vertex buffer object
 	unsigned int  numTriangles;         // number of triangles in the mesh
+	unsigned int  vertexFormat;         // MESH_FORMAT_FLOAT or MESH_FORMAT_COMPACT
+	GLenum        indexType;            // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT indices in the element buffer object
 
-	// material
-	glm::vec3     ambient;
-	glm::vec3     diffuse;
-	glm::vec3     specular;
-	float         shininess;
+	// loaded models are in the shared mesh buffer, the buffer objects and the vao are shared too
+	MeshBufferRange bufferRange;
+
+	// levels of detail of loaded models, ranges in the element buffer object (the shared one included)
+	unsigned int  numLods;
+	unsigned int  lodFirstTriangle[MESH_MAX_LODS];
+	unsigned int  lodNumTriangles[MESH_MAX_LODS];
+	float         lodError[MESH_MAX_LODS];   // distance from the full mesh in model units
+
+	// bounding volumes in model space, used for the frustum culling
+	MeshBounds    bounds;
+
+	// full detail triangles of loaded models for the occlusion culling
+	OccluderMesh  occluder;
+
+	// full detail triangles of loaded models for picking
+	PickMesh      pickMesh;
+
+	// materials of loaded models and of the floor, range of material m in level of detail l is at l * materials.size() + m
+	std::vector<MeshGeometryMaterial> materials;
+	std::vector<MeshDrawRange>        drawRanges;
+
+	// texture of the geometries created by init*Geometry() without a material
 	GLuint        texture;
 } MeshGeometry;
 
+/**
+*	struct for statistics of one frame
+*
+*/
+typedef struct RenderStats {
+	unsigned int drawCalls;
+	unsigned int indirectDraws;        // draws submitted by the multi-draw indirect calls
+	unsigned int triangles;            // triangles submitted
+	unsigned int fullDetailTriangles;  // triangles that would be submitted with levels of detail off
+
+	// objects left after the frustum and the occlusion culling
+	unsigned int visibleObjects;
+	unsigned int occludedObjects;      // inside the frustum but behind the occluders
+	unsigned int totalObjects;
+
+	// state changes made by the render queue
+	unsigned int stateChanges;
+	unsigned int unsortedStateChanges; // state changes the draw calls would need in the order they have been queued
+	unsigned int programChanges;
+	unsigned int vertexArrayChanges;
+	unsigned int textureChanges;
+	unsigned int fixedStateChanges;    // blending, depth test and object ID
+} RenderStats;
+
+/**
+*	struct for per instance data of an instanced mesh
+*
+*/
+typedef struct MeshInstance {
+	glm::mat4    modelMatrix;
+	unsigned int objectId;      // packed PickHandle written to the object ID buffer
+} MeshInstance;
+
+/**
+*	struct for instances of one mesh drawn by one instanced draw call per level of detail and material
+*
+*	Instances are sorted by their level of detail, level l uses instances
+*	lodFirstInstance[l] .. lodFirstInstance[l] + lodNumInstances[l] - 1 of the instance buffer.
+*
+*/
+typedef struct InstancedMesh {
+	const MeshGeometry* geometry;
+	GLuint        instanceBufferObject;
+	unsigned int  capacity;                          // instances the buffer object can hold
+	GLuint        lodVertexArrays[MESH_MAX_LODS];    // mesh and instance attributes of the instanced program
+
+	// instances of the last drawn frame
+	std::vector<MeshInstance> instances;
+	unsigned int  lodFirstInstance[MESH_MAX_LODS];
+	unsigned int  lodNumInstances[MESH_MAX_LODS];
+} InstancedMesh;
+
 /**
 *	struct for a camera
 *
@@ -67,6 +161,7 @@ typedef struct AlienObject {
 	glm::vec3 direction;
 	float     size;
 	float     collision;
+	int       lod;        // level of detail used in the last frame
 } AlienObject;
 
 /**
@@ -80,6 +175,7 @@ typedef struct ScannerObject {
 	float		size;
 	float		radius;
 	float		startTime;
+	int		lod;        // level of detail used in the last frame
 
 } ScannerObject;
 
@@ -91,6 +187,7 @@ typedef struct CargoObject {
 	glm::vec3 position;
 	glm::vec3 direction;
 	float     size;
+	int       lod;        // level of detail used in the last frame
 } CargoObject;
 
 /**
@@ -101,6 +198,7 @@ typedef struct StopObject {
 	glm::vec3 position;
 	glm::vec3 direction;
 	float     size;
+	int       lod;        // level of detail used in the last frame
 } StopObject;
 
 /**
@@ -112,6 +210,7 @@ typedef struct SwarmObject {
 	glm::vec3 direction;
 	float     size;
 	float     collision;
+	int       lod;        // level of detail used in the last frame
 } SwarmObject;
 
 /**
@@ -122,6 +221,7 @@ typedef struct CatObject {
 	glm::vec3 position;
 	glm::vec3 direction;
 	float     size;
+	int       lod;        // level of detail used in the last frame
 } CatObject;
 
 /**
@@ -141,6 +241,10 @@ typedef struct boxObject {
 
 	float rotationSpeed;
 
+	int lod;  // level of detail used in the last frame
+
+	unsigned int id;  // picking handle of the box, unique among all boxes ever created
+
 } BoxObject;
 
 /**
@@ -151,28 +255,9 @@ typedef struct LampObject {
 	glm::vec3 position;
 	float     size;
 	float	   radius;
+	int       lod;        // level of detail used in the last frame
 } LampObject;
 
-/**
-*	struct for a explosion
-*
-*/
-typedef struct ExplosionObject {
-	glm::vec3 position;
-	glm::vec3 direction;
-	float     speed;
-	float     size;
-
-	bool notDestroyed;
-
-	float startTime;
-	float currentTime;
-
-	int    textureFrames;
-	float  frameDuration;
-
-} ExplosionObject;
-
 /**
 *	struct for a ufo
 *
@@ -195,11 +280,13 @@ typedef struct _commonShaderProgram {
 	GLint normalLocation;
 	GLint texCoordLocation;
 
-	GLint PVMmatrixLocation;
-	GLint VmatrixLocation;      //   view/camera matrix
+	// view and projection matrices are in the FrameData uniform block
 	GLint MmatrixLocation;      //  modeling matrix
 	GLint normalMatrixLocation; //  inverse transposed VMmatrix
 
+	// instanced programs, -1 in the others
+	GLint instanceMatrixLocation; //  per instance model matrix attribute, 4 locations
+
 	GLint timeLocation;         //  elapsed time in seconds
 
 	// material 
@@ -208,22 +295,28 @@ typedef struct _commonShaderProgram {
 	GLint specularLocation;
 	GLint shininessLocation;
 	
-	// texture
-	GLint useTextureLocation;
+	// texture, used only by the variants with SHADER_VARIANT_TEXTURE
 	GLint texSamplerLocation;
 
-	//fog
-	GLint fogActiveLocation;
+	// fog and lights are in the FrameData and LightData uniform blocks
+} SCommonShaderProgram;
 
-	//lights
-	GLint lampActiveLoc;
-	GLint lampPositionLoc;
-	GLint lampIntensityLoc;
+// variants of the common programs, bits of the index of the variant and #defines of its shaders
+#define SHADER_VARIANT_TEXTURE       1   // USE_TEXTURE, the material has a texture
+#define SHADER_VARIANT_FOG           2   // USE_FOG
+#define SHADER_VARIANT_POINT_LIGHTS  4   // POINT_LIGHTS, the frame has point lights
+#define SHADER_VARIANT_SPOT_LIGHTS   8   // SPOT_LIGHTS, the frame has spot lights
+#define SHADER_VARIANT_COUNT         16
 
-	GLint flashlightIntensityLoc;
-	GLint flashlightPositionLoc;
-	GLint flashlightDirectionLoc;
-} SCommonShaderProgram;
+/**
+*	struct for the variants of one common program, created when a material can reach them
+*
+*/
+typedef struct SCommonShaderVariants {
+	std::string          vertexFile;
+	std::string          fragmentFile;
+	SCommonShaderProgram variants[SHADER_VARIANT_COUNT];  // program 0 until the variant is created
+} SCommonShaderVariants;
 
 /**
 *	struct for a skybox shader program
@@ -233,9 +326,7 @@ typedef struct SSkyboxShaderProgram {
 	GLuint program;
 	GLint PVMmatrixLocation;
 	GLint skyboxSamplerLocation;
-	GLint fogDensityLocation;
 	GLint posLocation;
-	GLint fogActiveLocation;
 } SSkyboxShaderProgram;
 
 typedef struct SExplosionShaderProgram {
@@ -244,15 +335,26 @@ typedef struct SExplosionShaderProgram {
 	// vertex attributes locations
 	GLint posLocation;           // = -1;
 	GLint texCoordLocation;      // = -1;
-	// uniforms locations
-	GLint PVMmatrixLocation;     // = -1;
-	GLint VmatrixLocation;       // = -1;
+	GLint instanceLocation;      // = -1; per instance center and half size
+	GLint instanceTimeLocation;  // = -1; per instance start time and frame duration
+	// uniforms locations, view and projection matrices are in the FrameData uniform block
 	GLint timeLocation;          // = -1;
 	GLint texSamplerLocation;    // = -1;
-	GLint frameDurationLocation; // = -1;
 
 } SExplosionShaderProgram;
 
+/**
+*	struct for a particle shader program
+*
+*/
+typedef struct SParticleShaderProgram {
+	GLuint program;
+	GLint posLocation;
+	GLint instanceLocation;       // per instance center and half size
+	GLint instanceLifeLocation;   // per instance age / lifetime
+	GLint instanceColorLocation;  // per instance color
+} SParticleShaderProgram;
+
 /**
 *	struct for a ufo shader program
 *
@@ -267,26 +369,36 @@ typedef struct SUfoProgram {
 } SUfoProgram;
 
 //drawing objects
-void drawFloor(FloorObject* floor, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix);
+void drawOccluders(CargoObject* cargo, StopObject* stop, LampObject* lamp, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix);
+void drawFloor(FloorObject* floor);
 void drawAlien(AlienObject* alien, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix);
 void drawScanner(ScannerObject* scanner, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix);
 void drawCargo(CargoObject* cargo, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix);
 void drawStop(StopObject* stop, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix);
 void drawSwarm(SwarmObject* swarm, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix);
 void drawCat(CatObject* cat, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix);
-void drawBox(BoxObject* box, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix);
+void drawBoxes(const std::vector<void*> &boxes, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix);
 void drawLamp(LampObject* lamp, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix);
-void drawExplosion(ExplosionObject* explosion, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix);
-void drawUfo(UfoObject* ufo, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix);
-void drawSkybox(const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix);
+void drawExplosions(const ExplosionPool &pool, float time);
+void drawParticles(const ParticleSystem &particles);
+void drawUfo(UfoObject* ufo, const glm::mat4 & viewMatrix);
+void drawSkybox();
+void resetRenderStats();
+
+//picking
+PickHandle pickObject(const std::vector<void*> &boxes, CatObject* cat, LampObject* lamp, const std::vector<void*> &lamps,
+	int x, int y, int windowWidth, int windowHeight, const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix);
 
 
 //shaders
 void initializeShaderPrograms();
+void setShaderVariantFrame(bool fog, bool pointLights, bool spotLights);
 void deleteShaderPrograms();
 
 //models
+bool loadMeshData(const std::string &fileName, MeshData *data, bool *cacheHit);
 void initializeModels();
+void deleteGeometry(MeshGeometry *geometry);
 void deleteModels();
 
 #endif 
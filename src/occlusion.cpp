@@ -0,0 +1,337 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       occlusion.cpp
+* \author     agent
+* \date       2026
+* \brief      Software occlusion culling.
+*
+*	Occluder triangles are transformed and set up on the calling thread and binned to the
+*	tiles they overlap. Each tile is then rasterized by one task, so no two tasks write
+*	the same pixel. The occluders are the full detail meshes, so a pixel is covered only if
+*	the real surface covers its center, simplified levels could stick out of the silhouette
+*	and hide objects which are still visible. Triangles crossing the near plane are skipped
+*	instead of clipped, they only leave pixels uncovered and make the culling less effective.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#include <math.h>
+#include <algorithm>
+#include "pgr.h"
+#include "threadPool.h"
+#include "occlusion.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE__)
+#include <xmmintrin.h>
+#define OCCLUSION_SSE 1
+#endif
+
+#define OCCLUSION_TILES_X  (OCCLUSION_WIDTH / OCCLUSION_TILE_WIDTH)
+#define OCCLUSION_TILES_Y  (OCCLUSION_HEIGHT / OCCLUSION_TILE_HEIGHT)
+
+/**
+*	struct for a set up screen space triangle, edge functions are positive inside
+*
+*/
+typedef struct OcclusionTriangle {
+	float edgeA[3], edgeB[3], edgeC[3];  // edge i is edgeA[i] * x + edgeB[i] * y + edgeC[i]
+	float depthA, depthB, depthC;        // 1 / w is depthA * x + depthB * y + depthC
+	int   minX, minY, maxX, maxY;        // pixel bounds clamped to the buffer
+} OcclusionTriangle;
+
+/**
+*	struct for the occlusion buffer of the current frame
+*
+*/
+typedef struct OcclusionBuffer {
+	glm::mat4                      projectionViewMatrix;
+	std::vector<float>             depth;          // OCCLUSION_WIDTH * OCCLUSION_HEIGHT, rows from the bottom
+	std::vector<OcclusionTriangle> triangles;
+	std::vector<unsigned int>      bins[OCCLUSION_TILES_X * OCCLUSION_TILES_Y];
+	bool                           ready;          // occluders are rasterized, objects may be tested
+} OcclusionBuffer;
+
+static OcclusionBuffer buffer;
+
+/**
+*	Creates occluder from the full detail level of the mesh. The simplified levels are not
+*	used, their triangles may cover pixels which the mesh itself leaves open.
+*	\param[in]  data     Loaded mesh.
+*	\param[out] occluder Positions of the used vertices and the triangles.
+*/
+void createOccluderMesh(const MeshData &data, OccluderMesh *occluder) {
+
+	occluder->vertices.clear();
+	occluder->indices.clear();
+
+	if (data.numLods == 0)
+		return;
+
+	const unsigned int *indices = data.indices + 3 * data.lodFirstTriangle[0];
+	unsigned int numIndices = 3 * data.lodNumTriangles[0];
+
+	// keep only the vertices used by the level
+	std::vector<unsigned int> remap(data.numVertices, ~0u);
+	occluder->indices.resize(numIndices);
+
+	for (unsigned int i = 0; i < numIndices; i++) {
+		unsigned int index = indices[i];
+		if (remap[index] == ~0u) {
+			remap[index] = (unsigned int)occluder->vertices.size() / 3;
+			const float *position = data.vertices + MESH_VERTEX_SIZE * index;
+			occluder->vertices.insert(occluder->vertices.end(), position, position + 3);
+		}
+		occluder->indices[i] = remap[index];
+	}
+}
+
+/**
+*	Starts a new frame, occluders of the previous frame are dropped and no object is occluded
+*	until rasterizeOccluders() is called.
+*	\param[in] projectionViewMatrix Projection * view matrix of the frame.
+*/
+void beginOcclusionFrame(const glm::mat4 &projectionViewMatrix) {
+	buffer.projectionViewMatrix = projectionViewMatrix;
+	buffer.triangles.clear();
+	for (int t = 0; t < OCCLUSION_TILES_X * OCCLUSION_TILES_Y; t++)
+		buffer.bins[t].clear();
+	buffer.ready = false;
+}
+
+/**
+*	Returns position of the clip space point in the pixels of the buffer.
+*/
+static glm::vec2 occlusionScreenPosition(const glm::vec4 &clip) {
+	float invW = 1.0f / clip.w;
+	return glm::vec2((clip.x * invW * 0.5f + 0.5f) * OCCLUSION_WIDTH, (clip.y * invW * 0.5f + 0.5f) * OCCLUSION_HEIGHT);
+}
+
+/**
+*	Sets up the triangle and adds it to the bins of the tiles it overlaps.
+*/
+static void addOcclusionTriangle(const glm::vec4 clip[3]) {
+
+	for (int i = 0; i < 3; i++) {
+		if (clip[i].w < OCCLUSION_MIN_W)
+			return;
+	}
+
+	glm::vec2 p[3];
+	float depth[3];
+	for (int i = 0; i < 3; i++) {
+		p[i] = occlusionScreenPosition(clip[i]);
+		depth[i] = 1.0f / clip[i].w;
+	}
+
+	OcclusionTriangle triangle;
+	triangle.minX = std::max((int)floorf(std::min(p[0].x, std::min(p[1].x, p[2].x))), 0);
+	triangle.minY = std::max((int)floorf(std::min(p[0].y, std::min(p[1].y, p[2].y))), 0);
+	triangle.maxX = std::min((int)ceilf(std::max(p[0].x, std::max(p[1].x, p[2].x))), OCCLUSION_WIDTH - 1);
+	triangle.maxY = std::min((int)ceilf(std::max(p[0].y, std::max(p[1].y, p[2].y))), OCCLUSION_HEIGHT - 1);
+
+	if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+		return;
+
+	// edge i goes from vertex i to vertex i + 1, it is zero on them and the area at the opposite vertex
+	for (int i = 0; i < 3; i++) {
+		const glm::vec2 &a = p[i];
+		const glm::vec2 &b = p[(i + 1) % 3];
+		triangle.edgeA[i] = a.y - b.y;
+		triangle.edgeB[i] = b.x - a.x;
+		triangle.edgeC[i] = a.x * b.y - b.x * a.y;
+	}
+
+	float area = triangle.edgeA[0] * p[2].x + triangle.edgeB[0] * p[2].y + triangle.edgeC[0];
+	if (fabsf(area) < 1e-6f)
+		return;
+
+	// both windings are rasterized, the occluders need not be closed
+	float invArea = 1.0f / area;
+	for (int i = 0; i < 3; i++) {
+		triangle.edgeA[i] *= invArea;
+		triangle.edgeB[i] *= invArea;
+		triangle.edgeC[i] *= invArea;
+	}
+
+	// normalized edges are the barycentric coordinates of the opposite vertices
+	triangle.depthA = triangle.edgeA[1] * depth[0] + triangle.edgeA[2] * depth[1] + triangle.edgeA[0] * depth[2];
+	triangle.depthB = triangle.edgeB[1] * depth[0] + triangle.edgeB[2] * depth[1] + triangle.edgeB[0] * depth[2];
+	triangle.depthC = triangle.edgeC[1] * depth[0] + triangle.edgeC[2] * depth[1] + triangle.edgeC[0] * depth[2];
+
+	unsigned int index = (unsigned int)buffer.triangles.size();
+	buffer.triangles.push_back(triangle);
+
+	for (int ty = triangle.minY / OCCLUSION_TILE_HEIGHT; ty <= triangle.maxY / OCCLUSION_TILE_HEIGHT; ty++)
+		for (int tx = triangle.minX / OCCLUSION_TILE_WIDTH; tx <= triangle.maxX / OCCLUSION_TILE_WIDTH; tx++)
+			buffer.bins[ty * OCCLUSION_TILES_X + tx].push_back(index);
+}
+
+/**
+*	Adds occluder to the frame.
+*	\param[in] occluder    Mesh created by createOccluderMesh().
+*	\param[in] modelMatrix Model matrix of the object.
+*/
+void addOccluder(const OccluderMesh &occluder, const glm::mat4 &modelMatrix) {
+
+	glm::mat4 matrix = buffer.projectionViewMatrix * modelMatrix;
+	unsigned int numVertices = (unsigned int)occluder.vertices.size() / 3;
+
+	std::vector<glm::vec4> clip(numVertices);
+	for (unsigned int v = 0; v < numVertices; v++) {
+		const float *position = &occluder.vertices[3 * v];
+		clip[v] = matrix * glm::vec4(position[0], position[1], position[2], 1.0f);
+	}
+
+	for (size_t i = 0; i + 2 < occluder.indices.size(); i += 3) {
+		glm::vec4 triangle[3] = { clip[occluder.indices[i]], clip[occluder.indices[i + 1]], clip[occluder.indices[i + 2]] };
+		addOcclusionTriangle(triangle);
+	}
+}
+
+/**
+*	Rasterizes triangles of one bin into its tile.
+*	\param[in] tile Index of the tile.
+*/
+static void rasterizeTile(unsigned int tile) {
+
+	const int tileMinX = (tile % OCCLUSION_TILES_X) * OCCLUSION_TILE_WIDTH;
+	const int tileMinY = (tile / OCCLUSION_TILES_X) * OCCLUSION_TILE_HEIGHT;
+	const int tileMaxX = tileMinX + OCCLUSION_TILE_WIDTH - 1;
+	const int tileMaxY = tileMinY + OCCLUSION_TILE_HEIGHT - 1;
+
+	for (int y = tileMinY; y <= tileMaxY; y++)
+		std::fill(buffer.depth.begin() + y * OCCLUSION_WIDTH + tileMinX, buffer.depth.begin() + y * OCCLUSION_WIDTH + tileMaxX + 1, 0.0f);
+
+	const std::vector<unsigned int> &bin = buffer.bins[tile];
+	for (size_t i = 0; i < bin.size(); i++) {
+		const OcclusionTriangle &triangle = buffer.triangles[bin[i]];
+
+		// start at a multiple of 4 pixels, the tiles are aligned to it
+		int minX = std::max(triangle.minX, tileMinX) & ~3;
+		int maxX = std::min(triangle.maxX, tileMaxX);
+		int minY = std::max(triangle.minY, tileMinY);
+		int maxY = std::min(triangle.maxY, tileMaxY);
+
+		for (int y = minY; y <= maxY; y++) {
+			float *row = &buffer.depth[y * OCCLUSION_WIDTH];
+			float sampleY = y + 0.5f;
+
+#ifdef OCCLUSION_SSE
+			__m128 zero = _mm_setzero_ps();
+			__m128 edgeRow[3], edgeStep[3];
+			for (int e = 0; e < 3; e++) {
+				edgeRow[e] = _mm_set1_ps(triangle.edgeB[e] * sampleY + triangle.edgeC[e]);
+				edgeStep[e] = _mm_set1_ps(triangle.edgeA[e]);
+			}
+			__m128 depthRow = _mm_set1_ps(triangle.depthB * sampleY + triangle.depthC);
+			__m128 depthStep = _mm_set1_ps(triangle.depthA);
+
+			for (int x = minX; x <= maxX; x += 4) {
+				__m128 sampleX = _mm_add_ps(_mm_set1_ps((float)x), _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f));
+
+				__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeStep[0], sampleX), edgeRow[0]), zero);
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeStep[1], sampleX), edgeRow[1]), zero));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeStep[2], sampleX), edgeRow[2]), zero));
+				if (_mm_movemask_ps(inside) == 0)
+					continue;
+
+				__m128 depth = _mm_add_ps(_mm_mul_ps(depthStep, sampleX), depthRow);
+				__m128 old = _mm_loadu_ps(row + x);
+				__m128 nearest = _mm_max_ps(old, depth);
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+			}
+#else
+			for (int x = minX; x <= maxX; x++) {
+				float sampleX = x + 0.5f;
+				bool inside = true;
+				for (int e = 0; e < 3; e++)
+					inside = inside && triangle.edgeA[e] * sampleX + triangle.edgeB[e] * sampleY + triangle.edgeC[e] >= 0.0f;
+				if (inside)
+					row[x] = std::max(row[x], triangle.depthA * sampleX + triangle.depthB * sampleY + triangle.depthC);
+			}
+#endif
+		}
+	}
+}
+
+/**
+*	Rasterizes the occluders of the frame, one task per tile.
+*/
+void rasterizeOccluders() {
+
+	buffer.depth.resize(OCCLUSION_WIDTH * OCCLUSION_HEIGHT);
+	buffer.ready = true;
+
+	// nothing to test against, the buffer is not even cleared
+	if (buffer.triangles.empty())
+		return;
+
+	for (unsigned int tile = 0; tile < OCCLUSION_TILES_X * OCCLUSION_TILES_Y; tile++)
+		runTask([tile]() { rasterizeTile(tile); });
+	waitForTasks();
+}
+
+/**
+*	Returns true if the box lies completely behind the occluders of the frame.
+*	\param[in] center  World space center of the box.
+*	\param[in] extents Half sizes of the box.
+*/
+bool boxOccluded(const glm::vec3 &center, const glm::vec3 &extents) {
+
+	if (!buffer.ready || buffer.triangles.empty())
+		return false;
+
+	// screen rectangle and the nearest depth of the corners
+	glm::vec2 minPosition(1e30f), maxPosition(-1e30f);
+	float nearest = 0.0f;
+
+	for (int c = 0; c < 8; c++) {
+		glm::vec3 corner = center + glm::vec3(c & 1 ? extents.x : -extents.x, c & 2 ? extents.y : -extents.y, c & 4 ? extents.z : -extents.z);
+		glm::vec4 clip = buffer.projectionViewMatrix * glm::vec4(corner, 1.0f);
+
+		// the box crosses the near plane
+		if (clip.w < OCCLUSION_MIN_W)
+			return false;
+
+		glm::vec2 position = occlusionScreenPosition(clip);
+		minPosition = glm::vec2(std::min(minPosition.x, position.x), std::min(minPosition.y, position.y));
+		maxPosition = glm::vec2(std::max(maxPosition.x, position.x), std::max(maxPosition.y, position.y));
+		nearest = std::max(nearest, 1.0f / clip.w);
+	}
+
+	int minX = std::max((int)floorf(minPosition.x), 0);
+	int minY = std::max((int)floorf(minPosition.y), 0);
+	int maxX = std::min((int)ceilf(maxPosition.x), OCCLUSION_WIDTH - 1);
+	int maxY = std::min((int)ceilf(maxPosition.y), OCCLUSION_HEIGHT - 1);
+
+	if (minX > maxX || minY > maxY)
+		return false;
+
+	nearest *= OCCLUSION_DEPTH_BIAS;
+
+	// visible if any pixel of the rectangle has no occluder in front of the nearest corner
+	for (int y = minY; y <= maxY; y++) {
+		const float *row = &buffer.depth[y * OCCLUSION_WIDTH];
+
+#ifdef OCCLUSION_SSE
+		__m128 nearestDepth = _mm_set1_ps(nearest);
+		__m128 rectMinX = _mm_set1_ps((float)minX);
+		__m128 rectMaxX = _mm_set1_ps((float)maxX);
+
+		for (int x = minX & ~3; x <= maxX; x += 4) {
+			__m128 pixelX = _mm_add_ps(_mm_set1_ps((float)x), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+			__m128 inRect = _mm_and_ps(_mm_cmpge_ps(pixelX, rectMinX), _mm_cmple_ps(pixelX, rectMaxX));
+			__m128 behind = _mm_cmplt_ps(_mm_loadu_ps(row + x), nearestDepth);
+			if (_mm_movemask_ps(_mm_and_ps(inRect, behind)) != 0)
+				return false;
+		}
+#else
+		for (int x = minX; x <= maxX; x++) {
+			if (row[x] < nearest)
+				return false;
+		}
+#endif
+	}
+
+	return true;
+}
@@ -0,0 +1,53 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       occlusion.h
+* \author     agent
+* \date       2026
+* \brief      Software occlusion culling.
+*
+*	A few large occluders are rasterized on the CPU into a small depth buffer before the
+*	frame is queued. Objects whose screen space bounds lie completely behind the occluders
+*	are not drawn. The buffer is split into tiles rasterized in parallel by the thread pool,
+*	four pixels of a row are processed by one SSE instruction. Nothing here touches OpenGL.
+*
+*	The buffer stores 1 / w of the nearest occluder, it is linear in screen space and 0 means
+*	no occluder.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#ifndef __OCCLUSION_H
+#define __OCCLUSION_H
+
+#include "pgr.h"
+#include "meshCache.h"
+#include <vector>
+
+#define OCCLUSION_WIDTH        256
+#define OCCLUSION_HEIGHT       128
+#define OCCLUSION_TILE_WIDTH   64     // multiple of 4, one SIMD batch is 4 pixels of a row
+#define OCCLUSION_TILE_HEIGHT  32
+
+// triangles and boxes with a vertex closer than this w are not clipped, they are skipped / treated as visible
+#define OCCLUSION_MIN_W        0.01f
+
+// relative 1 / w tolerance, objects touching the occluders (and the occluders themselves) stay visible
+#define OCCLUSION_DEPTH_BIAS   1.001f
+
+/**
+*	struct for an occluder mesh
+*
+*/
+typedef struct OccluderMesh {
+	std::vector<float>        vertices;   // model space positions, 3 floats per vertex
+	std::vector<unsigned int> indices;    // 3 indices per triangle
+} OccluderMesh;
+
+void createOccluderMesh(const MeshData &data, OccluderMesh *occluder);
+
+void beginOcclusionFrame(const glm::mat4 &projectionViewMatrix);
+void addOccluder(const OccluderMesh &occluder, const glm::mat4 &modelMatrix);
+void rasterizeOccluders();
+bool boxOccluded(const glm::vec3 &center, const glm::vec3 &extents);
+
+#endif
@@ -23,7 +23,9 @@
 #define SCENE_HEIGHT 1.0f
 #define SCENE_DEPTH  1.0f
 
-#define REFRESH_INTERVAL 33
+// the simulation advances by fixed steps, frames are drawn between the last two steps
+#define SIMULATION_STEP      0.01f   // seconds of one step
+#define SIMULATION_MAX_STEPS 10      // steps per frame, longer frames slow the simulation down
 #define AREA_SIZE_X 2.0f
 #define AREA_SIZE_Y 2.0f
 
@@ -34,11 +36,12 @@ enum { KEY_LEFT_ARROW, KEY_RIGHT_ARROW, KEY_UP_ARROW, KEY_DOWN_ARROW, KEY_SPACE,
 #define NUMBER_OF_CAMERA 3
 #define VIEW_ANGLE_DELTA 50.0f 
 #define CAMERA_ELEVATION_MAX 50.0f 
-#define CAMERA_MOVEMENT_SPEED 0.4f
+#define CAMERA_MOVEMENT_SPEED 0.3f   // free camera, scene units per second
+#define CAMERA_SPRINT_SPEED 1.5f
 #define CAMERA_SIZE 0.05f
 
 // objects
-#define BOXES_NUMBER 10
+#define BOXES_NUMBER 10     // default, "-boxes <count>" on the command line changes it
 #define BOX_SIZE 0.06f
 #define LAMP_SIZE 0.15f
 #define ALIEN_SIZE 0.08f
@@ -47,6 +50,17 @@ enum { KEY_LEFT_ARROW, KEY_RIGHT_ARROW, KEY_UP_ARROW, KEY_DOWN_ARROW, KEY_SPACE,
 #define CAT_SIZE 0.05f
 #define STOP_SIZE 0.15f
 #define SWARM_SIZE 0.08f
+#define UFO_SCROLL_SPEED 0.3f   // texture offset of the ufo per second
+#define COMPOUND_LAMPS 24   // lamps on the border of the compound, lit together with the lamp
+
+// loaded models use compact vertices (16-bit positions, packed normals, half float uv)
+#define MESH_COMPACT_VERTICES 1
+
+// levels of detail: allowed simplification error on the screen in pixels, hysteresis band around it
+// and the smallest reduction of triangles worth another level
+#define LOD_PIXEL_ERROR        1.0f
+#define LOD_HYSTERESIS         0.25f
+#define MESH_LOD_MIN_REDUCTION 0.8f
 
 // floor
 #define FLOOR_TRIANGLES 2
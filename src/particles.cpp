@@ -0,0 +1,343 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       particles.cpp
+* \author     agent
+* \date       2026
+* \brief      Debris, sparks and smoke of the explosions simulated on the CPU.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <functional>
+#include "pgr.h"
+#include "threadPool.h"
+#include "particles.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE__)
+#include <xmmintrin.h>
+#define PARTICLES_SSE 1
+#endif
+
+// fraction of the horizontal velocity kept after hitting the floor
+#define PARTICLE_FLOOR_FRICTION 0.6f
+
+// particles removed by each chunk of the last update, ascending
+static std::vector<std::vector<unsigned int> > deadParticles;
+
+/**
+*	Allocates arrays of the system for PARTICLE_CAPACITY particles, the system is empty.
+*/
+void initParticleSystem(ParticleSystem *particles) {
+	particles->positionX.resize(PARTICLE_CAPACITY);
+	particles->positionY.resize(PARTICLE_CAPACITY);
+	particles->positionZ.resize(PARTICLE_CAPACITY);
+	particles->velocityX.resize(PARTICLE_CAPACITY);
+	particles->velocityY.resize(PARTICLE_CAPACITY);
+	particles->velocityZ.resize(PARTICLE_CAPACITY);
+	particles->age.resize(PARTICLE_CAPACITY);
+	particles->lifetime.resize(PARTICLE_CAPACITY);
+	particles->size.resize(PARTICLE_CAPACITY);
+	particles->growth.resize(PARTICLE_CAPACITY);
+	particles->gravity.resize(PARTICLE_CAPACITY);
+	particles->drag.resize(PARTICLE_CAPACITY);
+	particles->bounce.resize(PARTICLE_CAPACITY);
+	particles->color.resize(PARTICLE_CAPACITY);
+	particles->count = 0;
+	particles->seed = 51;
+}
+
+/**
+*	Removes all particles, the arrays stay allocated.
+*/
+void clearParticles(ParticleSystem *particles) {
+	particles->count = 0;
+}
+
+/**
+*	Returns random number in <min, max>, xorshift generator of the system.
+*/
+static float randomParticleFloat(ParticleSystem *particles, float min, float max) {
+	unsigned int x = particles->seed;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	particles->seed = x;
+	return min + (max - min) * (float)(x & 0xFFFFFF) / (float)0xFFFFFF;
+}
+
+/**
+*	Returns color packed as bytes r, g, b, a.
+*/
+static unsigned int packColor(float r, float g, float b, float a) {
+	return (unsigned int)(r * 255.0f) | ((unsigned int)(g * 255.0f) << 8) | ((unsigned int)(b * 255.0f) << 16) | ((unsigned int)(a * 255.0f) << 24);
+}
+
+/**
+*	Adds one particle flying from the position in a random direction of the upper hemisphere.
+*	\return False if the system is full.
+*/
+static bool addParticle(ParticleSystem *particles, const glm::vec3 &position, float speed, float lifetime,
+	float size, float growth, float gravity, float drag, float bounce, unsigned int color) {
+
+	if (particles->count >= particles->positionX.size())
+		return false;
+
+	// z is up, the particles fly mostly upwards
+	float angle = randomParticleFloat(particles, 0.0f, 6.2831853f);
+	float elevation = randomParticleFloat(particles, 0.1f, 1.0f);
+	float horizontal = sqrtf(1.0f - elevation * elevation);
+	speed *= randomParticleFloat(particles, 0.5f, 1.0f);
+
+	unsigned int i = particles->count++;
+	particles->positionX[i] = position.x;
+	particles->positionY[i] = position.y;
+	particles->positionZ[i] = position.z;
+	particles->velocityX[i] = speed * horizontal * cosf(angle);
+	particles->velocityY[i] = speed * horizontal * sinf(angle);
+	particles->velocityZ[i] = speed * elevation;
+	particles->age[i] = 0.0f;
+	particles->lifetime[i] = lifetime * randomParticleFloat(particles, 0.6f, 1.0f);
+	particles->size[i] = size * randomParticleFloat(particles, 0.5f, 1.0f);
+	particles->growth[i] = growth;
+	particles->gravity[i] = gravity;
+	particles->drag[i] = drag;
+	particles->bounce[i] = bounce;
+	particles->color[i] = color;
+
+	return true;
+}
+
+/**
+*	Adds debris, sparks and smoke of one explosion.
+*	\param[in,out] particles Particle system.
+*	\param[in]     position  Center of the explosion.
+*	\param[in]     scale     Size of the explosion, speeds and sizes are proportional to it.
+*	\return Number of added particles, less than requested if the system is full.
+*/
+unsigned int spawnExplosionParticles(ParticleSystem *particles, const glm::vec3 &position, float scale) {
+
+	unsigned int first = particles->count;
+	const float gravity = 30.0f * scale;
+
+	for (int i = 0; i < PARTICLE_DEBRIS_COUNT; i++) {
+		float shade = randomParticleFloat(particles, 0.15f, 0.35f);
+		addParticle(particles, position, 12.0f * scale, 3.0f, 0.05f * scale, 0.0f, gravity, 0.2f, 0.3f, packColor(shade, 0.8f * shade, 0.6f * shade, 1.0f));
+	}
+
+	for (int i = 0; i < PARTICLE_SPARK_COUNT; i++) {
+		float green = randomParticleFloat(particles, 0.4f, 0.8f);
+		addParticle(particles, position, 20.0f * scale, 1.0f, 0.02f * scale, 0.0f, gravity, 0.5f, 0.5f, packColor(1.0f, green, 0.2f, 0.0f));
+	}
+
+	for (int i = 0; i < PARTICLE_SMOKE_COUNT; i++) {
+		float shade = randomParticleFloat(particles, 0.3f, 0.5f);
+		addParticle(particles, position, 3.0f * scale, 4.0f, 0.3f * scale, 0.4f * scale, -0.5f * scale, 1.5f, 0.0f, packColor(shade, shade, shade, 0.5f));
+	}
+
+	return particles->count - first;
+}
+
+/**
+*	Integrates one particle, the scalar version of the SIMD loop.
+*/
+static void integrateParticle(ParticleSystem *particles, unsigned int i, float deltaTime, float floorHeight) {
+
+	float damping = std::max(0.0f, 1.0f - particles->drag[i] * deltaTime);
+	float vx = particles->velocityX[i] * damping;
+	float vy = particles->velocityY[i] * damping;
+	float vz = (particles->velocityZ[i] - particles->gravity[i] * deltaTime) * damping;
+
+	float px = particles->positionX[i] + vx * deltaTime;
+	float py = particles->positionY[i] + vy * deltaTime;
+	float pz = particles->positionZ[i] + vz * deltaTime;
+
+	if (pz < floorHeight) {
+		pz = floorHeight;
+		vz = -vz * particles->bounce[i];
+		vx *= PARTICLE_FLOOR_FRICTION;
+		vy *= PARTICLE_FLOOR_FRICTION;
+	}
+
+	particles->positionX[i] = px;
+	particles->positionY[i] = py;
+	particles->positionZ[i] = pz;
+	particles->velocityX[i] = vx;
+	particles->velocityY[i] = vy;
+	particles->velocityZ[i] = vz;
+	particles->age[i] += deltaTime;
+	particles->size[i] += particles->growth[i] * deltaTime;
+}
+
+#ifdef PARTICLES_SSE
+
+/**
+*	Returns a where mask is set, otherwise b.
+*/
+static inline __m128 selectPs(__m128 mask, __m128 a, __m128 b) {
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+/**
+*	Integrates four particles starting at index i, see integrateParticle().
+*	\return Mask of the particles that died, bit k for particle i + k.
+*/
+static int integrateParticles4(ParticleSystem *particles, unsigned int i, float deltaTime, float floorHeight) {
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 dt = _mm_set1_ps(deltaTime);
+	const __m128 floorZ = _mm_set1_ps(floorHeight);
+	const __m128 friction = _mm_set1_ps(PARTICLE_FLOOR_FRICTION);
+
+	__m128 damping = _mm_max_ps(zero, _mm_sub_ps(one, _mm_mul_ps(_mm_loadu_ps(&particles->drag[i]), dt)));
+	__m128 vx = _mm_mul_ps(_mm_loadu_ps(&particles->velocityX[i]), damping);
+	__m128 vy = _mm_mul_ps(_mm_loadu_ps(&particles->velocityY[i]), damping);
+	__m128 vz = _mm_sub_ps(_mm_loadu_ps(&particles->velocityZ[i]), _mm_mul_ps(_mm_loadu_ps(&particles->gravity[i]), dt));
+	vz = _mm_mul_ps(vz, damping);
+
+	__m128 px = _mm_add_ps(_mm_loadu_ps(&particles->positionX[i]), _mm_mul_ps(vx, dt));
+	__m128 py = _mm_add_ps(_mm_loadu_ps(&particles->positionY[i]), _mm_mul_ps(vy, dt));
+	__m128 pz = _mm_add_ps(_mm_loadu_ps(&particles->positionZ[i]), _mm_mul_ps(vz, dt));
+
+	__m128 below = _mm_cmplt_ps(pz, floorZ);
+	pz = selectPs(below, floorZ, pz);
+	vz = selectPs(below, _mm_mul_ps(_mm_sub_ps(zero, vz), _mm_loadu_ps(&particles->bounce[i])), vz);
+	vx = selectPs(below, _mm_mul_ps(vx, friction), vx);
+	vy = selectPs(below, _mm_mul_ps(vy, friction), vy);
+
+	_mm_storeu_ps(&particles->positionX[i], px);
+	_mm_storeu_ps(&particles->positionY[i], py);
+	_mm_storeu_ps(&particles->positionZ[i], pz);
+	_mm_storeu_ps(&particles->velocityX[i], vx);
+	_mm_storeu_ps(&particles->velocityY[i], vy);
+	_mm_storeu_ps(&particles->velocityZ[i], vz);
+
+	__m128 age = _mm_add_ps(_mm_loadu_ps(&particles->age[i]), dt);
+	_mm_storeu_ps(&particles->age[i], age);
+	_mm_storeu_ps(&particles->size[i], _mm_add_ps(_mm_loadu_ps(&particles->size[i]), _mm_mul_ps(_mm_loadu_ps(&particles->growth[i]), dt)));
+
+	return _mm_movemask_ps(_mm_cmpge_ps(age, _mm_loadu_ps(&particles->lifetime[i])));
+}
+
+#endif
+
+/**
+*	Integrates particles begin .. end - 1 and collects the dead ones.
+*	\param[out] dead Indices of the particles that died, ascending.
+*/
+static void integrateParticleChunk(ParticleSystem *particles, unsigned int begin, unsigned int end, float deltaTime, float floorHeight, std::vector<unsigned int> *dead) {
+
+	dead->clear();
+	unsigned int i = begin;
+
+#ifdef PARTICLES_SSE
+	for (; i + PARTICLE_BATCH_WIDTH <= end; i += PARTICLE_BATCH_WIDTH) {
+		int mask = integrateParticles4(particles, i, deltaTime, floorHeight);
+		for (int k = 0; mask != 0; k++, mask >>= 1) {
+			if (mask & 1)
+				dead->push_back(i + k);
+		}
+	}
+#endif
+
+	for (; i < end; i++) {
+		integrateParticle(particles, i, deltaTime, floorHeight);
+		if (particles->age[i] >= particles->lifetime[i])
+			dead->push_back(i);
+	}
+}
+
+/**
+*	Splits count items into chunks and runs the function for each chunk on the worker threads.
+*	\param[in] count    Number of items.
+*	\param[in] function Called with the chunk index and its range begin .. end - 1.
+*	\return Number of chunks, all are finished.
+*/
+static unsigned int runParticleChunks(unsigned int count, const std::function<void(unsigned int, unsigned int, unsigned int)> &function) {
+
+	unsigned int numChunks = std::max(1u, std::min(threadPoolSize(), count / PARTICLE_MIN_CHUNK));
+	// chunks start at multiples of the batch width
+	unsigned int chunkSize = (count / numChunks + PARTICLE_BATCH_WIDTH - 1) / PARTICLE_BATCH_WIDTH * PARTICLE_BATCH_WIDTH;
+
+	if (numChunks == 1) {
+		function(0, 0, count);
+		return 1;
+	}
+
+	for (unsigned int c = 0; c < numChunks; c++) {
+		unsigned int begin = std::min(c * chunkSize, count);
+		unsigned int end = c + 1 == numChunks ? count : std::min(begin + chunkSize, count);
+		runTask([&function, c, begin, end]() { function(c, begin, end); });
+	}
+	waitForTasks();
+
+	return numChunks;
+}
+
+/**
+*	Copies particle from one index to another.
+*/
+static void moveParticle(ParticleSystem *particles, unsigned int from, unsigned int to) {
+	particles->positionX[to] = particles->positionX[from];
+	particles->positionY[to] = particles->positionY[from];
+	particles->positionZ[to] = particles->positionZ[from];
+	particles->velocityX[to] = particles->velocityX[from];
+	particles->velocityY[to] = particles->velocityY[from];
+	particles->velocityZ[to] = particles->velocityZ[from];
+	particles->age[to] = particles->age[from];
+	particles->lifetime[to] = particles->lifetime[from];
+	particles->size[to] = particles->size[from];
+	particles->growth[to] = particles->growth[from];
+	particles->gravity[to] = particles->gravity[from];
+	particles->drag[to] = particles->drag[from];
+	particles->bounce[to] = particles->bounce[from];
+	particles->color[to] = particles->color[from];
+}
+
+/**
+*	Moves the particles, bounces them off the floor and removes the dead ones.
+*	\param[in,out] particles   Particle system.
+*	\param[in]     deltaTime   Simulated time in seconds.
+*	\param[in]     floorHeight Height of the floor plane.
+*/
+void updateParticles(ParticleSystem *particles, float deltaTime, float floorHeight) {
+
+	if (particles->count == 0)
+		return;
+
+	deadParticles.resize(std::max(1u, threadPoolSize()));
+
+	unsigned int numChunks = runParticleChunks(particles->count, [particles, deltaTime, floorHeight](unsigned int chunk, unsigned int begin, unsigned int end) {
+		integrateParticleChunk(particles, begin, end, deltaTime, floorHeight, &deadParticles[chunk]);
+	});
+
+	// dead particles from the highest index, the last particle is always alive or the removed one
+	for (unsigned int c = numChunks; c-- > 0;) {
+		const std::vector<unsigned int> &dead = deadParticles[c];
+		for (size_t d = dead.size(); d-- > 0;) {
+			unsigned int last = --particles->count;
+			if (dead[d] != last)
+				moveParticle(particles, last, dead[d]);
+		}
+	}
+}
+
+/**
+*	Writes billboards of all live particles.
+*	\param[in]  particles Particle system.
+*	\param[out] instances Array of particles.count instances, may be a mapped buffer.
+*/
+void writeParticleInstances(const ParticleSystem &particles, ParticleInstance *instances) {
+
+	runParticleChunks(particles.count, [&particles, instances](unsigned int /*chunk*/, unsigned int begin, unsigned int end) {
+		for (unsigned int i = begin; i < end; i++) {
+			ParticleInstance *instance = &instances[i];
+			instance->position[0] = particles.positionX[i];
+			instance->position[1] = particles.positionY[i];
+			instance->position[2] = particles.positionZ[i];
+			instance->size = particles.size[i];
+			instance->life = particles.age[i] / particles.lifetime[i];
+			instance->color = particles.color[i];
+		}
+	});
+}
@@ -0,0 +1,71 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       particles.h
+* \author     agent
+* \date       2026
+* \brief      Debris, sparks and smoke of the explosions simulated on the CPU.
+*
+*	Particles are kept in structure of arrays with a fixed capacity. The simulation is split
+*	into chunks run by the worker threads, each chunk integrates four particles at once with
+*	SIMD and bounces them off the floor. Dead particles are replaced by the last live ones
+*	after the chunks finish, so the live particles always are 0 .. count - 1.
+*
+*	writeParticleInstances() fills the instance buffer by the workers too, drawParticles()
+*	of objects.cpp draws all particles by one instanced call.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#ifndef __PARTICLES_H
+#define __PARTICLES_H
+
+#include "pgr.h"
+#include <vector>
+
+// maximal number of live particles, more are not spawned
+#define PARTICLE_CAPACITY       (1 << 20)
+// number of particles integrated by one iteration of the SIMD loop
+#define PARTICLE_BATCH_WIDTH    4
+// smaller systems are simulated on the calling thread
+#define PARTICLE_MIN_CHUNK      16384
+
+// particles spawned by one explosion
+#define PARTICLE_DEBRIS_COUNT   96
+#define PARTICLE_SPARK_COUNT    160
+#define PARTICLE_SMOKE_COUNT    48
+
+/**
+*	struct for live particles in structure of arrays
+*
+*/
+typedef struct ParticleSystem {
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> velocityX, velocityY, velocityZ;
+	std::vector<float> age, lifetime;   // seconds, the particle dies when age reaches lifetime
+	std::vector<float> size, growth;    // half size of the billboard and its change per second
+	std::vector<float> gravity;         // downward acceleration, negative for rising smoke
+	std::vector<float> drag;            // fraction of the velocity lost per second
+	std::vector<float> bounce;          // fraction of the vertical velocity kept after hitting the floor
+	std::vector<unsigned int> color;    // RGBA8, alpha 0 is additive (sparks)
+	unsigned int       count;
+	unsigned int       seed;            // state of the random generator of spawnExplosionParticles()
+} ParticleSystem;
+
+/**
+*	struct for one particle billboard in the instance buffer
+*
+*/
+typedef struct ParticleInstance {
+	float        position[3];
+	float        size;
+	float        life;     // age / lifetime, fades the particle
+	unsigned int color;
+} ParticleInstance;
+
+void initParticleSystem(ParticleSystem *particles);
+void clearParticles(ParticleSystem *particles);
+unsigned int spawnExplosionParticles(ParticleSystem *particles, const glm::vec3 &position, float scale);
+void updateParticles(ParticleSystem *particles, float deltaTime, float floorHeight);
+void writeParticleInstances(const ParticleSystem &particles, ParticleInstance *instances);
+
+#endif
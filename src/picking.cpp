@@ -0,0 +1,353 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       picking.cpp
+* \author     agent
+* \date       2026
+* \brief      Picking of objects by a ray cast on the CPU.
+*
+*	The hierarchy is built for each pick by median splits along the longest axis of the
+*	object centers, the objects move every frame and picks are rare. Building it over
+*	100 000 boxes takes a few milliseconds, the ray then tests only tens of boxes.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+#include "pgr.h"
+#include "picking.h"
+
+// deeper hierarchies are not built, median splits of 2^32 objects are 32 levels deep
+#define PICK_STACK_SIZE 64
+
+/**
+*	Keeps triangles of the full detail level of the mesh for the ray casts.
+*	\param[in]  data Loaded mesh.
+*	\param[out] mesh Positions of the vertices used by the level and its triangles.
+*/
+void createPickMesh(const MeshData &data, PickMesh *mesh) {
+
+	mesh->vertices.clear();
+	mesh->indices.clear();
+
+	if (data.numLods == 0)
+		return;
+
+	const unsigned int *indices = data.indices + 3 * data.lodFirstTriangle[0];
+	unsigned int numIndices = 3 * data.lodNumTriangles[0];
+
+	// keep only the vertices used by the level
+	std::vector<unsigned int> remap(data.numVertices, ~0u);
+	mesh->indices.resize(numIndices);
+
+	for (unsigned int i = 0; i < numIndices; i++) {
+		unsigned int index = indices[i];
+		if (remap[index] == ~0u) {
+			remap[index] = (unsigned int)mesh->vertices.size() / 3;
+			const float *position = data.vertices + MESH_VERTEX_SIZE * index;
+			mesh->vertices.insert(mesh->vertices.end(), position, position + 3);
+		}
+		mesh->indices[i] = remap[index];
+	}
+}
+
+/**
+*	Returns 32-bit object ID of the handle, the value written to the object ID buffer.
+*	Ids above PICK_ID_MASK wrap around.
+*	\param[in] handle Handle of the object.
+*	\return Object ID, 0 for PICK_NONE.
+*/
+unsigned int packPickHandle(const PickHandle &handle) {
+	if (handle.type == PICK_NONE)
+		return 0;
+
+	return ((unsigned int)handle.type << PICK_ID_TYPE_SHIFT) | (handle.id & PICK_ID_MASK);
+}
+
+/**
+*	Returns handle of the 32-bit object ID, inverse of packPickHandle().
+*	\param[in] objectId Object ID read from the object ID buffer.
+*	\return Handle, type PICK_NONE for 0.
+*/
+PickHandle unpackPickHandle(unsigned int objectId) {
+	PickHandle handle;
+	handle.type = (int)(objectId >> PICK_ID_TYPE_SHIFT);
+	handle.id = handle.type == PICK_NONE ? 0 : objectId & PICK_ID_MASK;
+	return handle;
+}
+
+/**
+*	Removes all objects, the arrays stay allocated.
+*/
+void clearPickScene(PickScene *scene) {
+	scene->objects.clear();
+	scene->nodes.clear();
+}
+
+/**
+*	Adds object to the scene, buildPickHierarchy() has to be called after the last one.
+*	\param[in,out] scene       Scene of the pick.
+*	\param[in]     handle      Handle returned when the object is picked.
+*	\param[in]     mesh        Triangles of the object, NULL to pick by its box.
+*	\param[in]     bounds      Bounds of the mesh in model space.
+*	\param[in]     modelMatrix Model matrix of the object.
+*/
+void addPickObject(PickScene *scene, const PickHandle &handle, const PickMesh *mesh, const MeshBounds &bounds, const glm::mat4 &modelMatrix) {
+
+	PickObject object;
+	object.handle = handle;
+	object.mesh = mesh != NULL && !mesh->indices.empty() ? mesh : NULL;
+	object.modelMatrix = modelMatrix;
+
+	// world box around the transformed model box
+	glm::vec3 center = 0.5f * (bounds.boxMin + bounds.boxMax);
+	glm::vec3 extents = 0.5f * (bounds.boxMax - bounds.boxMin);
+	glm::vec3 worldCenter = glm::vec3(modelMatrix * glm::vec4(center, 1.0f));
+	glm::vec3 worldExtents(0.0f);
+	for (int column = 0; column < 3; column++) {
+		for (int row = 0; row < 3; row++)
+			worldExtents[row] += fabsf(modelMatrix[column][row]) * extents[column];
+	}
+	object.boxMin = worldCenter - worldExtents;
+	object.boxMax = worldCenter + worldExtents;
+
+	scene->objects.push_back(object);
+}
+
+/**
+*	Orders objects of the node by their centers along the axis.
+*/
+typedef struct PickCenterLess {
+	int axis;
+	bool operator()(const PickObject &a, const PickObject &b) const {
+		return a.boxMin[axis] + a.boxMax[axis] < b.boxMin[axis] + b.boxMax[axis];
+	}
+} PickCenterLess;
+
+/**
+*	Fills node of the objects first .. first + count - 1 and builds its subtree.
+*/
+static void buildPickNode(PickScene *scene, unsigned int nodeIndex, unsigned int first, unsigned int count) {
+
+	PickBvhNode node;
+	node.boxMin = glm::vec3(FLT_MAX);
+	node.boxMax = glm::vec3(-FLT_MAX);
+	glm::vec3 centerMin(FLT_MAX), centerMax(-FLT_MAX);
+
+	for (unsigned int i = first; i < first + count; i++) {
+		const PickObject &object = scene->objects[i];
+		glm::vec3 center = object.boxMin + object.boxMax;
+		node.boxMin = glm::min(node.boxMin, object.boxMin);
+		node.boxMax = glm::max(node.boxMax, object.boxMax);
+		centerMin = glm::min(centerMin, center);
+		centerMax = glm::max(centerMax, center);
+	}
+
+	if (count <= PICK_BVH_LEAF_SIZE) {
+		node.first = first;
+		node.count = count;
+		scene->nodes[nodeIndex] = node;
+		return;
+	}
+
+	// median split along the longest axis of the centers
+	glm::vec3 size = centerMax - centerMin;
+	PickCenterLess less;
+	less.axis = size.x >= size.y && size.x >= size.z ? 0 : (size.y >= size.z ? 1 : 2);
+
+	unsigned int half = count / 2;
+	std::vector<PickObject>::iterator begin = scene->objects.begin() + first;
+	std::nth_element(begin, begin + half, begin + count, less);
+
+	unsigned int left = (unsigned int)scene->nodes.size();
+	scene->nodes.push_back(PickBvhNode());
+	buildPickNode(scene, left, first, half);
+
+	unsigned int right = (unsigned int)scene->nodes.size();
+	scene->nodes.push_back(PickBvhNode());
+	buildPickNode(scene, right, first + half, count - half);
+
+	node.first = right;
+	node.count = 0;
+	scene->nodes[nodeIndex] = node;
+}
+
+/**
+*	Builds the hierarchy over the objects of the scene, the objects are reordered.
+*/
+void buildPickHierarchy(PickScene *scene) {
+	scene->nodes.clear();
+
+	unsigned int numObjects = (unsigned int)scene->objects.size();
+	if (numObjects == 0)
+		return;
+
+	scene->nodes.reserve(2 * (numObjects / PICK_BVH_LEAF_SIZE + 1));
+	scene->nodes.push_back(PickBvhNode());
+	buildPickNode(scene, 0, 0, numObjects);
+}
+
+/**
+*	Returns ray from the camera through the center of the pixel.
+*	\param[in]  x                Horizontal window coordinate of the pixel.
+*	\param[in]  y                Vertical window coordinate of the pixel, from the bottom.
+*	\param[in]  windowWidth      Width of the window.
+*	\param[in]  windowHeight     Height of the window.
+*	\param[in]  viewMatrix       View of the drawn frame.
+*	\param[in]  projectionMatrix Projection of the drawn frame.
+*	\param[out] origin           Point of the ray on the near plane.
+*	\param[out] direction        Normalized direction of the ray.
+*/
+void pickRay(int x, int y, int windowWidth, int windowHeight, const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix,
+	glm::vec3 *origin, glm::vec3 *direction) {
+
+	glm::mat4 inverse = glm::inverse(projectionMatrix * viewMatrix);
+	float ndcX = (2.0f * x + 1.0f) / windowWidth - 1.0f;
+	float ndcY = (2.0f * y + 1.0f) / windowHeight - 1.0f;
+
+	glm::vec4 nearPoint = inverse * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+	glm::vec4 farPoint = inverse * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+
+	*origin = glm::vec3(nearPoint) / nearPoint.w;
+	*direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - *origin);
+}
+
+/**
+*	Returns true if the ray hits the box closer than maxDistance.
+*	\param[out] entry Distance where the ray enters the box, 0 if it starts inside.
+*/
+static bool rayHitsBox(const glm::vec3 &origin, const glm::vec3 &inverseDirection, const glm::vec3 &boxMin, const glm::vec3 &boxMax,
+	float maxDistance, float *entry) {
+
+	float tMin = 0.0f, tMax = maxDistance;
+	for (int axis = 0; axis < 3; axis++) {
+		float t0 = (boxMin[axis] - origin[axis]) * inverseDirection[axis];
+		float t1 = (boxMax[axis] - origin[axis]) * inverseDirection[axis];
+		tMin = std::max(tMin, std::min(t0, t1));
+		tMax = std::min(tMax, std::max(t0, t1));
+	}
+
+	*entry = tMin;
+	return tMin <= tMax;
+}
+
+/**
+*	Returns true if the ray hits a triangle of the object closer than maxDistance.
+*	\param[out] distance Distance of the nearest hit.
+*/
+static bool rayHitsObject(const PickObject &object, const glm::vec3 &origin, const glm::vec3 &direction, float boxEntry,
+	float maxDistance, float *distance) {
+
+	if (object.mesh == NULL) {
+		*distance = boxEntry;
+		return true;
+	}
+
+	// model space ray, distances stay the same as the transformation is affine
+	glm::mat4 inverse = glm::inverse(object.modelMatrix);
+	glm::vec3 o = glm::vec3(inverse * glm::vec4(origin, 1.0f));
+	glm::vec3 d = glm::vec3(inverse * glm::vec4(direction, 0.0f));
+
+	const float *vertices = &object.mesh->vertices[0];
+	const std::vector<unsigned int> &indices = object.mesh->indices;
+	float nearest = maxDistance;
+	bool hit = false;
+
+	for (size_t i = 0; i < indices.size(); i += 3) {
+		glm::vec3 a = glm::make_vec3(vertices + 3 * indices[i]);
+		glm::vec3 edge1 = glm::make_vec3(vertices + 3 * indices[i + 1]) - a;
+		glm::vec3 edge2 = glm::make_vec3(vertices + 3 * indices[i + 2]) - a;
+
+		// Moller-Trumbore, both sides of the triangles are hit
+		glm::vec3 p = glm::cross(d, edge2);
+		float determinant = glm::dot(edge1, p);
+		if (fabsf(determinant) < 1e-12f)
+			continue;
+		float inverseDeterminant = 1.0f / determinant;
+
+		glm::vec3 s = o - a;
+		float u = glm::dot(s, p) * inverseDeterminant;
+		if (u < 0.0f || u > 1.0f)
+			continue;
+
+		glm::vec3 q = glm::cross(s, edge1);
+		float v = glm::dot(d, q) * inverseDeterminant;
+		if (v < 0.0f || u + v > 1.0f)
+			continue;
+
+		float t = glm::dot(edge2, q) * inverseDeterminant;
+		if (t > 0.0f && t < nearest) {
+			nearest = t;
+			hit = true;
+		}
+	}
+
+	*distance = nearest;
+	return hit;
+}
+
+/**
+*	Returns the object hit first by the ray.
+*	\param[in] scene     Objects with the built hierarchy.
+*	\param[in] origin    Start of the ray.
+*	\param[in] direction Direction of the ray.
+*	\return Handle of the object, type PICK_NONE if the ray hits nothing.
+*/
+PickHandle pickScene(const PickScene &scene, const glm::vec3 &origin, const glm::vec3 &direction) {
+
+	PickHandle picked;
+	picked.type = PICK_NONE;
+	picked.id = 0;
+
+	if (scene.nodes.empty())
+		return picked;
+
+	const glm::vec3 inverseDirection = 1.0f / direction;
+	float nearest = FLT_MAX;
+
+	unsigned int stack[PICK_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0) {
+		unsigned int nodeIndex = stack[--stackSize];
+		const PickBvhNode &node = scene.nodes[nodeIndex];
+
+		float entry;
+		if (!rayHitsBox(origin, inverseDirection, node.boxMin, node.boxMax, nearest, &entry))
+			continue;
+
+		if (node.count > 0) {
+			for (unsigned int i = node.first; i < node.first + node.count; i++) {
+				const PickObject &object = scene.objects[i];
+				float distance;
+				if (rayHitsBox(origin, inverseDirection, object.boxMin, object.boxMax, nearest, &entry)
+					&& rayHitsObject(object, origin, direction, entry, nearest, &distance)) {
+					nearest = distance;
+					picked = object.handle;
+				}
+			}
+			continue;
+		}
+
+		// the nearer child is visited first, the farther one is often skipped then
+		unsigned int left = nodeIndex + 1, right = node.first;
+		float leftEntry, rightEntry;
+		bool hitLeft = rayHitsBox(origin, inverseDirection, scene.nodes[left].boxMin, scene.nodes[left].boxMax, nearest, &leftEntry);
+		bool hitRight = rayHitsBox(origin, inverseDirection, scene.nodes[right].boxMin, scene.nodes[right].boxMax, nearest, &rightEntry);
+
+		if (hitLeft && hitRight && leftEntry > rightEntry)
+			std::swap(left, right);
+		if (hitLeft && hitRight && stackSize + 2 <= PICK_STACK_SIZE) {
+			stack[stackSize++] = right;
+			stack[stackSize++] = left;
+		}
+		else if (hitLeft && stackSize < PICK_STACK_SIZE)
+			stack[stackSize++] = left;
+		else if (hitRight && stackSize < PICK_STACK_SIZE)
+			stack[stackSize++] = right;
+	}
+
+	return picked;
+}
@@ -0,0 +1,104 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       picking.h
+* \author     agent
+* \date       2026
+* \brief      Picking of objects by a ray cast on the CPU.
+*
+*	The ray goes from the camera through the clicked pixel, it is built by the inverse
+*	projection * view matrix. The pickable objects are collected with their world space
+*	boxes into a bounding volume hierarchy, the ray visits its nodes from the nearest one
+*	and tests triangles of the objects whose boxes it hits. Nothing here touches OpenGL,
+*	so picking does not wait for the GPU and works with any number of objects.
+*
+*	Objects are identified by a handle, the type of the object and its id. The ids of the
+*	boxes stay the same when other boxes are removed.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#ifndef __PICKING_H
+#define __PICKING_H
+
+#include "pgr.h"
+#include "meshCache.h"
+#include "culling.h"
+#include <vector>
+
+// types of the pickable objects
+#define PICK_NONE           0
+#define PICK_BOX            1
+#define PICK_CAT            2
+#define PICK_LAMP           3
+
+// packed handles keep the type in the high bits and the id in the low bits, see packPickHandle()
+#define PICK_ID_TYPE_SHIFT  24
+#define PICK_ID_MASK        ((1u << PICK_ID_TYPE_SHIFT) - 1)
+
+// objects in a leaf of the hierarchy
+#define PICK_BVH_LEAF_SIZE  4
+
+/**
+*	struct for triangles of the full detail level of a mesh
+*
+*/
+typedef struct PickMesh {
+	std::vector<float>        vertices;   // model space positions, 3 floats per vertex
+	std::vector<unsigned int> indices;    // 3 indices per triangle
+} PickMesh;
+
+/**
+*	struct for a picked object
+*
+*/
+typedef struct PickHandle {
+	int          type;   // PICK_*
+	unsigned int id;     // id of the object among the objects of its type
+} PickHandle;
+
+/**
+*	struct for one pickable object
+*
+*/
+typedef struct PickObject {
+	PickHandle      handle;
+	const PickMesh* mesh;          // triangles in model space, NULL if the box is enough
+	glm::mat4       modelMatrix;
+	glm::vec3       boxMin;        // world space
+	glm::vec3       boxMax;
+} PickObject;
+
+/**
+*	struct for a node of the hierarchy, the left child of an inner node follows it
+*
+*/
+typedef struct PickBvhNode {
+	glm::vec3    boxMin;
+	glm::vec3    boxMax;
+	unsigned int first;   // first object of a leaf, right child of an inner node
+	unsigned int count;   // objects of a leaf, 0 for an inner node
+} PickBvhNode;
+
+/**
+*	struct for pickable objects of one pick and their hierarchy
+*
+*/
+typedef struct PickScene {
+	std::vector<PickObject>  objects;
+	std::vector<PickBvhNode> nodes;
+} PickScene;
+
+void createPickMesh(const MeshData &data, PickMesh *mesh);
+
+unsigned int packPickHandle(const PickHandle &handle);
+PickHandle unpackPickHandle(unsigned int objectId);
+
+void clearPickScene(PickScene *scene);
+void addPickObject(PickScene *scene, const PickHandle &handle, const PickMesh *mesh, const MeshBounds &bounds, const glm::mat4 &modelMatrix);
+void buildPickHierarchy(PickScene *scene);
+
+void pickRay(int x, int y, int windowWidth, int windowHeight, const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix,
+	glm::vec3 *origin, glm::vec3 *direction);
+PickHandle pickScene(const PickScene &scene, const glm::vec3 &origin, const glm::vec3 &direction);
+
+#endif
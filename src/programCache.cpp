@@ -0,0 +1,360 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       programCache.cpp
+* \author     agent
+* \date       2026
+* \brief      Cache of linked shader program binaries.
+*
+*	Cache file layout: header | program binary.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include "meshCache.h"
+#include "programCache.h"
+
+/**
+*	header of the cache file
+*
+*/
+typedef struct ProgramCacheHeader {
+	char               magic[4];      // "A51P"
+	unsigned int       version;       // PROGRAM_CACHE_VERSION
+	unsigned long long key;           // hash of the sources and of the driver
+	unsigned int       binaryFormat;
+	unsigned int       binaryLength;
+} ProgramCacheHeader;
+
+static const char PROGRAM_CACHE_MAGIC[4] = { 'A', '5', '1', 'P' };
+
+/**
+*	fixed location of a vertex attribute or a fragment shader output, names the shaders do not have are ignored
+*
+*/
+typedef struct ProgramAttribute {
+	const char *name;
+	GLuint      location;
+} ProgramAttribute;
+
+static const ProgramAttribute PROGRAM_ATTRIBUTES[] = {
+	{ "position", 0 },
+	{ "normal", 1 },
+	{ "texCoord", 2 },
+	{ "color", 3 },
+	{ "instanceMatrix", 4 },   // 4 locations
+	{ "objectId", 8 },         // RENDER_OBJECT_ID_LOCATION
+};
+
+// fixed draw buffers of the fragment shader outputs, objectId_f is the object ID buffer
+static const ProgramAttribute PROGRAM_OUTPUTS[] = {
+	{ "color_f", 0 },
+	{ "objectId_f", 1 },       // RENDER_OBJECT_ID_BUFFER
+};
+
+/**
+*	Adds bytes to the 64-bit FNV-1a hash.
+*/
+static unsigned long long hashBytes(unsigned long long hash, const void *data, size_t size) {
+	const unsigned char *bytes = (const unsigned char*)data;
+
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+/**
+*	Adds the string including its terminating zero to the hash.
+*/
+static unsigned long long hashString(unsigned long long hash, const char *string) {
+	if (string == NULL)
+		string = "";
+	return hashBytes(hash, string, strlen(string) + 1);
+}
+
+/**
+*	Reads whole text file.
+*	\param[in]  fileName File to read.
+*	\param[out] content  Content of the file.
+*	\return True if the file has been read.
+*/
+static bool readTextFile(const std::string &fileName, std::string *content) {
+	std::ifstream in(fileName.c_str(), std::ios::in | std::ios::binary);
+	if (!in)
+		return false;
+
+	std::stringstream buffer;
+	buffer << in.rdbuf();
+	*content = buffer.str();
+
+	return true;
+}
+
+/**
+*	Returns true if the driver can return program binaries (OpenGL 4.1 or ARB_get_program_binary).
+*	Has to be called from the thread owning the OpenGL context.
+*/
+static bool programBinarySupported() {
+	static int supported = -1;
+
+	if (supported < 0) {
+		GLint numFormats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+		glGetError(); // the query is an invalid enum on drivers without program binaries
+		supported = numFormats > 0 ? 1 : 0;
+	}
+
+	return supported == 1;
+}
+
+/**
+*	Inserts the defines after the #version line of the source, the line numbers of the
+*	source are kept by #line.
+*/
+static std::string insertDefines(const std::string &source, const std::string &defines) {
+	if (defines.empty())
+		return source;
+
+	size_t version = source.find("#version");
+	size_t lineEnd = version == std::string::npos ? std::string::npos : source.find('\n', version);
+	if (lineEnd == std::string::npos)
+		return defines + source;
+
+	return source.substr(0, lineEnd + 1) + defines + "#line 2\n" + source.substr(lineEnd + 1);
+}
+
+/**
+*	Returns short tag of the defines for the name of the cache file.
+*/
+static std::string definesTag(const std::string &defines) {
+	if (defines.empty())
+		return "";
+
+	std::ostringstream tag;
+	tag << "@" << std::hex << hashString(14695981039346656037ULL, defines.c_str());
+	return tag.str();
+}
+
+/**
+*	Returns name of the cache file for given pair of shaders.
+*	\param[in] vertexFile   Path to the vertex shader.
+*	\param[in] fragmentFile Path to the fragment shader.
+*	\param[in] defines      Lines with #defines of the variant, empty for the plain program.
+*/
+std::string programCacheFileName(const std::string &vertexFile, const std::string &fragmentFile, const std::string &defines) {
+	std::string name = vertexFile + "+" + fragmentFile + definesTag(defines);
+
+	for (size_t i = 0; i < name.size(); i++) {
+		if (name[i] == '/' || name[i] == '\\' || name[i] == ':')
+			name[i] = '_';
+	}
+
+	return std::string(PROGRAM_CACHE_DIRECTORY) + name + ".prog";
+}
+
+/**
+*	Creates program from the cached binary.
+*	\return Program or 0 if the cache file is missing, stale or rejected by the driver.
+*/
+static GLuint loadCachedProgram(const std::string &fileName, unsigned long long key, bool *rejected) {
+
+	*rejected = false;
+
+	MappedFile file;
+	if (!mapFile(fileName, &file))
+		return 0;
+
+	ProgramCacheHeader header;
+	if (file.size < sizeof(ProgramCacheHeader)) {
+		unmapFile(&file);
+		return 0;
+	}
+	memcpy(&header, file.data, sizeof(ProgramCacheHeader));
+
+	if (memcmp(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic)) != 0
+		|| header.version != PROGRAM_CACHE_VERSION
+		|| header.key != key
+		|| file.size != sizeof(ProgramCacheHeader) + header.binaryLength) {
+		unmapFile(&file);
+		return 0;
+	}
+
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, header.binaryFormat, file.data + sizeof(ProgramCacheHeader), header.binaryLength);
+	unmapFile(&file);
+
+	GLint status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (status != GL_TRUE) {
+		// e.g. the driver has been updated without changing its version string
+		glDeleteProgram(program);
+		glGetError();
+		*rejected = true;
+		return 0;
+	}
+
+	return program;
+}
+
+/**
+*	Stores binary of the linked program into the cache.
+*/
+static bool saveCachedProgram(const std::string &fileName, unsigned long long key, GLuint program) {
+
+	GLint binaryLength = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+	if (binaryLength <= 0)
+		return false;
+
+	std::vector<unsigned char> binary(binaryLength);
+	GLenum binaryFormat = 0;
+	glGetProgramBinary(program, binaryLength, &binaryLength, &binaryFormat, &binary[0]);
+	if (binaryLength <= 0)
+		return false;
+
+#ifdef _WIN32
+	_mkdir(PROGRAM_CACHE_DIRECTORY);
+#else
+	mkdir(PROGRAM_CACHE_DIRECTORY, 0755);
+#endif
+
+	ProgramCacheHeader header;
+	memset(&header, 0, sizeof(ProgramCacheHeader));
+	memcpy(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic));
+	header.version = PROGRAM_CACHE_VERSION;
+	header.key = key;
+	header.binaryFormat = binaryFormat;
+	header.binaryLength = (unsigned int)binaryLength;
+
+	// write into the temporary file first, half written cache must never be mapped
+	std::string tempFileName = fileName + ".tmp";
+	std::ofstream out(tempFileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!out) {
+		std::cerr << "saveCachedProgram(): cannot create " << tempFileName << std::endl;
+		return false;
+	}
+
+	out.write((const char*)&header, sizeof(ProgramCacheHeader));
+	out.write((const char*)&binary[0], binaryLength);
+	out.close();
+
+	if (!out) {
+		std::cerr << "saveCachedProgram(): cannot write " << tempFileName << std::endl;
+		remove(tempFileName.c_str());
+		return false;
+	}
+
+	remove(fileName.c_str());
+	if (rename(tempFileName.c_str(), fileName.c_str()) != 0) {
+		std::cerr << "saveCachedProgram(): cannot rename " << tempFileName << std::endl;
+		remove(tempFileName.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+/**
+*	Compiles and links the program, the binary is marked retrievable before linking.
+*	Sources are read from the files if they are empty.
+*/
+static GLuint compileProgram(const std::string &vertexFile, const std::string &fragmentFile,
+	const std::string &vertexSource, const std::string &fragmentSource, const std::string &defines) {
+
+	GLuint shaders[2];
+	if (vertexSource.empty() || fragmentSource.empty()) {
+		shaders[0] = pgr::createShaderFromFile(GL_VERTEX_SHADER, vertexFile);
+		shaders[1] = pgr::createShaderFromFile(GL_FRAGMENT_SHADER, fragmentFile);
+	}
+	else {
+		shaders[0] = pgr::createShaderFromSource(GL_VERTEX_SHADER, insertDefines(vertexSource, defines));
+		shaders[1] = pgr::createShaderFromSource(GL_FRAGMENT_SHADER, insertDefines(fragmentSource, defines));
+	}
+
+	GLuint program = glCreateProgram();
+	for (int i = 0; i < 2; i++)
+		glAttachShader(program, shaders[i]);
+
+	for (size_t i = 0; i < sizeof(PROGRAM_ATTRIBUTES) / sizeof(PROGRAM_ATTRIBUTES[0]); i++)
+		glBindAttribLocation(program, PROGRAM_ATTRIBUTES[i].location, PROGRAM_ATTRIBUTES[i].name);
+	for (size_t i = 0; i < sizeof(PROGRAM_OUTPUTS) / sizeof(PROGRAM_OUTPUTS[0]); i++)
+		glBindFragDataLocation(program, PROGRAM_OUTPUTS[i].location, PROGRAM_OUTPUTS[i].name);
+
+	if (programBinarySupported())
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(program);
+
+	GLint status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (status != GL_TRUE) {
+		GLint logLength = 0;
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+		std::vector<char> log(logLength + 1, 0);
+		glGetProgramInfoLog(program, logLength, NULL, &log[0]);
+		std::cerr << "compileProgram(): linking of " << vertexFile << " + " << fragmentFile << " failed:" << std::endl << defines << &log[0] << std::endl;
+
+		pgr::deleteProgramAndShaders(program);
+		pgr::dieWithError("Shader program linking failed!");
+	}
+
+	return program;
+}
+
+/**
+*	Creates program from the cached binary or compiles it from the sources and stores its binary.
+*	\param[in] vertexFile   Path to the vertex shader.
+*	\param[in] fragmentFile Path to the fragment shader.
+*	\param[in] defines      Lines with #defines inserted after the #version line of both shaders.
+*	\return Linked program, delete it with pgr::deleteProgramAndShaders().
+*/
+GLuint createCachedProgram(const std::string &vertexFile, const std::string &fragmentFile, const std::string &defines) {
+
+	std::string vertexSource, fragmentSource;
+	if (!readTextFile(vertexFile, &vertexSource) || !readTextFile(fragmentFile, &fragmentSource)) {
+		if (!defines.empty())
+			std::cerr << "createCachedProgram(): cannot read " << vertexFile << " + " << fragmentFile << ", compiled without the defines" << std::endl;
+		return compileProgram(vertexFile, fragmentFile, "", "", "");
+	}
+	if (!programBinarySupported())
+		return compileProgram(vertexFile, fragmentFile, vertexSource, fragmentSource, defines);
+
+	// binaries are valid only for the same sources and the same driver
+	unsigned long long key = 14695981039346656037ULL;
+	key = hashString(key, vertexSource.c_str());
+	key = hashString(key, fragmentSource.c_str());
+	key = hashString(key, defines.c_str());
+	key = hashString(key, (const char*)glGetString(GL_VENDOR));
+	key = hashString(key, (const char*)glGetString(GL_RENDERER));
+	key = hashString(key, (const char*)glGetString(GL_VERSION));
+
+	std::string cacheFileName = programCacheFileName(vertexFile, fragmentFile, defines);
+
+	bool rejected;
+	GLuint program = loadCachedProgram(cacheFileName, key, &rejected);
+	if (program != 0) {
+		std::cout << "Program cache hit: " << vertexFile << " + " << fragmentFile << definesTag(defines) << std::endl;
+		return program;
+	}
+
+	std::cout << (rejected ? "Program cache binary rejected: " : "Program cache miss: ") << vertexFile << " + " << fragmentFile << definesTag(defines) << std::endl;
+
+	program = compileProgram(vertexFile, fragmentFile, vertexSource, fragmentSource, defines);
+	if (!saveCachedProgram(cacheFileName, key, program))
+		std::cerr << "createCachedProgram(): cannot store program binary of " << vertexFile << " + " << fragmentFile << definesTag(defines) << std::endl;
+
+	return program;
+}
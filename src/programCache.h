@@ -0,0 +1,31 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       programCache.h
+* \author     agent
+* \date       2026
+* \brief      Cache of linked shader program binaries.
+*
+*	Programs linked from GLSL sources are stored by glGetProgramBinary(). The binary is reused
+*	only if the hash of the sources and of the driver vendor, renderer and version matches,
+*	a binary rejected by the driver is replaced by a program compiled from the sources.
+*
+*	Variants of one program are compiled from the same sources with different #defines inserted
+*	after the #version line. Attributes of all programs are bound to fixed locations, so the
+*	variants share vertex array objects.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#ifndef __PROGRAMCACHE_H
+#define __PROGRAMCACHE_H
+
+#include "pgr.h"
+#include <string>
+
+#define PROGRAM_CACHE_DIRECTORY "cache/"
+#define PROGRAM_CACHE_VERSION   3
+
+std::string programCacheFileName(const std::string &vertexFile, const std::string &fragmentFile, const std::string &defines = "");
+GLuint createCachedProgram(const std::string &vertexFile, const std::string &fragmentFile, const std::string &defines = "");
+
+#endif
@@ -0,0 +1,553 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       renderQueue.cpp
+* \author     agent
+* \date       2026
+* \brief      Sorted queue of draw calls of one frame.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#include <stddef.h>
+#include <algorithm>
+#include <map>
+#include <vector>
+#include "pgr.h"
+#include "objects.h"
+#include "vertexFormat.h"
+#include "transforms.h"
+#include "renderQueue.h"
+
+extern RenderStats renderStats;
+
+/**
+*	struct for a sort key of the item
+*
+*/
+typedef struct RenderQueueEntry {
+	unsigned long long key;
+	unsigned int       item;
+
+	// multi-draw indirect calls, only for indirect items
+	unsigned int       draw;       // command of the item
+	unsigned int       batchSize;  // items drawn by the call starting with this one, 0 for the following items of the call
+} RenderQueueEntry;
+
+/**
+*	struct for one command of a multi-draw indirect call, DrawElementsIndirectCommand of OpenGL
+*
+*/
+typedef struct RenderIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint  baseVertex;
+	GLuint baseInstance;   // first draw of the call, added to gl_DrawIDARB by the shader
+} RenderIndirectCommand;
+
+/**
+*	struct for per draw values of an indirect item, std430 layout of DrawData of indirectVertex.vert
+*
+*/
+typedef struct RenderDrawData {
+	glm::mat4    modelMatrix;
+	glm::mat4    normalMatrix;   // inverse transposed view * model
+	unsigned int material;       // index to the materials of the frame
+	unsigned int objectId;       // packed PickHandle of the item
+	unsigned int padding[2];
+} RenderDrawData;
+
+/**
+*	struct for a material of the indirect items, std430 layout of MaterialData of indirectFragment.frag
+*
+*/
+typedef struct RenderMaterial {
+	glm::vec4 ambient;     // w unused
+	glm::vec4 diffuse;
+	glm::vec4 specular;
+	float     shininess;
+	int       useTexture;
+	int       textureArray;  // texture array and its layer of the texture
+	int       textureLayer;
+} RenderMaterial;
+
+static_assert(offsetof(RenderDrawData, material) == 128 && sizeof(RenderDrawData) == 144, "RenderDrawData does not match std430 layout of DrawData");
+static_assert(offsetof(RenderMaterial, shininess) == 48 && sizeof(RenderMaterial) == 64, "RenderMaterial does not match std430 layout of MaterialData");
+
+/**
+*	struct for OpenGL state set by the queue, -1 (all bits set) is an unknown state
+*
+*/
+typedef struct RenderState {
+	GLuint program;
+	GLuint vertexArrayObject;
+	GLuint texture2D;
+	GLuint textureCubeMap;
+	int    blendMode;
+	int    depthTest;
+	long long objectId;       // -1 for unknown, any object ID differs
+	int    objectIdWrites;
+} RenderState;
+
+/**
+*	struct for the queue of the current frame
+*
+*/
+typedef struct RenderQueue {
+	std::vector<RenderItem>       items;
+	std::vector<RenderQueueEntry> entries;
+	glm::mat4                     viewMatrix;
+	glm::mat4                     projectionMatrix;
+	unsigned int                  objectId;
+	Frustum                       frustum;
+
+	// poses of the items and their matrices
+	TransformArrays               transforms;
+	std::vector<glm::mat4>        modelMatrices;
+	std::vector<glm::mat4>        normalMatrices;
+
+	// commands and per draw data of the indirect items
+	std::vector<RenderIndirectCommand> commands;
+	std::vector<RenderDrawData>        draws;
+	std::vector<RenderMaterial>        materials;
+	std::map<const MeshGeometryMaterial*, unsigned int> materialIndices;
+	GLuint                        commandBufferObject;
+	GLuint                        drawBufferObject;
+	GLuint                        materialBufferObject;
+} RenderQueue;
+
+static RenderQueue queue;
+
+/**
+*	Starts a new frame, items of the previous frame are dropped.
+*	\param[in] viewMatrix       View matrix of the frame.
+*	\param[in] projectionMatrix Projection matrix of the frame.
+*/
+void beginRenderQueue(const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix) {
+	queue.items.clear();
+	clearTransforms(&queue.transforms);
+	queue.viewMatrix = viewMatrix;
+	queue.projectionMatrix = projectionMatrix;
+	queue.objectId = 0;
+	extractFrustum(projectionMatrix * viewMatrix, &queue.frustum);
+}
+
+/**
+*	Sets object ID written to the object ID buffer by the following items (object picking).
+*	\param[in] objectId Packed PickHandle of the object, 0 for objects which cannot be picked.
+*/
+void setRenderObjectId(unsigned int objectId) {
+	queue.objectId = objectId;
+}
+
+/**
+*	Adds item to the queue with default state: opaque, depth tested, triangles without texture.
+*	\param[in] position World position of the object, used for the depth sorting.
+*	\return Item to fill, valid until the next push.
+*/
+RenderItem* pushRenderItem(const glm::vec3 &position) {
+
+	queue.items.push_back(RenderItem());
+	RenderItem *item = &queue.items.back();
+
+	item->program = 0;
+	item->vertexArrayObject = 0;
+	item->texture = 0;
+	item->textureTarget = GL_TEXTURE_2D;
+	item->layer = RENDER_LAYER_OPAQUE;
+	item->blendMode = RENDER_BLEND_NONE;
+	item->depthTest = true;
+	item->objectId = queue.objectId;
+	item->primitive = GL_TRIANGLES;
+	item->indexType = 0;
+	item->first = 0;
+	item->baseVertex = 0;
+	item->count = 0;
+	item->instanceCount = 1;
+	item->indirect = false;
+	item->fullDetailTriangles = 0;
+	item->depth = -(queue.viewMatrix * glm::vec4(position, 1.0f)).z;
+	item->setUniforms = NULL;
+	item->transform = -1;
+	item->modelMatrix = glm::mat4(1.0f);
+	item->normalMatrix = glm::mat4(1.0f);
+	item->material = NULL;
+	item->shader = NULL;
+	item->params[0] = 0.0f;
+	item->params[1] = 0.0f;
+
+	return item;
+}
+
+/**
+*	Adds pose of an object, the model matrix is alignObject(position, front, up) * scale(scale).
+*	The matrices are computed for all poses at once when the queue is flushed.
+*	\param[in] position Position of the object.
+*	\param[in] front    Direction the object faces.
+*	\param[in] up       Up direction of the object.
+*	\param[in] scale    Uniform scale of the object.
+*	\return Index of the pose for RenderItem::transform, may be shared by several items.
+*/
+int addRenderTransform(const glm::vec3 &position, const glm::vec3 &front, const glm::vec3 &up, float scale) {
+	return (int)addTransform(&queue.transforms, position, front, up, scale);
+}
+
+/**
+*	Returns planes of the view frustum of the frame, objects outside it should not be pushed.
+*/
+const Frustum& renderFrustum() {
+	return queue.frustum;
+}
+
+/**
+*	Builds sort key of the item, see renderQueue.h.
+*/
+static unsigned long long renderSortKey(const RenderItem &item) {
+
+	float normalizedDepth = std::min(std::max(item.depth / RENDER_DEPTH_RANGE, 0.0f), 1.0f);
+	unsigned long long depth = (unsigned long long)(normalizedDepth * 0xFFFFFF);
+	unsigned long long program = item.program & 0xFF;
+	unsigned long long vertexArray = item.vertexArrayObject & 0x3FF;
+	unsigned long long texture = item.texture & 0xFFF;
+
+	unsigned long long key = (unsigned long long)item.layer << 62;
+
+	if (item.layer != RENDER_LAYER_BLENDED)
+		return key | (program << 54) | (vertexArray << 44) | (texture << 32) | (depth << 8);
+
+	return key | ((unsigned long long)item.blendMode << 60) | ((0xFFFFFF - depth) << 36) | (program << 28) | (vertexArray << 18) | (texture << 6);
+}
+
+/**
+*	Changes OpenGL state to the state of the item.
+*	\param[in]     item   Item to draw.
+*	\param[in,out] state  Current state.
+*	\param[in]     submit Call OpenGL and count the changes per kind, otherwise only count them.
+*	\return Number of state changes.
+*/
+static unsigned int changeRenderState(const RenderItem &item, RenderState *state, bool submit) {
+	unsigned int changes = 0;
+
+	if (item.program != state->program) {
+		state->program = item.program;
+		if (submit) {
+			glUseProgram(item.program);
+			renderStats.programChanges++;
+		}
+		changes++;
+	}
+
+	if (item.vertexArrayObject != state->vertexArrayObject) {
+		state->vertexArrayObject = item.vertexArrayObject;
+		if (submit) {
+			glBindVertexArray(item.vertexArrayObject);
+			renderStats.vertexArrayChanges++;
+		}
+		changes++;
+	}
+
+	// items without texture do not sample, whatever is bound may stay
+	GLuint *boundTexture = item.textureTarget == GL_TEXTURE_CUBE_MAP ? &state->textureCubeMap : &state->texture2D;
+	if (item.texture != 0 && item.texture != *boundTexture) {
+		*boundTexture = item.texture;
+		if (submit) {
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(item.textureTarget, item.texture);
+			renderStats.textureChanges++;
+		}
+		changes++;
+	}
+
+	if (item.blendMode != state->blendMode) {
+		state->blendMode = item.blendMode;
+		if (submit) {
+			if (item.blendMode == RENDER_BLEND_NONE) {
+				glDisable(GL_BLEND);
+			}
+			else {
+				glEnable(GL_BLEND);
+				if (item.blendMode == RENDER_BLEND_ADDITIVE)
+					glBlendFunc(GL_ONE, GL_ONE);
+				else if (item.blendMode == RENDER_BLEND_PREMULTIPLIED)
+					glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+				else
+					glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			}
+			// unsorted particles must not hide each other
+			glDepthMask(item.blendMode == RENDER_BLEND_PREMULTIPLIED ? GL_FALSE : GL_TRUE);
+			renderStats.fixedStateChanges++;
+		}
+		changes++;
+	}
+
+	if ((int)item.depthTest != state->depthTest) {
+		state->depthTest = item.depthTest;
+		if (submit) {
+			if (item.depthTest)
+				glEnable(GL_DEPTH_TEST);
+			else
+				glDisable(GL_DEPTH_TEST);
+			renderStats.fixedStateChanges++;
+		}
+		changes++;
+	}
+
+	// a constant attribute is not a state of the vao, it stays for all following draw calls,
+	// indirect items read their IDs from the per draw data
+	if (!item.indirect && (long long)item.objectId != state->objectId) {
+		state->objectId = item.objectId;
+		if (submit) {
+			glVertexAttribI1ui(RENDER_OBJECT_ID_LOCATION, item.objectId);
+			renderStats.fixedStateChanges++;
+		}
+		changes++;
+	}
+
+	int objectIdWrites = item.layer == RENDER_LAYER_OPAQUE ? 1 : 0;
+	if (objectIdWrites != state->objectIdWrites) {
+		state->objectIdWrites = objectIdWrites;
+		if (submit) {
+			GLboolean write = objectIdWrites ? GL_TRUE : GL_FALSE;
+			glColorMaski(RENDER_OBJECT_ID_BUFFER, write, write, write, write);
+			renderStats.fixedStateChanges++;
+		}
+		changes++;
+	}
+
+	return changes;
+}
+
+/**
+*	Returns state unknown to the queue, everything is set by the first item.
+*/
+static RenderState unknownRenderState() {
+	RenderState state;
+	state.program = ~0u;
+	state.vertexArrayObject = ~0u;
+	state.texture2D = ~0u;
+	state.textureCubeMap = ~0u;
+	state.blendMode = -1;
+	state.depthTest = -1;
+	state.objectId = -1;
+	state.objectIdWrites = -1;
+	return state;
+}
+
+/**
+*	Returns true if the indirect items can be drawn by one multi-draw indirect call.
+*/
+static bool sameIndirectBatch(const RenderItem &a, const RenderItem &b) {
+	return a.indirect && b.indirect && a.program == b.program && a.vertexArrayObject == b.vertexArrayObject
+		&& a.texture == b.texture && a.textureTarget == b.textureTarget && a.blendMode == b.blendMode && a.depthTest == b.depthTest
+		&& a.primitive == b.primitive && a.indexType == b.indexType;
+}
+
+/**
+*	Returns index of the material of the indirect item in the materials of the frame, adds it if it is not there.
+*/
+static unsigned int indirectMaterial(const RenderItem &item) {
+
+	std::map<const MeshGeometryMaterial*, unsigned int>::iterator it = queue.materialIndices.find(item.material);
+	if (it != queue.materialIndices.end())
+		return it->second;
+
+	RenderMaterial material;
+	material.ambient = glm::vec4(item.material->ambient, 0.0f);
+	material.diffuse = glm::vec4(item.material->diffuse, 0.0f);
+	material.specular = glm::vec4(item.material->specular, 0.0f);
+	material.shininess = item.material->shininess;
+	material.useTexture = item.material->texture != 0 ? 1 : 0;
+	material.textureArray = std::max(item.material->textureArray, 0);
+	material.textureLayer = item.material->textureLayer;
+
+	unsigned int index = (unsigned int)queue.materials.size();
+	queue.materials.push_back(material);
+	queue.materialIndices[item.material] = index;
+	return index;
+}
+
+/**
+*	Joins sorted indirect items following each other with the same state into multi-draw calls and
+*	uploads their commands and per draw data.
+*	\param[in] numItems Number of items, the entries are sorted.
+*/
+static void buildIndirectDraws(unsigned int numItems) {
+
+	queue.commands.clear();
+	queue.draws.clear();
+	queue.materials.clear();
+	queue.materialIndices.clear();
+
+	unsigned int batch = 0;
+	bool batchOpen = false;
+
+	for (unsigned int i = 0; i < numItems; i++) {
+		RenderQueueEntry &entry = queue.entries[i];
+		const RenderItem &item = queue.items[entry.item];
+
+		entry.draw = (unsigned int)queue.commands.size();
+		entry.batchSize = 1;
+
+		if (!item.indirect) {
+			batchOpen = false;
+			continue;
+		}
+
+		if (batchOpen && sameIndirectBatch(queue.items[queue.entries[batch].item], item)) {
+			queue.entries[batch].batchSize++;
+			entry.batchSize = 0;
+		}
+		else {
+			batch = i;
+			batchOpen = true;
+		}
+
+		RenderIndirectCommand command;
+		command.count = item.count;
+		command.instanceCount = 1;
+		command.firstIndex = item.first;
+		command.baseVertex = item.baseVertex;
+		command.baseInstance = queue.entries[batch].draw;
+		queue.commands.push_back(command);
+
+		RenderDrawData draw;
+		draw.modelMatrix = item.modelMatrix;
+		draw.normalMatrix = item.normalMatrix;
+		draw.material = indirectMaterial(item);
+		draw.objectId = item.objectId;
+		draw.padding[0] = draw.padding[1] = 0;
+		queue.draws.push_back(draw);
+	}
+
+	if (queue.commands.empty())
+		return;
+
+	if (queue.commandBufferObject == 0) {
+		glGenBuffers(1, &queue.commandBufferObject);
+		glGenBuffers(1, &queue.drawBufferObject);
+		glGenBuffers(1, &queue.materialBufferObject);
+	}
+
+	// orphaned every frame, the driver does not wait for the draw calls of the previous frame
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, queue.commandBufferObject);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, queue.commands.size() * sizeof(RenderIndirectCommand), &queue.commands[0], GL_STREAM_DRAW);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, queue.drawBufferObject);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, queue.draws.size() * sizeof(RenderDrawData), &queue.draws[0], GL_STREAM_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, queue.materialBufferObject);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, queue.materials.size() * sizeof(RenderMaterial), &queue.materials[0], GL_STREAM_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RENDER_DRAW_DATA_BINDING, queue.drawBufferObject);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RENDER_MATERIAL_BINDING, queue.materialBufferObject);
+	CHECK_GL_ERROR();
+}
+
+/**
+*	Computes matrices of the items, sorts them and draws them. OpenGL state is reset to the defaults
+*	(no program, no vao, no blending, depth test on, object ID 0 written) afterwards.
+*/
+void flushRenderQueue() {
+
+	unsigned int numItems = (unsigned int)queue.items.size();
+
+	// model and normal matrices of all poses in SIMD batches
+	unsigned int numTransforms = queue.transforms.count;
+	if (numTransforms > 0) {
+		queue.modelMatrices.resize(numTransforms);
+		queue.normalMatrices.resize(numTransforms);
+		computeTransforms(queue.transforms, queue.viewMatrix, &queue.modelMatrices[0], &queue.normalMatrices[0]);
+
+		for (unsigned int i = 0; i < numItems; i++) {
+			RenderItem &item = queue.items[i];
+			if (item.transform >= 0) {
+				item.modelMatrix = queue.modelMatrices[item.transform];
+				item.normalMatrix = queue.normalMatrices[item.transform];
+			}
+		}
+	}
+
+	// state changes the items would need in the order they have been pushed
+	RenderState state = unknownRenderState();
+	for (unsigned int i = 0; i < numItems; i++)
+		renderStats.unsortedStateChanges += changeRenderState(queue.items[i], &state, false);
+
+	queue.entries.resize(numItems);
+	for (unsigned int i = 0; i < numItems; i++) {
+		queue.entries[i].key = renderSortKey(queue.items[i]);
+		queue.entries[i].item = i;
+	}
+
+	// equal keys keep the order of pushing
+	std::sort(queue.entries.begin(), queue.entries.end(), [](const RenderQueueEntry &a, const RenderQueueEntry &b) {
+		return a.key < b.key || (a.key == b.key && a.item < b.item);
+	});
+
+	buildIndirectDraws(numItems);
+	if (!queue.commands.empty())
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, queue.commandBufferObject);
+
+	state = unknownRenderState();
+	for (unsigned int i = 0; i < numItems; i++) {
+		const RenderQueueEntry &entry = queue.entries[i];
+		const RenderItem &item = queue.items[entry.item];
+
+		renderStats.triangles += (item.primitive == GL_TRIANGLE_STRIP ? (item.count >= 3 ? item.count - 2 : 0) : item.count / 3) * item.instanceCount;
+		renderStats.fullDetailTriangles += item.fullDetailTriangles;
+
+		// drawn by the multi-draw call of a previous item
+		if (entry.batchSize == 0)
+			continue;
+
+		renderStats.stateChanges += changeRenderState(item, &state, true);
+
+		if (item.setUniforms != NULL)
+			item.setUniforms(item, queue.viewMatrix, queue.projectionMatrix);
+
+		void *indices = (void*)((size_t)item.first * indexTypeSize(item.indexType));
+		if (item.indirect) {
+			glMultiDrawElementsIndirect(item.primitive, item.indexType, (void*)(entry.draw * sizeof(RenderIndirectCommand)), entry.batchSize, 0);
+			renderStats.indirectDraws += entry.batchSize;
+		}
+		else if (item.instanceCount != 1 && item.baseVertex != 0)
+			glDrawElementsInstancedBaseVertex(item.primitive, item.count, item.indexType, indices, item.instanceCount, item.baseVertex);
+		else if (item.instanceCount != 1 && item.indexType != 0)
+			glDrawElementsInstanced(item.primitive, item.count, item.indexType, indices, item.instanceCount);
+		else if (item.instanceCount != 1)
+			glDrawArraysInstanced(item.primitive, item.first, item.count, item.instanceCount);
+		else if (item.baseVertex != 0)
+			glDrawElementsBaseVertex(item.primitive, item.count, item.indexType, indices, item.baseVertex);
+		else if (item.indexType != 0)
+			glDrawElements(item.primitive, item.count, item.indexType, indices);
+		else
+			glDrawArrays(item.primitive, item.first, item.count);
+
+		renderStats.drawCalls++;
+	}
+	CHECK_GL_ERROR();
+
+	if (!queue.commands.empty())
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glBindVertexArray(0);
+	glUseProgram(0);
+	glDisable(GL_BLEND);
+	glDepthMask(GL_TRUE);
+	glEnable(GL_DEPTH_TEST);
+	glVertexAttribI1ui(RENDER_OBJECT_ID_LOCATION, 0);
+	glColorMaski(RENDER_OBJECT_ID_BUFFER, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+	queue.items.clear();
+}
+
+/**
+*	Deletes buffers of the multi-draw indirect calls.
+*/
+void deleteRenderQueue() {
+	glDeleteBuffers(1, &queue.commandBufferObject);
+	glDeleteBuffers(1, &queue.drawBufferObject);
+	glDeleteBuffers(1, &queue.materialBufferObject);
+	queue.commandBufferObject = 0;
+	queue.drawBufferObject = 0;
+	queue.materialBufferObject = 0;
+}
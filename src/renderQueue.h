@@ -0,0 +1,109 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       renderQueue.h
+* \author     agent
+* \date       2026
+* \brief      Sorted queue of draw calls of one frame.
+*
+*	draw* functions only push render items. flushRenderQueue() sorts them once per frame
+*	by a 64-bit key and submits them, so the program, vao, texture, blending, depth test
+*	and object ID are changed only when they differ from the previous item. Model and normal
+*	matrices of the items with a pose are computed together in SIMD batches before that.
+*
+*	The object ID is a constant vertex attribute at RENDER_OBJECT_ID_LOCATION, instanced
+*	items may read it per instance instead, indirect items read it from the per draw data.
+*	Only the opaque layer writes it into the object ID buffer of idBuffer.h, the sky and
+*	blended items leave the IDs under them.
+*
+*	Indirect items following each other with the same state are drawn by one multi-draw
+*	indirect call. Their matrices, materials and object IDs are uploaded into per draw
+*	buffers read by the vertex shader at gl_BaseInstanceARB + gl_DrawIDARB, the base instance
+*	of the commands of one call is the index of its first draw. Their textures are layers of the texture
+*	arrays, so items with different materials are drawn by the same call.
+*
+*	Sort key: opaque items  | layer 2 | program 8 | vao 10 | texture 12 | depth front to back 24 | 8 unused |
+*	          blended items | layer 2 | blend 2 | depth back to front 24 | program 8 | vao 10 | texture 12 | 6 unused |
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#ifndef __RENDERQUEUE_H
+#define __RENDERQUEUE_H
+
+#include "pgr.h"
+#include "culling.h"
+
+// layers are drawn in this order
+#define RENDER_LAYER_OPAQUE   0
+#define RENDER_LAYER_SKY      1
+#define RENDER_LAYER_BLENDED  2
+
+#define RENDER_BLEND_NONE     0
+#define RENDER_BLEND_ALPHA    1   // GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA
+#define RENDER_BLEND_ADDITIVE 2   // GL_ONE, GL_ONE
+#define RENDER_BLEND_PREMULTIPLIED 3   // GL_ONE, GL_ONE_MINUS_SRC_ALPHA without depth writes, alpha 0 is additive
+
+// view space depth mapped to the depth bits of the sort key (far plane of the projection)
+#define RENDER_DEPTH_RANGE    10.0f
+
+// fixed location of the objectId vertex attribute, see PROGRAM_ATTRIBUTES of programCache.cpp
+#define RENDER_OBJECT_ID_LOCATION 8
+// draw buffer of the object IDs in the framebuffer of the ID buffer
+#define RENDER_OBJECT_ID_BUFFER   1
+
+// shader storage binding points of the per draw data of the indirect items
+#define RENDER_DRAW_DATA_BINDING 0
+#define RENDER_MATERIAL_BINDING  1
+
+struct MeshGeometryMaterial;
+struct _commonShaderProgram;
+struct RenderItem;
+
+// sets uniforms of the item for its program, the program is already in use
+typedef void (*RenderUniformsFunction)(const RenderItem &item, const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix);
+
+/**
+*	struct for one draw call
+*
+*/
+typedef struct RenderItem {
+	// state
+	GLuint        program;
+	GLuint        vertexArrayObject;
+	GLuint        texture;            // texture bound to unit 0, 0 for none
+	GLenum        textureTarget;      // GL_TEXTURE_2D or GL_TEXTURE_CUBE_MAP
+	int           layer;              // RENDER_LAYER_*
+	int           blendMode;          // RENDER_BLEND_*
+	bool          depthTest;
+	unsigned int  objectId;           // packed PickHandle written to the object ID buffer, 0 = not pickable
+
+	// draw call
+	GLenum        primitive;          // GL_TRIANGLES or GL_TRIANGLE_STRIP
+	GLenum        indexType;          // type of indices, 0 for glDrawArrays()
+	unsigned int  first;              // first index or vertex
+	int           baseVertex;         // added to the indices, only with baseVertexSupported() of meshBuffer.h
+	unsigned int  count;              // number of indices or vertices
+	unsigned int  instanceCount;      // instances of an instanced draw call, 1 for a plain draw call
+	bool          indirect;           // indexed draw call of a multi-draw indirect call, uniforms come from the per draw data
+	unsigned int  fullDetailTriangles; // of all instances
+	float         depth;              // view space distance used for the sorting
+
+	// uniforms
+	RenderUniformsFunction      setUniforms;
+	int                         transform;    // pose added by addRenderTransform(), -1 if modelMatrix is set directly
+	glm::mat4                   modelMatrix;
+	glm::mat4                   normalMatrix; // inverse transposed view * model, only for items with a pose
+	const MeshGeometryMaterial* material;  // material of the common shader program or NULL
+	const _commonShaderProgram* shader;    // variant of the common shader program the program belongs to or NULL
+	float                       params[2]; // program specific values (time, frame duration)
+} RenderItem;
+
+void beginRenderQueue(const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix);
+void setRenderObjectId(unsigned int objectId);
+RenderItem* pushRenderItem(const glm::vec3 &position);
+int addRenderTransform(const glm::vec3 &position, const glm::vec3 &front, const glm::vec3 &up, float scale);
+const Frustum& renderFrustum();
+void flushRenderQueue();
+void deleteRenderQueue();
+
+#endif
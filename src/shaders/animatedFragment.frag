@@ -5,8 +5,10 @@ uniform float time;            // time used for simulation of moving lights (suc
 uniform mat4 PVMmatrix;        // Projection * View * Model  --> model to clip coordinates
 
 out vec4  color_f;             // outgoing fragment color
+out uint  objectId_f;          // object ID buffer, the ufo cannot be picked
 smooth in vec2 texCoord_v;     // fragment texture coordinates
 
 void main() {	
 	color_f = texture(texSampler, texCoord_v);	
+	objectId_f = 0u;
 }
\ No newline at end of file
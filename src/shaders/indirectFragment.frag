@@ -0,0 +1,189 @@
+#version 430
+
+#define MAX_TEXTURE_ARRAYS 8
+
+struct Material {
+	vec3  ambient;             // ambient component
+	vec3  diffuse;             // diffuse component
+	vec3  specular;            // specular component
+	float shininess;           // sharpness of specular reflection
+};
+
+struct Light {                 // structure describing light parameters, ClusterLight
+	vec4  position;            // light position in eye coordinates
+	vec4  ambient;             // intensity & color of the ambient component
+	vec4  diffuse;             // intensity & color of the diffuse component
+	vec4  specular;            // intensity & color of the specular component
+	vec4  spotDirection;       // spotlight direction in eye coordinates
+	float spotCosCutoff;       // cosine of the spotlight's half angle, -1 for lights without a cone
+	float spotExponent;        // distribution of the light energy within the reflector's cone (center->cone's edge)
+	float constantAttenuation;
+	float linearAttenuation;
+	float quadraticAttenuation;
+	float intensity;
+	float range;               // the light fades out to zero at this distance
+};
+
+layout(std140) uniform FrameData {  // per frame values shared by all programs, FrameUniforms
+	mat4  Vmatrix;             // View                       --> world to eye coordinates
+	mat4  Pmatrix;             // Projection                 --> eye to clip coordinates
+	mat4  PVmatrix;            // Projection * View
+	vec4  sunDirection;        // direction to the sun in eye coordinates
+	vec4  fogColor;
+	float fogDensity;
+	int   fogActive;
+};
+
+layout(std140) uniform LightData {  // clusters of the lamps, flashlight and explosions, LightUniforms
+	vec4  clusterScale;        // clusters per pixel in x and y, slices per log of the depth and the slice of depth 1
+	ivec3 clusterGrid;         // number of clusters in x, y and z
+	int   numLights;
+};
+
+uniform samplerBuffer  lightTexels;       // ClusterLight, 7 texels per light
+uniform usamplerBuffer clusterTexels;     // first index and point | spot << 16 light counts of each cluster
+uniform usamplerBuffer lightIndexTexels;  // lights of all clusters
+
+struct MaterialData {          // material of the multi-draw indirect calls, RenderMaterial
+	vec4  ambient;
+	vec4  diffuse;
+	vec4  specular;
+	float shininess;
+	int   useTexture;
+	int   textureArray;        // index to materialTextures
+	int   textureLayer;
+};
+
+layout(std430, binding = 1) readonly buffer MaterialBuffer {  // RENDER_MATERIAL_BINDING
+	MaterialData materials[];
+};
+
+smooth in vec2 texCoord_v;      // fragment texture coordinates
+smooth in vec3 normal_v;		//camera space normal
+smooth in vec3 position_v;      // camera space position
+flat in uint objectId_v;        // packed PickHandle of the object
+flat in uint material_v;        // index to the materials of the frame
+
+uniform sampler2DArray materialTextures[MAX_TEXTURE_ARRAYS];  // textures of all materials, bound once
+uniform float time;             // time used for simulation of moving lights (such as sun)
+
+out vec4       color_f;        // outgoing fragment color
+out uint       objectId_f;     // object ID buffer, masked out when it is not drawn to
+
+// ambient, diffuse and specular reflection of the light coming from direction L
+vec3 reflectLight(Light light, Material material, vec3 L, vec3 N, vec3 V) {
+	vec3 result = light.ambient.rgb * material.ambient;
+	result += max(dot(L, N), 0.0f) * light.diffuse.rgb * material.diffuse;
+	result += pow(max(dot(reflect(-L, N), V), 0.0f), material.shininess) * light.specular.rgb * material.specular;
+	return result;
+}
+
+// attenuation by the distance, it fades out to zero at the range of the light
+float distanceAttenuation(Light light, float dst) {
+	float attenuationFactor = 1.0f / (light.constantAttenuation + light.linearAttenuation * dst + light.quadraticAttenuation * (dst * dst));
+	float rangeFactor = clamp(1.0f - pow(dst / light.range, 4.0f), 0.0f, 1.0f);
+	return attenuationFactor * rangeFactor * rangeFactor * light.intensity;
+}
+
+// the sun, position is the direction to the light
+vec3 directionalLight(Light light, Material material, vec3 N, vec3 V) {
+	return reflectLight(light, material, normalize(light.position.xyz), N, V);
+}
+
+vec3 pointLight(Light light, Material material, vec3 N, vec3 V, vec3 vertexPosition) {
+	vec3 toLight = light.position.xyz - vertexPosition;
+	float dst = length(toLight);
+	vec3 L = toLight / dst;
+	return reflectLight(light, material, L, N, V) * distanceAttenuation(light, dst);
+}
+
+vec3 spotLight(Light light, Material material, vec3 N, vec3 V, vec3 vertexPosition) {
+	vec3 toLight = light.position.xyz - vertexPosition;
+	float dst = length(toLight);
+	vec3 L = toLight / dst;
+
+	// nothing outside of the cone
+	float spotFactor = max(dot(-L, light.spotDirection.xyz), 0.0f);
+	float cone = step(light.spotCosCutoff, spotFactor) * pow(spotFactor, light.spotExponent);
+	return reflectLight(light, material, L, N, V) * distanceAttenuation(light, dst) * cone;
+}
+
+Light fetchLight(int index) {
+	int texel = index * 7;
+	vec4 spot = texelFetch(lightTexels, texel + 5);
+	vec4 attenuation = texelFetch(lightTexels, texel + 6);
+
+	Light light;
+	light.position = texelFetch(lightTexels, texel);
+	light.ambient = texelFetch(lightTexels, texel + 1);
+	light.diffuse = texelFetch(lightTexels, texel + 2);
+	light.specular = texelFetch(lightTexels, texel + 3);
+	light.spotDirection = texelFetch(lightTexels, texel + 4);
+	light.spotCosCutoff = spot.x;
+	light.spotExponent = spot.y;
+	light.constantAttenuation = spot.z;
+	light.linearAttenuation = spot.w;
+	light.quadraticAttenuation = attenuation.x;
+	light.intensity = attenuation.y;
+	light.range = attenuation.z;
+	return light;
+}
+
+void main() {
+	MaterialData data = materials[material_v];
+	Material material = Material(data.ambient.rgb, data.diffuse.rgb, data.specular.rgb, data.shininess);
+
+	vec3 globalAmbientLight = vec3(0.20f);
+  	vec4 outputColor = vec4(globalAmbientLight * material.ambient, 0.0f); //ambient light from the environment
+	
+	vec3 N = normalize(normal_v);
+	vec3 V = normalize(-position_v);
+
+	// sun
+	Light sunLight;
+	sunLight.ambient  = vec4(0.0f);
+	sunLight.diffuse  = vec4(1.0f, 1.0f, 0.7f, 1.0f);
+	sunLight.specular = vec4(1.0f);
+	sunLight.position = sunDirection;
+	outputColor.rgb += directionalLight(sunLight, material, N, V);
+	outputColor.a = 1.0f;
+	
+	color_f = outputColor;
+	objectId_f = objectId_v;
+
+#if defined(POINT_LIGHTS) || defined(SPOT_LIGHTS)
+	// lights of the cluster of the fragment, the slice grows exponentially with the depth
+	ivec3 cluster = ivec3(gl_FragCoord.xy * clusterScale.xy, log(max(-position_v.z, 1e-4f)) * clusterScale.z + clusterScale.w);
+	cluster = clamp(cluster, ivec3(0), clusterGrid - 1);
+	uvec2 clusterLights = texelFetch(clusterTexels, (cluster.z * clusterGrid.y + cluster.y) * clusterGrid.x + cluster.x).xy;
+
+	// point lights of the cluster are followed by its spot lights
+	uint index = clusterLights.x;
+	uint pointEnd = index + (clusterLights.y & 0xFFFFu);
+	uint spotEnd = pointEnd + (clusterLights.y >> 16);
+#endif
+
+#ifdef POINT_LIGHTS
+	for (; index < pointEnd; index++) {
+		Light light = fetchLight(int(texelFetch(lightIndexTexels, int(index)).x));
+		color_f.rgb += pointLight(light, material, N, V, position_v);
+	}
+#endif
+
+#ifdef SPOT_LIGHTS
+	for (index = pointEnd; index < spotEnd; index++) {
+		Light light = fetchLight(int(texelFetch(lightIndexTexels, int(index)).x));
+		color_f.rgb += spotLight(light, material, N, V, position_v);
+	}
+#endif
+		
+#ifdef USE_TEXTURE
+	color_f = color_f * texture(materialTextures[data.textureArray], vec3(texCoord_v, data.textureLayer));
+#endif
+
+#ifdef USE_FOG
+	float fogFunc = exp(-pow(fogDensity * abs(gl_FragCoord.z / gl_FragCoord.w), 2.0f));
+	fogFunc = 1.0f - clamp(fogFunc, 0.0f, 1.0f);
+	color_f = mix(color_f, fogColor, fogFunc);
+#endif
+}
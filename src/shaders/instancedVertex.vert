@@ -0,0 +1,34 @@
+#version 140
+
+layout(std140) uniform FrameData {  // per frame values shared by all programs, FrameUniforms
+	mat4  Vmatrix;             // View --> world to eye coordinates
+	mat4  Pmatrix;             // Projection --> eye to clip coordinates
+	mat4  PVmatrix;            // Projection * View
+	vec4  sunDirection;
+	vec4  fogColor;
+	float fogDensity;
+	int   fogActive;
+};
+
+in vec3 position;           
+in vec3 normal;            
+in vec2 texCoord;           
+in mat4 instanceMatrix;        // Model --> model to world coordinates, one per instance
+in uint objectId;              // packed PickHandle, per instance or constant
+
+smooth out vec2 texCoord_v;  
+smooth out vec3 normal_v;      //normal in eye coord
+smooth out vec3 position_v;    //vertex in eye coord
+flat out uint objectId_v;
+
+
+void main() {
+	vec4 worldPosition = instanceMatrix * vec4(position, 1.0f);
+
+	// instances are scaled uniformly, the model matrix transforms normals too, no inverse needed
+	normal_v = normalize((Vmatrix * instanceMatrix * vec4(normal, 0.0f)).xyz);
+	position_v = (Vmatrix * worldPosition).xyz;
+	texCoord_v = texCoord;
+	objectId_v = objectId;
+	gl_Position = PVmatrix * worldPosition;
+}
@@ -0,0 +1,15 @@
+#version 140
+
+smooth in vec2 corner_v;       // position in the quad, -1 .. 1
+smooth in vec4 color_v;        // color with premultiplied alpha
+
+out vec4 color_f;              // outgoing fragment color, blended by GL_ONE, GL_ONE_MINUS_SRC_ALPHA
+
+void main() {
+	float distance2 = dot(corner_v, corner_v);
+	if (distance2 > 1.0f)
+		discard;
+
+	// soft edge of the disc
+	color_f = color_v * (1.0f - distance2);
+}
@@ -0,0 +1,163 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       textureArrays.cpp
+* \author     agent
+* \date       2026
+* \brief      Material textures copied into texture arrays.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#include <iostream>
+#include <algorithm>
+#include "pgr.h"
+#include "textureArrays.h"
+
+/**
+*	struct for the format shared by all layers of an array
+*
+*/
+typedef struct TextureArrayFormat {
+	GLint internalFormat;
+	GLint width;
+	GLint height;
+	GLint numLevels;
+} TextureArrayFormat;
+
+/**
+*	struct for one texture array
+*
+*/
+typedef struct TextureArray {
+	TextureArrayFormat  format;
+	GLuint              texture;
+	std::vector<GLuint> sources;   // texture copied into each layer
+} TextureArray;
+
+static std::vector<TextureArray> textureArrays;
+
+/**
+*	Returns format, size and number of mipmap levels of the 2D texture.
+*/
+static TextureArrayFormat textureFormat(GLuint texture) {
+	TextureArrayFormat format;
+	GLint maxLevel = 0;
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &format.internalFormat);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &format.width);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &format.height);
+	glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// the default maximal level is 1000, the chain ends with 1x1
+	GLint fullChain = 1;
+	while ((std::max(format.width, format.height) >> fullChain) > 0)
+		fullChain++;
+	format.numLevels = std::min(maxLevel + 1, fullChain);
+
+	return format;
+}
+
+/**
+*	Returns true if the textures can be layers of one array.
+*/
+static bool sameFormat(const TextureArrayFormat &a, const TextureArrayFormat &b) {
+	return a.internalFormat == b.internalFormat && a.width == b.width && a.height == b.height && a.numLevels == b.numLevels;
+}
+
+/**
+*	Copies the textures into texture arrays and binds the arrays to their texture units,
+*	arrays of the previous call are deleted. The textures themselves are not changed.
+*	Textures of more than MAX_TEXTURE_ARRAYS different formats do not get a layer.
+*	\param[in]  textures 2D textures, 0 and repeated textures are allowed.
+*	\param[out] layers   Array and layer of each texture.
+*/
+void buildTextureArrays(const std::vector<GLuint> &textures, std::vector<TextureArrayLayer> *layers) {
+
+	deleteTextureArrays();
+
+	TextureArrayLayer none = { -1, 0 };
+	layers->assign(textures.size(), none);
+
+	for (size_t i = 0; i < textures.size(); i++) {
+		if (textures[i] == 0)
+			continue;
+
+		// texture shared by several materials is copied only once
+		for (size_t a = 0; a < textureArrays.size() && (*layers)[i].array < 0; a++) {
+			std::vector<GLuint>::const_iterator it = std::find(textureArrays[a].sources.begin(), textureArrays[a].sources.end(), textures[i]);
+			if (it != textureArrays[a].sources.end()) {
+				(*layers)[i].array = (int)a;
+				(*layers)[i].layer = (int)(it - textureArrays[a].sources.begin());
+			}
+		}
+		if ((*layers)[i].array >= 0)
+			continue;
+
+		TextureArrayFormat format = textureFormat(textures[i]);
+
+		size_t a = 0;
+		while (a < textureArrays.size() && !sameFormat(textureArrays[a].format, format))
+			a++;
+
+		if (a == textureArrays.size()) {
+			if (a == MAX_TEXTURE_ARRAYS)
+				continue;
+			TextureArray array;
+			array.format = format;
+			array.texture = 0;
+			textureArrays.push_back(array);
+		}
+
+		(*layers)[i].array = (int)a;
+		(*layers)[i].layer = (int)textureArrays[a].sources.size();
+		textureArrays[a].sources.push_back(textures[i]);
+	}
+
+	unsigned int numLayers = 0;
+
+	for (size_t a = 0; a < textureArrays.size(); a++) {
+		TextureArray *array = &textureArrays[a];
+		const TextureArrayFormat &format = array->format;
+		GLsizei arrayLayers = (GLsizei)array->sources.size();
+
+		glGenTextures(1, &array->texture);
+		glActiveTexture(GL_TEXTURE0 + TEXTURE_ARRAY_UNIT + (GLenum)a);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, array->texture);
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, format.numLevels, format.internalFormat, format.width, format.height, arrayLayers);
+
+		// the levels are copied on the GPU, compressed blocks included
+		for (GLsizei layer = 0; layer < arrayLayers; layer++) {
+			for (GLint level = 0; level < format.numLevels; level++) {
+				glCopyImageSubData(array->sources[layer], GL_TEXTURE_2D, level, 0, 0, 0,
+					array->texture, GL_TEXTURE_2D_ARRAY, level, 0, 0, layer,
+					std::max(1, format.width >> level), std::max(1, format.height >> level), 1);
+			}
+		}
+
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, format.numLevels - 1);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		numLayers += arrayLayers;
+	}
+
+	// the arrays stay bound, the other textures are bound to unit 0
+	glActiveTexture(GL_TEXTURE0);
+	CHECK_GL_ERROR();
+
+	std::cout << "Texture arrays: " << numLayers << " textures in " << textureArrays.size() << " arrays" << std::endl;
+}
+
+/**
+*	Deletes the texture arrays.
+*/
+void deleteTextureArrays() {
+
+	for (size_t a = 0; a < textureArrays.size(); a++)
+		glDeleteTextures(1, &textureArrays[a].texture);
+
+	textureArrays.clear();
+}
@@ -0,0 +1,38 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       textureArrays.h
+* \author     agent
+* \date       2026
+* \brief      Material textures copied into texture arrays.
+*
+*	Textures of the loaded models are grouped by their format, size and number of mipmap
+*	levels, each group is copied on the GPU into the layers of one GL_TEXTURE_2D_ARRAY.
+*	The arrays stay bound to their own texture units, a material only stores its array and
+*	layer, so draws with different materials need no texture binds. Needs OpenGL 4.3.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#ifndef __TEXTUREARRAYS_H
+#define __TEXTUREARRAYS_H
+
+#include "pgr.h"
+#include <vector>
+
+// arrays are bound to units TEXTURE_ARRAY_UNIT .. TEXTURE_ARRAY_UNIT + MAX_TEXTURE_ARRAYS - 1, unit 0 is used by the render queue
+#define TEXTURE_ARRAY_UNIT  1
+#define MAX_TEXTURE_ARRAYS  8     // has to match MAX_TEXTURE_ARRAYS of indirectFragment.frag
+
+/**
+*	struct for the place of a texture in the arrays
+*
+*/
+typedef struct TextureArrayLayer {
+	int array;   // index of the array, -1 if the texture is not in any array
+	int layer;
+} TextureArrayLayer;
+
+void buildTextureArrays(const std::vector<GLuint> &textures, std::vector<TextureArrayLayer> *layers);
+void deleteTextureArrays();
+
+#endif
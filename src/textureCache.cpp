@@ -0,0 +1,456 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       textureCache.cpp
+* \author     agent
+* \date       2026
+* \brief      Cooked textures with the whole mipmap chain.
+*
+*	Cache file layout (similar to KTX): header | name | padding to 4 bytes |
+*	for each level, for each face: image size (unsigned int) | image | padding to 4 bytes.
+*	Compressed images are stored as returned by glGetCompressedTexImage().
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include "textureCache.h"
+
+/**
+*	header of the cache file
+*
+*/
+typedef struct TextureCacheHeader {
+	char         magic[4];          // "A51T"
+	unsigned int version;           // TEXTURE_CACHE_VERSION
+	unsigned int nameLength;
+	long long    sourceTime;        // newest modification time of the source images
+	unsigned int internalFormat;
+	unsigned int format;            // pixel format of uncompressed images, 0 for compressed ones
+	unsigned int width;
+	unsigned int height;
+	unsigned int numFaces;
+	unsigned int numLevels;
+} TextureCacheHeader;
+
+static const char TEXTURE_CACHE_MAGIC[4] = { 'A', '5', '1', 'T' };
+
+/**
+*	Rounds size up to the multiple of four bytes.
+*/
+static size_t alignSize(size_t size) {
+	return (size + 3) & ~(size_t)3;
+}
+
+/**
+*	Returns true if the driver can compress and upload S3TC textures.
+*	Has to be called from the thread owning the OpenGL context.
+*/
+bool textureCompressionSupported() {
+	static int supported = -1;
+
+	if (supported < 0) {
+		GLint numExtensions = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+
+		supported = 0;
+		for (GLint i = 0; i < numExtensions; i++) {
+			const char *extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+			if (extension != NULL && strcmp(extension, "GL_EXT_texture_compression_s3tc") == 0)
+				supported = 1;
+		}
+	}
+
+	return supported == 1;
+}
+
+/**
+*	Returns name of the cache file for given texture.
+*	\param[in] name Path to the source image or name of the cube map.
+*/
+std::string textureCacheFileName(const std::string &name) {
+	std::string fileName = name;
+
+	for (size_t i = 0; i < fileName.size(); i++) {
+		if (fileName[i] == '/' || fileName[i] == '\\' || fileName[i] == ':' || fileName[i] == '*')
+			fileName[i] = '_';
+	}
+
+	return std::string(TEXTURE_CACHE_DIRECTORY) + fileName + ".tex";
+}
+
+/**
+*	Returns the newest modification time of the source images or -1 if one of them is missing.
+*/
+static long long sourceModificationTime(const std::vector<std::string> &sourceFiles) {
+	long long newest = -1;
+
+	for (size_t i = 0; i < sourceFiles.size(); i++) {
+		long long time = fileModificationTime(sourceFiles[i]);
+		if (time < 0)
+			return -1;
+		newest = std::max(newest, time);
+	}
+
+	return newest;
+}
+
+/**
+*	Returns target of one face of the texture.
+*/
+static GLenum faceTarget(GLenum target, unsigned int face) {
+	return target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : target;
+}
+
+/**
+*	Sets filtering of the bound texture with all mipmap levels present.
+*/
+static void setCookedTextureParameters(GLenum target, unsigned int numLevels) {
+	glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
+	glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+/**
+*	Builds mipmap chain down to 1x1 with a 2x2 box filter, level 0 is the image itself.
+*	\param[in]  image  Decoded image.
+*	\param[out] levels All mipmap levels.
+*/
+static void buildMipmaps(const ImageData &image, std::vector<ImageData> *levels) {
+
+	levels->assign(1, image);
+
+	while (levels->back().width > 1 || levels->back().height > 1) {
+		ImageData level;
+		const ImageData &source = levels->back();
+
+		level.width = std::max(1, source.width / 2);
+		level.height = std::max(1, source.height / 2);
+		level.channels = source.channels;
+		level.pixels.resize((size_t)level.width * level.height * level.channels);
+
+		for (int y = 0; y < level.height; y++) {
+			int y0 = std::min(2 * y, source.height - 1);
+			int y1 = std::min(2 * y + 1, source.height - 1);
+
+			for (int x = 0; x < level.width; x++) {
+				int x0 = std::min(2 * x, source.width - 1);
+				int x1 = std::min(2 * x + 1, source.width - 1);
+
+				for (int c = 0; c < level.channels; c++) {
+					unsigned int sum = source.pixels[((size_t)y0 * source.width + x0) * source.channels + c]
+						+ source.pixels[((size_t)y0 * source.width + x1) * source.channels + c]
+						+ source.pixels[((size_t)y1 * source.width + x0) * source.channels + c]
+						+ source.pixels[((size_t)y1 * source.width + x1) * source.channels + c];
+					level.pixels[((size_t)y * level.width + x) * level.channels + c] = (unsigned char)((sum + 2) / 4);
+				}
+			}
+		}
+
+		levels->push_back(level);
+	}
+}
+
+/**
+*	Maps cooked texture from the cache, can run on a worker thread.
+*	Cache file is valid only if it has the same version, name and the source images have not changed.
+*	\param[in]  name        Path to the source image or name of the cube map.
+*	\param[in]  sourceFiles Source images, one per face.
+*	\param[out] texture     Levels pointing into the mapped cache file.
+*	\return True on cache hit.
+*/
+bool loadCookedTexture(const std::string &name, const std::vector<std::string> &sourceFiles, CookedTexture *texture) {
+
+	memset(&texture->mapping, 0, sizeof(MappedFile));
+	texture->images.clear();
+	texture->imageSizes.clear();
+
+	long long sourceTime = sourceModificationTime(sourceFiles);
+	if (sourceTime < 0)
+		return false;
+
+	MappedFile file;
+	if (!mapFile(textureCacheFileName(name), &file))
+		return false;
+
+	TextureCacheHeader header;
+	if (file.size < sizeof(TextureCacheHeader)) {
+		unmapFile(&file);
+		return false;
+	}
+	memcpy(&header, file.data, sizeof(TextureCacheHeader));
+
+	size_t offset = sizeof(TextureCacheHeader) + alignSize(header.nameLength);
+
+	if (memcmp(header.magic, TEXTURE_CACHE_MAGIC, sizeof(header.magic)) != 0
+		|| header.version != TEXTURE_CACHE_VERSION
+		|| header.sourceTime != sourceTime
+		|| header.numFaces != sourceFiles.size()
+		|| header.numLevels == 0 || header.numLevels > TEXTURE_MAX_LEVELS
+		|| header.width == 0 || header.height == 0
+		|| file.size < offset
+		|| name.compare(0, std::string::npos, (const char*)file.data + sizeof(TextureCacheHeader), header.nameLength) != 0) {
+		unmapFile(&file);
+		return false;
+	}
+
+	unsigned int bytesPerPixel = header.format == GL_RGBA ? 4 : 3;
+
+	for (unsigned int level = 0; level < header.numLevels; level++) {
+		unsigned int width = std::max(1u, header.width >> level);
+		unsigned int height = std::max(1u, header.height >> level);
+
+		for (unsigned int face = 0; face < header.numFaces; face++) {
+			unsigned int imageSize;
+			if (file.size < offset + sizeof(imageSize)) {
+				unmapFile(&file);
+				return false;
+			}
+			memcpy(&imageSize, file.data + offset, sizeof(imageSize));
+			offset += sizeof(imageSize);
+
+			// uncompressed images must have exactly the size read by glTexImage2D()
+			if (file.size < offset + imageSize || (header.format != 0 && imageSize != width * height * bytesPerPixel)) {
+				unmapFile(&file);
+				return false;
+			}
+
+			texture->images.push_back(file.data + offset);
+			texture->imageSizes.push_back(imageSize);
+			offset += alignSize(imageSize);
+		}
+	}
+
+	if (offset != file.size) {
+		texture->images.clear();
+		texture->imageSizes.clear();
+		unmapFile(&file);
+		return false;
+	}
+
+	texture->internalFormat = header.internalFormat;
+	texture->format = header.format;
+	texture->width = header.width;
+	texture->height = header.height;
+	texture->numFaces = header.numFaces;
+	texture->numLevels = header.numLevels;
+	texture->mapping = file;
+
+	return true;
+}
+
+/**
+*	Unmaps the cache file of the cooked texture.
+*	\param[in] texture Texture loaded by loadCookedTexture().
+*/
+void releaseCookedTexture(CookedTexture *texture) {
+	unmapFile(&texture->mapping);
+	texture->images.clear();
+	texture->imageSizes.clear();
+}
+
+/**
+*	Uploads all levels of the cooked texture.
+*	\param[in]  cooked   Texture loaded by loadCookedTexture().
+*	\param[out] gpuBytes Size of all levels.
+*	\return Texture name or 0 if the driver cannot use the compressed format.
+*/
+GLuint createCookedTexture(const CookedTexture &cooked, size_t *gpuBytes) {
+
+	*gpuBytes = 0;
+
+	if (cooked.format == 0 && !textureCompressionSupported())
+		return 0;
+
+	GLenum target = cooked.numFaces == 6 ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(target, texture);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (unsigned int level = 0; level < cooked.numLevels; level++) {
+		GLsizei width = std::max(1u, cooked.width >> level);
+		GLsizei height = std::max(1u, cooked.height >> level);
+
+		for (unsigned int face = 0; face < cooked.numFaces; face++) {
+			unsigned int image = level * cooked.numFaces + face;
+
+			if (cooked.format == 0)
+				glCompressedTexImage2D(faceTarget(target, face), level, cooked.internalFormat, width, height, 0, cooked.imageSizes[image], cooked.images[image]);
+			else
+				glTexImage2D(faceTarget(target, face), level, cooked.internalFormat, width, height, 0, cooked.format, GL_UNSIGNED_BYTE, cooked.images[image]);
+
+			*gpuBytes += cooked.imageSizes[image];
+		}
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	setCookedTextureParameters(target, cooked.numLevels);
+
+	glBindTexture(target, 0);
+	CHECK_GL_ERROR();
+
+	return texture;
+}
+
+/**
+*	Writes cooked images into the cache.
+*/
+static bool saveCookedTexture(const std::string &name, const TextureCacheHeader &header, const std::vector<std::vector<unsigned char> > &images) {
+
+#ifdef _WIN32
+	_mkdir(TEXTURE_CACHE_DIRECTORY);
+#else
+	mkdir(TEXTURE_CACHE_DIRECTORY, 0755);
+#endif
+
+	const char padding[4] = { 0, 0, 0, 0 };
+
+	// write into the temporary file first, half written cache must never be mapped
+	std::string cacheFileName = textureCacheFileName(name);
+	std::string tempFileName = cacheFileName + ".tmp";
+	std::ofstream out(tempFileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!out) {
+		std::cerr << "saveCookedTexture(): cannot create " << tempFileName << std::endl;
+		return false;
+	}
+
+	out.write((const char*)&header, sizeof(TextureCacheHeader));
+	out.write(name.data(), name.size());
+	out.write(padding, alignSize(name.size()) - name.size());
+	for (size_t i = 0; i < images.size(); i++) {
+		unsigned int imageSize = (unsigned int)images[i].size();
+		out.write((const char*)&imageSize, sizeof(imageSize));
+		out.write((const char*)&images[i][0], imageSize);
+		out.write(padding, alignSize(imageSize) - imageSize);
+	}
+	out.close();
+
+	if (!out) {
+		std::cerr << "saveCookedTexture(): cannot write " << tempFileName << std::endl;
+		remove(tempFileName.c_str());
+		return false;
+	}
+
+	remove(cacheFileName.c_str());
+	if (rename(tempFileName.c_str(), cacheFileName.c_str()) != 0) {
+		std::cerr << "saveCookedTexture(): cannot rename " << tempFileName << std::endl;
+		remove(tempFileName.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+/**
+*	Creates texture from decoded images with the whole mipmap chain and stores it into the cache.
+*	The driver compresses the levels during the upload, they are read back for the cache file.
+*	\param[in]  name        Path to the source image or name of the cube map.
+*	\param[in]  sourceFiles Source images, one per face.
+*	\param[in]  faces       Decoded images, 1 for 2D texture or 6 for cube map in order +X, -X, +Y, -Y, +Z, -Z.
+*	\param[out] gpuBytes    Size of all levels.
+*	\return Texture name or 0 if the images are missing or do not match.
+*/
+GLuint cookTexture(const std::string &name, const std::vector<std::string> &sourceFiles, const std::vector<ImageData> &faces, size_t *gpuBytes) {
+
+	*gpuBytes = 0;
+
+	unsigned int numFaces = (unsigned int)faces.size();
+	if (numFaces != 1 && numFaces != 6)
+		return 0;
+
+	for (unsigned int face = 0; face < numFaces; face++) {
+		if (faces[face].pixels.empty() || faces[face].width != faces[0].width
+			|| faces[face].height != faces[0].height || faces[face].channels != faces[0].channels)
+			return 0;
+	}
+
+	std::vector<std::vector<ImageData> > mipmaps(numFaces);
+	for (unsigned int face = 0; face < numFaces; face++)
+		buildMipmaps(faces[face], &mipmaps[face]);
+	unsigned int numLevels = (unsigned int)mipmaps[0].size();
+
+	bool alpha = faces[0].channels == 4;
+	GLenum format = alpha ? GL_RGBA : GL_RGB;
+	GLenum internalFormat = alpha ? GL_RGBA8 : GL_RGB8;
+	if (textureCompressionSupported())
+		internalFormat = alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+
+	GLenum target = numFaces == 6 ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(target, texture);
+
+	// the driver compresses the levels during the upload
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (unsigned int level = 0; level < numLevels; level++) {
+		for (unsigned int face = 0; face < numFaces; face++) {
+			const ImageData &image = mipmaps[face][level];
+			glTexImage2D(faceTarget(target, face), level, internalFormat, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, &image.pixels[0]);
+		}
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	setCookedTextureParameters(target, numLevels);
+
+	GLint compressed = GL_FALSE;
+	if (internalFormat != GL_RGBA8 && internalFormat != GL_RGB8)
+		glGetTexLevelParameteriv(faceTarget(target, 0), 0, GL_TEXTURE_COMPRESSED, &compressed);
+
+	// compressed levels are read back from the driver, uncompressed ones are stored as they are
+	std::vector<std::vector<unsigned char> > images(numLevels * numFaces);
+	for (unsigned int level = 0; level < numLevels; level++) {
+		for (unsigned int face = 0; face < numFaces; face++) {
+			std::vector<unsigned char> *image = &images[level * numFaces + face];
+
+			if (compressed) {
+				GLint imageSize = 0;
+				glGetTexLevelParameteriv(faceTarget(target, face), level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &imageSize);
+				image->resize(imageSize);
+				glGetCompressedTexImage(faceTarget(target, face), level, &(*image)[0]);
+			}
+			else {
+				*image = mipmaps[face][level].pixels;
+			}
+
+			*gpuBytes += image->size();
+		}
+	}
+
+	glBindTexture(target, 0);
+	CHECK_GL_ERROR();
+
+	long long sourceTime = sourceModificationTime(sourceFiles);
+	if (sourceTime < 0)
+		return texture;
+
+	TextureCacheHeader header;
+	memset(&header, 0, sizeof(TextureCacheHeader));
+	memcpy(header.magic, TEXTURE_CACHE_MAGIC, sizeof(header.magic));
+	header.version = TEXTURE_CACHE_VERSION;
+	header.nameLength = (unsigned int)name.size();
+	header.sourceTime = sourceTime;
+	header.internalFormat = compressed ? internalFormat : (alpha ? GL_RGBA8 : GL_RGB8);
+	header.format = compressed ? 0 : format;
+	header.width = faces[0].width;
+	header.height = faces[0].height;
+	header.numFaces = numFaces;
+	header.numLevels = numLevels;
+
+	if (!saveCookedTexture(name, header, images))
+		std::cerr << "cookTexture(): cannot store texture cache for " << name << std::endl;
+
+	return texture;
+}
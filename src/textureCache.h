@@ -0,0 +1,63 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       textureCache.h
+* \author     agent
+* \date       2026
+* \brief      Cooked textures with the whole mipmap chain.
+*
+*	The first launch decodes the source images, builds the mipmaps and lets the driver compress
+*	the levels (S3TC if available). The levels are read back and stored into a KTX-like file.
+*	Next launches map this file on a worker thread and upload the levels directly,
+*	there is no image decoding and no mipmap generation.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#ifndef __TEXTURECACHE_H
+#define __TEXTURECACHE_H
+
+#include "pgr.h"
+#include "meshCache.h"
+#include "textures.h"
+#include <string>
+#include <vector>
+
+#define TEXTURE_CACHE_DIRECTORY  "cache/"
+#define TEXTURE_CACHE_VERSION    1
+
+// maximal number of mipmap levels of a cooked texture (16k x 16k)
+#define TEXTURE_MAX_LEVELS       15
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT  0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+/**
+*	struct for a cooked texture mapped from the cache
+*
+*/
+typedef struct CookedTexture {
+	GLenum                            internalFormat;
+	GLenum                            format;       // pixel format of uncompressed levels, 0 for compressed levels
+	unsigned int                      width;
+	unsigned int                      height;
+	unsigned int                      numFaces;     // 1 for 2D textures, 6 for cube maps
+	unsigned int                      numLevels;
+	std::vector<const unsigned char*> images;       // image of face f in level l is at l * numFaces + f
+	std::vector<unsigned int>         imageSizes;
+	MappedFile                        mapping;
+} CookedTexture;
+
+bool textureCompressionSupported();
+
+std::string textureCacheFileName(const std::string &name);
+bool loadCookedTexture(const std::string &name, const std::vector<std::string> &sourceFiles, CookedTexture *texture);
+void releaseCookedTexture(CookedTexture *texture);
+
+GLuint createCookedTexture(const CookedTexture &cooked, size_t *gpuBytes);
+GLuint cookTexture(const std::string &name, const std::vector<std::string> &sourceFiles, const std::vector<ImageData> &faces, size_t *gpuBytes);
+
+#endif
@@ -0,0 +1,136 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       textures.cpp
+* \author     agent
+* \date       2026
+* \brief      Decoding of texture images and their upload to OpenGL.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#include <iostream>
+#include <fstream>
+#include <mutex>
+#include <IL/il.h>
+#include "textures.h"
+
+// DevIL keeps the bound image in global state, decoding itself has to be serialized
+static std::mutex devilMutex;
+
+/**
+*	Reads whole file into memory.
+*	\param[in]  fileName File to read.
+*	\param[out] content  File content.
+*	\return True if the file has been read.
+*/
+static bool readFile(const std::string &fileName, std::vector<char> *content) {
+	std::ifstream in(fileName.c_str(), std::ios::in | std::ios::binary);
+	if (!in)
+		return false;
+
+	in.seekg(0, std::ios::end);
+	std::streamoff size = in.tellg();
+	in.seekg(0, std::ios::beg);
+	if (size <= 0)
+		return false;
+
+	content->resize((size_t)size);
+	in.read(&(*content)[0], size);
+
+	return !in.fail();
+}
+
+/**
+*	Decodes image file into memory, safe to call from worker threads.
+*	File is read without any lock, only the DevIL decoding is serialized.
+*	\param[in]  fileName Image file.
+*	\param[out] image    Decoded image in RGB or RGBA format.
+*	\return True if the image has been decoded.
+*/
+bool decodeImage(const std::string &fileName, ImageData *image) {
+
+	std::vector<char> content;
+	if (!readFile(fileName, &content)) {
+		std::cerr << "decodeImage(): cannot read image " << fileName << std::endl;
+		return false;
+	}
+
+	std::unique_lock<std::mutex> lock(devilMutex);
+
+	ILuint imageID;
+	ilGenImages(1, &imageID);
+	ilBindImage(imageID);
+
+	// set origin to the lower left corner (the orientation which OpenGL uses)
+	ilEnable(IL_ORIGIN_SET);
+	ilSetInteger(IL_ORIGIN_MODE, IL_ORIGIN_LOWER_LEFT);
+
+	if (ilLoadL(ilTypeFromExt(fileName.c_str()), &content[0], (ILuint)content.size()) == IL_FALSE) {
+		ilDeleteImages(1, &imageID);
+		std::cerr << "decodeImage(): cannot decode image " << fileName << std::endl;
+		return false;
+	}
+
+	ILenum format = ilGetInteger(IL_IMAGE_FORMAT);
+	image->width = ilGetInteger(IL_IMAGE_WIDTH);
+	image->height = ilGetInteger(IL_IMAGE_HEIGHT);
+	image->channels = (format == IL_RGBA || format == IL_BGRA) ? 4 : 3;
+	image->pixels.resize((size_t)image->width * image->height * image->channels);
+
+	// convert image to RGB or RGBA, one byte per channel
+	ilCopyPixels(0, 0, 0, image->width, image->height, 1, image->channels == 4 ? IL_RGBA : IL_RGB, IL_UNSIGNED_BYTE, &image->pixels[0]);
+	ilDeleteImages(1, &imageID);
+
+	return true;
+}
+
+/**
+*	Frees memory held by the image.
+*	\param[in] image Image to release.
+*/
+void releaseImage(ImageData *image) {
+	std::vector<unsigned char>().swap(image->pixels);
+	image->width = 0;
+	image->height = 0;
+}
+
+/**
+*	Uploads decoded image into the currently bound texture.
+*	\param[in] image  Decoded image.
+*	\param[in] target Texture target (GL_TEXTURE_2D or a cube map face).
+*/
+void uploadTexImage2D(const ImageData &image, GLenum target) {
+	GLenum format = image.channels == 4 ? GL_RGBA : GL_RGB;
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(target, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, &image.pixels[0]);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+/**
+*	Creates 2D texture from decoded image, same settings as pgr::createTexture().
+*	\param[in] image  Decoded image.
+*	\param[in] mipmap Generate mipmaps and use trilinear filtering.
+*	\return Texture name or 0 if the image is empty.
+*/
+GLuint createTextureFromImage(const ImageData &image, bool mipmap) {
+
+	if (image.pixels.empty())
+		return 0;
+
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+
+	uploadTexImage2D(image, GL_TEXTURE_2D);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmap ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	if (mipmap)
+		glGenerateMipmap(GL_TEXTURE_2D);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	CHECK_GL_ERROR();
+
+	return texture;
+}
@@ -0,0 +1,38 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       textures.h
+* \author     agent
+* \date       2026
+* \brief      Decoding of texture images and their upload to OpenGL.
+*
+*	Images are decoded into memory by decodeImage(), which can run on a worker thread.
+*	Only the upload functions have to be called from the thread owning the OpenGL context.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#ifndef __TEXTURES_H
+#define __TEXTURES_H
+
+#include "pgr.h"
+#include <string>
+#include <vector>
+
+/**
+*	struct for a decoded image
+*
+*/
+typedef struct ImageData {
+	int                        width;
+	int                        height;
+	int                        channels;  // 3 for RGB, 4 for RGBA, one byte per channel
+	std::vector<unsigned char> pixels;    // rows from the bottom to the top (OpenGL orientation)
+} ImageData;
+
+bool decodeImage(const std::string &fileName, ImageData *image);
+void releaseImage(ImageData *image);
+
+void uploadTexImage2D(const ImageData &image, GLenum target);
+GLuint createTextureFromImage(const ImageData &image, bool mipmap = true);
+
+#endif
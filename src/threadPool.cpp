@@ -0,0 +1,134 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       threadPool.cpp
+* \author     agent
+* \date       2026
+* \brief      Pool of worker threads.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include "threadPool.h"
+
+/**
+*	struct for a pool of worker threads
+*
+*/
+typedef struct ThreadPool {
+	std::vector<std::thread>           workers;
+	std::deque<std::function<void()> > tasks;
+	std::mutex                         mutex;
+	std::condition_variable            taskAvailable;  // signaled when a task is queued or the pool stops
+	std::condition_variable            tasksFinished;  // signaled when the last running task finishes
+	unsigned int                       runningTasks;
+	bool                               stop;
+} ThreadPool;
+
+static ThreadPool pool;
+
+/**
+*	Main loop of a worker thread.
+*/
+static void workerLoop() {
+
+	for (;;) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(pool.mutex);
+			while (!pool.stop && pool.tasks.empty())
+				pool.taskAvailable.wait(lock);
+
+			if (pool.stop && pool.tasks.empty())
+				return;
+
+			task = pool.tasks.front();
+			pool.tasks.pop_front();
+			pool.runningTasks++;
+		}
+
+		task();
+
+		{
+			std::unique_lock<std::mutex> lock(pool.mutex);
+			pool.runningTasks--;
+			if (pool.runningTasks == 0 && pool.tasks.empty())
+				pool.tasksFinished.notify_all();
+		}
+	}
+}
+
+/**
+*	Starts worker threads.
+*	\param[in] numThreads Number of workers, 0 means one worker per hardware thread.
+*/
+void initializeThreadPool(unsigned int numThreads) {
+
+	if (!pool.workers.empty())
+		return;
+
+	if (numThreads == 0)
+		numThreads = std::thread::hardware_concurrency();
+	if (numThreads == 0)
+		numThreads = 2;
+
+	pool.stop = false;
+	pool.runningTasks = 0;
+
+	for (unsigned int i = 0; i < numThreads; i++)
+		pool.workers.push_back(std::thread(workerLoop));
+}
+
+/**
+*	Finishes queued tasks and joins all workers.
+*/
+void finalizeThreadPool() {
+	{
+		std::unique_lock<std::mutex> lock(pool.mutex);
+		pool.stop = true;
+	}
+	pool.taskAvailable.notify_all();
+
+	for (size_t i = 0; i < pool.workers.size(); i++)
+		pool.workers[i].join();
+
+	pool.workers.clear();
+}
+
+/**
+*	Returns number of worker threads.
+*/
+unsigned int threadPoolSize() {
+	return (unsigned int)pool.workers.size();
+}
+
+/**
+*	Queues a task, it is run immediately on the calling thread when the pool is not running.
+*	\param[in] task Task to run.
+*/
+void runTask(const std::function<void()> &task) {
+
+	if (pool.workers.empty()) {
+		task();
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(pool.mutex);
+		pool.tasks.push_back(task);
+	}
+	pool.taskAvailable.notify_one();
+}
+
+/**
+*	Blocks until all queued tasks are finished. Must not be called from a worker.
+*/
+void waitForTasks() {
+	std::unique_lock<std::mutex> lock(pool.mutex);
+	while (pool.runningTasks != 0 || !pool.tasks.empty())
+		pool.tasksFinished.wait(lock);
+}
@@ -0,0 +1,25 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       threadPool.h
+* \author     agent
+* \date       2026
+* \brief      Pool of worker threads.
+*
+*	Workers run tasks that do not touch OpenGL (file reading, mesh import, image decoding).
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#ifndef __THREADPOOL_H
+#define __THREADPOOL_H
+
+#include <functional>
+
+void initializeThreadPool(unsigned int numThreads = 0);
+void finalizeThreadPool();
+unsigned int threadPoolSize();
+
+void runTask(const std::function<void()> &task);
+void waitForTasks();
+
+#endif
@@ -0,0 +1,40 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       timer.cpp
+* \author     agent
+* \date       2026
+* \brief      High resolution monotonic clock.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "timer.h"
+
+/**
+*	Returns time in seconds from an arbitrary fixed point, never goes backwards.
+*/
+double highResolutionTime() {
+#ifdef _WIN32
+	static LARGE_INTEGER frequency = { 0 };
+	LARGE_INTEGER counter;
+
+	if (frequency.QuadPart == 0)
+		QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+
+	return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (double)now.tv_sec + 1e-9 * (double)now.tv_nsec;
+#endif
+}
@@ -0,0 +1,16 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       timer.h
+* \author     agent
+* \date       2026
+* \brief      High resolution monotonic clock.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#ifndef __TIMER_H
+#define __TIMER_H
+
+double highResolutionTime();
+
+#endif
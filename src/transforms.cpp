@@ -0,0 +1,217 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       transforms.cpp
+* \author     agent
+* \date       2026
+* \brief      Model and normal matrices of many objects computed in SIMD batches.
+*
+*	The model matrix of a pose is a rotation with a uniform scale and the view matrix
+*	is rigid, so the inverse transposed view * model matrix is view * rotation / scale
+*	and no general 4x4 inverse is needed. Objects collapsed to scale 0 (the clicked cat)
+*	get a zero normal matrix instead of an infinite one.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#include <math.h>
+#include "pgr.h"
+#include "transforms.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE__)
+#include <xmmintrin.h>
+#define TRANSFORMS_SSE 1
+#endif
+
+/**
+*	Removes all poses, the memory is kept for the next frame.
+*/
+void clearTransforms(TransformArrays *transforms) {
+	transforms->positionX.clear();
+	transforms->positionY.clear();
+	transforms->positionZ.clear();
+	transforms->frontX.clear();
+	transforms->frontY.clear();
+	transforms->frontZ.clear();
+	transforms->upX.clear();
+	transforms->upY.clear();
+	transforms->upZ.clear();
+	transforms->scale.clear();
+	transforms->count = 0;
+}
+
+/**
+*	Adds pose of one object.
+*	\param[in,out] transforms Poses.
+*	\param[in]     position   Position of the object.
+*	\param[in]     front      Direction the object faces, it does not need to be normalized.
+*	\param[in]     up         Up direction of the object.
+*	\param[in]     scale      Uniform scale of the object.
+*	\return Index of the pose, index of its matrices in the output of computeTransforms().
+*/
+unsigned int addTransform(TransformArrays *transforms, const glm::vec3 &position, const glm::vec3 &front, const glm::vec3 &up, float scale) {
+	transforms->positionX.push_back(position.x);
+	transforms->positionY.push_back(position.y);
+	transforms->positionZ.push_back(position.z);
+	transforms->frontX.push_back(front.x);
+	transforms->frontY.push_back(front.y);
+	transforms->frontZ.push_back(front.z);
+	transforms->upX.push_back(up.x);
+	transforms->upY.push_back(up.y);
+	transforms->upZ.push_back(up.z);
+	transforms->scale.push_back(scale);
+
+	return transforms->count++;
+}
+
+/**
+*	Returns rotation of a pose, columns are the x, y and z axes of alignObject().
+*	\param[in] front Direction the object faces, it does not need to be normalized.
+*	\param[in] up    Up direction of the object.
+*/
+glm::mat3 poseRotation(const glm::vec3 &front, const glm::vec3 &up) {
+
+	// z axis looks against the front direction, x axis is perpendicular to up and z
+	glm::vec3 z = -front;
+	float length2 = glm::dot(z, z);
+	z = length2 == 0.0f ? glm::vec3(0.0f, 0.0f, 1.0f) : z * (1.0f / sqrtf(length2));
+
+	glm::vec3 x = glm::cross(up, z);
+	length2 = glm::dot(x, x);
+	x = length2 == 0.0f ? glm::vec3(1.0f, 0.0f, 0.0f) : x * (1.0f / sqrtf(length2));
+
+	return glm::mat3(x, glm::cross(z, x), z);
+}
+
+/**
+*	Computes matrices of one pose, the scalar version of the SIMD loop.
+*/
+static void computeTransform(const TransformArrays &transforms, unsigned int i, const glm::mat4 &viewMatrix, glm::mat4 *modelMatrix, glm::mat4 *normalMatrix) {
+
+	glm::mat3 rotation = poseRotation(glm::vec3(transforms.frontX[i], transforms.frontY[i], transforms.frontZ[i]),
+		glm::vec3(transforms.upX[i], transforms.upY[i], transforms.upZ[i]));
+	const glm::vec3 &x = rotation[0];
+	const glm::vec3 &y = rotation[1];
+	const glm::vec3 &z = rotation[2];
+
+	float scale = transforms.scale[i];
+	glm::mat4 &model = *modelMatrix;
+	model[0] = glm::vec4(x * scale, 0.0f);
+	model[1] = glm::vec4(y * scale, 0.0f);
+	model[2] = glm::vec4(z * scale, 0.0f);
+	model[3] = glm::vec4(transforms.positionX[i], transforms.positionY[i], transforms.positionZ[i], 1.0f);
+
+	if (normalMatrix != NULL) {
+		// only the upper 3x3 part is used for normals, the last row is left zero
+		glm::mat4 &normal = *normalMatrix;
+		glm::vec3 axes[3] = { x, y, z };
+		float inverseScale = scale > 0.0f ? 1.0f / scale : 0.0f;
+		for (int c = 0; c < 3; c++)
+			normal[c] = viewMatrix * glm::vec4(axes[c] * inverseScale, 0.0f);
+		normal[3] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+}
+
+#ifdef TRANSFORMS_SSE
+
+/**
+*	Returns a where mask is set, otherwise b.
+*/
+static inline __m128 selectPs(__m128 mask, __m128 a, __m128 b) {
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+/**
+*	Stores one column of four matrices given as rows of the x, y, z and w components of the four objects.
+*/
+static inline void storeColumns(__m128 x, __m128 y, __m128 z, __m128 w, glm::mat4 *matrices, int column) {
+	_MM_TRANSPOSE4_PS(x, y, z, w);
+	_mm_storeu_ps(&matrices[0][column][0], x);
+	_mm_storeu_ps(&matrices[1][column][0], y);
+	_mm_storeu_ps(&matrices[2][column][0], z);
+	_mm_storeu_ps(&matrices[3][column][0], w);
+}
+
+/**
+*	Computes matrices of four poses starting at index i, see computeTransform().
+*/
+static void computeTransforms4(const TransformArrays &transforms, unsigned int i, const glm::mat4 &viewMatrix, glm::mat4 *modelMatrices, glm::mat4 *normalMatrices) {
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	__m128 zx = _mm_sub_ps(zero, _mm_loadu_ps(&transforms.frontX[i]));
+	__m128 zy = _mm_sub_ps(zero, _mm_loadu_ps(&transforms.frontY[i]));
+	__m128 zz = _mm_sub_ps(zero, _mm_loadu_ps(&transforms.frontZ[i]));
+	__m128 length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(zx, zx), _mm_mul_ps(zy, zy)), _mm_mul_ps(zz, zz));
+	__m128 isNull = _mm_cmpeq_ps(length2, zero);
+	__m128 inverseLength = _mm_div_ps(one, _mm_sqrt_ps(length2));
+	zx = selectPs(isNull, zero, _mm_mul_ps(zx, inverseLength));
+	zy = selectPs(isNull, zero, _mm_mul_ps(zy, inverseLength));
+	zz = selectPs(isNull, one, _mm_mul_ps(zz, inverseLength));
+
+	__m128 ux = _mm_loadu_ps(&transforms.upX[i]);
+	__m128 uy = _mm_loadu_ps(&transforms.upY[i]);
+	__m128 uz = _mm_loadu_ps(&transforms.upZ[i]);
+	__m128 xx = _mm_sub_ps(_mm_mul_ps(uy, zz), _mm_mul_ps(uz, zy));
+	__m128 xy = _mm_sub_ps(_mm_mul_ps(uz, zx), _mm_mul_ps(ux, zz));
+	__m128 xz = _mm_sub_ps(_mm_mul_ps(ux, zy), _mm_mul_ps(uy, zx));
+	length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(xx, xx), _mm_mul_ps(xy, xy)), _mm_mul_ps(xz, xz));
+	isNull = _mm_cmpeq_ps(length2, zero);
+	inverseLength = _mm_div_ps(one, _mm_sqrt_ps(length2));
+	xx = selectPs(isNull, one, _mm_mul_ps(xx, inverseLength));
+	xy = selectPs(isNull, zero, _mm_mul_ps(xy, inverseLength));
+	xz = selectPs(isNull, zero, _mm_mul_ps(xz, inverseLength));
+
+	__m128 yx = _mm_sub_ps(_mm_mul_ps(zy, xz), _mm_mul_ps(zz, xy));
+	__m128 yy = _mm_sub_ps(_mm_mul_ps(zz, xx), _mm_mul_ps(zx, xz));
+	__m128 yz = _mm_sub_ps(_mm_mul_ps(zx, xy), _mm_mul_ps(zy, xx));
+
+	__m128 scale = _mm_loadu_ps(&transforms.scale[i]);
+	storeColumns(_mm_mul_ps(xx, scale), _mm_mul_ps(xy, scale), _mm_mul_ps(xz, scale), zero, modelMatrices + i, 0);
+	storeColumns(_mm_mul_ps(yx, scale), _mm_mul_ps(yy, scale), _mm_mul_ps(yz, scale), zero, modelMatrices + i, 1);
+	storeColumns(_mm_mul_ps(zx, scale), _mm_mul_ps(zy, scale), _mm_mul_ps(zz, scale), zero, modelMatrices + i, 2);
+	storeColumns(_mm_loadu_ps(&transforms.positionX[i]), _mm_loadu_ps(&transforms.positionY[i]), _mm_loadu_ps(&transforms.positionZ[i]), one, modelMatrices + i, 3);
+
+	if (normalMatrices == NULL)
+		return;
+
+	// view * axis / scale, the view matrix entries are broadcast to all lanes, scales <= 0 give zero
+	__m128 inverseScale = selectPs(_mm_cmple_ps(scale, zero), zero, _mm_div_ps(one, scale));
+	__m128 axes[3][3] = { { xx, xy, xz }, { yx, yy, yz }, { zx, zy, zz } };
+	for (int c = 0; c < 3; c++) {
+		__m128 ax = _mm_mul_ps(axes[c][0], inverseScale);
+		__m128 ay = _mm_mul_ps(axes[c][1], inverseScale);
+		__m128 az = _mm_mul_ps(axes[c][2], inverseScale);
+
+		__m128 rows[3];
+		for (int r = 0; r < 3; r++) {
+			rows[r] = _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(_mm_set1_ps(viewMatrix[0][r]), ax),
+				_mm_mul_ps(_mm_set1_ps(viewMatrix[1][r]), ay)),
+				_mm_mul_ps(_mm_set1_ps(viewMatrix[2][r]), az));
+		}
+		storeColumns(rows[0], rows[1], rows[2], zero, normalMatrices + i, c);
+	}
+	storeColumns(zero, zero, zero, one, normalMatrices + i, 3);
+}
+
+#endif
+
+/**
+*	Computes model matrices and inverse transposed view * model matrices of all poses.
+*	\param[in]  transforms     Poses.
+*	\param[in]  viewMatrix     Rigid view matrix (rotation and translation only).
+*	\param[out] modelMatrices  Model matrix of each pose.
+*	\param[out] normalMatrices Normal matrix of each pose or NULL if not needed.
+*/
+void computeTransforms(const TransformArrays &transforms, const glm::mat4 &viewMatrix, glm::mat4 *modelMatrices, glm::mat4 *normalMatrices) {
+	unsigned int i = 0;
+
+#ifdef TRANSFORMS_SSE
+	for (; i + TRANSFORM_BATCH_WIDTH <= transforms.count; i += TRANSFORM_BATCH_WIDTH)
+		computeTransforms4(transforms, i, viewMatrix, modelMatrices, normalMatrices);
+#endif
+
+	// remaining poses
+	for (; i < transforms.count; i++)
+		computeTransform(transforms, i, viewMatrix, modelMatrices + i, normalMatrices != NULL ? normalMatrices + i : NULL);
+}
@@ -0,0 +1,42 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       transforms.h
+* \author     agent
+* \date       2026
+* \brief      Model and normal matrices of many objects computed in SIMD batches.
+*
+*	Poses of the objects (position, front and up direction, uniform scale) are kept
+*	in structure of arrays, so four objects are transformed by one SSE instruction.
+*	The model matrix of a pose is alignObject(position, front, up) * scale(scale).
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#ifndef __TRANSFORMS_H
+#define __TRANSFORMS_H
+
+#include "pgr.h"
+#include <vector>
+
+// number of poses computed by one iteration of the SIMD loop
+#define TRANSFORM_BATCH_WIDTH 4
+
+/**
+*	struct for poses of objects in structure of arrays
+*
+*/
+typedef struct TransformArrays {
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> frontX, frontY, frontZ;
+	std::vector<float> upX, upY, upZ;
+	std::vector<float> scale;
+	unsigned int       count;
+} TransformArrays;
+
+void clearTransforms(TransformArrays *transforms);
+unsigned int addTransform(TransformArrays *transforms, const glm::vec3 &position, const glm::vec3 &front, const glm::vec3 &up, float scale);
+
+glm::mat3 poseRotation(const glm::vec3 &front, const glm::vec3 &up);
+void computeTransforms(const TransformArrays &transforms, const glm::mat4 &viewMatrix, glm::mat4 *modelMatrices, glm::mat4 *normalMatrices);
+
+#endif
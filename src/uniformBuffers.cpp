@@ -0,0 +1,89 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       uniformBuffers.cpp
+* \author     agent
+* \date       2026
+* \brief      Uniform buffer objects shared by all shader programs.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#include <stddef.h>
+#include "pgr.h"
+#include "uniformBuffers.h"
+#include "lightClusters.h"
+
+// std140 offsets of the block members
+static_assert(offsetof(FrameUniforms, sunDirection) == 192 && offsetof(FrameUniforms, fogDensity) == 224 && sizeof(FrameUniforms) % 16 == 0, "FrameUniforms does not match std140 layout of FrameData");
+static_assert(offsetof(LightUniforms, clusterGrid) == 16 && sizeof(LightUniforms) == 32, "LightUniforms does not match std140 layout of LightData");
+
+static GLuint frameBufferObject = 0;
+static GLuint lightBufferObject = 0;
+
+/**
+*	Creates the uniform buffers and binds them to their binding points.
+*/
+void initializeUniformBuffers() {
+	glGenBuffers(1, &frameBufferObject);
+	glBindBuffer(GL_UNIFORM_BUFFER, frameBufferObject);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), NULL, GL_STREAM_DRAW);
+
+	glGenBuffers(1, &lightBufferObject);
+	glBindBuffer(GL_UNIFORM_BUFFER, lightBufferObject);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(LightUniforms), NULL, GL_STREAM_DRAW);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORMS_BINDING, frameBufferObject);
+	glBindBufferBase(GL_UNIFORM_BUFFER, LIGHT_UNIFORMS_BINDING, lightBufferObject);
+	CHECK_GL_ERROR();
+}
+
+/**
+*	Deletes the uniform buffers.
+*/
+void deleteUniformBuffers() {
+	glDeleteBuffers(1, &frameBufferObject);
+	glDeleteBuffers(1, &lightBufferObject);
+	frameBufferObject = 0;
+	lightBufferObject = 0;
+}
+
+/**
+*	Connects FrameData and LightData blocks of the program to the shared buffers, programs
+*	with LightData get the texture units of the light clusters too.
+*	Has to be called after the program is linked or loaded from its binary.
+*	\param[in] program Program, blocks it does not use are skipped.
+*/
+void bindUniformBlocks(GLuint program) {
+	GLuint frameBlock = glGetUniformBlockIndex(program, "FrameData");
+	if (frameBlock != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, frameBlock, FRAME_UNIFORMS_BINDING);
+
+	GLuint lightBlock = glGetUniformBlockIndex(program, "LightData");
+	if (lightBlock != GL_INVALID_INDEX) {
+		glUniformBlockBinding(program, lightBlock, LIGHT_UNIFORMS_BINDING);
+		setLightClusterSamplers(program);
+	}
+	CHECK_GL_ERROR();
+}
+
+/**
+*	Uploads per frame values, the previous content is orphaned.
+*	\param[in] frame Values of the frame.
+*/
+void uploadFrameUniforms(const FrameUniforms &frame) {
+	glBindBuffer(GL_UNIFORM_BUFFER, frameBufferObject);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), &frame, GL_STREAM_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+/**
+*	Uploads parameters of the light clusters of the frame, the previous content is orphaned.
+*	\param[in] lights Cluster grid and number of lights, see buildLightClusters().
+*/
+void uploadLightUniforms(const LightUniforms &lights) {
+	glBindBuffer(GL_UNIFORM_BUFFER, lightBufferObject);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(LightUniforms), &lights, GL_STREAM_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
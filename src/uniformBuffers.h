@@ -0,0 +1,57 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       uniformBuffers.h
+* \author     agent
+* \date       2026
+* \brief      Uniform buffer objects shared by all shader programs.
+*
+*	Values that are the same for every draw call of a frame (camera, sun, fog) and the
+*	parameters of the light clusters are uploaded once per frame into std140 uniform blocks.
+*	The structures below mirror the FrameData and LightData blocks of the shaders member by
+*	member. The lights themselves are in texture buffers, see lightClusters.h.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#ifndef __UNIFORMBUFFERS_H
+#define __UNIFORMBUFFERS_H
+
+#include "pgr.h"
+
+// binding points of the uniform blocks
+#define FRAME_UNIFORMS_BINDING 0
+#define LIGHT_UNIFORMS_BINDING 1
+
+/**
+*	struct for the FrameData uniform block
+*
+*/
+typedef struct FrameUniforms {
+	glm::mat4 viewMatrix;
+	glm::mat4 projectionMatrix;
+	glm::mat4 PVmatrix;          // projection * view
+	glm::vec4 sunDirection;      // direction to the sun in view space, w = 0
+	glm::vec4 fogColor;
+	float     fogDensity;
+	int       fogActive;
+	float     padding[2];
+} FrameUniforms;
+
+/**
+*	struct for the LightData uniform block
+*
+*/
+typedef struct LightUniforms {
+	glm::vec4 clusterScale;      // clusters per pixel in x and y, slices per log of the depth and the slice of depth 1
+	int       clusterGrid[3];    // number of clusters in x, y and z
+	int       numLights;
+} LightUniforms;
+
+void initializeUniformBuffers();
+void deleteUniformBuffers();
+void bindUniformBlocks(GLuint program);
+
+void uploadFrameUniforms(const FrameUniforms &frame);
+void uploadLightUniforms(const LightUniforms &lights);
+
+#endif
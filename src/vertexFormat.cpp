@@ -0,0 +1,224 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       vertexFormat.cpp
+* \author     agent
+* \date       2026
+* \brief      Vertex formats of loaded meshes.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#include <string.h>
+#include <math.h>
+#include "meshCache.h"
+#include "vertexFormat.h"
+
+// size of one vertex in the compact format
+#define COMPACT_VERTEX_SIZE 16
+
+/**
+*	Returns size of one vertex in bytes.
+*	\param[in] format MESH_FORMAT_FLOAT or MESH_FORMAT_COMPACT.
+*/
+unsigned int meshVertexSize(unsigned int format) {
+	return format == MESH_FORMAT_COMPACT ? COMPACT_VERTEX_SIZE : MESH_VERTEX_SIZE * sizeof(float);
+}
+
+/**
+*	Returns true if the driver can read GL_INT_2_10_10_10_REV vertex attributes (OpenGL 3.3).
+*	Otherwise compact normals are stored as three normalized bytes.
+*/
+static bool packedNormalsSupported() {
+	static int supported = -1;
+
+	if (supported < 0) {
+		GLint major = 0, minor = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &major);
+		glGetIntegerv(GL_MINOR_VERSION, &minor);
+		supported = (major > 3 || (major == 3 && minor >= 3)) ? 1 : 0;
+	}
+
+	return supported == 1;
+}
+
+/**
+*	Converts float to IEEE half float with rounding to nearest.
+*	\param[in] value Value to convert.
+*/
+unsigned short floatToHalf(float value) {
+	unsigned int bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	unsigned int sign = (bits >> 16) & 0x8000;
+	unsigned int floatExponent = (bits >> 23) & 0xFF;
+	unsigned int mantissa = bits & 0x7FFFFF;
+	int exponent = (int)floatExponent - 127 + 15;
+
+	// infinity or nan
+	if (floatExponent == 0xFF)
+		return (unsigned short)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+
+	// overflow to infinity
+	if (exponent >= 31)
+		return (unsigned short)(sign | 0x7C00);
+
+	// denormalized half or zero
+	if (exponent <= 0) {
+		if (exponent < -10)
+			return (unsigned short)sign;
+
+		mantissa |= 0x800000;
+		unsigned int shift = 14 - exponent;
+		unsigned int half = mantissa >> shift;
+		if ((mantissa >> (shift - 1)) & 1)
+			half++;
+		return (unsigned short)(sign | half);
+	}
+
+	// rounding may carry into the exponent, which gives the correct result
+	unsigned int half = sign | (exponent << 10) | (mantissa >> 13);
+	if (mantissa & 0x1000)
+		half++;
+
+	return (unsigned short)half;
+}
+
+/**
+*	Converts float from [-1, 1] to signed normalized integer with given maximum.
+*/
+static int toSnorm(float value, float maximum) {
+	if (value > 1.0f) value = 1.0f;
+	if (value < -1.0f) value = -1.0f;
+
+	return (int)floor(value * maximum + 0.5f);
+}
+
+/**
+*	Converts interleaved float vertices |VVVNNNTT| to the vertex format.
+*	\param[in]  vertices    Interleaved float vertices.
+*	\param[in]  numVertices Number of vertices.
+*	\param[in]  format      Target vertex format.
+*	\param[out] packed      Vertices in the target format.
+*/
+void packMeshVertices(const float *vertices, unsigned int numVertices, unsigned int format, std::vector<unsigned char> *packed) {
+
+	unsigned int vertexSize = meshVertexSize(format);
+	packed->resize((size_t)vertexSize * numVertices);
+
+	if (numVertices == 0)
+		return;
+
+	if (format != MESH_FORMAT_COMPACT) {
+		memcpy(&(*packed)[0], vertices, packed->size());
+		return;
+	}
+
+	bool packedNormals = packedNormalsSupported();
+
+	for (unsigned int v = 0; v < numVertices; v++) {
+		const float *vertex = vertices + MESH_VERTEX_SIZE * v;
+		unsigned char *out = &(*packed)[(size_t)vertexSize * v];
+
+		// position: 4 x normalized short (the last one is padding)
+		short position[4];
+		for (int i = 0; i < 3; i++)
+			position[i] = (short)toSnorm(vertex[i], 32767.0f);
+		position[3] = 0;
+		memcpy(out, position, sizeof(position));
+
+		// normal: 10 bits per component or 3 x normalized byte
+		if (packedNormals) {
+			unsigned int normal = ((unsigned int)toSnorm(vertex[3], 511.0f) & 0x3FF)
+				| (((unsigned int)toSnorm(vertex[4], 511.0f) & 0x3FF) << 10)
+				| (((unsigned int)toSnorm(vertex[5], 511.0f) & 0x3FF) << 20);
+			memcpy(out + 8, &normal, sizeof(normal));
+		}
+		else {
+			signed char normal[4];
+			for (int i = 0; i < 3; i++)
+				normal[i] = (signed char)toSnorm(vertex[3 + i], 127.0f);
+			normal[3] = 0;
+			memcpy(out + 8, normal, sizeof(normal));
+		}
+
+		// texture coordinates: 2 x half float, they may be outside of [0, 1] (repeated textures)
+		unsigned short texCoord[2];
+		texCoord[0] = floatToHalf(vertex[6]);
+		texCoord[1] = floatToHalf(vertex[7]);
+		memcpy(out + 12, texCoord, sizeof(texCoord));
+	}
+}
+
+/**
+*	Stores indices as 16-bit whenever all vertices can be addressed, 32-bit otherwise.
+*	\param[in]  indices     Triangle indices.
+*	\param[in]  numIndices  Number of indices.
+*	\param[in]  numVertices Number of vertices referenced by the indices.
+*	\param[out] packed      Indices of the returned type.
+*	\return GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+*/
+GLenum packMeshIndices(const unsigned int *indices, unsigned int numIndices, unsigned int numVertices, std::vector<unsigned char> *packed) {
+
+	if (numVertices > 65536) {
+		packed->resize(numIndices * sizeof(unsigned int));
+		if (numIndices > 0)
+			memcpy(&(*packed)[0], indices, packed->size());
+		return GL_UNSIGNED_INT;
+	}
+
+	packed->resize(numIndices * sizeof(unsigned short));
+	for (unsigned int i = 0; i < numIndices; i++) {
+		unsigned short index = (unsigned short)indices[i];
+		memcpy(&(*packed)[i * sizeof(unsigned short)], &index, sizeof(index));
+	}
+
+	return GL_UNSIGNED_SHORT;
+}
+
+/**
+*	Returns size of one index in bytes.
+*	\param[in] indexType GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+*/
+unsigned int indexTypeSize(GLenum indexType) {
+	return indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+}
+
+/**
+*	Connects vertices of the format in the bound vertex buffer to the shader inputs of the bound vao.
+*	Attributes the program does not use have location -1 and are skipped.
+*	\param[in] format           Vertex format.
+*	\param[in] posLocation      Location of the position attribute.
+*	\param[in] normalLocation   Location of the normal attribute.
+*	\param[in] texCoordLocation Location of the texture coordinates attribute.
+*/
+void setVertexFormatAttributes(unsigned int format, GLint posLocation, GLint normalLocation, GLint texCoordLocation) {
+	const GLsizei stride = meshVertexSize(format);
+	const bool compact = format == MESH_FORMAT_COMPACT;
+
+	if (posLocation >= 0) {
+		glEnableVertexAttribArray(posLocation);
+		if (compact)
+			glVertexAttribPointer(posLocation, 3, GL_SHORT, GL_TRUE, stride, 0);
+		else
+			glVertexAttribPointer(posLocation, 3, GL_FLOAT, GL_FALSE, stride, 0);
+	}
+
+	if (normalLocation >= 0) {
+		glEnableVertexAttribArray(normalLocation);
+		if (compact && packedNormalsSupported())
+			glVertexAttribPointer(normalLocation, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)8);
+		else if (compact)
+			glVertexAttribPointer(normalLocation, 4, GL_BYTE, GL_TRUE, stride, (void*)8);
+		else
+			glVertexAttribPointer(normalLocation, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+	}
+
+	if (texCoordLocation >= 0) {
+		glEnableVertexAttribArray(texCoordLocation);
+		if (compact)
+			glVertexAttribPointer(texCoordLocation, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)12);
+		else
+			glVertexAttribPointer(texCoordLocation, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
+	}
+	CHECK_GL_ERROR();
+}
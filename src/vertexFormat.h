@@ -0,0 +1,33 @@
+//----------------------------------------------------------------------------------------
+/**
+* \file       vertexFormat.h
+* \author     agent
+* \date       2026
+* \brief      Vertex formats of loaded meshes.
+*
+*	MESH_FORMAT_FLOAT   32 B per vertex: float position, float normal, float uv.
+*	MESH_FORMAT_COMPACT 16 B per vertex: normalized 16-bit position, packed 10-bit normal,
+*	                    half float uv. Positions must be inside (-1..1)^3.
+*
+*/
+//----------------------------------------------------------------------------------------
+
+#ifndef __VERTEXFORMAT_H
+#define __VERTEXFORMAT_H
+
+#include "pgr.h"
+#include <vector>
+
+#define MESH_FORMAT_FLOAT   0
+#define MESH_FORMAT_COMPACT 1
+
+unsigned int meshVertexSize(unsigned int format);
+unsigned short floatToHalf(float value);
+
+void packMeshVertices(const float *vertices, unsigned int numVertices, unsigned int format, std::vector<unsigned char> *packed);
+GLenum packMeshIndices(const unsigned int *indices, unsigned int numIndices, unsigned int numVertices, std::vector<unsigned char> *packed);
+unsigned int indexTypeSize(GLenum indexType);
+
+void setVertexFormatAttributes(unsigned int format, GLint posLocation, GLint normalLocation, GLint texCoordLocation);
+
+#endif